@@ -0,0 +1,46 @@
+#ifndef CORE_ARENA_H
+#define CORE_ARENA_H
+
+#include "defines.h"
+#include "memory.h"
+
+#define ARENA_DEFAULT_ALIGNMENT 16
+
+typedef struct arena_block_t {
+    struct arena_block_t* next;
+    u64 capacity;
+    u64 offset;
+} arena_block_t;
+
+// Linear allocator over a chain of blocks. Allocation bumps an offset, and
+// resetting to a marker is O(1): blocks past the marker are kept and reused
+// by later allocations rather than freed, so a frame or import arena stops
+// touching the system allocator once it has warmed up.
+typedef struct {
+    arena_block_t* first;
+    arena_block_t* current;
+    u64 block_size;
+    u64 used;
+    u64 peak;
+    memory_tag_t tag;
+} arena_t;
+
+typedef struct {
+    arena_block_t* block;
+    u64 offset;
+    u64 used;
+} arena_marker_t;
+
+void arena_init(arena_t* arena, u64 block_size, memory_tag_t tag);
+void arena_destroy(arena_t* arena);
+
+void* arena_alloc(arena_t* arena, u64 size);
+void* arena_alloc_aligned(arena_t* arena, u64 size, u64 alignment);
+void* arena_alloc_zeroed(arena_t* arena, u64 size);
+#define arena_push_array(arena, T, count) ((T*) arena_alloc_aligned((arena), sizeof(T) * (count), _Alignof(T)))
+
+arena_marker_t arena_mark(const arena_t* arena);
+void arena_reset_to(arena_t* arena, arena_marker_t marker);
+void arena_reset(arena_t* arena);
+
+#endif
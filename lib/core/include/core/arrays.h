@@ -2,17 +2,25 @@
 #define CORE_ARRAYS_H
 
 
-#include <stdlib.h>
 #include "defines.h"
+#include "memory.h"
 
-#define OVERALLOC 8
+#define ARRAY_MIN_CAPACITY 8
 
-void ensure_capacity_overalloc(void** parray, u64* arr_size, u64 ensure_size, u64 elem_size) {
-    if (*arr_size < ensure_size) {
-        u64 new_len = (ensure_size + OVERALLOC);
-        *parray = realloc(*parray, new_len * elem_size);
-        *arr_size = new_len;
-    }
-}
+// Typed growable array, e.g. ARRAY(u32) indices = {0}; array_push(&indices, 7);
+#define ARRAY(T) struct { T* data; u64 count; u64 capacity; }
 
-#endif
\ No newline at end of file
+#define array_reserve(arr, n) array_grow((void**) &(arr)->data, &(arr)->capacity, (n), sizeof(*(arr)->data))
+#define array_push(arr, value) \
+    (array_reserve((arr), (arr)->count + 1), (arr)->data[(arr)->count++] = (value))
+#define array_pop(arr) ((arr)->data[--(arr)->count])
+#define array_clear(arr) ((arr)->count = 0)
+#define array_free(arr)                                                                           \
+    (memory_free((arr)->data, (arr)->capacity * sizeof(*(arr)->data), MEMORY_TAG_ARRAY), (arr)->data = 0, \
+     (arr)->count = 0, (arr)->capacity = 0)
+
+// Grows *parray to hold at least ensure_size elements, doubling so repeated
+// appends stay amortised O(1).
+void array_grow(void** parray, u64* capacity, u64 ensure_size, u64 elem_size);
+
+#endif
@@ -7,4 +7,8 @@ u32 bitmask_flags_set_on(u32 mask, u32 bit_index);
 u32 bitmask_flags_set_off(u32 mask, u32 bit_index);
 u32 bitmask_flags_get(u32 mask, u32 bit_index);
 
+// Index of the lowest / highest set bit, value must not be 0.
+u32 bit_lowest_set(u64 value);
+u32 bit_highest_set(u64 value);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef CORE_BLOCK_POOL_H
+#define CORE_BLOCK_POOL_H
+
+#include "defines.h"
+#include "memory.h"
+
+// Fixed size blocks carved from one allocation. Free blocks hold the link to
+// the next free block, so alloc and free are O(1) with no per block overhead.
+typedef struct {
+    u8* memory;
+    void* free_list;
+    u64 block_size;
+    u32 block_count;
+    u32 free_count;
+    memory_tag_t tag;
+} block_pool_t;
+
+b8 block_pool_init(block_pool_t* pool, u64 block_size, u32 block_count, memory_tag_t tag);
+void block_pool_destroy(block_pool_t* pool);
+
+// Returns null when every block is taken.
+void* block_pool_alloc(block_pool_t* pool);
+void block_pool_free(block_pool_t* pool, void* block);
+b8 block_pool_owns(const block_pool_t* pool, const void* block);
+
+#endif
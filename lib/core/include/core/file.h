@@ -0,0 +1,69 @@
+#ifndef CORE_FILE_H
+#define CORE_FILE_H
+
+#include "defines.h"
+
+typedef enum {
+    FILE_OK = 0,
+    FILE_ERR_NOT_FOUND,
+    FILE_ERR_ACCESS,
+    FILE_ERR_IO,
+    FILE_ERR_NO_MEMORY,
+    FILE_ERR_TOO_LARGE,
+} file_result_t;
+
+// Whole file in one allocation. data is followed by a zero byte so text can
+// be parsed in place; size does not count it.
+typedef struct {
+    u8* data;
+    u64 size;
+} file_buffer_t;
+
+// Read only mapping of a whole file, pages fault in on first touch.
+typedef struct {
+    const u8* data;
+    u64 size;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+} file_map_t;
+
+// Sequential reader over a caller supplied buffer, never allocates.
+typedef struct {
+#ifdef _WIN32
+    void* handle;
+#else
+    int fd;
+#endif
+    u8* buffer;
+    u64 capacity;
+    u64 begin;
+    u64 end;
+    u64 offset;
+    b8 eof;
+} file_stream_t;
+
+const char* file_result_str(file_result_t result);
+
+file_result_t file_size(const char* path, u64* out_size);
+file_result_t file_read_all(const char* path, file_buffer_t* out);
+void file_buffer_free(file_buffer_t* buffer);
+// Writes to a sibling temp file and renames it over path, so readers see
+// either the old contents or the new ones, never a torn file. Returns once
+// both the data and the rename are on disk.
+file_result_t file_write_atomic(const char* path, const void* data, u64 size);
+
+file_result_t file_map(const char* path, file_map_t* out);
+void file_unmap(file_map_t* map);
+// Hint that the whole mapping is about to be read.
+void file_map_prefetch(const file_map_t* map);
+
+file_result_t file_stream_open(const char* path, void* buffer, u64 capacity, file_stream_t* out);
+// Copies up to size bytes, *out_read is 0 only at the end of the file.
+file_result_t file_stream_read(file_stream_t* stream, void* dst, u64 size, u64* out_read);
+// Zero copy variant: hands out the next buffered chunk, valid until the next call.
+file_result_t file_stream_next(file_stream_t* stream, const u8** out_chunk, u64* out_size);
+void file_stream_close(file_stream_t* stream);
+
+#endif
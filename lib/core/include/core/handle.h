@@ -3,10 +3,16 @@
 
 #include "defines.h"
 
+// Generation 0 is never handed out, so a zeroed handle is always invalid.
 typedef struct {
-    u64 index;
+    u32 index;
+    u32 generation;
 } handle_t;
 
-handle_t handle_create(u64 index);
+#define HANDLE_INVALID ((handle_t) {0, 0})
 
-#endif
\ No newline at end of file
+handle_t handle_create(u32 index, u32 generation);
+b8 handle_is_valid(handle_t handle);
+b8 handle_equal(handle_t a, handle_t b);
+
+#endif
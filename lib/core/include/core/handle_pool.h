@@ -0,0 +1,43 @@
+#ifndef CORE_HANDLE_POOL_H
+#define CORE_HANDLE_POOL_H
+
+#include "defines.h"
+#include "handle.h"
+
+// Generational slot map. Items live packed in dense storage; handles point at
+// a sparse slot that records where the item currently sits and the
+// generation it was issued with. Removing swaps the last item into the hole
+// and bumps the slot generation, so stale handles fail every lookup. Free
+// slots are threaded through the sparse array as a list.
+typedef struct {
+    u8* dense;
+    u32* dense_slots;
+    u32* slots;
+    u32* generations;
+    u64 item_size;
+    u32 count;
+    u32 capacity;
+    u32 slot_count;
+    u32 slot_capacity;
+    u32 free_head;
+} handle_pool_t;
+
+void handle_pool_init(handle_pool_t* pool, u64 item_size, u32 initial_capacity);
+void handle_pool_destroy(handle_pool_t* pool);
+
+// Copies item into the pool, item may be null to zero initialise.
+handle_t handle_pool_insert(handle_pool_t* pool, const void* item);
+// Copies the item out before removing it when out_item is not null.
+b8 handle_pool_remove(handle_pool_t* pool, handle_t handle, void* out_item);
+void handle_pool_clear(handle_pool_t* pool);
+
+b8 handle_pool_contains(const handle_pool_t* pool, handle_t handle);
+// Pointers stay valid until the next insert or remove.
+void* handle_pool_get(const handle_pool_t* pool, handle_t handle);
+
+// Dense iteration, in no particular order.
+u32 handle_pool_count(const handle_pool_t* pool);
+void* handle_pool_at(const handle_pool_t* pool, u32 dense_index);
+handle_t handle_pool_handle_at(const handle_pool_t* pool, u32 dense_index);
+
+#endif
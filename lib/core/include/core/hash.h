@@ -0,0 +1,9 @@
+#ifndef CORE_HASH_H
+#define CORE_HASH_H
+
+#include "defines.h"
+
+u64 hash_bytes(const void* data, u64 size, u64 seed);
+u64 hash_combine(u64 a, u64 b);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef CORE_HASH_MAP_H
+#define CORE_HASH_MAP_H
+
+#include "defines.h"
+
+#define HASH_MAP_EMPTY 0xFFFFFFFFu
+
+// Open addressed u64 -> u32 map with linear probing, meant for mapping hashes
+// to indices into a side array. Values must not be HASH_MAP_EMPTY. Keys are
+// used as is, so they should already be well mixed.
+typedef struct {
+    u64* keys;
+    u32* values;
+    u64 capacity;
+    u64 count;
+} hash_map_t;
+
+void hash_map_init(hash_map_t* map, u64 initial_capacity);
+void hash_map_destroy(hash_map_t* map);
+
+// Returns HASH_MAP_EMPTY when the key is not present.
+u32 hash_map_get(const hash_map_t* map, u64 key);
+// Inserts or overwrites.
+void hash_map_set(hash_map_t* map, u64 key, u32 value);
+b8 hash_map_remove(hash_map_t* map, u64 key);
+void hash_map_clear(hash_map_t* map);
+
+#endif
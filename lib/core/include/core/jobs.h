@@ -0,0 +1,49 @@
+#ifndef CORE_JOBS_H
+#define CORE_JOBS_H
+
+#include "defines.h"
+
+#include <stdatomic.h>
+
+// Fixed capacity of every per thread job ring and deque.
+#define JOB_QUEUE_CAPACITY 4096u
+
+// Jobs receive the range they cover, single jobs get [0, 1).
+typedef void (*job_fn_t)(void* data, u32 begin, u32 end);
+
+// Counts jobs still in flight. Waiting on it is how fork/join is expressed:
+// submit several jobs against one counter, then job_wait on it.
+typedef struct {
+    _Atomic u32 pending;
+} job_counter_t;
+
+typedef struct {
+    job_fn_t fn;
+    void* data;
+    u32 begin;
+    u32 end;
+} job_desc_t;
+
+// Starts worker_count background workers. The thread calling
+// job_system_init becomes an extra participant: it runs jobs whenever it is
+// inside job_wait. Each thread owns a Chase-Lev deque it pushes and pops at
+// the bottom; idle threads steal from the top of the others. Returns the
+// number of workers running, fewer than asked for if the OS refused to start
+// a thread; jobs still run, on fewer threads.
+u32 job_system_init(u32 worker_count);
+void job_system_shutdown();
+u32 job_system_thread_count();
+// Index of the calling thread, 0 for the initialising thread, ~0u for
+// threads that do not belong to the job system.
+u32 job_system_thread_index();
+
+// Only job system threads can submit; anything else runs the jobs inline.
+void job_run(const job_desc_t* jobs, u32 count, job_counter_t* counter);
+void job_run_one(job_fn_t fn, void* data, job_counter_t* counter);
+// Splits [0, count) into batches of batch_size and runs fn over each.
+void job_parallel_for(job_fn_t fn, void* data, u32 count, u32 batch_size, job_counter_t* counter);
+
+// Runs other jobs until the counter drops to zero.
+void job_wait(job_counter_t* counter);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CORE_MEMORY_H
+#define CORE_MEMORY_H
+
+#include "defines.h"
+
+typedef enum {
+    MEMORY_TAG_UNKNOWN = 0,
+    MEMORY_TAG_ARRAY,
+    MEMORY_TAG_ARENA,
+    MEMORY_TAG_POOL,
+    MEMORY_TAG_HASH_MAP,
+    MEMORY_TAG_FILE,
+    MEMORY_TAG_MESH,
+    MEMORY_TAG_RENDERER,
+    MEMORY_TAG_PROFILER,
+    MEMORY_TAG_COUNT,
+} memory_tag_t;
+
+typedef struct {
+    u64 current[MEMORY_TAG_COUNT];
+    u64 peak[MEMORY_TAG_COUNT];
+    u64 allocations[MEMORY_TAG_COUNT];
+    u64 total_current;
+    u64 total_peak;
+} memory_stats_t;
+
+// Thin wrappers over the C allocator that keep per tag byte counts. Sizes
+// passed to memory_realloc and memory_free must match the allocation.
+void* memory_alloc(u64 size, memory_tag_t tag);
+void* memory_alloc_zeroed(u64 size, memory_tag_t tag);
+void* memory_realloc(void* ptr, u64 old_size, u64 new_size, memory_tag_t tag);
+void memory_free(void* ptr, u64 size, memory_tag_t tag);
+
+void memory_get_stats(memory_stats_t* out);
+const char* memory_tag_str(memory_tag_t tag);
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef CORE_MESH_FORMAT_H
+#define CORE_MESH_FORMAT_H
+
+#include "defines.h"
+
+// Compiled mesh container, shared by the asset compiler (writer) and the
+// engine (reader). Layout, all little-endian:
+//   mesh_file_header_t
+//   mesh_file_section_t[section_count]   at header.sections_offset
+//   section payloads                     each at a 16 byte aligned offset
+// The checksum covers every byte after the header.
+
+#define MESH_FORMAT_MAGIC 0x48534D50u // "PMSH"
+#define MESH_FORMAT_VERSION 4u
+#define MESH_FORMAT_ALIGNMENT 16u
+
+// Bit indices of mesh_file_header_t.features.
+#define MESH_FEATURE_BIT_INDICES 0
+#define MESH_FEATURE_BIT_TEX_COORDS 1
+#define MESH_FEATURE_BIT_NORMALS 2
+#define MESH_FEATURE_BIT_TANGENTS 3
+
+typedef enum {
+    MESH_SECTION_POSITIONS = 1,
+    MESH_SECTION_INDICES = 2,
+    MESH_SECTION_NORMALS = 3,
+    MESH_SECTION_TANGENTS = 4,
+    MESH_SECTION_TEX_COORDS = 5,
+    MESH_SECTION_BOUNDS = 6,
+    MESH_SECTION_LODS = 7,
+    MESH_SECTION_MESHLETS = 8,
+    MESH_SECTION_MESHLET_VERTICES = 9,
+    MESH_SECTION_MESHLET_TRIANGLES = 10,
+    MESH_SECTION_MESHLET_BOUNDS = 11,
+    MESH_SECTION_SUBMESHES = 12,
+    MESH_SECTION_NODES = 13,
+    MESH_SECTION_NODE_MESHES = 14,
+    MESH_SECTION_NODE_TRANSFORMS = 15,
+} mesh_section_type_t;
+
+#define MESH_LOD_MAX 8
+#define MESH_MESHLET_MAX_VERTICES 255
+#define MESH_NODE_TRANSFORM_PLANES 10
+
+// How a section's elements are stored.
+//   UNORM16_POSITION: u16 x, y, z, pad, dequantised with mesh_file_bounds_t
+//   OCT16_NORMAL:     i16 x, y octahedral, snorm
+//   OCT16_TANGENT:    as OCT16_NORMAL, but y carries 15 bits and its lowest
+//                     bit is set when the bitangent sign (w) is negative
+//   F16_TEX_COORD:    half u, v
+typedef enum {
+    MESH_ENCODING_RAW = 0,
+    MESH_ENCODING_F32,
+    MESH_ENCODING_UNORM16_POSITION,
+    MESH_ENCODING_OCT16_NORMAL,
+    MESH_ENCODING_OCT16_TANGENT,
+    MESH_ENCODING_F16_TEX_COORD,
+    MESH_ENCODING_U16_INDEX,
+    MESH_ENCODING_U32_INDEX,
+} mesh_encoding_t;
+
+typedef enum {
+    MESH_FORMAT_OK = 0,
+    MESH_FORMAT_ERR_IO,
+    MESH_FORMAT_ERR_TRUNCATED,
+    MESH_FORMAT_ERR_MAGIC,
+    MESH_FORMAT_ERR_VERSION,
+    MESH_FORMAT_ERR_SECTION,
+    MESH_FORMAT_ERR_CHECKSUM,
+} mesh_format_result_t;
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 features;
+    u32 section_count;
+    u64 file_size;
+    u64 checksum;
+    u64 sections_offset;
+    u64 reserved;
+} mesh_file_header_t;
+
+typedef struct {
+    u16 type;
+    u16 encoding;
+    u32 stride;
+    u64 count;
+    u64 offset;
+    u64 size;
+} mesh_file_section_t;
+
+// Payload of MESH_SECTION_BOUNDS, one entry per submesh in the same order as
+// MESH_SECTION_SUBMESHES. A submesh's quantised positions decode as
+// min + q * dequant_scale of its own entry.
+typedef struct {
+    f32 min[3];
+    f32 radius;
+    f32 max[3];
+    f32 pad;
+    f32 dequant_scale[3];
+    f32 pad2;
+} mesh_file_bounds_t;
+
+// Payload of MESH_SECTION_LODS, one entry per level, finest first, grouped by
+// submesh. Ranges index into MESH_SECTION_INDICES and share the submesh's
+// vertices. error is the
+// object space deviation from the source mesh; on screen it spans
+// error * projection_scale / distance pixels.
+typedef struct {
+    u32 index_offset;
+    u32 index_count;
+    f32 error;
+    f32 pad;
+} mesh_file_lod_t;
+
+// Payload of MESH_SECTION_MESHLETS. vertex_offset indexes
+// MESH_SECTION_MESHLET_VERTICES (u32 absolute vertex indices); triangle_offset is a
+// byte offset into MESH_SECTION_MESHLET_TRIANGLES, three u8 local indices per
+// triangle, each meshlet padded to 4 bytes.
+typedef struct {
+    u32 vertex_offset;
+    u32 triangle_offset;
+    u32 vertex_count;
+    u32 triangle_count;
+} mesh_file_meshlet_t;
+
+// Payload of MESH_SECTION_MESHLET_BOUNDS, parallel to the meshlets. A meshlet
+// is backfacing for a camera at c when
+// dot(normalize(cone_apex - c), cone_axis) >= cone_cutoff.
+typedef struct {
+    f32 center[3];
+    f32 radius;
+    f32 cone_apex[3];
+    f32 cone_cutoff;
+    f32 cone_axis[3];
+    f32 pad;
+} mesh_file_meshlet_bounds_t;
+
+// Payload of MESH_SECTION_SUBMESHES. All submeshes share the vertex and index
+// pools; indices are relative to vertex_offset, so draws pass it as the base
+// vertex. The index range covers every LOD of the submesh, lod_offset and
+// meshlet_offset index the LODS and MESHLETS sections.
+typedef struct {
+    u32 vertex_offset;
+    u32 vertex_count;
+    u32 index_offset;
+    u32 index_count;
+    u32 lod_offset;
+    u32 lod_count;
+    u32 meshlet_offset;
+    u32 meshlet_count;
+    f32 center[3];
+    f32 radius;
+    u32 material_index;
+    u32 pad[3];
+} mesh_file_submesh_t;
+
+// Payload of MESH_SECTION_NODES in depth first order, so a parent always
+// precedes its children. mesh_offset indexes MESH_SECTION_NODE_MESHES, a list
+// of u32 submesh indices.
+typedef struct {
+    i32 parent;
+    u32 mesh_offset;
+    u32 mesh_count;
+    u32 pad;
+} mesh_file_node_t;
+
+// MESH_SECTION_NODE_TRANSFORMS holds the local transforms as
+// MESH_NODE_TRANSFORM_PLANES arrays of node_count floats each.
+typedef enum {
+    MESH_NODE_TRANSLATION_X = 0,
+    MESH_NODE_TRANSLATION_Y,
+    MESH_NODE_TRANSLATION_Z,
+    MESH_NODE_ROTATION_X,
+    MESH_NODE_ROTATION_Y,
+    MESH_NODE_ROTATION_Z,
+    MESH_NODE_ROTATION_W,
+    MESH_NODE_SCALE_X,
+    MESH_NODE_SCALE_Y,
+    MESH_NODE_SCALE_Z,
+} mesh_node_plane_t;
+
+_Static_assert(sizeof(mesh_file_header_t) % MESH_FORMAT_ALIGNMENT == 0, "header must keep sections aligned");
+_Static_assert(sizeof(mesh_file_section_t) % MESH_FORMAT_ALIGNMENT == 0, "section entries must stay aligned");
+_Static_assert(sizeof(mesh_file_bounds_t) % MESH_FORMAT_ALIGNMENT == 0, "bounds must stay aligned");
+_Static_assert(sizeof(mesh_file_submesh_t) % MESH_FORMAT_ALIGNMENT == 0, "submeshes must stay aligned");
+
+u64 mesh_format_align(u64 offset);
+u64 mesh_format_checksum(const void* data, u64 size);
+mesh_format_result_t mesh_format_validate(const void* data, u64 size, b8 verify_checksum);
+const mesh_file_section_t* mesh_format_find_section(const void* data, u32 type);
+const char* mesh_format_result_str(mesh_format_result_t result);
+
+// projection_scale is viewport_height / (2 * tan(fov_y / 2)).
+u32 mesh_format_select_lod(const mesh_file_lod_t* lods, u32 lod_count, f32 distance, f32 projection_scale,
+                           f32 pixel_threshold);
+
+u32 mesh_format_encoding_stride(u16 encoding, u32 components);
+void mesh_format_encode_position(const f32 p[3], const mesh_file_bounds_t* bounds, u16 out[4]);
+void mesh_format_encode_normal(const f32 n[3], i16 out[2]);
+void mesh_format_encode_tangent(const f32 t[4], i16 out[2]);
+void mesh_format_decode_position(const void* element, u16 encoding, const mesh_file_bounds_t* bounds, f32 out[3]);
+void mesh_format_decode_normal(const void* element, u16 encoding, f32 out[3]);
+void mesh_format_decode_tangent(const void* element, u16 encoding, f32 out[4]);
+void mesh_format_decode_tex_coord(const void* element, u16 encoding, f32 out[2]);
+u32 mesh_format_decode_index(const void* indices, u16 encoding, u64 i);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef CORE_PROFILER_H
+#define CORE_PROFILER_H
+
+#include "defines.h"
+
+// Completed zones each thread keeps, the oldest are overwritten first.
+#define PROFILER_THREAD_CAPACITY 65536u
+#define PROFILER_MAX_THREADS 64u
+// Zones open at once on one thread. Deeper zones are dropped.
+#define PROFILER_MAX_DEPTH 64u
+#define PROFILER_NAME_LENGTH 32u
+#define PROFILER_NO_TRACK 0xffffffffu
+
+// Scoped CPU zones. Every thread records into a ring of its own, so a zone
+// costs two clock reads and no locking. Zones nest: each PROFILE_BEGIN must
+// be matched by a PROFILE_END on the same thread. Names are stored by
+// pointer and must outlive the capture, string literals are the usual case.
+//
+// Zones are only compiled in with PTIA_PROFILE defined (the POTENTIA_PROFILE
+// CMake option); without it the macros expand to nothing and the functions
+// below record an empty capture.
+#ifdef PTIA_PROFILE
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END() profiler_end()
+#define PROFILE_FUNCTION_BEGIN() profiler_begin(__func__)
+#define PROFILE_THREAD_NAME(name) profiler_set_thread_name(name)
+#else
+#define PROFILE_BEGIN(name) ((void) 0)
+#define PROFILE_END() ((void) 0)
+#define PROFILE_FUNCTION_BEGIN() ((void) 0)
+#define PROFILE_THREAD_NAME(name) ((void) 0)
+#endif
+
+// Sets the time every capture is relative to. Calling it is optional, the
+// first zone does the same.
+void profiler_init();
+// Frees every thread's ring. No thread may be inside a zone.
+void profiler_shutdown();
+
+// Monotonic nanoseconds.
+u64 profiler_now();
+
+void profiler_begin(const char* name);
+void profiler_end();
+// Copied, shows up as the thread's name in the trace.
+void profiler_set_thread_name(const char* name);
+
+// A track is a timeline of its own for zones timed elsewhere, GPU work for
+// instance, with start and end already converted to profiler_now time.
+// Zones on a track may come from one thread at a time and in any order.
+// Tracks last until profiler_shutdown; PROFILER_NO_TRACK when there is no
+// room for another.
+u32 profiler_track_create(const char* name);
+void profiler_track_zone(u32 track, const char* name, u64 start, u64 end);
+
+// Writes everything recorded so far as Chrome trace event JSON, which
+// chrome://tracing and Perfetto both open. Zones still being written while
+// this runs may come out torn, so export while the profiled threads are
+// idle, between frames or on shutdown.
+b8 profiler_export_chrome(const char* path);
+// Drops everything recorded so far, same caveat as exporting.
+void profiler_clear();
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef CORE_QUANTISE_H
+#define CORE_QUANTISE_H
+
+#include "defines.h"
+
+u16 quantise_unorm16(f32 v);
+f32 dequantise_unorm16(u16 q);
+i16 quantise_snorm16(f32 v);
+f32 dequantise_snorm16(i16 q);
+
+u16 half_from_f32(f32 v);
+f32 half_to_f32(u16 h);
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2.
+void oct_encode(const f32 n[3], f32 out[2]);
+void oct_decode(const f32 e[2], f32 out[3]);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef CORE_TLSF_H
+#define CORE_TLSF_H
+
+#include "defines.h"
+
+// Two level segregated fit over an abstract range [0, size). It only keeps
+// the books, the memory itself lives somewhere else (device memory, a file),
+// so blocks are referred to by index and carry offsets instead of pointers.
+// Free blocks are binned by size: the first level is the power of two, the
+// second splits every power of two into TLSF_SL_COUNT linear steps. Finding a
+// fit is two bit scans and freeing merges with both physical neighbours, so
+// alloc and free are O(1) whatever the fragmentation.
+#define TLSF_SL_LOG 5u
+#define TLSF_SL_COUNT (1u << TLSF_SL_LOG)
+#define TLSF_FL_COUNT (64u - TLSF_SL_LOG + 1u)
+#define TLSF_NONE 0xffffffffu
+
+typedef struct {
+    u64 offset;
+    u64 size;
+    u32 prev_phys;
+    u32 next_phys;
+    // Free list links while the block is free. next_free also chains the
+    // nodes that are not in use at all.
+    u32 prev_free;
+    u32 next_free;
+    b8 free;
+} tlsf_block_t;
+
+typedef struct {
+    tlsf_block_t* blocks;
+    u32 block_capacity;
+    u32 unused_head;
+    u64 size;
+    u64 used;
+    u32 alloc_count;
+    u64 fl_bitmap;
+    u32 sl_bitmap[TLSF_FL_COUNT];
+    u32 heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+} tlsf_t;
+
+void tlsf_init(tlsf_t* tlsf, u64 size);
+void tlsf_destroy(tlsf_t* tlsf);
+
+// alignment must be a power of two. Returns TLSF_NONE when nothing fits.
+u32 tlsf_alloc(tlsf_t* tlsf, u64 size, u64 alignment);
+void tlsf_free(tlsf_t* tlsf, u32 block);
+
+u64 tlsf_offset(const tlsf_t* tlsf, u32 block);
+u64 tlsf_size(const tlsf_t* tlsf, u32 block);
+b8 tlsf_is_empty(const tlsf_t* tlsf);
+// Size of the largest free block, the biggest request that is sure to fit
+// when its alignment is already satisfied.
+u64 tlsf_largest_free(const tlsf_t* tlsf);
+
+// Walks every block and checks the invariants: blocks tile [0, size) with no
+// two free neighbours, every free block sits in the bin its size maps to and
+// the bitmaps match the bins. For tests and debug builds.
+b8 tlsf_validate(const tlsf_t* tlsf);
+
+#endif
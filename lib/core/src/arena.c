@@ -0,0 +1,123 @@
+#include "core/arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static u64 _align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static u8* _block_data(arena_block_t* block) {
+    return (u8*) block + _align_up(sizeof(arena_block_t), ARENA_DEFAULT_ALIGNMENT);
+}
+
+// Offset of the first address at or after base + offset with the alignment.
+static u64 _aligned_offset(arena_block_t* block, u64 offset, u64 alignment) {
+    const u64 base = (u64) (uintptr_t) _block_data(block);
+    return _align_up(base + offset, alignment) - base;
+}
+
+static arena_block_t* _new_block(arena_t* arena, u64 min_capacity) {
+    const u64 capacity = min_capacity > arena->block_size ? min_capacity : arena->block_size;
+    const u64 header = _align_up(sizeof(arena_block_t), ARENA_DEFAULT_ALIGNMENT);
+    arena_block_t* block = memory_alloc(header + capacity, arena->tag);
+    if (!block) {
+        return 0;
+    }
+    block->next = 0;
+    block->capacity = capacity;
+    block->offset = 0;
+    return block;
+}
+
+void arena_init(arena_t* arena, u64 block_size, memory_tag_t tag) {
+    memset(arena, 0, sizeof(arena_t));
+    arena->block_size = block_size;
+    arena->tag = tag;
+}
+
+void arena_destroy(arena_t* arena) {
+    const u64 header = _align_up(sizeof(arena_block_t), ARENA_DEFAULT_ALIGNMENT);
+    arena_block_t* block = arena->first;
+    while (block) {
+        arena_block_t* next = block->next;
+        memory_free(block, header + block->capacity, arena->tag);
+        block = next;
+    }
+    arena->first = 0;
+    arena->current = 0;
+    arena->used = 0;
+}
+
+void* arena_alloc_aligned(arena_t* arena, u64 size, u64 alignment) {
+    arena_block_t* block = arena->current;
+    u64 offset = block ? _aligned_offset(block, block->offset, alignment) : 0;
+
+    // Move on to a retained block when it is big enough, otherwise splice a
+    // fresh one in after the current block.
+    if (!block || offset + size > block->capacity) {
+        const u64 needed = size + alignment;
+        arena_block_t* next = block ? block->next : arena->first;
+        if (next && next->capacity >= needed) {
+            next->offset = 0;
+            block = next;
+        } else {
+            arena_block_t* fresh = _new_block(arena, needed);
+            if (!fresh) {
+                return 0;
+            }
+            fresh->next = next;
+            if (block) {
+                block->next = fresh;
+            } else {
+                arena->first = fresh;
+            }
+            block = fresh;
+        }
+        arena->current = block;
+        offset = _aligned_offset(block, 0, alignment);
+    }
+
+    const u64 consumed = offset + size - block->offset;
+    block->offset = offset + size;
+    arena->used += consumed;
+    arena->peak = arena->used > arena->peak ? arena->used : arena->peak;
+    return _block_data(block) + offset;
+}
+
+void* arena_alloc(arena_t* arena, u64 size) {
+    return arena_alloc_aligned(arena, size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+void* arena_alloc_zeroed(arena_t* arena, u64 size) {
+    void* ptr = arena_alloc(arena, size);
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+arena_marker_t arena_mark(const arena_t* arena) {
+    arena_marker_t marker;
+    marker.block = arena->current;
+    marker.offset = arena->current ? arena->current->offset : 0;
+    marker.used = arena->used;
+    return marker;
+}
+
+void arena_reset_to(arena_t* arena, arena_marker_t marker) {
+    arena->current = marker.block;
+    if (marker.block) {
+        marker.block->offset = marker.offset;
+    } else if (arena->first) {
+        // Marked before the first allocation: start over from the first block.
+        arena->current = arena->first;
+        arena->first->offset = 0;
+    }
+    arena->used = marker.used;
+}
+
+void arena_reset(arena_t* arena) {
+    arena_marker_t start = {0, 0, 0};
+    arena_reset_to(arena, start);
+}
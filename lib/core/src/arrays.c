@@ -1 +1,14 @@
-#include "core/arrays.h"
\ No newline at end of file
+#include "core/arrays.h"
+#include "core/memory.h"
+
+void array_grow(void** parray, u64* capacity, u64 ensure_size, u64 elem_size) {
+    if (*capacity >= ensure_size) {
+        return;
+    }
+    u64 new_capacity = *capacity < ARRAY_MIN_CAPACITY ? ARRAY_MIN_CAPACITY : *capacity;
+    while (new_capacity < ensure_size) {
+        new_capacity *= 2;
+    }
+    *parray = memory_realloc(*parray, *capacity * elem_size, new_capacity * elem_size, MEMORY_TAG_ARRAY);
+    *capacity = new_capacity;
+}
@@ -1,5 +1,9 @@
 #include "core/bitwise.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 u32 bitmask_flags_set_on(u32 mask, u32 bit_index) {
     return mask | 1 << bit_index;
 }
@@ -11,3 +15,23 @@ u32 bitmask_flags_set_off(u32 mask, u32 bit_index) {
 u32 bitmask_flags_get(u32 mask, u32 bit_index) {
     return mask & (1 << bit_index);
 }
+
+u32 bit_lowest_set(u64 value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return (u32) __builtin_ctzll(value);
+#endif
+}
+
+u32 bit_highest_set(u64 value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#else
+    return 63u - (u32) __builtin_clzll(value);
+#endif
+}
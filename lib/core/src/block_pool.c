@@ -0,0 +1,58 @@
+#include "core/block_pool.h"
+
+#include <string.h>
+
+#define BLOCK_POOL_ALIGNMENT 16
+
+b8 block_pool_init(block_pool_t* pool, u64 block_size, u32 block_count, memory_tag_t tag) {
+    memset(pool, 0, sizeof(block_pool_t));
+    // Every block has to be able to hold the free list link.
+    block_size = block_size < sizeof(void*) ? sizeof(void*) : block_size;
+    block_size = (block_size + BLOCK_POOL_ALIGNMENT - 1) & ~((u64) BLOCK_POOL_ALIGNMENT - 1);
+    pool->memory = memory_alloc(block_size * block_count, tag);
+    if (!pool->memory) {
+        return false;
+    }
+    pool->block_size = block_size;
+    pool->block_count = block_count;
+    pool->free_count = block_count;
+    pool->tag = tag;
+
+    // Thread the list front to back so blocks are handed out in address order.
+    for (u32 i = 0; i < block_count; i++) {
+        void** link = (void**) (pool->memory + i * block_size);
+        *link = i + 1 < block_count ? pool->memory + (i + 1) * block_size : 0;
+    }
+    pool->free_list = block_count > 0 ? pool->memory : 0;
+    return true;
+}
+
+void block_pool_destroy(block_pool_t* pool) {
+    memory_free(pool->memory, pool->block_size * pool->block_count, pool->tag);
+    memset(pool, 0, sizeof(block_pool_t));
+}
+
+void* block_pool_alloc(block_pool_t* pool) {
+    void** block = pool->free_list;
+    if (!block) {
+        return 0;
+    }
+    pool->free_list = *block;
+    pool->free_count--;
+    return block;
+}
+
+void block_pool_free(block_pool_t* pool, void* block) {
+    if (!block) {
+        return;
+    }
+    *(void**) block = pool->free_list;
+    pool->free_list = block;
+    pool->free_count++;
+}
+
+b8 block_pool_owns(const block_pool_t* pool, const void* block) {
+    const u8* p = block;
+    return p >= pool->memory && p < pool->memory + pool->block_size * pool->block_count &&
+           (u64) (p - pool->memory) % pool->block_size == 0;
+}
@@ -0,0 +1,497 @@
+#include "core/file.h"
+#include "core/memory.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Largest single read request, some platforms reject bigger ones.
+#define FILE_READ_CHUNK (1ull << 30)
+
+const char* file_result_str(file_result_t result) {
+    switch (result) {
+        case FILE_OK: return "ok";
+        case FILE_ERR_NOT_FOUND: return "file not found";
+        case FILE_ERR_ACCESS: return "permission denied";
+        case FILE_ERR_IO: return "i/o error";
+        case FILE_ERR_NO_MEMORY: return "out of memory";
+        case FILE_ERR_TOO_LARGE: return "file too large";
+    }
+    return "unknown";
+}
+
+#ifdef _WIN32
+static file_result_t _last_error() {
+    switch (GetLastError()) {
+        case ERROR_FILE_NOT_FOUND:
+        case ERROR_PATH_NOT_FOUND: return FILE_ERR_NOT_FOUND;
+        case ERROR_ACCESS_DENIED:
+        case ERROR_SHARING_VIOLATION: return FILE_ERR_ACCESS;
+        default: return FILE_ERR_IO;
+    }
+}
+
+static file_result_t _open(const char* path, HANDLE* out, u64* out_size) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return _last_error();
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return FILE_ERR_IO;
+    }
+    *out = file;
+    *out_size = (u64) size.QuadPart;
+    return FILE_OK;
+}
+
+static file_result_t _read(HANDLE file, u8* dst, u64 size, u64* out_read) {
+    const DWORD request = (DWORD) (size < FILE_READ_CHUNK ? size : FILE_READ_CHUNK);
+    DWORD got = 0;
+    if (!ReadFile(file, dst, request, &got, 0)) {
+        return FILE_ERR_IO;
+    }
+    *out_read = got;
+    return FILE_OK;
+}
+
+static void _close(HANDLE file) {
+    CloseHandle(file);
+}
+#else
+static file_result_t _from_errno() {
+    switch (errno) {
+        case ENOENT:
+        case ENOTDIR: return FILE_ERR_NOT_FOUND;
+        case EACCES:
+        case EPERM: return FILE_ERR_ACCESS;
+        case ENOMEM: return FILE_ERR_NO_MEMORY;
+        default: return FILE_ERR_IO;
+    }
+}
+
+static file_result_t _open(const char* path, int* out, u64* out_size) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return _from_errno();
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const file_result_t result = _from_errno();
+        close(fd);
+        return result;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        return FILE_ERR_IO;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    *out = fd;
+    *out_size = (u64) st.st_size;
+    return FILE_OK;
+}
+
+static file_result_t _read(int fd, u8* dst, u64 size, u64* out_read) {
+    for (;;) {
+        const ssize_t got = read(fd, dst, size < FILE_READ_CHUNK ? size : FILE_READ_CHUNK);
+        if (got >= 0) {
+            *out_read = (u64) got;
+            return FILE_OK;
+        }
+        if (errno != EINTR) {
+            return _from_errno();
+        }
+    }
+}
+
+static void _close(int fd) {
+    close(fd);
+}
+#endif
+
+file_result_t file_size(const char* path, u64* out_size) {
+#ifdef _WIN32
+    HANDLE file;
+#else
+    int file;
+#endif
+    const file_result_t result = _open(path, &file, out_size);
+    if (result == FILE_OK) {
+        _close(file);
+    }
+    return result;
+}
+
+file_result_t file_read_all(const char* path, file_buffer_t* out) {
+    out->data = 0;
+    out->size = 0;
+#ifdef _WIN32
+    HANDLE file;
+#else
+    int file;
+#endif
+    u64 size;
+    file_result_t result = _open(path, &file, &size);
+    if (result != FILE_OK) {
+        return result;
+    }
+    if (size > (u64) SIZE_MAX - 1) {
+        _close(file);
+        return FILE_ERR_TOO_LARGE;
+    }
+    u8* data = memory_alloc(size + 1, MEMORY_TAG_FILE);
+    if (!data) {
+        _close(file);
+        return FILE_ERR_NO_MEMORY;
+    }
+
+    // Normally a single read; the loop only matters for huge files and short
+    // reads. A file that shrank underneath us is an error, not a short buffer.
+    u64 filled = 0;
+    while (filled < size) {
+        u64 got = 0;
+        result = _read(file, data + filled, size - filled, &got);
+        if (result != FILE_OK || got == 0) {
+            result = result != FILE_OK ? result : FILE_ERR_IO;
+            break;
+        }
+        filled += got;
+    }
+    _close(file);
+    if (result != FILE_OK) {
+        memory_free(data, size + 1, MEMORY_TAG_FILE);
+        return result;
+    }
+    data[size] = 0;
+    out->data = data;
+    out->size = size;
+    return FILE_OK;
+}
+
+void file_buffer_free(file_buffer_t* buffer) {
+    memory_free(buffer->data, buffer->size + 1, MEMORY_TAG_FILE);
+    buffer->data = 0;
+    buffer->size = 0;
+}
+
+#ifdef _WIN32
+static file_result_t _write_file(const char* path, const u8* data, u64 size) {
+    HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return _last_error();
+    }
+    file_result_t result = FILE_OK;
+    u64 written = 0;
+    while (written < size) {
+        const u64 left = size - written;
+        const DWORD request = (DWORD) (left < FILE_READ_CHUNK ? left : FILE_READ_CHUNK);
+        DWORD put = 0;
+        if (!WriteFile(file, data + written, request, &put, 0) || put == 0) {
+            result = FILE_ERR_IO;
+            break;
+        }
+        written += put;
+    }
+    if (result == FILE_OK && !FlushFileBuffers(file)) {
+        result = FILE_ERR_IO;
+    }
+    CloseHandle(file);
+    return result;
+}
+#else
+static file_result_t _write_file(const char* path, const u8* data, u64 size) {
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return _from_errno();
+    }
+    file_result_t result = FILE_OK;
+    u64 written = 0;
+    while (written < size) {
+        const u64 left = size - written;
+        const ssize_t put = write(fd, data + written, left < FILE_READ_CHUNK ? left : FILE_READ_CHUNK);
+        if (put < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = _from_errno();
+            break;
+        }
+        written += (u64) put;
+    }
+    // Without the sync a crash after the rename can leave an empty file behind.
+    if (result == FILE_OK && fsync(fd) != 0) {
+        result = _from_errno();
+    }
+    close(fd);
+    return result;
+}
+#endif
+
+#ifndef _WIN32
+// A rename is only durable once the directory entry is on disk too.
+static file_result_t _sync_parent_dir(const char* path) {
+    const char* slash = strrchr(path, '/');
+    int fd;
+    if (slash) {
+        const u64 length = slash == path ? 1 : (u64) (slash - path);
+        char* dir = memory_alloc(length + 1, MEMORY_TAG_FILE);
+        if (!dir) {
+            return FILE_ERR_NO_MEMORY;
+        }
+        memcpy(dir, path, length);
+        dir[length] = 0;
+        fd = open(dir, O_RDONLY | O_DIRECTORY);
+        memory_free(dir, length + 1, MEMORY_TAG_FILE);
+    } else {
+        fd = open(".", O_RDONLY | O_DIRECTORY);
+    }
+    if (fd < 0) {
+        return _from_errno();
+    }
+    // Some filesystems cannot sync directories and say so with EINVAL.
+    const file_result_t result = fsync(fd) != 0 && errno != EINVAL ? _from_errno() : FILE_OK;
+    close(fd);
+    return result;
+}
+#endif
+
+file_result_t file_write_atomic(const char* path, const void* data, u64 size) {
+    const u64 path_length = strlen(path);
+    const u64 tmp_size = path_length + sizeof(".tmp");
+    char* tmp = memory_alloc(tmp_size, MEMORY_TAG_FILE);
+    if (!tmp) {
+        return FILE_ERR_NO_MEMORY;
+    }
+    memcpy(tmp, path, path_length);
+    memcpy(tmp + path_length, ".tmp", sizeof(".tmp"));
+
+    file_result_t result = _write_file(tmp, data, size);
+    if (result == FILE_OK) {
+#ifdef _WIN32
+        if (!MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            result = _last_error();
+        }
+#else
+        if (rename(tmp, path) != 0) {
+            result = _from_errno();
+        }
+#endif
+    }
+    if (result != FILE_OK) {
+#ifdef _WIN32
+        DeleteFileA(tmp);
+#else
+        unlink(tmp);
+#endif
+    }
+    memory_free(tmp, tmp_size, MEMORY_TAG_FILE);
+#ifndef _WIN32
+    if (result == FILE_OK) {
+        result = _sync_parent_dir(path);
+    }
+#endif
+    return result;
+}
+
+file_result_t file_map(const char* path, file_map_t* out) {
+    memset(out, 0, sizeof(file_map_t));
+#ifdef _WIN32
+    HANDLE file;
+    u64 size;
+    const file_result_t result = _open(path, &file, &size);
+    if (result != FILE_OK) {
+        return result;
+    }
+    // Empty files cannot be mapped, hand them out as an empty view.
+    if (size == 0) {
+        CloseHandle(file);
+        return FILE_OK;
+    }
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (!mapping) {
+        CloseHandle(file);
+        return FILE_ERR_IO;
+    }
+    void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return FILE_ERR_IO;
+    }
+    out->file_handle = file;
+    out->mapping_handle = mapping;
+    out->data = base;
+    out->size = size;
+#else
+    int fd;
+    u64 size;
+    const file_result_t result = _open(path, &fd, &size);
+    if (result != FILE_OK) {
+        return result;
+    }
+    if (size == 0) {
+        close(fd);
+        return FILE_OK;
+    }
+    void* base = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // Before close, which may overwrite errno.
+    const file_result_t mapped = base == MAP_FAILED ? _from_errno() : FILE_OK;
+    // The mapping holds its own reference to the file.
+    close(fd);
+    if (mapped != FILE_OK) {
+        return mapped;
+    }
+    out->data = base;
+    out->size = size;
+#endif
+    return FILE_OK;
+}
+
+void file_unmap(file_map_t* map) {
+    if (map->data) {
+#ifdef _WIN32
+        UnmapViewOfFile(map->data);
+        CloseHandle(map->mapping_handle);
+        CloseHandle(map->file_handle);
+#else
+        munmap((void*) map->data, map->size);
+#endif
+    }
+    memset(map, 0, sizeof(file_map_t));
+}
+
+void file_map_prefetch(const file_map_t* map) {
+    if (!map->data) {
+        return;
+    }
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (void*) map->data;
+    range.NumberOfBytes = map->size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    posix_madvise((void*) map->data, map->size, POSIX_MADV_WILLNEED);
+#endif
+}
+
+file_result_t file_stream_open(const char* path, void* buffer, u64 capacity, file_stream_t* out) {
+    memset(out, 0, sizeof(file_stream_t));
+#ifndef _WIN32
+    out->fd = -1;
+#endif
+    u64 size;
+#ifdef _WIN32
+    const file_result_t result = _open(path, &out->handle, &size);
+#else
+    const file_result_t result = _open(path, &out->fd, &size);
+#endif
+    if (result != FILE_OK) {
+        return result;
+    }
+    out->buffer = buffer;
+    out->capacity = capacity;
+    return FILE_OK;
+}
+
+static file_result_t _refill(file_stream_t* stream) {
+    u64 got = 0;
+#ifdef _WIN32
+    const file_result_t result = _read(stream->handle, stream->buffer, stream->capacity, &got);
+#else
+    const file_result_t result = _read(stream->fd, stream->buffer, stream->capacity, &got);
+#endif
+    if (result != FILE_OK) {
+        return result;
+    }
+    stream->begin = 0;
+    stream->end = got;
+    stream->eof = got == 0;
+    return FILE_OK;
+}
+
+file_result_t file_stream_read(file_stream_t* stream, void* dst, u64 size, u64* out_read) {
+    u8* out = dst;
+    u64 copied = 0;
+    while (copied < size) {
+        if (stream->begin == stream->end) {
+            if (stream->eof) {
+                break;
+            }
+            // Large requests skip the buffer and land directly in dst.
+            if (size - copied >= stream->capacity) {
+                u64 got = 0;
+#ifdef _WIN32
+                const file_result_t result = _read(stream->handle, out + copied, size - copied, &got);
+#else
+                const file_result_t result = _read(stream->fd, out + copied, size - copied, &got);
+#endif
+                if (result != FILE_OK) {
+                    stream->offset += copied;
+                    *out_read = copied;
+                    return result;
+                }
+                stream->eof = got == 0;
+                copied += got;
+                continue;
+            }
+            const file_result_t result = _refill(stream);
+            if (result != FILE_OK) {
+                stream->offset += copied;
+                *out_read = copied;
+                return result;
+            }
+            continue;
+        }
+        const u64 available = stream->end - stream->begin;
+        const u64 take = available < size - copied ? available : size - copied;
+        memcpy(out + copied, stream->buffer + stream->begin, take);
+        stream->begin += take;
+        copied += take;
+    }
+    stream->offset += copied;
+    *out_read = copied;
+    return FILE_OK;
+}
+
+file_result_t file_stream_next(file_stream_t* stream, const u8** out_chunk, u64* out_size) {
+    if (stream->begin == stream->end && !stream->eof) {
+        const file_result_t result = _refill(stream);
+        if (result != FILE_OK) {
+            return result;
+        }
+    }
+    *out_chunk = stream->buffer + stream->begin;
+    *out_size = stream->end - stream->begin;
+    stream->offset += *out_size;
+    stream->begin = stream->end;
+    return FILE_OK;
+}
+
+void file_stream_close(file_stream_t* stream) {
+#ifdef _WIN32
+    if (stream->handle) {
+        CloseHandle(stream->handle);
+    }
+#else
+    if (stream->fd >= 0) {
+        close(stream->fd);
+    }
+#endif
+    memset(stream, 0, sizeof(file_stream_t));
+#ifndef _WIN32
+    stream->fd = -1;
+#endif
+}
@@ -1,7 +1,16 @@
 #include "core/handle.h"
 
-handle_t handle_create(u64 index) {
+handle_t handle_create(u32 index, u32 generation) {
     handle_t handle;
     handle.index = index;
+    handle.generation = generation;
     return handle;
-}
\ No newline at end of file
+}
+
+b8 handle_is_valid(handle_t handle) {
+    return handle.generation != 0;
+}
+
+b8 handle_equal(handle_t a, handle_t b) {
+    return a.index == b.index && a.generation == b.generation;
+}
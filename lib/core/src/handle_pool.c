@@ -0,0 +1,145 @@
+#include "core/handle_pool.h"
+#include "core/memory.h"
+
+#include <string.h>
+
+#define HANDLE_POOL_NONE 0xffffffffu
+#define HANDLE_POOL_MIN_CAPACITY 16u
+
+static u32 _grow(u32 capacity, u32 needed) {
+    u32 grown = capacity < HANDLE_POOL_MIN_CAPACITY ? HANDLE_POOL_MIN_CAPACITY : capacity;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    return grown;
+}
+
+static void _reserve_dense(handle_pool_t* pool, u32 needed) {
+    if (needed <= pool->capacity) {
+        return;
+    }
+    const u32 grown = _grow(pool->capacity, needed);
+    pool->dense = memory_realloc(pool->dense, pool->capacity * pool->item_size, grown * pool->item_size,
+                                 MEMORY_TAG_POOL);
+    pool->dense_slots = memory_realloc(pool->dense_slots, pool->capacity * sizeof(u32), grown * sizeof(u32),
+                                       MEMORY_TAG_POOL);
+    pool->capacity = grown;
+}
+
+static void _reserve_slots(handle_pool_t* pool, u32 needed) {
+    if (needed <= pool->slot_capacity) {
+        return;
+    }
+    const u32 grown = _grow(pool->slot_capacity, needed);
+    pool->slots = memory_realloc(pool->slots, pool->slot_capacity * sizeof(u32), grown * sizeof(u32),
+                                 MEMORY_TAG_POOL);
+    pool->generations = memory_realloc(pool->generations, pool->slot_capacity * sizeof(u32), grown * sizeof(u32),
+                                       MEMORY_TAG_POOL);
+    pool->slot_capacity = grown;
+}
+
+void handle_pool_init(handle_pool_t* pool, u64 item_size, u32 initial_capacity) {
+    memset(pool, 0, sizeof(handle_pool_t));
+    pool->item_size = item_size;
+    pool->free_head = HANDLE_POOL_NONE;
+    if (initial_capacity > 0) {
+        _reserve_dense(pool, initial_capacity);
+        _reserve_slots(pool, initial_capacity);
+    }
+}
+
+void handle_pool_destroy(handle_pool_t* pool) {
+    memory_free(pool->dense, pool->capacity * pool->item_size, MEMORY_TAG_POOL);
+    memory_free(pool->dense_slots, pool->capacity * sizeof(u32), MEMORY_TAG_POOL);
+    memory_free(pool->slots, pool->slot_capacity * sizeof(u32), MEMORY_TAG_POOL);
+    memory_free(pool->generations, pool->slot_capacity * sizeof(u32), MEMORY_TAG_POOL);
+    memset(pool, 0, sizeof(handle_pool_t));
+    pool->free_head = HANDLE_POOL_NONE;
+}
+
+handle_t handle_pool_insert(handle_pool_t* pool, const void* item) {
+    u32 slot;
+    if (pool->free_head != HANDLE_POOL_NONE) {
+        slot = pool->free_head;
+        pool->free_head = pool->slots[slot];
+    } else {
+        _reserve_slots(pool, pool->slot_count + 1);
+        slot = pool->slot_count++;
+        pool->generations[slot] = 1;
+    }
+
+    _reserve_dense(pool, pool->count + 1);
+    const u32 dense_index = pool->count++;
+    u8* dst = pool->dense + dense_index * pool->item_size;
+    if (item) {
+        memcpy(dst, item, pool->item_size);
+    } else {
+        memset(dst, 0, pool->item_size);
+    }
+    pool->dense_slots[dense_index] = slot;
+    pool->slots[slot] = dense_index;
+    return handle_create(slot, pool->generations[slot]);
+}
+
+b8 handle_pool_contains(const handle_pool_t* pool, handle_t handle) {
+    return handle.index < pool->slot_count && handle.generation != 0 &&
+           pool->generations[handle.index] == handle.generation;
+}
+
+void* handle_pool_get(const handle_pool_t* pool, handle_t handle) {
+    if (!handle_pool_contains(pool, handle)) {
+        return 0;
+    }
+    return pool->dense + pool->slots[handle.index] * pool->item_size;
+}
+
+b8 handle_pool_remove(handle_pool_t* pool, handle_t handle, void* out_item) {
+    if (!handle_pool_contains(pool, handle)) {
+        return false;
+    }
+    const u32 slot = handle.index;
+    const u32 dense_index = pool->slots[slot];
+    u8* hole = pool->dense + dense_index * pool->item_size;
+    if (out_item) {
+        memcpy(out_item, hole, pool->item_size);
+    }
+
+    const u32 last = --pool->count;
+    if (dense_index != last) {
+        memcpy(hole, pool->dense + last * pool->item_size, pool->item_size);
+        const u32 moved_slot = pool->dense_slots[last];
+        pool->dense_slots[dense_index] = moved_slot;
+        pool->slots[moved_slot] = dense_index;
+    }
+
+    // Skip generation 0 on wrap around so the slot never issues an invalid handle.
+    pool->generations[slot]++;
+    if (pool->generations[slot] == 0) {
+        pool->generations[slot] = 1;
+    }
+    pool->slots[slot] = pool->free_head;
+    pool->free_head = slot;
+    return true;
+}
+
+void handle_pool_clear(handle_pool_t* pool) {
+    while (pool->count > 0) {
+        handle_pool_remove(pool, handle_pool_handle_at(pool, pool->count - 1), 0);
+    }
+}
+
+u32 handle_pool_count(const handle_pool_t* pool) {
+    return pool->count;
+}
+
+void* handle_pool_at(const handle_pool_t* pool, u32 dense_index) {
+    return dense_index < pool->count ? pool->dense + dense_index * pool->item_size : 0;
+}
+
+handle_t handle_pool_handle_at(const handle_pool_t* pool, u32 dense_index) {
+    if (dense_index >= pool->count) {
+        return HANDLE_INVALID;
+    }
+    const u32 slot = pool->dense_slots[dense_index];
+    return handle_create(slot, pool->generations[slot]);
+}
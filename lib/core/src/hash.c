@@ -0,0 +1,49 @@
+#include "core/hash.h"
+
+#include <string.h>
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ull
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME_3 0x165667B19E3779F9ull
+
+static u64 _rotl64(u64 x, u32 r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static u64 _avalanche(u64 h) {
+    h ^= h >> 33;
+    h *= HASH_PRIME_2;
+    h ^= h >> 29;
+    h *= HASH_PRIME_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Word-at-a-time mix, good enough for content addressing and checksums.
+u64 hash_bytes(const void* data, u64 size, u64 seed) {
+    const u8* p = data;
+    u64 h = seed ^ (size * HASH_PRIME_1);
+
+    while (size >= 8) {
+        u64 k;
+        memcpy(&k, p, sizeof(u64));
+        k *= HASH_PRIME_2;
+        k = _rotl64(k, 31);
+        k *= HASH_PRIME_1;
+        h ^= k;
+        h = _rotl64(h, 27) * HASH_PRIME_1 + HASH_PRIME_3;
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        h ^= (*p) * HASH_PRIME_3;
+        h = _rotl64(h, 11) * HASH_PRIME_1;
+        p++;
+        size--;
+    }
+    return _avalanche(h);
+}
+
+u64 hash_combine(u64 a, u64 b) {
+    return _avalanche(a ^ (b + HASH_PRIME_3 + (a << 6) + (a >> 2)));
+}
@@ -0,0 +1,120 @@
+#include "core/hash_map.h"
+#include "core/memory.h"
+
+#include <string.h>
+
+#define HASH_MAP_MIN_CAPACITY 16
+
+static u64 _slot_bytes(u64 capacity) {
+    return capacity * (sizeof(u64) + sizeof(u32));
+}
+
+static void _allocate(hash_map_t* map, u64 capacity) {
+    u8* block = memory_alloc(_slot_bytes(capacity), MEMORY_TAG_HASH_MAP);
+    map->keys = (u64*) block;
+    map->values = (u32*) (block + capacity * sizeof(u64));
+    map->capacity = capacity;
+    memset(map->values, 0xFF, capacity * sizeof(u32));
+}
+
+void hash_map_init(hash_map_t* map, u64 initial_capacity) {
+    // Power of two so the probe can mask instead of divide.
+    u64 capacity = HASH_MAP_MIN_CAPACITY;
+    while (capacity < initial_capacity) {
+        capacity <<= 1;
+    }
+    map->count = 0;
+    _allocate(map, capacity);
+}
+
+void hash_map_destroy(hash_map_t* map) {
+    if (map->keys) {
+        memory_free(map->keys, _slot_bytes(map->capacity), MEMORY_TAG_HASH_MAP);
+    }
+    memset(map, 0, sizeof(hash_map_t));
+}
+
+static u64 _find(const hash_map_t* map, u64 key) {
+    const u64 mask = map->capacity - 1;
+    u64 i = key & mask;
+    while (map->values[i] != HASH_MAP_EMPTY && map->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static void _grow(hash_map_t* map) {
+    u64* old_keys = map->keys;
+    u32* old_values = map->values;
+    const u64 old_capacity = map->capacity;
+
+    _allocate(map, old_capacity * 2);
+    for (u64 i = 0; i < old_capacity; i++) {
+        if (old_values[i] != HASH_MAP_EMPTY) {
+            const u64 slot = _find(map, old_keys[i]);
+            map->keys[slot] = old_keys[i];
+            map->values[slot] = old_values[i];
+        }
+    }
+    memory_free(old_keys, _slot_bytes(old_capacity), MEMORY_TAG_HASH_MAP);
+}
+
+u32 hash_map_get(const hash_map_t* map, u64 key) {
+    if (!map->keys) {
+        return HASH_MAP_EMPTY;
+    }
+    return map->values[_find(map, key)];
+}
+
+void hash_map_set(hash_map_t* map, u64 key, u32 value) {
+    if (!map->keys) {
+        hash_map_init(map, HASH_MAP_MIN_CAPACITY);
+    }
+    // Keep the load under 3/4, probe lengths blow up past that.
+    if ((map->count + 1) * 4 > map->capacity * 3) {
+        _grow(map);
+    }
+    const u64 slot = _find(map, key);
+    if (map->values[slot] == HASH_MAP_EMPTY) {
+        map->count++;
+    }
+    map->keys[slot] = key;
+    map->values[slot] = value;
+}
+
+b8 hash_map_remove(hash_map_t* map, u64 key) {
+    if (!map->keys) {
+        return false;
+    }
+    const u64 mask = map->capacity - 1;
+    u64 hole = _find(map, key);
+    if (map->values[hole] == HASH_MAP_EMPTY) {
+        return false;
+    }
+    // Backward shift: pull later entries of the same run into the hole so no
+    // tombstones are needed.
+    u64 i = hole;
+    for (;;) {
+        i = (i + 1) & mask;
+        if (map->values[i] == HASH_MAP_EMPTY) {
+            break;
+        }
+        const u64 home = map->keys[i] & mask;
+        const b8 movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            map->keys[hole] = map->keys[i];
+            map->values[hole] = map->values[i];
+            hole = i;
+        }
+    }
+    map->values[hole] = HASH_MAP_EMPTY;
+    map->count--;
+    return true;
+}
+
+void hash_map_clear(hash_map_t* map) {
+    if (map->values) {
+        memset(map->values, 0xFF, map->capacity * sizeof(u32));
+    }
+    map->count = 0;
+}
@@ -0,0 +1,302 @@
+#include "core/jobs.h"
+#include "core/memory.h"
+#include "core/profiler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+
+#define JOB_NO_THREAD 0xffffffffu
+#define JOB_SPINS_BEFORE_SLEEP 64
+#define JOB_CACHE_LINE 64
+
+typedef struct {
+    job_desc_t desc;
+    job_counter_t* counter;
+    _Atomic u32 busy;
+} job_t;
+
+typedef struct {
+    _Alignas(JOB_CACHE_LINE) _Atomic i64 top;
+    _Alignas(JOB_CACHE_LINE) _Atomic i64 bottom;
+    _Atomic(job_t*) slots[JOB_QUEUE_CAPACITY];
+} job_deque_t;
+
+typedef struct {
+    job_deque_t deque;
+    job_t ring[JOB_QUEUE_CAPACITY];
+    u32 ring_next;
+    u32 rng;
+    thrd_t thread;
+} job_thread_t;
+
+_Static_assert((JOB_QUEUE_CAPACITY & (JOB_QUEUE_CAPACITY - 1)) == 0, "job queue capacity must be a power of two");
+
+static job_thread_t* g_threads = 0;
+// Threads taking part, lowered by init when a worker fails to start. Workers
+// read it while stealing, hence atomic.
+static _Atomic u32 g_thread_count = 0;
+static u32 g_thread_capacity = 0;
+static _Atomic b8 g_running = false;
+static _Atomic u32 g_queued = 0;
+static _Atomic u32 g_sleepers = 0;
+static mtx_t g_sleep_lock;
+static cnd_t g_sleep_wake;
+static _Thread_local u32 t_thread_index = JOB_NO_THREAD;
+
+// Chase-Lev deque with the C11 orderings from Le et al., "Correct and
+// Efficient Work-Stealing for Weak Memory Models". Only the owner touches
+// bottom; thieves race on top with a CAS.
+static b8 _deque_push(job_deque_t* deque, job_t* job) {
+    const i64 b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    const i64 t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= (i64) JOB_QUEUE_CAPACITY) {
+        return false;
+    }
+    atomic_store_explicit(&deque->slots[b & (JOB_QUEUE_CAPACITY - 1)], job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+static job_t* _deque_pop(job_deque_t* deque) {
+    const i64 b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+    job_t* job = atomic_load_explicit(&deque->slots[b & (JOB_QUEUE_CAPACITY - 1)], memory_order_relaxed);
+    if (t == b) {
+        // Last item: whoever moves top first gets it.
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            job = 0;
+        }
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+static job_t* _deque_steal(job_deque_t* deque) {
+    i64 t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    const i64 b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (t >= b) {
+        return 0;
+    }
+    job_t* job = atomic_load_explicit(&deque->slots[t & (JOB_QUEUE_CAPACITY - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return 0;
+    }
+    return job;
+}
+
+static u32 _next_random(job_thread_t* self) {
+    u32 x = self->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    self->rng = x;
+    return x;
+}
+
+static job_t* _find_job(u32 index) {
+    job_thread_t* self = &g_threads[index];
+    job_t* job = _deque_pop(&self->deque);
+    if (!job) {
+        const u32 count = atomic_load_explicit(&g_thread_count, memory_order_relaxed);
+        const u32 start = _next_random(self) % count;
+        for (u32 i = 0; i < count && !job; i++) {
+            const u32 victim = (start + i) % count;
+            if (victim != index) {
+                job = _deque_steal(&g_threads[victim].deque);
+            }
+        }
+    }
+    if (job) {
+        atomic_fetch_sub(&g_queued, 1);
+    }
+    return job;
+}
+
+static void _execute(const job_desc_t* desc, job_counter_t* counter) {
+    desc->fn(desc->data, desc->begin, desc->end);
+    if (counter) {
+        atomic_fetch_sub_explicit(&counter->pending, 1, memory_order_release);
+    }
+}
+
+static void _run_job(job_t* job) {
+    // Copy out first so the ring slot can be recycled while the job runs.
+    const job_desc_t desc = job->desc;
+    job_counter_t* counter = job->counter;
+    atomic_store_explicit(&job->busy, 0, memory_order_release);
+    _execute(&desc, counter);
+}
+
+static int _worker_main(void* arg) {
+    t_thread_index = (u32) (uintptr_t) arg;
+#ifdef PTIA_PROFILE
+    char name[PROFILER_NAME_LENGTH];
+    snprintf(name, sizeof(name), "job worker %u", t_thread_index);
+    PROFILE_THREAD_NAME(name);
+#endif
+    u32 idle_spins = 0;
+    while (atomic_load_explicit(&g_running, memory_order_acquire)) {
+        job_t* job = _find_job(t_thread_index);
+        if (job) {
+            _run_job(job);
+            idle_spins = 0;
+            continue;
+        }
+        if (++idle_spins < JOB_SPINS_BEFORE_SLEEP) {
+            thrd_yield();
+            continue;
+        }
+        // Submitters bump g_queued before reading g_sleepers, sleepers bump
+        // g_sleepers before reading g_queued, so one side always sees the other.
+        mtx_lock(&g_sleep_lock);
+        atomic_fetch_add(&g_sleepers, 1);
+        while (atomic_load(&g_queued) == 0 && atomic_load(&g_running)) {
+            cnd_wait(&g_sleep_wake, &g_sleep_lock);
+        }
+        atomic_fetch_sub(&g_sleepers, 1);
+        mtx_unlock(&g_sleep_lock);
+        idle_spins = 0;
+    }
+    return 0;
+}
+
+u32 job_system_init(u32 worker_count) {
+    g_thread_capacity = worker_count + 1;
+    atomic_store(&g_thread_count, g_thread_capacity);
+    g_threads = memory_alloc_zeroed(sizeof(job_thread_t) * g_thread_capacity, MEMORY_TAG_POOL);
+    mtx_init(&g_sleep_lock, mtx_plain);
+    cnd_init(&g_sleep_wake);
+    atomic_store(&g_queued, 0);
+    atomic_store(&g_running, true);
+    for (u32 i = 0; i < g_thread_capacity; i++) {
+        g_threads[i].rng = 0x9E3779B9u * (i + 1);
+    }
+    t_thread_index = 0;
+    for (u32 i = 1; i < g_thread_capacity; i++) {
+        if (thrd_create(&g_threads[i].thread, _worker_main, (void*) (uintptr_t) i) != thrd_success) {
+            // Carry on with the workers that did start. A worker that read
+            // the old count may still pick a missing one as victim, its deque
+            // is simply empty.
+            atomic_store(&g_thread_count, i);
+            break;
+        }
+    }
+    return atomic_load(&g_thread_count) - 1;
+}
+
+void job_system_shutdown() {
+    atomic_store(&g_running, false);
+    mtx_lock(&g_sleep_lock);
+    cnd_broadcast(&g_sleep_wake);
+    mtx_unlock(&g_sleep_lock);
+    const u32 count = atomic_load(&g_thread_count);
+    for (u32 i = 1; i < count; i++) {
+        thrd_join(g_threads[i].thread, 0);
+    }
+    cnd_destroy(&g_sleep_wake);
+    mtx_destroy(&g_sleep_lock);
+    memory_free(g_threads, sizeof(job_thread_t) * g_thread_capacity, MEMORY_TAG_POOL);
+    g_threads = 0;
+    g_thread_capacity = 0;
+    atomic_store(&g_thread_count, 0);
+    t_thread_index = JOB_NO_THREAD;
+}
+
+u32 job_system_thread_count() {
+    return atomic_load(&g_thread_count);
+}
+
+u32 job_system_thread_index() {
+    return t_thread_index;
+}
+
+void job_run(const job_desc_t* jobs, u32 count, job_counter_t* counter) {
+    if (counter) {
+        atomic_fetch_add_explicit(&counter->pending, count, memory_order_relaxed);
+    }
+    const u32 index = t_thread_index;
+    if (index == JOB_NO_THREAD || !g_threads) {
+        for (u32 i = 0; i < count; i++) {
+            _execute(&jobs[i], counter);
+        }
+        return;
+    }
+
+    job_thread_t* self = &g_threads[index];
+    u32 pushed = 0;
+    for (u32 i = 0; i < count; i++) {
+        job_t* job = &self->ring[self->ring_next++ & (JOB_QUEUE_CAPACITY - 1)];
+        // A slot still owned by a running or queued job, or a full deque,
+        // means we are submitting faster than anyone drains: run it here.
+        if (atomic_load_explicit(&job->busy, memory_order_acquire)) {
+            _execute(&jobs[i], counter);
+            continue;
+        }
+        job->desc = jobs[i];
+        job->counter = counter;
+        atomic_store_explicit(&job->busy, 1, memory_order_relaxed);
+        if (!_deque_push(&self->deque, job)) {
+            atomic_store_explicit(&job->busy, 0, memory_order_relaxed);
+            _execute(&jobs[i], counter);
+            continue;
+        }
+        pushed++;
+    }
+
+    if (pushed > 0) {
+        atomic_fetch_add(&g_queued, pushed);
+        if (atomic_load(&g_sleepers) > 0) {
+            mtx_lock(&g_sleep_lock);
+            pushed > 1 ? cnd_broadcast(&g_sleep_wake) : cnd_signal(&g_sleep_wake);
+            mtx_unlock(&g_sleep_lock);
+        }
+    }
+}
+
+void job_run_one(job_fn_t fn, void* data, job_counter_t* counter) {
+    const job_desc_t desc = {fn, data, 0, 1};
+    job_run(&desc, 1, counter);
+}
+
+void job_parallel_for(job_fn_t fn, void* data, u32 count, u32 batch_size, job_counter_t* counter) {
+    if (count == 0) {
+        return;
+    }
+    batch_size = batch_size > 0 ? batch_size : 1;
+    job_desc_t batch[64];
+    u32 filled = 0;
+    for (u32 begin = 0; begin < count; begin += batch_size) {
+        const u32 end = count - begin > batch_size ? begin + batch_size : count;
+        batch[filled++] = (job_desc_t) {fn, data, begin, end};
+        if (filled == sizeof(batch) / sizeof(batch[0])) {
+            job_run(batch, filled, counter);
+            filled = 0;
+        }
+    }
+    if (filled > 0) {
+        job_run(batch, filled, counter);
+    }
+}
+
+void job_wait(job_counter_t* counter) {
+    const u32 index = t_thread_index;
+    while (atomic_load_explicit(&counter->pending, memory_order_acquire) > 0) {
+        job_t* job = index != JOB_NO_THREAD && g_threads ? _find_job(index) : 0;
+        if (job) {
+            _run_job(job);
+        } else {
+            thrd_yield();
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#include "core/memory.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+static _Atomic u64 current_bytes[MEMORY_TAG_COUNT];
+static _Atomic u64 peak_bytes[MEMORY_TAG_COUNT];
+static _Atomic u64 allocation_count[MEMORY_TAG_COUNT];
+static _Atomic u64 total_current;
+static _Atomic u64 total_peak;
+
+static void _raise_peak(_Atomic u64* peak, u64 value) {
+    u64 seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(peak, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void _track(u64 size, memory_tag_t tag) {
+    const u64 now = atomic_fetch_add_explicit(&current_bytes[tag], size, memory_order_relaxed) + size;
+    _raise_peak(&peak_bytes[tag], now);
+    const u64 total = atomic_fetch_add_explicit(&total_current, size, memory_order_relaxed) + size;
+    _raise_peak(&total_peak, total);
+}
+
+static void _untrack(u64 size, memory_tag_t tag) {
+    atomic_fetch_sub_explicit(&current_bytes[tag], size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&total_current, size, memory_order_relaxed);
+}
+
+void* memory_alloc(u64 size, memory_tag_t tag) {
+    void* ptr = malloc(size);
+    if (ptr) {
+        atomic_fetch_add_explicit(&allocation_count[tag], 1, memory_order_relaxed);
+        _track(size, tag);
+    }
+    return ptr;
+}
+
+void* memory_alloc_zeroed(u64 size, memory_tag_t tag) {
+    void* ptr = calloc(1, size);
+    if (ptr) {
+        atomic_fetch_add_explicit(&allocation_count[tag], 1, memory_order_relaxed);
+        _track(size, tag);
+    }
+    return ptr;
+}
+
+void* memory_realloc(void* ptr, u64 old_size, u64 new_size, memory_tag_t tag) {
+    void* grown = realloc(ptr, new_size);
+    if (!grown) {
+        return 0;
+    }
+    if (!ptr) {
+        atomic_fetch_add_explicit(&allocation_count[tag], 1, memory_order_relaxed);
+    }
+    _untrack(ptr ? old_size : 0, tag);
+    _track(new_size, tag);
+    return grown;
+}
+
+void memory_free(void* ptr, u64 size, memory_tag_t tag) {
+    if (!ptr) {
+        return;
+    }
+    free(ptr);
+    _untrack(size, tag);
+}
+
+void memory_get_stats(memory_stats_t* out) {
+    for (u32 i = 0; i < MEMORY_TAG_COUNT; i++) {
+        out->current[i] = atomic_load_explicit(&current_bytes[i], memory_order_relaxed);
+        out->peak[i] = atomic_load_explicit(&peak_bytes[i], memory_order_relaxed);
+        out->allocations[i] = atomic_load_explicit(&allocation_count[i], memory_order_relaxed);
+    }
+    out->total_current = atomic_load_explicit(&total_current, memory_order_relaxed);
+    out->total_peak = atomic_load_explicit(&total_peak, memory_order_relaxed);
+}
+
+const char* memory_tag_str(memory_tag_t tag) {
+    switch (tag) {
+        case MEMORY_TAG_UNKNOWN: return "untagged";
+        case MEMORY_TAG_ARRAY: return "array";
+        case MEMORY_TAG_ARENA: return "arena";
+        case MEMORY_TAG_POOL: return "pool";
+        case MEMORY_TAG_HASH_MAP: return "hash map";
+        case MEMORY_TAG_FILE: return "file";
+        case MEMORY_TAG_MESH: return "mesh";
+        case MEMORY_TAG_RENDERER: return "renderer";
+        case MEMORY_TAG_PROFILER: return "profiler";
+        case MEMORY_TAG_COUNT: break;
+    }
+    return "invalid";
+}
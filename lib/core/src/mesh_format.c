@@ -0,0 +1,189 @@
+#include "core/mesh_format.h"
+#include "core/hash.h"
+#include "core/quantise.h"
+
+#include <string.h>
+
+#define MESH_FORMAT_CHECKSUM_SEED 0x5054494Du
+
+u64 mesh_format_align(u64 offset) {
+    return (offset + MESH_FORMAT_ALIGNMENT - 1) & ~((u64) MESH_FORMAT_ALIGNMENT - 1);
+}
+
+u64 mesh_format_checksum(const void* data, u64 size) {
+    const u8* bytes = data;
+    return hash_bytes(bytes + sizeof(mesh_file_header_t), size - sizeof(mesh_file_header_t),
+                      MESH_FORMAT_CHECKSUM_SEED);
+}
+
+mesh_format_result_t mesh_format_validate(const void* data, u64 size, b8 verify_checksum) {
+    if (size < sizeof(mesh_file_header_t)) {
+        return MESH_FORMAT_ERR_TRUNCATED;
+    }
+    const mesh_file_header_t* header = data;
+    if (header->magic != MESH_FORMAT_MAGIC) {
+        return MESH_FORMAT_ERR_MAGIC;
+    }
+    if (header->version != MESH_FORMAT_VERSION) {
+        return MESH_FORMAT_ERR_VERSION;
+    }
+    if (header->file_size != size) {
+        return MESH_FORMAT_ERR_TRUNCATED;
+    }
+
+    const u64 table_size = (u64) header->section_count * sizeof(mesh_file_section_t);
+    if (header->sections_offset % MESH_FORMAT_ALIGNMENT != 0 ||
+        header->sections_offset < sizeof(mesh_file_header_t) ||
+        header->sections_offset + table_size > size) {
+        return MESH_FORMAT_ERR_SECTION;
+    }
+
+    const mesh_file_section_t* sections =
+        (const mesh_file_section_t*) ((const u8*) data + header->sections_offset);
+    for (u32 i = 0; i < header->section_count; i++) {
+        const mesh_file_section_t* s = &sections[i];
+        if (s->offset % MESH_FORMAT_ALIGNMENT != 0 || s->offset > size || s->size > size - s->offset ||
+            s->count * s->stride != s->size) {
+            return MESH_FORMAT_ERR_SECTION;
+        }
+    }
+
+    if (verify_checksum && mesh_format_checksum(data, size) != header->checksum) {
+        return MESH_FORMAT_ERR_CHECKSUM;
+    }
+    return MESH_FORMAT_OK;
+}
+
+const mesh_file_section_t* mesh_format_find_section(const void* data, u32 type) {
+    const mesh_file_header_t* header = data;
+    const mesh_file_section_t* sections =
+        (const mesh_file_section_t*) ((const u8*) data + header->sections_offset);
+    for (u32 i = 0; i < header->section_count; i++) {
+        if (sections[i].type == type) {
+            return &sections[i];
+        }
+    }
+    return 0;
+}
+
+const char* mesh_format_result_str(mesh_format_result_t result) {
+    switch (result) {
+        case MESH_FORMAT_OK: return "ok";
+        case MESH_FORMAT_ERR_IO: return "i/o error";
+        case MESH_FORMAT_ERR_TRUNCATED: return "truncated file";
+        case MESH_FORMAT_ERR_MAGIC: return "bad magic";
+        case MESH_FORMAT_ERR_VERSION: return "unsupported version";
+        case MESH_FORMAT_ERR_SECTION: return "malformed section table";
+        case MESH_FORMAT_ERR_CHECKSUM: return "checksum mismatch";
+    }
+    return "unknown";
+}
+
+u32 mesh_format_select_lod(const mesh_file_lod_t* lods, u32 lod_count, f32 distance, f32 projection_scale,
+                           f32 pixel_threshold) {
+    if (distance <= 0.f) {
+        return 0;
+    }
+    u32 selected = 0;
+    for (u32 i = 1; i < lod_count; i++) {
+        if (lods[i].error * projection_scale / distance > pixel_threshold) {
+            break;
+        }
+        selected = i;
+    }
+    return selected;
+}
+
+u32 mesh_format_encoding_stride(u16 encoding, u32 components) {
+    switch (encoding) {
+        case MESH_ENCODING_UNORM16_POSITION: return 4 * sizeof(u16);
+        case MESH_ENCODING_OCT16_NORMAL:
+        case MESH_ENCODING_OCT16_TANGENT: return 2 * sizeof(i16);
+        case MESH_ENCODING_F16_TEX_COORD: return 2 * sizeof(u16);
+        case MESH_ENCODING_U16_INDEX: return sizeof(u16);
+        case MESH_ENCODING_U32_INDEX: return sizeof(u32);
+        default: return components * sizeof(f32);
+    }
+}
+
+void mesh_format_encode_position(const f32 p[3], const mesh_file_bounds_t* bounds, u16 out[4]) {
+    for (u32 k = 0; k < 3; k++) {
+        const f32 extent = bounds->max[k] - bounds->min[k];
+        out[k] = extent > 0.f ? quantise_unorm16((p[k] - bounds->min[k]) / extent) : 0;
+    }
+    out[3] = 0;
+}
+
+void mesh_format_encode_normal(const f32 n[3], i16 out[2]) {
+    f32 e[2];
+    oct_encode(n, e);
+    out[0] = quantise_snorm16(e[0]);
+    out[1] = quantise_snorm16(e[1]);
+}
+
+void mesh_format_encode_tangent(const f32 t[4], i16 out[2]) {
+    f32 e[2];
+    oct_encode(t, e);
+    out[0] = quantise_snorm16(e[0]);
+    const i16 y = (i16) (quantise_snorm16(e[1]) / 2);
+    out[1] = (i16) (y * 2 + (t[3] < 0.f ? 1 : 0));
+}
+
+void mesh_format_decode_position(const void* element, u16 encoding, const mesh_file_bounds_t* bounds, f32 out[3]) {
+    if (encoding == MESH_ENCODING_UNORM16_POSITION) {
+        u16 q[4];
+        memcpy(q, element, sizeof(q));
+        for (u32 k = 0; k < 3; k++) {
+            out[k] = bounds->min[k] + (f32) q[k] * bounds->dequant_scale[k];
+        }
+        return;
+    }
+    memcpy(out, element, 3 * sizeof(f32));
+}
+
+void mesh_format_decode_normal(const void* element, u16 encoding, f32 out[3]) {
+    if (encoding == MESH_ENCODING_OCT16_NORMAL) {
+        i16 q[2];
+        memcpy(q, element, sizeof(q));
+        const f32 e[2] = {dequantise_snorm16(q[0]), dequantise_snorm16(q[1])};
+        oct_decode(e, out);
+        return;
+    }
+    memcpy(out, element, 3 * sizeof(f32));
+}
+
+void mesh_format_decode_tangent(const void* element, u16 encoding, f32 out[4]) {
+    if (encoding == MESH_ENCODING_OCT16_TANGENT) {
+        i16 q[2];
+        memcpy(q, element, sizeof(q));
+        const i32 sign_bit = q[1] & 1;
+        const i32 y = ((i32) q[1] - sign_bit) / 2;
+        const f32 e[2] = {dequantise_snorm16(q[0]), dequantise_snorm16((i16) (y * 2))};
+        oct_decode(e, out);
+        out[3] = sign_bit ? -1.f : 1.f;
+        return;
+    }
+    memcpy(out, element, 4 * sizeof(f32));
+}
+
+void mesh_format_decode_tex_coord(const void* element, u16 encoding, f32 out[2]) {
+    if (encoding == MESH_ENCODING_F16_TEX_COORD) {
+        u16 h[2];
+        memcpy(h, element, sizeof(h));
+        out[0] = half_to_f32(h[0]);
+        out[1] = half_to_f32(h[1]);
+        return;
+    }
+    memcpy(out, element, 2 * sizeof(f32));
+}
+
+u32 mesh_format_decode_index(const void* indices, u16 encoding, u64 i) {
+    if (encoding == MESH_ENCODING_U16_INDEX) {
+        u16 index;
+        memcpy(&index, (const u8*) indices + i * sizeof(u16), sizeof(u16));
+        return index;
+    }
+    u32 index;
+    memcpy(&index, (const u8*) indices + i * sizeof(u32), sizeof(u32));
+    return index;
+}
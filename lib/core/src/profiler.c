@@ -0,0 +1,251 @@
+#include "core/profiler.h"
+#include "core/file.h"
+#include "core/memory.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct {
+    const char* name;
+    u64 start;
+    u64 end;
+} profiler_zone_t;
+
+typedef struct {
+    profiler_zone_t* zones;
+    // Zones written so far; the ring holds the last PROFILER_THREAD_CAPACITY.
+    _Atomic u64 head;
+    const char* open_names[PROFILER_MAX_DEPTH];
+    u64 open_starts[PROFILER_MAX_DEPTH];
+    // Can exceed PROFILER_MAX_DEPTH, zones past it are not recorded.
+    u32 depth;
+    u32 id;
+    char name[PROFILER_NAME_LENGTH];
+} profiler_thread_t;
+
+_Static_assert((PROFILER_THREAD_CAPACITY & (PROFILER_THREAD_CAPACITY - 1)) == 0,
+               "profiler capacity must be a power of two");
+
+static _Atomic(profiler_thread_t*) g_threads[PROFILER_MAX_THREADS];
+static _Atomic u32 g_thread_count = 0;
+static _Atomic u64 g_epoch = 0;
+// Bumped by profiler_shutdown so threads drop their stale ring and register
+// again on their next zone.
+static _Atomic u32 g_generation = 1;
+static _Thread_local profiler_thread_t* t_thread = 0;
+static _Thread_local u32 t_generation = 0;
+
+u64 profiler_now() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (u64) ((counter.QuadPart / frequency.QuadPart) * 1000000000ull +
+                  (counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * 1000000000ull + (u64) ts.tv_nsec;
+#endif
+}
+
+void profiler_init() {
+    u64 expected = 0;
+    atomic_compare_exchange_strong(&g_epoch, &expected, profiler_now());
+}
+
+static profiler_thread_t* _register() {
+    profiler_init();
+    const u32 index = atomic_fetch_add(&g_thread_count, 1);
+    if (index >= PROFILER_MAX_THREADS) {
+        return 0;
+    }
+    profiler_thread_t* thread = memory_alloc_zeroed(sizeof(profiler_thread_t), MEMORY_TAG_PROFILER);
+    thread->zones = memory_alloc(sizeof(profiler_zone_t) * PROFILER_THREAD_CAPACITY, MEMORY_TAG_PROFILER);
+    thread->id = index;
+    snprintf(thread->name, sizeof(thread->name), "thread %u", index);
+    atomic_store_explicit(&g_threads[index], thread, memory_order_release);
+    return thread;
+}
+
+static profiler_thread_t* _this_thread() {
+    const u32 generation = atomic_load_explicit(&g_generation, memory_order_acquire);
+    if (t_generation == generation) {
+        return t_thread;
+    }
+    t_generation = generation;
+    t_thread = _register();
+    return t_thread;
+}
+
+static void _push_zone(profiler_thread_t* thread, const char* name, u64 start, u64 end) {
+    const u64 head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+    profiler_zone_t* zone = &thread->zones[head & (PROFILER_THREAD_CAPACITY - 1)];
+    zone->name = name;
+    zone->start = start;
+    zone->end = end;
+    atomic_store_explicit(&thread->head, head + 1, memory_order_release);
+}
+
+void profiler_begin(const char* name) {
+    profiler_thread_t* thread = _this_thread();
+    if (!thread) {
+        return;
+    }
+    if (thread->depth < PROFILER_MAX_DEPTH) {
+        thread->open_names[thread->depth] = name;
+        thread->open_starts[thread->depth] = profiler_now();
+    }
+    thread->depth++;
+}
+
+void profiler_end() {
+    profiler_thread_t* thread = _this_thread();
+    if (!thread || thread->depth == 0) {
+        return;
+    }
+    thread->depth--;
+    if (thread->depth >= PROFILER_MAX_DEPTH) {
+        return;
+    }
+    _push_zone(thread, thread->open_names[thread->depth], thread->open_starts[thread->depth], profiler_now());
+}
+
+void profiler_set_thread_name(const char* name) {
+    profiler_thread_t* thread = _this_thread();
+    if (thread) {
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+    }
+}
+
+u32 profiler_track_create(const char* name) {
+    profiler_thread_t* track = _register();
+    if (!track) {
+        return PROFILER_NO_TRACK;
+    }
+    snprintf(track->name, sizeof(track->name), "%s", name);
+    return track->id;
+}
+
+void profiler_track_zone(u32 track, const char* name, u64 start, u64 end) {
+    if (track >= PROFILER_MAX_THREADS) {
+        return;
+    }
+    profiler_thread_t* thread = atomic_load_explicit(&g_threads[track], memory_order_acquire);
+    if (thread) {
+        _push_zone(thread, name, start, end);
+    }
+}
+
+static u32 _published_count() {
+    const u32 count = atomic_load(&g_thread_count);
+    return count < PROFILER_MAX_THREADS ? count : PROFILER_MAX_THREADS;
+}
+
+void profiler_clear() {
+    for (u32 i = 0; i < _published_count(); i++) {
+        profiler_thread_t* thread = atomic_load_explicit(&g_threads[i], memory_order_acquire);
+        if (thread) {
+            atomic_store_explicit(&thread->head, 0, memory_order_relaxed);
+        }
+    }
+}
+
+void profiler_shutdown() {
+    atomic_fetch_add_explicit(&g_generation, 1, memory_order_release);
+    for (u32 i = 0; i < _published_count(); i++) {
+        profiler_thread_t* thread = atomic_exchange(&g_threads[i], 0);
+        if (thread) {
+            memory_free(thread->zones, sizeof(profiler_zone_t) * PROFILER_THREAD_CAPACITY, MEMORY_TAG_PROFILER);
+            memory_free(thread, sizeof(profiler_thread_t), MEMORY_TAG_PROFILER);
+        }
+    }
+    atomic_store(&g_thread_count, 0);
+    atomic_store(&g_epoch, 0);
+}
+
+typedef struct {
+    char* data;
+    u64 size;
+    u64 capacity;
+} trace_writer_t;
+
+static void _appendf(trace_writer_t* w, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int needed = vsnprintf(0, 0, fmt, args);
+    va_end(args);
+    if (w->size + needed + 1 > w->capacity) {
+        u64 capacity = w->capacity ? w->capacity * 2 : 65536;
+        while (capacity < w->size + needed + 1) {
+            capacity *= 2;
+        }
+        w->data = memory_realloc(w->data, w->capacity, capacity, MEMORY_TAG_PROFILER);
+        w->capacity = capacity;
+    }
+    va_start(args, fmt);
+    vsnprintf(w->data + w->size, needed + 1, fmt, args);
+    va_end(args);
+    w->size += needed;
+}
+
+static void _append_string(trace_writer_t* w, const char* s) {
+    _appendf(w, "\"");
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            _appendf(w, "\\%c", *s);
+        } else if ((u8) *s >= ' ') {
+            _appendf(w, "%c", *s);
+        }
+    }
+    _appendf(w, "\"");
+}
+
+// Chrome wants microseconds; the fraction keeps nanosecond resolution.
+static void _append_zone(trace_writer_t* w, b8* first, u32 tid, const char* name, u64 start, u64 end, u64 epoch) {
+    _appendf(w, "%s\n{\"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"name\": ", *first ? "" : ",", tid);
+    _append_string(w, name);
+    _appendf(w, ", \"ts\": %.3f, \"dur\": %.3f}", (f64) (i64) (start - epoch) / 1000.0,
+             (f64) (end - start) / 1000.0);
+    *first = false;
+}
+
+b8 profiler_export_chrome(const char* path) {
+    trace_writer_t w = {0};
+    const u64 epoch = atomic_load(&g_epoch);
+    b8 first = true;
+    _appendf(&w, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (u32 i = 0; i < _published_count(); i++) {
+        profiler_thread_t* thread = atomic_load_explicit(&g_threads[i], memory_order_acquire);
+        if (!thread) {
+            continue;
+        }
+        _appendf(&w, "%s\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"name\": \"thread_name\", \"args\": {\"name\": ",
+                 first ? "" : ",", thread->id);
+        _append_string(&w, thread->name);
+        _appendf(&w, "}}");
+        first = false;
+
+        const u64 head = atomic_load_explicit(&thread->head, memory_order_acquire);
+        const u64 count = head < PROFILER_THREAD_CAPACITY ? head : PROFILER_THREAD_CAPACITY;
+        for (u64 z = head - count; z < head; z++) {
+            const profiler_zone_t* zone = &thread->zones[z & (PROFILER_THREAD_CAPACITY - 1)];
+            _append_zone(&w, &first, thread->id, zone->name, zone->start, zone->end, epoch);
+        }
+    }
+    _appendf(&w, "\n]}\n");
+    const file_result_t result = file_write_atomic(path, w.data, w.size);
+    memory_free(w.data, w.capacity, MEMORY_TAG_PROFILER);
+    return result == FILE_OK;
+}
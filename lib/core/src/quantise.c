@@ -0,0 +1,126 @@
+#include "core/quantise.h"
+
+#include <math.h>
+#include <string.h>
+
+static f32 _clamp(f32 v, f32 lo, f32 hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static f32 _sign_not_zero(f32 v) {
+    return v >= 0.f ? 1.f : -1.f;
+}
+
+u16 quantise_unorm16(f32 v) {
+    return (u16) (_clamp(v, 0.f, 1.f) * 65535.f + 0.5f);
+}
+
+f32 dequantise_unorm16(u16 q) {
+    return (f32) q / 65535.f;
+}
+
+i16 quantise_snorm16(f32 v) {
+    return (i16) lroundf(_clamp(v, -1.f, 1.f) * 32767.f);
+}
+
+f32 dequantise_snorm16(i16 q) {
+    return _clamp((f32) q / 32767.f, -1.f, 1.f);
+}
+
+u16 half_from_f32(f32 v) {
+    u32 bits;
+    memcpy(&bits, &v, sizeof(u32));
+    const u32 sign = (bits >> 16) & 0x8000u;
+    const u32 raw_exp = (bits >> 23) & 0xffu;
+    u32 mant = bits & 0x7fffffu;
+
+    if (raw_exp == 0xffu) {
+        return (u16) (sign | 0x7c00u | (mant ? 0x200u : 0u));
+    }
+    const i32 exp = (i32) raw_exp - 127 + 15;
+    if (exp >= 31) {
+        return (u16) (sign | 0x7c00u);
+    }
+    if (exp <= 0) {
+        if (exp < -10) {
+            return (u16) sign;
+        }
+        mant |= 0x800000u;
+        const u32 shift = (u32) (14 - exp);
+        u32 half_mant = mant >> shift;
+        const u32 rem = mant & ((1u << shift) - 1u);
+        const u32 halfway = 1u << (shift - 1u);
+        if (rem > halfway || (rem == halfway && (half_mant & 1u))) {
+            half_mant++;
+        }
+        return (u16) (sign | half_mant);
+    }
+
+    u32 h = sign | ((u32) exp << 10) | (mant >> 13);
+    const u32 rem = mant & 0x1fffu;
+    // Round to nearest even, a carry into the exponent is the correct result.
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) {
+        h++;
+    }
+    return (u16) h;
+}
+
+f32 half_to_f32(u16 h) {
+    const u32 sign = ((u32) h & 0x8000u) << 16;
+    u32 exp = ((u32) h >> 10) & 0x1fu;
+    u32 mant = (u32) h & 0x3ffu;
+    u32 bits;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400u)) {
+                mant <<= 1;
+                exp--;
+            }
+            mant &= 0x3ffu;
+            bits = sign | (exp << 23) | (mant << 13);
+        }
+    } else if (exp == 31) {
+        bits = sign | 0x7f800000u | (mant << 13);
+    } else {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    f32 v;
+    memcpy(&v, &bits, sizeof(f32));
+    return v;
+}
+
+void oct_encode(const f32 n[3], f32 out[2]) {
+    const f32 l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    const f32 inv = l1 > 0.f ? 1.f / l1 : 0.f;
+    f32 x = n[0] * inv;
+    f32 y = n[1] * inv;
+    if (n[2] < 0.f) {
+        const f32 fx = (1.f - fabsf(y)) * _sign_not_zero(x);
+        const f32 fy = (1.f - fabsf(x)) * _sign_not_zero(y);
+        x = fx;
+        y = fy;
+    }
+    out[0] = x;
+    out[1] = y;
+}
+
+void oct_decode(const f32 e[2], f32 out[3]) {
+    f32 x = e[0];
+    f32 y = e[1];
+    const f32 z = 1.f - fabsf(x) - fabsf(y);
+    if (z < 0.f) {
+        const f32 fx = (1.f - fabsf(y)) * _sign_not_zero(x);
+        const f32 fy = (1.f - fabsf(x)) * _sign_not_zero(y);
+        x = fx;
+        y = fy;
+    }
+    const f32 len = sqrtf(x * x + y * y + z * z);
+    const f32 inv = len > 0.f ? 1.f / len : 0.f;
+    out[0] = x * inv;
+    out[1] = y * inv;
+    out[2] = z * inv;
+}
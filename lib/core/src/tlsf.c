@@ -0,0 +1,327 @@
+#include "core/tlsf.h"
+#include "core/bitwise.h"
+#include "core/memory.h"
+
+#include <string.h>
+
+#define TLSF_MIN_CAPACITY 16u
+
+static void _mapping(u64 size, u32* fl, u32* sl) {
+    if (size < TLSF_SL_COUNT) {
+        *fl = 0;
+        *sl = (u32) size;
+        return;
+    }
+    const u32 msb = bit_highest_set(size);
+    *fl = msb - TLSF_SL_LOG + 1;
+    *sl = (u32) (size >> (msb - TLSF_SL_LOG)) - TLSF_SL_COUNT;
+}
+
+// Rounds size up to the next bin boundary so any block in the bin it maps to
+// is big enough. Returns false if that overflows.
+static b8 _mapping_search(u64 size, u32* fl, u32* sl) {
+    if (size >= TLSF_SL_COUNT) {
+        const u64 round = (1ull << (bit_highest_set(size) - TLSF_SL_LOG)) - 1;
+        if (size > ~0ull - round) {
+            return false;
+        }
+        size += round;
+    }
+    _mapping(size, fl, sl);
+    return *fl < TLSF_FL_COUNT;
+}
+
+static u32 _node_new(tlsf_t* tlsf) {
+    if (tlsf->unused_head == TLSF_NONE) {
+        const u32 old_capacity = tlsf->block_capacity;
+        const u32 capacity = old_capacity < TLSF_MIN_CAPACITY ? TLSF_MIN_CAPACITY : old_capacity * 2;
+        tlsf->blocks = memory_realloc(tlsf->blocks, old_capacity * sizeof(tlsf_block_t),
+                                      capacity * sizeof(tlsf_block_t), MEMORY_TAG_POOL);
+        for (u32 i = capacity; i > old_capacity; i--) {
+            tlsf->blocks[i - 1].next_free = tlsf->unused_head;
+            tlsf->unused_head = i - 1;
+        }
+        tlsf->block_capacity = capacity;
+    }
+    const u32 node = tlsf->unused_head;
+    tlsf->unused_head = tlsf->blocks[node].next_free;
+    memset(&tlsf->blocks[node], 0, sizeof(tlsf_block_t));
+    tlsf->blocks[node].prev_phys = TLSF_NONE;
+    tlsf->blocks[node].next_phys = TLSF_NONE;
+    tlsf->blocks[node].prev_free = TLSF_NONE;
+    tlsf->blocks[node].next_free = TLSF_NONE;
+    return node;
+}
+
+static void _node_release(tlsf_t* tlsf, u32 node) {
+    tlsf->blocks[node].next_free = tlsf->unused_head;
+    tlsf->unused_head = node;
+}
+
+static void _insert_free(tlsf_t* tlsf, u32 node) {
+    tlsf_block_t* block = &tlsf->blocks[node];
+    u32 fl, sl;
+    _mapping(block->size, &fl, &sl);
+    const u32 head = tlsf->heads[fl][sl];
+    block->free = true;
+    block->prev_free = TLSF_NONE;
+    block->next_free = head;
+    if (head != TLSF_NONE) {
+        tlsf->blocks[head].prev_free = node;
+    }
+    tlsf->heads[fl][sl] = node;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+    tlsf->fl_bitmap |= 1ull << fl;
+}
+
+static void _remove_free(tlsf_t* tlsf, u32 node) {
+    tlsf_block_t* block = &tlsf->blocks[node];
+    u32 fl, sl;
+    _mapping(block->size, &fl, &sl);
+    if (block->prev_free != TLSF_NONE) {
+        tlsf->blocks[block->prev_free].next_free = block->next_free;
+    } else {
+        tlsf->heads[fl][sl] = block->next_free;
+    }
+    if (block->next_free != TLSF_NONE) {
+        tlsf->blocks[block->next_free].prev_free = block->prev_free;
+    }
+    if (tlsf->heads[fl][sl] == TLSF_NONE) {
+        tlsf->sl_bitmap[fl] &= ~(1u << sl);
+        if (tlsf->sl_bitmap[fl] == 0) {
+            tlsf->fl_bitmap &= ~(1ull << fl);
+        }
+    }
+    block->free = false;
+    block->prev_free = TLSF_NONE;
+    block->next_free = TLSF_NONE;
+}
+
+// Cuts [offset, offset + size) off the front of node into a new node placed
+// before it in address order. Returns the new node.
+static u32 _split_front(tlsf_t* tlsf, u32 node, u64 size) {
+    const u32 front = _node_new(tlsf);
+    tlsf_block_t* block = &tlsf->blocks[node];
+    tlsf_block_t* split = &tlsf->blocks[front];
+    split->offset = block->offset;
+    split->size = size;
+    split->prev_phys = block->prev_phys;
+    split->next_phys = node;
+    if (block->prev_phys != TLSF_NONE) {
+        tlsf->blocks[block->prev_phys].next_phys = front;
+    }
+    block->prev_phys = front;
+    block->offset += size;
+    block->size -= size;
+    return front;
+}
+
+// Cuts everything past size off the back of node into a new node.
+static u32 _split_back(tlsf_t* tlsf, u32 node, u64 size) {
+    const u32 back = _node_new(tlsf);
+    tlsf_block_t* block = &tlsf->blocks[node];
+    tlsf_block_t* split = &tlsf->blocks[back];
+    split->offset = block->offset + size;
+    split->size = block->size - size;
+    split->prev_phys = node;
+    split->next_phys = block->next_phys;
+    if (block->next_phys != TLSF_NONE) {
+        tlsf->blocks[block->next_phys].prev_phys = back;
+    }
+    block->next_phys = back;
+    block->size = size;
+    return back;
+}
+
+// Folds next into node, next must directly follow it.
+static void _absorb(tlsf_t* tlsf, u32 node, u32 next) {
+    tlsf_block_t* block = &tlsf->blocks[node];
+    const tlsf_block_t* absorbed = &tlsf->blocks[next];
+    block->size += absorbed->size;
+    block->next_phys = absorbed->next_phys;
+    if (absorbed->next_phys != TLSF_NONE) {
+        tlsf->blocks[absorbed->next_phys].prev_phys = node;
+    }
+    _node_release(tlsf, next);
+}
+
+void tlsf_init(tlsf_t* tlsf, u64 size) {
+    memset(tlsf, 0, sizeof(tlsf_t));
+    memset(tlsf->heads, 0xff, sizeof(tlsf->heads));
+    tlsf->unused_head = TLSF_NONE;
+    tlsf->size = size;
+    if (size == 0) {
+        return;
+    }
+    const u32 node = _node_new(tlsf);
+    tlsf->blocks[node].size = size;
+    _insert_free(tlsf, node);
+}
+
+void tlsf_destroy(tlsf_t* tlsf) {
+    memory_free(tlsf->blocks, tlsf->block_capacity * sizeof(tlsf_block_t), MEMORY_TAG_POOL);
+    memset(tlsf, 0, sizeof(tlsf_t));
+    tlsf->unused_head = TLSF_NONE;
+}
+
+u32 tlsf_alloc(tlsf_t* tlsf, u64 size, u64 alignment) {
+    size = size > 0 ? size : 1;
+    alignment = alignment > 0 ? alignment : 1;
+    // Searching for the worst case padding keeps the search O(1), any block
+    // found is big enough wherever it starts.
+    if (size > ~0ull - (alignment - 1)) {
+        return TLSF_NONE;
+    }
+    u32 fl, sl;
+    if (!_mapping_search(size + alignment - 1, &fl, &sl)) {
+        return TLSF_NONE;
+    }
+    u32 sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        const u64 fl_map = fl + 1 < 64 ? tlsf->fl_bitmap & (~0ull << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return TLSF_NONE;
+        }
+        fl = bit_lowest_set(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+    sl = bit_lowest_set(sl_map);
+    const u32 node = tlsf->heads[fl][sl];
+    _remove_free(tlsf, node);
+
+    const u64 offset = tlsf->blocks[node].offset;
+    const u64 padding = ((offset + alignment - 1) & ~(alignment - 1)) - offset;
+    // The block before a free block is never free, so the padding becomes a
+    // block of its own rather than being merged backwards.
+    if (padding > 0) {
+        _insert_free(tlsf, _split_front(tlsf, node, padding));
+    }
+    if (tlsf->blocks[node].size > size) {
+        _insert_free(tlsf, _split_back(tlsf, node, size));
+    }
+    tlsf->used += size;
+    tlsf->alloc_count++;
+    return node;
+}
+
+void tlsf_free(tlsf_t* tlsf, u32 block) {
+    tlsf_block_t* freed = &tlsf->blocks[block];
+    tlsf->used -= freed->size;
+    tlsf->alloc_count--;
+
+    u32 node = block;
+    const u32 next = freed->next_phys;
+    if (next != TLSF_NONE && tlsf->blocks[next].free) {
+        _remove_free(tlsf, next);
+        _absorb(tlsf, node, next);
+    }
+    const u32 prev = tlsf->blocks[node].prev_phys;
+    if (prev != TLSF_NONE && tlsf->blocks[prev].free) {
+        _remove_free(tlsf, prev);
+        _absorb(tlsf, prev, node);
+        node = prev;
+    }
+    _insert_free(tlsf, node);
+}
+
+u64 tlsf_offset(const tlsf_t* tlsf, u32 block) {
+    return tlsf->blocks[block].offset;
+}
+
+u64 tlsf_size(const tlsf_t* tlsf, u32 block) {
+    return tlsf->blocks[block].size;
+}
+
+b8 tlsf_is_empty(const tlsf_t* tlsf) {
+    return tlsf->alloc_count == 0;
+}
+
+u64 tlsf_largest_free(const tlsf_t* tlsf) {
+    if (tlsf->fl_bitmap == 0) {
+        return 0;
+    }
+    const u32 fl = bit_highest_set(tlsf->fl_bitmap);
+    const u32 sl = bit_highest_set(tlsf->sl_bitmap[fl]);
+    // A bin spans a range of sizes, the head is not necessarily the largest.
+    u64 largest = 0;
+    for (u32 node = tlsf->heads[fl][sl]; node != TLSF_NONE; node = tlsf->blocks[node].next_free) {
+        largest = tlsf->blocks[node].size > largest ? tlsf->blocks[node].size : largest;
+    }
+    return largest;
+}
+
+b8 tlsf_validate(const tlsf_t* tlsf) {
+    if (tlsf->size == 0) {
+        return tlsf->fl_bitmap == 0 && tlsf->alloc_count == 0;
+    }
+    // The live node without a predecessor starts the physical chain.
+    b8* unused = memory_alloc_zeroed(tlsf->block_capacity, MEMORY_TAG_POOL);
+    for (u32 node = tlsf->unused_head; node != TLSF_NONE; node = tlsf->blocks[node].next_free) {
+        unused[node] = true;
+    }
+    u32 first = TLSF_NONE;
+    for (u32 node = 0; node < tlsf->block_capacity && first == TLSF_NONE; node++) {
+        if (!unused[node] && tlsf->blocks[node].prev_phys == TLSF_NONE) {
+            first = node;
+        }
+    }
+    memory_free(unused, tlsf->block_capacity, MEMORY_TAG_POOL);
+    if (first == TLSF_NONE) {
+        return false;
+    }
+
+    u64 offset = 0;
+    u64 used = 0;
+    u32 allocs = 0;
+    u32 free_blocks = 0;
+    b8 prev_free = false;
+    for (u32 node = first; node != TLSF_NONE; node = tlsf->blocks[node].next_phys) {
+        const tlsf_block_t* block = &tlsf->blocks[node];
+        if (block->offset != offset || block->size == 0) {
+            return false;
+        }
+        if (block->next_phys != TLSF_NONE && tlsf->blocks[block->next_phys].prev_phys != node) {
+            return false;
+        }
+        if (block->free) {
+            if (prev_free) {
+                return false;
+            }
+            u32 fl, sl;
+            _mapping(block->size, &fl, &sl);
+            u32 walk = tlsf->heads[fl][sl];
+            while (walk != TLSF_NONE && walk != node) {
+                walk = tlsf->blocks[walk].next_free;
+            }
+            if (walk != node) {
+                return false;
+            }
+            free_blocks++;
+        } else {
+            used += block->size;
+            allocs++;
+        }
+        prev_free = block->free;
+        offset += block->size;
+    }
+    if (offset != tlsf->size || used != tlsf->used || allocs != tlsf->alloc_count) {
+        return false;
+    }
+
+    u32 listed = 0;
+    for (u32 fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (u32 sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            const b8 bit = (tlsf->sl_bitmap[fl] >> sl) & 1u;
+            if (bit != (tlsf->heads[fl][sl] != TLSF_NONE)) {
+                return false;
+            }
+            for (u32 node = tlsf->heads[fl][sl]; node != TLSF_NONE; node = tlsf->blocks[node].next_free) {
+                listed++;
+            }
+        }
+        if (((tlsf->fl_bitmap >> fl) & 1u) != (tlsf->sl_bitmap[fl] != 0)) {
+            return false;
+        }
+    }
+    return listed == free_blocks;
+}
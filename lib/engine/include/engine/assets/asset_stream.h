@@ -0,0 +1,67 @@
+#ifndef ASSETS_ASSET_STREAM_H
+#define ASSETS_ASSET_STREAM_H
+
+#include <core/file.h>
+#include <core/handle.h>
+#include <stdint.h>
+
+typedef enum {
+  ASSET_REQUEST_READ = 0,
+  ASSET_REQUEST_MAP,
+} asset_request_kind_t;
+
+typedef enum {
+  ASSET_STATUS_QUEUED = 0,
+  ASSET_STATUS_LOADING,
+  ASSET_STATUS_DONE,
+  ASSET_STATUS_FAILED,
+  ASSET_STATUS_CANCELLED,
+} asset_status_t;
+
+#define ASSET_PRIORITY_LOW 0u
+#define ASSET_PRIORITY_NORMAL 100u
+#define ASSET_PRIORITY_HIGH 200u
+
+// Result of a finished request. READ requests fill buffer, MAP requests fill
+// map. A callback may take ownership of either by zeroing it.
+typedef struct {
+  handle_t request;
+  asset_status_t status;
+  file_result_t error;
+  asset_request_kind_t kind;
+  file_buffer_t buffer;
+  file_map_t map;
+  void *user_data;
+} asset_load_t;
+
+typedef void (*asset_stream_callback_t)(asset_load_t *load);
+
+// Reads happen on background workers. Nothing user supplied runs there:
+// callbacks fire from asset_stream_drain on whichever thread calls it,
+// normally once per frame on the main thread.
+void asset_stream_init(uint32_t worker_count, uint32_t max_requests);
+void asset_stream_shutdown();
+
+// Higher priorities are served first, equal priorities in request order.
+// Returns an invalid handle when max_requests are in flight or the path
+// cannot be copied.
+handle_t asset_stream_request(const char *path, asset_request_kind_t kind,
+                              uint32_t priority,
+                              asset_stream_callback_t callback,
+                              void *user_data);
+// Queued requests never start; ones already loading have their result
+// dropped. Either way the request finishes as ASSET_STATUS_CANCELLED.
+uint8_t asset_stream_cancel(handle_t request);
+
+// Polled futures, for requests made without a callback. Returns the current
+// status and, once finished, the result, valid until asset_stream_release.
+// Releasing a request whose callback has not run yet drops the callback.
+asset_status_t asset_stream_poll(handle_t request, const asset_load_t **out);
+void asset_stream_release(handle_t request);
+
+// Runs callbacks for up to max_callbacks finished requests and releases
+// them. Returns how many ran.
+uint32_t asset_stream_drain(uint32_t max_callbacks);
+uint32_t asset_stream_pending();
+
+#endif
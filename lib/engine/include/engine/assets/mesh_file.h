@@ -0,0 +1,37 @@
+#ifndef ASSETS_MESH_FILE_H
+#define ASSETS_MESH_FILE_H
+
+#include <core/file.h>
+#include <core/mesh_format.h>
+#include <stdint.h>
+
+// A compiled mesh mapped straight from disk. Spans point into the mapping and
+// stay valid until mesh_file_close.
+typedef struct {
+  const void *data;
+  uint64_t count;
+  uint32_t stride;
+  uint16_t encoding;
+} mesh_span_t;
+
+typedef struct {
+  file_map_t map;
+  const uint8_t *base;
+  uint64_t size;
+  const mesh_file_header_t *header;
+} mesh_file_t;
+
+mesh_format_result_t mesh_file_open(const char *path, uint8_t verify_checksum,
+                                    mesh_file_t *out);
+void mesh_file_close(mesh_file_t *file);
+uint8_t mesh_file_section(const mesh_file_t *file, uint32_t type,
+                          mesh_span_t *out);
+mesh_span_t mesh_file_positions(const mesh_file_t *file);
+mesh_span_t mesh_file_indices(const mesh_file_t *file);
+const mesh_file_bounds_t *mesh_file_bounds(const mesh_file_t *file,
+                                           uint32_t *count);
+const mesh_file_submesh_t *mesh_file_submeshes(const mesh_file_t *file,
+                                               uint32_t *count);
+void mesh_file_prefetch(const mesh_file_t *file);
+
+#endif
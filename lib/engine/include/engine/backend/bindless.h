@@ -0,0 +1,75 @@
+#ifndef BACKEND_BINDLESS_H
+#define BACKEND_BINDLESS_H
+
+#include <core/handle.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// One update-after-bind descriptor set holds every sampled image, storage
+// buffer and sampler. It is set 0 of every pipeline layout and is bound once
+// per command buffer; draws pick resources by the indices handed out here,
+// passed through push constants, instead of binding sets of their own.
+//
+// Shaders declare:
+//   layout(set = 0, binding = 0) uniform texture2D images[];
+//   layout(set = 0, binding = 1) buffer Buffers { ... } buffers[];
+//   layout(set = 0, binding = 2) uniform sampler samplers[];
+#define BINDLESS_BINDING_SAMPLED_IMAGES 0
+#define BINDLESS_BINDING_STORAGE_BUFFERS 1
+#define BINDLESS_BINDING_SAMPLERS 2
+
+// Upper bounds, lowered to what the device allows.
+#define BINDLESS_MAX_SAMPLED_IMAGES 16384u
+#define BINDLESS_MAX_STORAGE_BUFFERS 16384u
+#define BINDLESS_MAX_SAMPLERS 256u
+
+// Push constant space of the one pipeline layout, visible to all stages.
+// Layouts only stay compatible for set 0 with identical push constant
+// ranges, so every pipeline shares it and the set stays bound across
+// pipeline switches. 128 bytes is the minimum every device supports.
+#define BINDLESS_PUSH_CONSTANT_SIZE 128u
+
+#define BINDLESS_INVALID 0xffffffffu
+
+// Generational, so a handle kept after its removal is caught instead of
+// freeing whatever took its index next.
+typedef handle_t bindless_handle_t;
+
+void bindless_init();
+void bindless_shutdown();
+
+// Null until bindless_init.
+VkDescriptorSetLayout bindless_get_set_layout();
+// The layout every pipeline is built with, for binding the set and pushing
+// constants.
+VkPipelineLayout bindless_get_pipeline_layout();
+
+// Each returns HANDLE_INVALID when the table is full. Safe from any thread,
+// like the rest of the handle functions.
+bindless_handle_t bindless_add_image(VkImageView view, VkImageLayout layout);
+bindless_handle_t bindless_add_buffer(VkBuffer buffer, VkDeviceSize offset,
+                                      VkDeviceSize range);
+bindless_handle_t bindless_add_sampler(VkSampler sampler);
+
+// The index shaders use, BINDLESS_INVALID once the handle has been removed.
+uint32_t bindless_index(bindless_handle_t handle);
+
+// Frames already recorded may still read the descriptor, so the index only
+// becomes free again once every frame in flight at the time has finished.
+// A stale handle, one removed already or one of another kind is rejected:
+// nothing changes and 0 is returned.
+uint8_t bindless_remove_image(bindless_handle_t handle);
+uint8_t bindless_remove_buffer(bindless_handle_t handle);
+uint8_t bindless_remove_sampler(bindless_handle_t handle);
+
+// Called by frame_begin once the slot's fence has been waited on. Frees
+// indices removed at least frames_in_flight frames ago.
+void bindless_begin_frame(uint64_t frame_number, uint32_t frames_in_flight);
+
+// Binds the set for graphics and compute. Secondary command buffers need
+// their own bind, descriptor state is not inherited.
+void bindless_bind(VkCommandBuffer cmd);
+void bindless_push_constants(VkCommandBuffer cmd, const void *data,
+                             uint32_t size);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef BACKEND_FRAME_H
+#define BACKEND_FRAME_H
+
+#include <core/arena.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define FRAME_DEFAULT_IN_FLIGHT 2
+#define FRAME_MAX_IN_FLIGHT 4
+
+// One frame being recorded. cmd is a primary command buffer from a pool that
+// belongs to this frame slot alone and is reset wholesale when the slot comes
+// around again.
+typedef struct {
+  VkCommandBuffer cmd;
+  VkCommandPool pool;
+  VkFramebuffer framebuffer;
+  VkExtent2D extent;
+  uint32_t slot;
+  uint32_t image_index;
+  uint64_t number;
+} frame_t;
+
+// frames_in_flight of 0 picks FRAME_DEFAULT_IN_FLIGHT. More frames let the
+// CPU run further ahead of the GPU at the cost of latency.
+void frame_init(uint32_t frames_in_flight);
+// Waits for the GPU to finish every frame in flight, then frees the per frame
+// objects.
+void frame_shutdown();
+
+// Blocks until the GPU is done with the oldest frame slot, acquires a
+// swapchain image and begins recording. Returns 0 when there is nothing to
+// draw into this time round (swapchain rebuilt or window closing); skip the
+// frame and try again.
+uint8_t frame_begin(frame_t *frame);
+// Begins the main render pass cleared to clear_color. With INLINE contents
+// viewport and scissor are set to cover the whole target; with SECONDARY
+// contents the secondary buffers have to set their own.
+void frame_begin_main_pass(const frame_t *frame, const float clear_color[4],
+                           VkSubpassContents contents);
+void frame_end_main_pass(const frame_t *frame);
+// Headless only: copies the frame's image into host memory once the frame
+// has rendered. Call after frame_end_main_pass and before frame_end.
+void frame_capture(const frame_t *frame);
+// Waits for a captured frame and copies its pixels out as tightly packed
+// RGBA8 rows, extent.width * extent.height * 4 bytes. Returns 0 if the frame
+// was not captured or its slot has been reused since.
+uint8_t frame_read_capture(const frame_t *frame, void *pixels);
+// Submits and presents, or only submits when headless. An out of date or
+// suboptimal swapchain is rebuilt here, the next frame_begin picks the new
+// one up.
+void frame_end(frame_t *frame);
+
+uint32_t frame_in_flight_count();
+// CPU scratch for the frame being recorded, reset by the next frame_begin.
+// Main thread only.
+arena_t *frame_scratch();
+
+#endif
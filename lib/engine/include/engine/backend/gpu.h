@@ -4,6 +4,22 @@
 #include <stdint.h>
 #include <vulkan/vulkan_core.h>
 
+#define GPU_HEADLESS_IMAGE_COUNT 3
+
+// Where the pipeline cache persists between runs, 0 disables it. Call before
+// gpu_init_vk.
+void gpu_preset_pipeline_cache_path(const char* path);
+// Headless mode needs no window system and no surface: any device with a
+// graphics queue will do, and frames go into GPU_HEADLESS_IMAGE_COUNT
+// offscreen images sized by window_preset_resolution in place of a swapchain.
+// Call before gpu_init_vk.
+void gpu_preset_headless(uint8_t headless);
+uint8_t gpu_is_headless();
+// Device to use instead of the best scoring one: an index into the
+// enumeration order, or part of its name in any case. The PTIA_DEVICE
+// environment variable takes precedence. A device that doesn't match or lacks
+// what the backend needs is ignored. Call before gpu_init_vk.
+void gpu_preset_device(const char* device);
 void gpu_init_vk(const char* app_name, uint32_t app_version);
 VkInstance gpu_get_vk_instance();
 VkDevice gpu_get_vk_device();
@@ -12,6 +28,34 @@ VkSwapchainKHR gpu_get_vk_swapchain();
 VkExtent2D gpu_get_swapchain_extent();
 VkFormat gpu_get_swapchain_format();
 VkRenderPass gpu_get_render_pass();
+VkQueue gpu_get_gfx_queue();
+VkQueue gpu_get_present_queue();
+uint32_t gpu_get_gfx_queue_family();
+// A queue of its own for copies when the device has a transfer capable family
+// without graphics, the graphics queue otherwise.
+VkQueue gpu_get_transfer_queue();
+uint32_t gpu_get_transfer_queue_family();
+uint32_t gpu_get_swapchain_image_count();
+VkImage gpu_get_swapchain_image(uint32_t image_index);
+VkFramebuffer gpu_get_framebuffer(uint32_t image_index);
+// Whether VK_EXT_memory_budget was available and got enabled.
+uint8_t gpu_has_memory_budget();
+// Whether VK_EXT_calibrated_timestamps was available and got enabled.
+uint8_t gpu_has_calibrated_timestamps();
+// Whether the device supports these Vulkan 1.3 features. Only availability,
+// they are not enabled while nothing records with them.
+uint8_t gpu_has_dynamic_rendering();
+uint8_t gpu_has_synchronization2();
+
+// Polls window events, returns 0 once the window wants to close. Always 1
+// when headless.
+uint8_t gpu_pump_events();
+// Whether the window was resized since the last call.
+uint8_t gpu_consume_resize();
+// Rebuilds the swapchain, its views and framebuffers for the current window
+// size. Waits for the device to go idle. Returns 0 if the window closed while
+// minimised.
+uint8_t gpu_recreate_swapchain();
 void gpu_destroy_vk();
 
 #endif
\ No newline at end of file
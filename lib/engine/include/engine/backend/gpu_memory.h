@@ -0,0 +1,107 @@
+#ifndef BACKEND_GPU_MEMORY_H
+#define BACKEND_GPU_MEMORY_H
+
+#include <core/handle.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Device memory is taken from the driver in large blocks per memory type and
+// sub-allocated with a TLSF allocator, so the number of vkAllocateMemory
+// calls stays far below maxMemoryAllocationCount. Buffers and linear images
+// never share a block with optimal images, which takes care of
+// bufferImageGranularity. Host visible blocks are mapped once for their
+// whole life.
+#define GPU_MEMORY_BLOCK_SIZE (64ull << 20)
+
+typedef enum {
+  // Device local, never mapped.
+  GPU_MEMORY_DEVICE = 0,
+  // Host visible and coherent, for data the CPU writes once and the GPU
+  // reads, preferring memory the CPU does not cache.
+  GPU_MEMORY_UPLOAD,
+  // Host visible, preferring cached memory, for data the CPU reads back.
+  GPU_MEMORY_READBACK,
+} gpu_memory_usage_t;
+
+typedef handle_t gpu_allocation_t;
+
+typedef struct {
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  // Null unless the memory is host visible.
+  void *mapped;
+  uint32_t memory_type;
+  uint8_t dedicated;
+} gpu_allocation_info_t;
+
+typedef struct {
+  uint32_t blocks;
+  uint32_t dedicated;
+  uint32_t allocations;
+  VkDeviceSize block_bytes;
+  VkDeviceSize dedicated_bytes;
+  VkDeviceSize used_bytes;
+  // Per heap. With VK_EXT_memory_budget these are the driver's numbers and
+  // include other processes, without it usage is this allocator's own and
+  // the budget is 80% of the heap.
+  uint32_t heap_count;
+  VkDeviceSize heap_budget[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize heap_usage[VK_MAX_MEMORY_HEAPS];
+} gpu_memory_stats_t;
+
+void gpu_memory_init();
+// Releases every block, allocations still alive are reported and dropped.
+void gpu_memory_shutdown();
+
+// Raw allocation for requirements the caller queried. linear is 0 only for
+// optimal tiling images. Returns an invalid handle when no suitable memory
+// type has room left within its budget.
+gpu_allocation_t gpu_memory_alloc(const VkMemoryRequirements *requirements,
+                                  gpu_memory_usage_t usage, uint8_t linear);
+void gpu_memory_free(gpu_allocation_t allocation);
+// Returns 0 for stale handles.
+uint8_t gpu_memory_info(gpu_allocation_t allocation,
+                        gpu_allocation_info_t *out);
+
+// Make host writes to a mapped allocation visible to the device, or device
+// writes visible to the host. offset and size are relative to the
+// allocation, VK_WHOLE_SIZE runs to its end. Nothing to do for coherent
+// memory; otherwise the range is widened to whole nonCoherentAtomSize atoms.
+// Returns 0 for stale handles and driver failures.
+uint8_t gpu_memory_flush(gpu_allocation_t allocation, VkDeviceSize offset,
+                         VkDeviceSize size);
+uint8_t gpu_memory_invalidate(gpu_allocation_t allocation, VkDeviceSize offset,
+                              VkDeviceSize size);
+
+// Create the resource, allocate memory for it and bind it. Resources the
+// driver prefers dedicated memory for, and anything over half a block, get a
+// VkDeviceMemory of their own.
+VkResult gpu_buffer_create(const VkBufferCreateInfo *info,
+                           gpu_memory_usage_t usage, VkBuffer *out_buffer,
+                           gpu_allocation_t *out_allocation);
+VkResult gpu_image_create(const VkImageCreateInfo *info,
+                          gpu_memory_usage_t usage, VkImage *out_image,
+                          gpu_allocation_t *out_allocation);
+void gpu_buffer_destroy(VkBuffer buffer, gpu_allocation_t allocation);
+void gpu_image_destroy(VkImage image, gpu_allocation_t allocation);
+
+// Called once an allocation has moved. The owner recreates its buffer, binds
+// it to the new place from gpu_memory_info and destroys the old one.
+typedef void (*gpu_defrag_moved_fn)(gpu_allocation_t allocation,
+                                    void *user_data);
+
+// Records copies into cmd that move buffer allocations out of the emptiest
+// block of every memory type into the others, up to max_bytes in total.
+// Returns the number of allocations being moved. Moved allocations must not
+// be written by the GPU until gpu_memory_defrag_end, which may only be called
+// once cmd has finished executing. Only allocations made by gpu_buffer_create
+// are moved, never images or raw gpu_memory_alloc memory.
+uint32_t gpu_memory_defrag_begin(VkCommandBuffer cmd, VkDeviceSize max_bytes);
+// Points the moved allocations at their new place, calls moved for each of
+// them, then releases the old ranges and any block left empty.
+void gpu_memory_defrag_end(gpu_defrag_moved_fn moved, void *user_data);
+
+void gpu_memory_get_stats(gpu_memory_stats_t *out);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef BACKEND_GPU_PROFILER_H
+#define BACKEND_GPU_PROFILER_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Scopes timed per frame, later ones are not timed.
+#define GPU_PROFILER_MAX_SCOPES 128
+#define GPU_PROFILER_MAX_DEPTH 16
+
+// GPU scopes are a pair of timestamp queries from a pool that belongs to the
+// frame slot. The slot's results are read when frame_begin comes round to it
+// again, after its fence, so reading them never waits on the GPU. Ticks are
+// converted with timestampPeriod, moved onto the profiler_now clock and
+// recorded on a "GPU" profiler track, so they line up with the CPU zones of
+// the same trace.
+//
+// Like CPU zones, scopes are only compiled in with PTIA_PROFILE.
+#ifdef PTIA_PROFILE
+#define GPU_PROFILE_BEGIN(cmd, name) gpu_profiler_begin(cmd, name)
+#define GPU_PROFILE_END(cmd) gpu_profiler_end(cmd)
+#else
+#define GPU_PROFILE_BEGIN(cmd, name) ((void)0)
+#define GPU_PROFILE_END(cmd) ((void)0)
+#endif
+
+typedef struct {
+  const char *name;
+  uint32_t depth;
+  double ms;
+} gpu_profiler_scope_t;
+
+// Called by frame_init and frame_shutdown. Without PTIA_PROFILE, or when the
+// graphics queue has no timestamps, everything here does nothing.
+void gpu_profiler_init(uint32_t frames_in_flight);
+void gpu_profiler_shutdown();
+
+// Called by frame_begin once the slot's fence has signalled and cmd has
+// begun, outside any render pass. Resolves the slot's previous frame and
+// resets its queries.
+void gpu_profiler_begin_frame(uint32_t slot, VkCommandBuffer cmd);
+
+// Scopes nest. Begin and end have to go into the same primary command
+// buffer, recorded on the thread that drives the frame loop. Names are kept
+// by pointer like CPU zone names.
+void gpu_profiler_begin(VkCommandBuffer cmd, const char *name);
+void gpu_profiler_end(VkCommandBuffer cmd);
+
+// Scopes of the last resolved frame in the order they began, that frame
+// being frames_in_flight behind the one being recorded.
+uint32_t gpu_profiler_results(const gpu_profiler_scope_t **out);
+
+#endif
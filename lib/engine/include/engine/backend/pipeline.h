@@ -1,15 +1,124 @@
 #ifndef BACKEND_PIPELINE_H
 #define BACKEND_PIPELINE_H
 
+#include <stdint.h>
 #include <vulkan/vulkan_core.h>
 
+#define PIPELINE_MAX_VERTEX_BINDINGS 4
+#define PIPELINE_MAX_VERTEX_ATTRIBUTES 16
+#define PIPELINE_MAX_COLOR_TARGETS 4
+
+typedef enum {
+  PIPELINE_BLEND_NONE = 0,
+  PIPELINE_BLEND_ALPHA,
+  PIPELINE_BLEND_ADDITIVE,
+  PIPELINE_BLEND_PREMULTIPLIED,
+} pipeline_blend_t;
+
+// Everything that decides which VkPipeline gets built. Viewport and scissor
+// are always dynamic, so descriptions do not depend on the swapchain size.
+// Start from pipeline_desc_init and override what differs.
+typedef struct {
+  const char *vertex_shader;
+  // May be null for depth only passes.
+  const char *fragment_shader;
+
+  uint32_t vertex_binding_count;
+  VkVertexInputBindingDescription vertex_bindings[PIPELINE_MAX_VERTEX_BINDINGS];
+  uint32_t vertex_attribute_count;
+  VkVertexInputAttributeDescription
+      vertex_attributes[PIPELINE_MAX_VERTEX_ATTRIBUTES];
+  VkPrimitiveTopology topology;
+
+  VkPolygonMode polygon_mode;
+  VkCullModeFlags cull_mode;
+  VkFrontFace front_face;
+
+  uint32_t depth_test;
+  uint32_t depth_write;
+  VkCompareOp depth_compare;
+
+  uint32_t color_target_count;
+  VkFormat color_formats[PIPELINE_MAX_COLOR_TARGETS];
+  pipeline_blend_t blend[PIPELINE_MAX_COLOR_TARGETS];
+  VkFormat depth_format;
+  VkSampleCountFlagBits samples;
+
+  // Every pipeline gets the bindless layout, whose push constant range covers
+  // all stages. Bytes the shaders use, more than BINDLESS_PUSH_CONSTANT_SIZE
+  // panics.
+  uint32_t push_constant_size;
+} pipeline_desc_t;
+
+// Shared with every other description that hashed the same, do not destroy.
 typedef struct {
   VkPipelineLayout layout;
   VkPipeline pipeline;
-  VkShaderModule* shaders;
-  uint32_t shader_count;
+  uint64_t hash;
 } pipeline_def_t;
 
-pipeline_def_t create_graphics_pipeline();
+typedef enum {
+  PIPELINE_STATUS_PENDING = 0,
+  PIPELINE_STATUS_READY,
+  PIPELINE_STATUS_FAILED,
+} pipeline_status_t;
+
+typedef struct {
+  uint32_t pipelines;
+  uint32_t shader_modules;
+  uint32_t render_passes;
+  uint64_t hits;
+  uint64_t misses;
+
+  // Requests waiting for a compiler thread, and those inside the driver.
+  uint32_t queue_depth;
+  uint32_t queue_depth_peak;
+  uint32_t compiling;
+  uint64_t compiled;
+  uint64_t failed;
+  // Times pipeline_resolve handed out the fallback.
+  uint64_t fallback_uses;
+  // Batched compiles are charged evenly to every pipeline in the batch.
+  double compile_ms_total;
+  double compile_ms_max;
+  // Longest wait between the request and the start of its compile.
+  double queued_ms_max;
+} pipeline_stats_t;
+
+// Triangle list, filled, back face culled, no depth, one alpha blended target
+// in the swapchain format.
+void pipeline_desc_init(pipeline_desc_t *desc);
+uint64_t pipeline_desc_hash(const pipeline_desc_t *desc);
+
+// Returns the existing pipeline for an identical description, otherwise
+// builds one, reusing shader modules, layouts and render passes. Blocks until
+// the pipeline exists, even if it was already queued asynchronously. A
+// description whose earlier build failed is built again.
+pipeline_def_t create_graphics_pipeline(const pipeline_desc_t *desc);
+
+// Background compilation. Requests are queued and compiler threads load the
+// shaders and hand them to the driver in batches. Without running compiler
+// threads requests compile on the spot.
+void pipeline_compiler_init(uint32_t thread_count);
+// Waits for compiles in flight; anything still queued ends up FAILED.
+void pipeline_compiler_shutdown();
+
+// Non blocking variant of create_graphics_pipeline. Returns an id that stays
+// valid until destroy_graphics_pipelines; requesting a failed description
+// again retries it under the same id. Ids not handed out here panic.
+uint32_t request_graphics_pipeline(const pipeline_desc_t *desc);
+pipeline_status_t pipeline_status(uint32_t id);
+// The requested pipeline once it is ready, the fallback until then. The
+// fallback must be compatible with whatever is being drawn: same render
+// target formats and a layout the bound resources fit. Without a fallback
+// this blocks until the compile is done and panics if it failed.
+pipeline_def_t pipeline_resolve(uint32_t id);
+// Compiles desc synchronously and makes it the fallback.
+void pipeline_set_fallback(const pipeline_desc_t *desc);
+
+void pipeline_get_stats(pipeline_stats_t *out);
+// Stops the compiler threads, then destroys every pipeline and the state
+// shared between them.
+void destroy_graphics_pipelines();
 
-#endif
\ No newline at end of file
+#endif
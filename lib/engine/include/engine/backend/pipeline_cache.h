@@ -0,0 +1,20 @@
+#ifndef BACKEND_PIPELINE_CACHE_H
+#define BACKEND_PIPELINE_CACHE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define PIPELINE_CACHE_DEFAULT_PATH "pipeline_cache.bin"
+
+// Creates the device wide VkPipelineCache, seeded from path when the file was
+// written by the same vendor, device, driver and pipeline cache UUID. Anything
+// else is ignored and the cache starts out empty. A null path keeps the cache
+// in memory only.
+void pipeline_cache_load(const char *path);
+VkPipelineCache pipeline_cache_get();
+// Writes the cache back to the path it was loaded from. Returns 0 on failure.
+uint8_t pipeline_cache_save();
+// Saves, then destroys the cache. Must run before the device goes away.
+void pipeline_cache_destroy();
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef BACKEND_RECORD_H
+#define BACKEND_RECORD_H
+
+#include "engine/backend/frame.h"
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Records items [begin, end) of a draw list into cmd. Viewport and scissor
+// are already set to the frame's extent and the bindless set is bound. Runs
+// on job system threads, several at once, so it must only read shared state.
+typedef void (*record_fn_t)(VkCommandBuffer cmd, void *user_data,
+                            uint32_t begin, uint32_t end);
+
+// Creates a command pool per frame slot and job system thread. Must be called
+// after frame_init and job_system_init: the pools are sized by the thread
+// count at this point, and recording on a thread past it panics. Without a
+// job system everything records on the calling thread.
+void record_init();
+void record_shutdown();
+
+// Splits [0, item_count) into chunks of at least min_chunk items, records each
+// chunk into its own secondary command buffer on the job system, and executes
+// them into the frame's primary buffer in chunk order, so the result does not
+// depend on which thread recorded what. The main pass must have been begun
+// with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Call from the thread
+// that initialised the job system.
+void record_parallel(const frame_t *frame, record_fn_t fn, void *user_data,
+                     uint32_t item_count, uint32_t min_chunk);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef BACKEND_UPLOAD_H
+#define BACKEND_UPLOAD_H
+
+#include "engine/assets/mesh_file.h"
+#include "engine/backend/gpu_memory.h"
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define UPLOAD_DEFAULT_RING_SIZE (32ull << 20)
+// Batches that can be in flight on the transfer queue at once.
+#define UPLOAD_BATCH_COUNT 4
+
+// Uploads go through one persistently mapped staging ring. Copies are
+// gathered into a batch and submitted together to the transfer queue, which
+// signals a timeline semaphore; staging space is reclaimed as the counter
+// passes each batch. With a separate transfer family the destination buffers
+// change owner: the transfer queue releases them and the graphics queue
+// acquires them once the copies have finished, so the graphics queue never
+// waits on a transfer.
+//
+// Nothing hands a buffer back to the transfer queue, so a buffer is written
+// once: after its upload retires, uploading into it again panics until
+// upload_release says the graphics queue is done with it. Until it retires,
+// more uploads into it are fine.
+//
+// Everything here runs on the thread that submits graphics work.
+void upload_init(VkDeviceSize ring_size);
+// Waits for every upload in flight.
+void upload_shutdown();
+
+// Copies data into the ring straight away, so the caller may reuse it on
+// return, and queues the copy into dst. Uploads larger than the ring are
+// split. When the ring is full this waits on the CPU for the oldest batch to
+// retire. dst must not have been handed over to the graphics queue yet, or
+// have been released since. Returns a ticket for upload_is_complete.
+uint64_t upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void *data,
+                       VkDeviceSize size);
+// Submits whatever is queued. upload_update calls it every frame.
+void upload_flush();
+// Once per frame: flushes, reclaims ring space from finished batches and
+// hands their buffers over to the graphics queue.
+void upload_update();
+// Whether graphics work submitted from now on sees the data.
+uint8_t upload_is_complete(uint64_t ticket);
+void upload_wait(uint64_t ticket);
+// The graphics queue no longer uses buffer: every submission reading it has
+// finished. It may then be uploaded into again, which with separate families
+// takes it back without an ownership transfer, or destroyed. Call it before
+// destroying any buffer that was uploaded into, a later buffer can reuse the
+// handle.
+void upload_release(VkBuffer buffer);
+
+typedef struct {
+  VkBuffer vertices;
+  gpu_allocation_t vertex_memory;
+  VkBuffer indices;
+  gpu_allocation_t index_memory;
+  uint64_t vertex_count;
+  uint32_t vertex_stride;
+  uint64_t index_count;
+  VkIndexType index_type;
+  uint64_t ticket;
+} upload_mesh_t;
+
+// Creates device local vertex and index buffers for the positions and
+// indices of a compiled mesh and queues their upload. Data stays in its
+// compiled encoding. Returns 0 if the mesh lacks either section or memory
+// ran out.
+uint8_t upload_mesh(const mesh_file_t *file, upload_mesh_t *out);
+// The mesh must no longer be in use by the GPU.
+void upload_mesh_destroy(upload_mesh_t *mesh);
+
+#endif
@@ -7,11 +7,4 @@
 
 uint32_t clamp(uint32_t i, uint32_t min, uint32_t max);
 
-typedef struct {
-    char *data;
-    size_t size;
-} file_str_t;
-
-file_str_t read_file(const char *fname);
-
 #endif
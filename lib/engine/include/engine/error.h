@@ -6,5 +6,7 @@
 #include <stdlib.h>
 
 void ptia_panic(const char* msg);
+// Non fatal problems, printf style, written to stderr on a line of their own.
+void ptia_warn(const char* fmt, ...);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "engine/assets/asset_stream.h"
+#include "engine/error.h"
+
+#include <core/arrays.h>
+#include <core/block_pool.h>
+#include <core/handle_pool.h>
+#include <string.h>
+#include <threads.h>
+
+typedef struct {
+  char *path;
+  asset_stream_callback_t callback;
+  uint8_t cancel_requested;
+  uint8_t release_requested;
+  // Set while the handle sits in g_finished, release then leaves freeing it
+  // to drain so the ring never holds a dead entry.
+  uint8_t finished_queued;
+  // Set while drain runs the callback unlocked; drain frees it afterwards.
+  uint8_t draining;
+  asset_load_t load;
+} asset_request_t;
+
+typedef struct {
+  handle_t request;
+  uint32_t priority;
+  uint64_t sequence;
+} queue_entry_t;
+
+// Requests live in fixed blocks so pointers handed out by poll stay put; the
+// handle pool only stores the pointers.
+static handle_pool_t g_requests;
+static block_pool_t g_request_blocks;
+static ARRAY(queue_entry_t) g_queue;
+// Ring of finished requests waiting for their callback. A request is in it
+// at most once, so max_requests slots always suffice.
+static handle_t *g_finished = 0;
+static uint32_t g_finished_capacity = 0;
+static uint32_t g_finished_head = 0;
+static uint32_t g_finished_count = 0;
+static uint64_t g_sequence = 0;
+
+static mtx_t g_stream_lock;
+static cnd_t g_stream_wake;
+static thrd_t *g_workers = 0;
+static uint32_t g_worker_count = 0;
+static uint8_t g_running = 0;
+
+static uint8_t _before(const queue_entry_t *a, const queue_entry_t *b) {
+  return a->priority > b->priority ||
+         (a->priority == b->priority && a->sequence < b->sequence);
+}
+
+static void _queue_push(queue_entry_t entry) {
+  array_push(&g_queue, entry);
+  uint64_t i = g_queue.count - 1;
+  while (i > 0) {
+    const uint64_t parent = (i - 1) / 2;
+    if (!_before(&g_queue.data[i], &g_queue.data[parent])) {
+      break;
+    }
+    const queue_entry_t tmp = g_queue.data[i];
+    g_queue.data[i] = g_queue.data[parent];
+    g_queue.data[parent] = tmp;
+    i = parent;
+  }
+}
+
+static queue_entry_t _queue_pop() {
+  const queue_entry_t top = g_queue.data[0];
+  g_queue.data[0] = array_pop(&g_queue);
+  uint64_t i = 0;
+  for (;;) {
+    const uint64_t left = i * 2 + 1;
+    const uint64_t right = left + 1;
+    uint64_t best = i;
+    if (left < g_queue.count && _before(&g_queue.data[left], &g_queue.data[best])) {
+      best = left;
+    }
+    if (right < g_queue.count && _before(&g_queue.data[right], &g_queue.data[best])) {
+      best = right;
+    }
+    if (best == i) {
+      break;
+    }
+    const queue_entry_t tmp = g_queue.data[i];
+    g_queue.data[i] = g_queue.data[best];
+    g_queue.data[best] = tmp;
+    i = best;
+  }
+  return top;
+}
+
+static asset_request_t *_lookup(handle_t handle) {
+  asset_request_t **slot = handle_pool_get(&g_requests, handle);
+  return slot ? *slot : 0;
+}
+
+static void _free_result(asset_load_t *load) {
+  if (load->buffer.data) {
+    file_buffer_free(&load->buffer);
+  }
+  file_unmap(&load->map);
+}
+
+static void _free_request(handle_t handle, asset_request_t *request) {
+  _free_result(&request->load);
+  free(request->path);
+  handle_pool_remove(&g_requests, handle, 0);
+  block_pool_free(&g_request_blocks, request);
+}
+
+// Called with the lock held once a request reaches a final status.
+static void _finish(handle_t handle, asset_request_t *request) {
+  if (request->release_requested) {
+    _free_request(handle, request);
+  } else if (request->callback) {
+    const uint32_t tail =
+        (g_finished_head + g_finished_count) % g_finished_capacity;
+    g_finished[tail] = handle;
+    g_finished_count++;
+    request->finished_queued = 1;
+  }
+}
+
+static int _worker(void *arg) {
+  (void)arg;
+  mtx_lock(&g_stream_lock);
+  for (;;) {
+    while (g_running && g_queue.count == 0) {
+      cnd_wait(&g_stream_wake, &g_stream_lock);
+    }
+    if (!g_running) {
+      break;
+    }
+    const queue_entry_t entry = _queue_pop();
+    asset_request_t *request = _lookup(entry.request);
+    // Cancelled and released requests stay in the heap until they surface.
+    if (!request || request->load.status != ASSET_STATUS_QUEUED) {
+      continue;
+    }
+    request->load.status = ASSET_STATUS_LOADING;
+    const asset_request_kind_t kind = request->load.kind;
+    const char *path = request->path;
+    mtx_unlock(&g_stream_lock);
+
+    file_buffer_t buffer = {0};
+    file_map_t map;
+    memset(&map, 0, sizeof(map));
+    const file_result_t result = kind == ASSET_REQUEST_READ
+                                     ? file_read_all(path, &buffer)
+                                     : file_map(path, &map);
+
+    mtx_lock(&g_stream_lock);
+    asset_load_t *load = &request->load;
+    load->buffer = buffer;
+    load->map = map;
+    load->error = result;
+    if (request->cancel_requested) {
+      _free_result(load);
+      load->status = ASSET_STATUS_CANCELLED;
+    } else {
+      load->status = result == FILE_OK ? ASSET_STATUS_DONE : ASSET_STATUS_FAILED;
+    }
+    _finish(entry.request, request);
+  }
+  mtx_unlock(&g_stream_lock);
+  return 0;
+}
+
+void asset_stream_init(uint32_t worker_count, uint32_t max_requests) {
+  mtx_init(&g_stream_lock, mtx_plain);
+  cnd_init(&g_stream_wake);
+  handle_pool_init(&g_requests, sizeof(asset_request_t *), max_requests);
+  if (!block_pool_init(&g_request_blocks, sizeof(asset_request_t), max_requests,
+                       MEMORY_TAG_POOL)) {
+    ptia_panic("Failed to allocate asset stream requests");
+  }
+  g_finished_capacity = max_requests > 0 ? max_requests : 1;
+  g_finished = malloc(sizeof(handle_t) * g_finished_capacity);
+  g_finished_head = 0;
+  g_finished_count = 0;
+  if (!g_finished) {
+    ptia_panic("Failed to allocate asset stream requests");
+  }
+
+  g_running = 1;
+  g_worker_count = worker_count > 0 ? worker_count : 1;
+  g_workers = malloc(sizeof(thrd_t) * g_worker_count);
+  if (!g_workers) {
+    ptia_panic("Failed to start asset stream workers");
+  }
+  for (uint32_t i = 0; i < g_worker_count; i++) {
+    if (thrd_create(&g_workers[i], _worker, 0) != thrd_success) {
+      ptia_panic("Failed to start asset stream worker");
+    }
+  }
+}
+
+void asset_stream_shutdown() {
+  mtx_lock(&g_stream_lock);
+  g_running = 0;
+  cnd_broadcast(&g_stream_wake);
+  mtx_unlock(&g_stream_lock);
+  for (uint32_t i = 0; i < g_worker_count; i++) {
+    thrd_join(g_workers[i], 0);
+  }
+  free(g_workers);
+  g_workers = 0;
+  g_worker_count = 0;
+
+  while (handle_pool_count(&g_requests) > 0) {
+    const handle_t handle = handle_pool_handle_at(&g_requests, 0);
+    _free_request(handle, _lookup(handle));
+  }
+  handle_pool_destroy(&g_requests);
+  block_pool_destroy(&g_request_blocks);
+  array_free(&g_queue);
+  free(g_finished);
+  g_finished = 0;
+  g_finished_capacity = 0;
+  g_finished_count = 0;
+  cnd_destroy(&g_stream_wake);
+  mtx_destroy(&g_stream_lock);
+}
+
+handle_t asset_stream_request(const char *path, asset_request_kind_t kind,
+                              uint32_t priority,
+                              asset_stream_callback_t callback,
+                              void *user_data) {
+  const size_t path_size = strlen(path) + 1;
+  char *path_copy = malloc(path_size);
+  if (!path_copy) {
+    return HANDLE_INVALID;
+  }
+  memcpy(path_copy, path, path_size);
+
+  mtx_lock(&g_stream_lock);
+  asset_request_t *request = block_pool_alloc(&g_request_blocks);
+  if (!request) {
+    mtx_unlock(&g_stream_lock);
+    free(path_copy);
+    return HANDLE_INVALID;
+  }
+  memset(request, 0, sizeof(asset_request_t));
+  request->path = path_copy;
+  request->callback = callback;
+  request->load.status = ASSET_STATUS_QUEUED;
+  request->load.kind = kind;
+  request->load.user_data = user_data;
+
+  const handle_t handle = handle_pool_insert(&g_requests, &request);
+  request->load.request = handle;
+  queue_entry_t entry = {handle, priority, g_sequence++};
+  _queue_push(entry);
+  cnd_signal(&g_stream_wake);
+  mtx_unlock(&g_stream_lock);
+  return handle;
+}
+
+uint8_t asset_stream_cancel(handle_t handle) {
+  mtx_lock(&g_stream_lock);
+  asset_request_t *request = _lookup(handle);
+  uint8_t cancelled = 0;
+  if (request && request->load.status == ASSET_STATUS_QUEUED) {
+    request->load.status = ASSET_STATUS_CANCELLED;
+    _finish(handle, request);
+    cancelled = 1;
+  } else if (request && request->load.status == ASSET_STATUS_LOADING) {
+    request->cancel_requested = 1;
+    cancelled = 1;
+  }
+  mtx_unlock(&g_stream_lock);
+  return cancelled;
+}
+
+asset_status_t asset_stream_poll(handle_t handle, const asset_load_t **out) {
+  mtx_lock(&g_stream_lock);
+  asset_request_t *request = _lookup(handle);
+  asset_status_t status = request ? request->load.status : ASSET_STATUS_CANCELLED;
+  if (out) {
+    const uint8_t finished = status != ASSET_STATUS_QUEUED && status != ASSET_STATUS_LOADING;
+    *out = request && finished ? &request->load : 0;
+  }
+  mtx_unlock(&g_stream_lock);
+  return status;
+}
+
+void asset_stream_release(handle_t handle) {
+  mtx_lock(&g_stream_lock);
+  asset_request_t *request = _lookup(handle);
+  if (request && (request->draining || request->finished_queued)) {
+    // Drain frees it, without running the callback if it has not yet.
+    request->release_requested = 1;
+  } else if (request && request->load.status == ASSET_STATUS_LOADING) {
+    // The worker still uses it, it frees the request when done.
+    request->cancel_requested = 1;
+    request->release_requested = 1;
+  } else if (request) {
+    _free_request(handle, request);
+  }
+  mtx_unlock(&g_stream_lock);
+}
+
+uint32_t asset_stream_drain(uint32_t max_callbacks) {
+  uint32_t ran = 0;
+  while (ran < max_callbacks) {
+    mtx_lock(&g_stream_lock);
+    if (g_finished_count == 0) {
+      mtx_unlock(&g_stream_lock);
+      break;
+    }
+    const handle_t handle = g_finished[g_finished_head];
+    g_finished_head = (g_finished_head + 1) % g_finished_capacity;
+    g_finished_count--;
+    asset_request_t *request = _lookup(handle);
+    request->finished_queued = 0;
+    if (request->release_requested) {
+      _free_request(handle, request);
+      mtx_unlock(&g_stream_lock);
+      continue;
+    }
+    request->draining = 1;
+    mtx_unlock(&g_stream_lock);
+
+    // Unlocked so the callback can issue follow up requests; draining keeps
+    // a concurrent release from freeing the request under it.
+    request->callback(&request->load);
+    ran++;
+
+    mtx_lock(&g_stream_lock);
+    _free_request(handle, request);
+    mtx_unlock(&g_stream_lock);
+  }
+  return ran;
+}
+
+uint32_t asset_stream_pending() {
+  mtx_lock(&g_stream_lock);
+  const uint32_t count = handle_pool_count(&g_requests);
+  mtx_unlock(&g_stream_lock);
+  return count;
+}
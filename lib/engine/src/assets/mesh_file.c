@@ -0,0 +1,83 @@
+#include "engine/assets/mesh_file.h"
+#include <string.h>
+
+mesh_format_result_t mesh_file_open(const char *path, uint8_t verify_checksum,
+                                    mesh_file_t *out) {
+  memset(out, 0, sizeof(mesh_file_t));
+  if (file_map(path, &out->map) != FILE_OK) {
+    return MESH_FORMAT_ERR_IO;
+  }
+  out->base = out->map.data;
+  out->size = out->map.size;
+
+  mesh_format_result_t res =
+      mesh_format_validate(out->base, out->size, verify_checksum);
+  if (res != MESH_FORMAT_OK) {
+    file_unmap(&out->map);
+    memset(out, 0, sizeof(mesh_file_t));
+    return res;
+  }
+  out->header = (const mesh_file_header_t *)out->base;
+  return MESH_FORMAT_OK;
+}
+
+void mesh_file_close(mesh_file_t *file) {
+  file_unmap(&file->map);
+  memset(file, 0, sizeof(mesh_file_t));
+}
+
+uint8_t mesh_file_section(const mesh_file_t *file, uint32_t type,
+                          mesh_span_t *out) {
+  const mesh_file_section_t *section =
+      mesh_format_find_section(file->base, type);
+  if (!section) {
+    out->data = 0;
+    out->count = 0;
+    out->stride = 0;
+    out->encoding = MESH_ENCODING_RAW;
+    return 0;
+  }
+  out->data = file->base + section->offset;
+  out->count = section->count;
+  out->stride = section->stride;
+  out->encoding = section->encoding;
+  return 1;
+}
+
+mesh_span_t mesh_file_positions(const mesh_file_t *file) {
+  mesh_span_t span;
+  mesh_file_section(file, MESH_SECTION_POSITIONS, &span);
+  return span;
+}
+
+mesh_span_t mesh_file_indices(const mesh_file_t *file) {
+  mesh_span_t span;
+  mesh_file_section(file, MESH_SECTION_INDICES, &span);
+  return span;
+}
+
+const mesh_file_bounds_t *mesh_file_bounds(const mesh_file_t *file,
+                                           uint32_t *count) {
+  mesh_span_t span;
+  if (!mesh_file_section(file, MESH_SECTION_BOUNDS, &span)) {
+    *count = 0;
+    return 0;
+  }
+  *count = (uint32_t)span.count;
+  return (const mesh_file_bounds_t *)span.data;
+}
+
+const mesh_file_submesh_t *mesh_file_submeshes(const mesh_file_t *file,
+                                               uint32_t *count) {
+  mesh_span_t span;
+  if (!mesh_file_section(file, MESH_SECTION_SUBMESHES, &span)) {
+    *count = 0;
+    return 0;
+  }
+  *count = (uint32_t)span.count;
+  return (const mesh_file_submesh_t *)span.data;
+}
+
+void mesh_file_prefetch(const mesh_file_t *file) {
+  file_map_prefetch(&file->map);
+}
@@ -0,0 +1,331 @@
+#include "engine/backend/bindless.h"
+#include "engine/backend/gpu.h"
+#include "engine/error.h"
+#include <core/arrays.h>
+#include <core/handle_pool.h>
+#include <string.h>
+#include <threads.h>
+
+#define BINDLESS_TABLE_COUNT 3
+
+typedef struct {
+  uint32_t index;
+  uint64_t frame;
+} bindless_retired_t;
+
+// What a handle stands for: a table and an index into it.
+typedef struct {
+  uint32_t table;
+  uint32_t index;
+} bindless_entry_t;
+
+// Index allocator for one binding. Fresh indices come from next, freed ones
+// wait in retired until no frame in flight can read them.
+typedef struct {
+  VkDescriptorType type;
+  uint32_t binding;
+  uint32_t capacity;
+  uint32_t next;
+  ARRAY(uint32_t) free;
+  ARRAY(bindless_retired_t) retired;
+} bindless_table_t;
+
+static bindless_table_t g_tables[BINDLESS_TABLE_COUNT];
+static handle_pool_t g_handles;
+static VkDescriptorSetLayout g_set_layout = VK_NULL_HANDLE;
+static VkDescriptorPool g_pool = VK_NULL_HANDLE;
+static VkDescriptorSet g_set = VK_NULL_HANDLE;
+static VkPipelineLayout g_pipeline_layout = VK_NULL_HANDLE;
+static uint64_t g_frame_number = 0;
+// Covers the tables, the handles and the set: descriptor writes to one set
+// must not race.
+static mtx_t g_bindless_lock;
+
+static uint32_t _min(uint32_t a, uint32_t b) { return a < b ? a : b; }
+
+static uint32_t _acquire_index(bindless_table_t *table) {
+  uint32_t index = BINDLESS_INVALID;
+  if (table->free.count > 0) {
+    index = array_pop(&table->free);
+  } else if (table->next < table->capacity) {
+    index = table->next++;
+  }
+  return index;
+}
+
+static uint8_t _release(uint32_t table, bindless_handle_t handle) {
+  mtx_lock(&g_bindless_lock);
+  const bindless_entry_t *entry = handle_pool_get(&g_handles, handle);
+  if (!entry || entry->table != table) {
+    mtx_unlock(&g_bindless_lock);
+    return 0;
+  }
+  bindless_retired_t retired;
+  retired.index = entry->index;
+  retired.frame = g_frame_number;
+  array_push(&g_tables[table].retired, retired);
+  handle_pool_remove(&g_handles, handle, 0);
+  mtx_unlock(&g_bindless_lock);
+  return 1;
+}
+
+static void _write(const bindless_table_t *table, uint32_t index,
+                   const VkDescriptorImageInfo *image,
+                   const VkDescriptorBufferInfo *buffer) {
+  VkWriteDescriptorSet write;
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.pNext = 0;
+  write.dstSet = g_set;
+  write.dstBinding = table->binding;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = table->type;
+  write.pImageInfo = image;
+  write.pBufferInfo = buffer;
+  write.pTexelBufferView = 0;
+  vkUpdateDescriptorSets(gpu_get_vk_device(), 1, &write, 0, 0);
+}
+
+static bindless_handle_t _add(uint32_t table,
+                              const VkDescriptorImageInfo *image,
+                              const VkDescriptorBufferInfo *buffer) {
+  bindless_handle_t handle = HANDLE_INVALID;
+  mtx_lock(&g_bindless_lock);
+  bindless_entry_t entry;
+  entry.table = table;
+  entry.index = _acquire_index(&g_tables[table]);
+  if (entry.index != BINDLESS_INVALID) {
+    _write(&g_tables[table], entry.index, image, buffer);
+    handle = handle_pool_insert(&g_handles, &entry);
+  }
+  mtx_unlock(&g_bindless_lock);
+  return handle;
+}
+
+void bindless_init() {
+  VkPhysicalDeviceVulkan12Properties props_12;
+  memset(&props_12, 0, sizeof(props_12));
+  props_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+  VkPhysicalDeviceProperties2 props;
+  props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  props.pNext = &props_12;
+  vkGetPhysicalDeviceProperties2(gpu_get_vk_phy_device(), &props);
+
+  memset(g_tables, 0, sizeof(g_tables));
+  g_tables[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  g_tables[0].binding = BINDLESS_BINDING_SAMPLED_IMAGES;
+  g_tables[0].capacity = _min(
+      BINDLESS_MAX_SAMPLED_IMAGES,
+      _min(props_12.maxDescriptorSetUpdateAfterBindSampledImages,
+           props_12.maxPerStageDescriptorUpdateAfterBindSampledImages));
+  g_tables[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  g_tables[1].binding = BINDLESS_BINDING_STORAGE_BUFFERS;
+  g_tables[1].capacity = _min(
+      BINDLESS_MAX_STORAGE_BUFFERS,
+      _min(props_12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+           props_12.maxPerStageDescriptorUpdateAfterBindStorageBuffers));
+  g_tables[2].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+  g_tables[2].binding = BINDLESS_BINDING_SAMPLERS;
+  g_tables[2].capacity =
+      _min(BINDLESS_MAX_SAMPLERS,
+           _min(props_12.maxDescriptorSetUpdateAfterBindSamplers,
+                props_12.maxPerStageDescriptorUpdateAfterBindSamplers));
+
+  // Every stage sees every table, so together they also have to fit the
+  // per stage resource limit, less what fragment shaders need for their
+  // color attachments. Shrink all tables by the same factor until they do.
+  const uint32_t color_attachments = props.properties.limits.maxColorAttachments;
+  const uint64_t budget =
+      props_12.maxPerStageUpdateAfterBindResources > color_attachments
+          ? props_12.maxPerStageUpdateAfterBindResources - color_attachments
+          : 0;
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < BINDLESS_TABLE_COUNT; i++) {
+    total += g_tables[i].capacity;
+  }
+  if (total > budget) {
+    for (uint32_t i = 0; i < BINDLESS_TABLE_COUNT; i++) {
+      g_tables[i].capacity =
+          (uint32_t)((uint64_t)g_tables[i].capacity * budget / total);
+    }
+  }
+
+  // Partially bound: unused slots may hold anything. Update unused while
+  // pending: adding a resource never has to wait for frames in flight.
+  VkDescriptorSetLayoutBinding bindings[BINDLESS_TABLE_COUNT];
+  VkDescriptorBindingFlags binding_flags[BINDLESS_TABLE_COUNT];
+  VkDescriptorPoolSize pool_sizes[BINDLESS_TABLE_COUNT];
+  for (uint32_t i = 0; i < BINDLESS_TABLE_COUNT; i++) {
+    bindings[i].binding = g_tables[i].binding;
+    bindings[i].descriptorType = g_tables[i].type;
+    bindings[i].descriptorCount = g_tables[i].capacity;
+    bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+    bindings[i].pImmutableSamplers = 0;
+    binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                       VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                       VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    pool_sizes[i].type = g_tables[i].type;
+    pool_sizes[i].descriptorCount = g_tables[i].capacity;
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info;
+  flags_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flags_info.pNext = 0;
+  flags_info.bindingCount = BINDLESS_TABLE_COUNT;
+  flags_info.pBindingFlags = binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo layout_info;
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.pNext = &flags_info;
+  layout_info.flags =
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layout_info.bindingCount = BINDLESS_TABLE_COUNT;
+  layout_info.pBindings = bindings;
+  VkDevice device = gpu_get_vk_device();
+  if (vkCreateDescriptorSetLayout(device, &layout_info, 0, &g_set_layout) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to create bindless vk Descriptor Set Layout");
+  }
+
+  VkDescriptorPoolCreateInfo pool_info;
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.pNext = 0;
+  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = BINDLESS_TABLE_COUNT;
+  pool_info.pPoolSizes = pool_sizes;
+  if (vkCreateDescriptorPool(device, &pool_info, 0, &g_pool) != VK_SUCCESS) {
+    ptia_panic("Failed to create bindless vk Descriptor Pool");
+  }
+
+  VkDescriptorSetAllocateInfo alloc_info;
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.pNext = 0;
+  alloc_info.descriptorPool = g_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &g_set_layout;
+  if (vkAllocateDescriptorSets(device, &alloc_info, &g_set) != VK_SUCCESS) {
+    ptia_panic("Failed to allocate bindless vk Descriptor Set");
+  }
+
+  VkPushConstantRange push_constants;
+  push_constants.stageFlags = VK_SHADER_STAGE_ALL;
+  push_constants.offset = 0;
+  push_constants.size = BINDLESS_PUSH_CONSTANT_SIZE;
+  VkPipelineLayoutCreateInfo pipeline_layout_info;
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.pNext = 0;
+  pipeline_layout_info.flags = 0;
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts = &g_set_layout;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &push_constants;
+  if (vkCreatePipelineLayout(device, &pipeline_layout_info, 0,
+                             &g_pipeline_layout) != VK_SUCCESS) {
+    ptia_panic("Failed to create bindless vk Pipeline Layout");
+  }
+
+  handle_pool_init(&g_handles, sizeof(bindless_entry_t), 256);
+  g_frame_number = 0;
+  mtx_init(&g_bindless_lock, mtx_plain);
+}
+
+void bindless_shutdown() {
+  VkDevice device = gpu_get_vk_device();
+  vkDestroyPipelineLayout(device, g_pipeline_layout, 0);
+  vkDestroyDescriptorPool(device, g_pool, 0);
+  vkDestroyDescriptorSetLayout(device, g_set_layout, 0);
+  g_pipeline_layout = VK_NULL_HANDLE;
+  g_pool = VK_NULL_HANDLE;
+  g_set = VK_NULL_HANDLE;
+  g_set_layout = VK_NULL_HANDLE;
+  for (uint32_t i = 0; i < BINDLESS_TABLE_COUNT; i++) {
+    array_free(&g_tables[i].free);
+    array_free(&g_tables[i].retired);
+  }
+  handle_pool_destroy(&g_handles);
+  mtx_destroy(&g_bindless_lock);
+}
+
+VkDescriptorSetLayout bindless_get_set_layout() { return g_set_layout; }
+
+VkPipelineLayout bindless_get_pipeline_layout() { return g_pipeline_layout; }
+
+bindless_handle_t bindless_add_image(VkImageView view, VkImageLayout layout) {
+  VkDescriptorImageInfo info;
+  info.sampler = VK_NULL_HANDLE;
+  info.imageView = view;
+  info.imageLayout = layout;
+  return _add(0, &info, 0);
+}
+
+bindless_handle_t bindless_add_buffer(VkBuffer buffer, VkDeviceSize offset,
+                                      VkDeviceSize range) {
+  VkDescriptorBufferInfo info;
+  info.buffer = buffer;
+  info.offset = offset;
+  info.range = range;
+  return _add(1, 0, &info);
+}
+
+bindless_handle_t bindless_add_sampler(VkSampler sampler) {
+  VkDescriptorImageInfo info;
+  info.sampler = sampler;
+  info.imageView = VK_NULL_HANDLE;
+  info.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  return _add(2, &info, 0);
+}
+
+uint32_t bindless_index(bindless_handle_t handle) {
+  mtx_lock(&g_bindless_lock);
+  const bindless_entry_t *entry = handle_pool_get(&g_handles, handle);
+  const uint32_t index = entry ? entry->index : BINDLESS_INVALID;
+  mtx_unlock(&g_bindless_lock);
+  return index;
+}
+
+uint8_t bindless_remove_image(bindless_handle_t handle) {
+  return _release(0, handle);
+}
+
+uint8_t bindless_remove_buffer(bindless_handle_t handle) {
+  return _release(1, handle);
+}
+
+uint8_t bindless_remove_sampler(bindless_handle_t handle) {
+  return _release(2, handle);
+}
+
+void bindless_begin_frame(uint64_t frame_number, uint32_t frames_in_flight) {
+  mtx_lock(&g_bindless_lock);
+  g_frame_number = frame_number;
+  for (uint32_t t = 0; t < BINDLESS_TABLE_COUNT; t++) {
+    bindless_table_t *table = &g_tables[t];
+    // Compacted in place, so what stays keeps its order.
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < table->retired.count; i++) {
+      const bindless_retired_t retired = table->retired.data[i];
+      if (retired.frame + frames_in_flight <= frame_number) {
+        array_push(&table->free, retired.index);
+      } else {
+        table->retired.data[kept++] = retired;
+      }
+    }
+    table->retired.count = kept;
+  }
+  mtx_unlock(&g_bindless_lock);
+}
+
+void bindless_bind(VkCommandBuffer cmd) {
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          g_pipeline_layout, 0, 1, &g_set, 0, 0);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          g_pipeline_layout, 0, 1, &g_set, 0, 0);
+}
+
+void bindless_push_constants(VkCommandBuffer cmd, const void *data,
+                             uint32_t size) {
+  vkCmdPushConstants(cmd, g_pipeline_layout, VK_SHADER_STAGE_ALL, 0, size,
+                     data);
+}
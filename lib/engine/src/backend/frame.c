@@ -0,0 +1,426 @@
+#include "engine/backend/frame.h"
+#include "engine/backend/bindless.h"
+#include "engine/backend/gpu.h"
+#include "engine/backend/gpu_memory.h"
+#include "engine/backend/gpu_profiler.h"
+#include "engine/error.h"
+#include <core/profiler.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  VkCommandPool pool;
+  VkCommandBuffer cmd;
+  VkSemaphore image_acquired;
+  VkFence in_flight;
+  // Headless readback target, created on the first capture.
+  VkBuffer capture;
+  gpu_allocation_t capture_memory;
+  uint64_t capture_frame;
+} frame_slot_t;
+
+// Largest nonCoherentAtomSize the spec allows. Capture buffers are padded to
+// it so the whole buffer can always be invalidated.
+#define FRAME_CAPTURE_ALIGNMENT 256u
+#define FRAME_SCRATCH_BLOCK_SIZE (64u * 1024u)
+
+static frame_slot_t g_slots[FRAME_MAX_IN_FLIGHT];
+static uint32_t g_slot_count = 0;
+static uint32_t g_current_slot = 0;
+static uint64_t g_frame_number = 0;
+static arena_t g_scratch;
+
+// Indexed by swapchain image rather than by slot: presentation may still be
+// reading the semaphore after the slot's fence has signalled, so it is only
+// safe to reuse once the same image is acquired again.
+static VkSemaphore *g_render_finished = 0;
+// Fence of the frame that last rendered into each image.
+static VkFence *g_image_fences = 0;
+static uint32_t g_image_count = 0;
+
+static VkSemaphore _create_semaphore() {
+  VkSemaphoreCreateInfo create_info;
+  create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  create_info.pNext = 0;
+  create_info.flags = 0;
+
+  VkSemaphore semaphore;
+  if (vkCreateSemaphore(gpu_get_vk_device(), &create_info, 0, &semaphore) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to create vk Semaphore");
+  }
+  return semaphore;
+}
+
+static void _destroy_image_sync() {
+  VkDevice device = gpu_get_vk_device();
+  for (uint32_t i = 0; i < g_image_count; i++) {
+    vkDestroySemaphore(device, g_render_finished[i], 0);
+  }
+  free(g_render_finished);
+  free(g_image_fences);
+  g_render_finished = 0;
+  g_image_fences = 0;
+  g_image_count = 0;
+}
+
+// The image count can change whenever the swapchain is rebuilt.
+static void _init_image_sync() {
+  g_image_count = gpu_get_swapchain_image_count();
+  g_render_finished = malloc(sizeof(VkSemaphore) * g_image_count);
+  g_image_fences = malloc(sizeof(VkFence) * g_image_count);
+  for (uint32_t i = 0; i < g_image_count; i++) {
+    g_render_finished[i] = _create_semaphore();
+    g_image_fences[i] = VK_NULL_HANDLE;
+  }
+}
+
+static void _recreate_swapchain() {
+  if (gpu_recreate_swapchain()) {
+    _destroy_image_sync();
+    _init_image_sync();
+  }
+}
+
+void frame_init(uint32_t frames_in_flight) {
+  if (frames_in_flight == 0) {
+    frames_in_flight = FRAME_DEFAULT_IN_FLIGHT;
+  }
+  if (frames_in_flight > FRAME_MAX_IN_FLIGHT) {
+    frames_in_flight = FRAME_MAX_IN_FLIGHT;
+  }
+  VkDevice device = gpu_get_vk_device();
+  g_slot_count = frames_in_flight;
+  g_current_slot = 0;
+  g_frame_number = 0;
+
+  for (uint32_t i = 0; i < g_slot_count; i++) {
+    frame_slot_t *slot = &g_slots[i];
+
+    // Transient: everything in the pool lives for exactly one frame.
+    VkCommandPoolCreateInfo pool_info;
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.pNext = 0;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = gpu_get_gfx_queue_family();
+    if (vkCreateCommandPool(device, &pool_info, 0, &slot->pool) != VK_SUCCESS) {
+      ptia_panic("Failed to create vk Command Pool");
+    }
+
+    VkCommandBufferAllocateInfo alloc_info;
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.pNext = 0;
+    alloc_info.commandPool = slot->pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &alloc_info, &slot->cmd) !=
+        VK_SUCCESS) {
+      ptia_panic("Failed to allocate vk Command Buffer");
+    }
+
+    slot->image_acquired = _create_semaphore();
+
+    // Signalled so the first wait on every slot falls straight through.
+    VkFenceCreateInfo fence_info;
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.pNext = 0;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    if (vkCreateFence(device, &fence_info, 0, &slot->in_flight) != VK_SUCCESS) {
+      ptia_panic("Failed to create vk Fence");
+    }
+    slot->capture = VK_NULL_HANDLE;
+    slot->capture_frame = UINT64_MAX;
+  }
+  _init_image_sync();
+  arena_init(&g_scratch, FRAME_SCRATCH_BLOCK_SIZE, MEMORY_TAG_RENDERER);
+  gpu_profiler_init(g_slot_count);
+}
+
+void frame_shutdown() {
+  VkDevice device = gpu_get_vk_device();
+  vkDeviceWaitIdle(device);
+  gpu_profiler_shutdown();
+  for (uint32_t i = 0; i < g_slot_count; i++) {
+    frame_slot_t *slot = &g_slots[i];
+    if (slot->capture != VK_NULL_HANDLE) {
+      gpu_buffer_destroy(slot->capture, slot->capture_memory);
+    }
+    vkDestroyFence(device, slot->in_flight, 0);
+    vkDestroySemaphore(device, slot->image_acquired, 0);
+    vkDestroyCommandPool(device, slot->pool, 0);
+  }
+  memset(g_slots, 0, sizeof(g_slots));
+  g_slot_count = 0;
+  _destroy_image_sync();
+  arena_destroy(&g_scratch);
+}
+
+uint8_t frame_begin(frame_t *frame) {
+  VkDevice device = gpu_get_vk_device();
+  frame_slot_t *slot = &g_slots[g_current_slot];
+
+  PROFILE_FUNCTION_BEGIN();
+  // The only place the CPU waits for the GPU: at most g_slot_count frames are
+  // queued, everything else overlaps.
+  PROFILE_BEGIN("wait for frame slot");
+  vkWaitForFences(device, 1, &slot->in_flight, VK_TRUE, UINT64_MAX);
+  PROFILE_END();
+
+  uint32_t image_index;
+  if (gpu_is_headless()) {
+    // Offscreen images are always available, take them in turn.
+    image_index = (uint32_t)(g_frame_number % g_image_count);
+  } else {
+    VkResult res = vkAcquireNextImageKHR(device, gpu_get_vk_swapchain(),
+                                         UINT64_MAX, slot->image_acquired,
+                                         VK_NULL_HANDLE, &image_index);
+    if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+      // The semaphore was not signalled and the fence is untouched, so the
+      // slot can be used again as is.
+      _recreate_swapchain();
+      PROFILE_END();
+      return 0;
+    }
+    if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
+      ptia_panic("Failed to acquire swapchain image");
+    }
+  }
+
+  // With more images than slots, an image can come back while an older slot
+  // is still rendering into it.
+  VkFence image_fence = g_image_fences[image_index];
+  if (image_fence != VK_NULL_HANDLE && image_fence != slot->in_flight) {
+    vkWaitForFences(device, 1, &image_fence, VK_TRUE, UINT64_MAX);
+  }
+  g_image_fences[image_index] = slot->in_flight;
+
+  // Only reset once a submit is certain to follow, an early return above
+  // would otherwise leave a fence that never signals.
+  vkResetFences(device, 1, &slot->in_flight);
+  vkResetCommandPool(device, slot->pool, 0);
+  arena_reset(&g_scratch);
+
+  VkCommandBufferBeginInfo begin_info;
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.pNext = 0;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  begin_info.pInheritanceInfo = 0;
+  if (vkBeginCommandBuffer(slot->cmd, &begin_info) != VK_SUCCESS) {
+    ptia_panic("Failed to begin vk Command Buffer");
+  }
+  // Reads back the queries of the slot's previous frame, which the fence
+  // above has just seen finish.
+  gpu_profiler_begin_frame(g_current_slot, slot->cmd);
+  GPU_PROFILE_BEGIN(slot->cmd, "frame");
+  // The slot's previous frame is done, along with everything before it.
+  bindless_begin_frame(g_frame_number, g_slot_count);
+  bindless_bind(slot->cmd);
+
+  frame->cmd = slot->cmd;
+  frame->pool = slot->pool;
+  frame->framebuffer = gpu_get_framebuffer(image_index);
+  frame->extent = gpu_get_swapchain_extent();
+  frame->slot = g_current_slot;
+  frame->image_index = image_index;
+  frame->number = g_frame_number;
+  PROFILE_END();
+  return 1;
+}
+
+void frame_begin_main_pass(const frame_t *frame, const float clear_color[4],
+                           VkSubpassContents contents) {
+  VkClearValue clear;
+  memcpy(clear.color.float32, clear_color, sizeof(float) * 4);
+
+  VkRenderPassBeginInfo begin_info;
+  begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  begin_info.pNext = 0;
+  begin_info.renderPass = gpu_get_render_pass();
+  begin_info.framebuffer = frame->framebuffer;
+  begin_info.renderArea.offset.x = 0;
+  begin_info.renderArea.offset.y = 0;
+  begin_info.renderArea.extent = frame->extent;
+  begin_info.clearValueCount = 1;
+  begin_info.pClearValues = &clear;
+  GPU_PROFILE_BEGIN(frame->cmd, "main pass");
+  vkCmdBeginRenderPass(frame->cmd, &begin_info, contents);
+  if (contents != VK_SUBPASS_CONTENTS_INLINE) {
+    return;
+  }
+
+  VkViewport viewport;
+  viewport.x = 0.f;
+  viewport.y = 0.f;
+  viewport.width = frame->extent.width;
+  viewport.height = frame->extent.height;
+  viewport.minDepth = 0.f;
+  viewport.maxDepth = 1.f;
+  vkCmdSetViewport(frame->cmd, 0, 1, &viewport);
+  vkCmdSetScissor(frame->cmd, 0, 1, &begin_info.renderArea);
+}
+
+void frame_end_main_pass(const frame_t *frame) {
+  vkCmdEndRenderPass(frame->cmd);
+  GPU_PROFILE_END(frame->cmd);
+}
+
+void frame_capture(const frame_t *frame) {
+  if (!gpu_is_headless()) {
+    ptia_panic("Frame capture needs headless mode");
+  }
+  frame_slot_t *slot = &g_slots[frame->slot];
+  const VkDeviceSize size =
+      (VkDeviceSize)frame->extent.width * frame->extent.height * 4;
+  if (slot->capture == VK_NULL_HANDLE) {
+    VkBufferCreateInfo buffer_info;
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = 0;
+    buffer_info.flags = 0;
+    buffer_info.size = (size + FRAME_CAPTURE_ALIGNMENT - 1) &
+                       ~(VkDeviceSize)(FRAME_CAPTURE_ALIGNMENT - 1);
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.queueFamilyIndexCount = 0;
+    buffer_info.pQueueFamilyIndices = 0;
+    if (gpu_buffer_create(&buffer_info, GPU_MEMORY_READBACK, &slot->capture,
+                          &slot->capture_memory) != VK_SUCCESS) {
+      ptia_panic("Failed to create frame capture buffer");
+    }
+  }
+
+  // The render pass leaves the image in TRANSFER_SRC_OPTIMAL and its
+  // external dependency makes the colour writes visible to this copy.
+  VkBufferImageCopy region;
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset.x = 0;
+  region.imageOffset.y = 0;
+  region.imageOffset.z = 0;
+  region.imageExtent.width = frame->extent.width;
+  region.imageExtent.height = frame->extent.height;
+  region.imageExtent.depth = 1;
+  vkCmdCopyImageToBuffer(frame->cmd, gpu_get_swapchain_image(frame->image_index),
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->capture, 1,
+                         &region);
+
+  VkBufferMemoryBarrier barrier;
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.pNext = 0;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = slot->capture;
+  barrier.offset = 0;
+  barrier.size = size;
+  vkCmdPipelineBarrier(frame->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, 0, 1, &barrier, 0, 0);
+  slot->capture_frame = frame->number;
+}
+
+uint8_t frame_read_capture(const frame_t *frame, void *pixels) {
+  frame_slot_t *slot = &g_slots[frame->slot];
+  if (slot->capture == VK_NULL_HANDLE || slot->capture_frame != frame->number) {
+    return 0;
+  }
+  VkDevice device = gpu_get_vk_device();
+  vkWaitForFences(device, 1, &slot->in_flight, VK_TRUE, UINT64_MAX);
+
+  gpu_allocation_info_t info;
+  if (!gpu_memory_info(slot->capture_memory, &info) || info.mapped == 0) {
+    return 0;
+  }
+  const VkDeviceSize size =
+      (VkDeviceSize)frame->extent.width * frame->extent.height * 4;
+  // Readback memory prefers host cached types, which are often not coherent.
+  if (!gpu_memory_invalidate(slot->capture_memory, 0, size)) {
+    return 0;
+  }
+  memcpy(pixels, info.mapped, size);
+  return 1;
+}
+
+void frame_end(frame_t *frame) {
+  PROFILE_FUNCTION_BEGIN();
+  frame_slot_t *slot = &g_slots[frame->slot];
+  GPU_PROFILE_END(frame->cmd);
+  if (vkEndCommandBuffer(frame->cmd) != VK_SUCCESS) {
+    ptia_panic("Failed to record vk Command Buffer");
+  }
+
+  if (gpu_is_headless()) {
+    VkSubmitInfo submit_info;
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = 0;
+    submit_info.waitSemaphoreCount = 0;
+    submit_info.pWaitSemaphores = 0;
+    submit_info.pWaitDstStageMask = 0;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &frame->cmd;
+    submit_info.signalSemaphoreCount = 0;
+    submit_info.pSignalSemaphores = 0;
+    if (vkQueueSubmit(gpu_get_gfx_queue(), 1, &submit_info, slot->in_flight) !=
+        VK_SUCCESS) {
+      ptia_panic("Failed to submit frame");
+    }
+    g_current_slot = (g_current_slot + 1) % g_slot_count;
+    g_frame_number++;
+    PROFILE_END();
+    return;
+  }
+
+  VkSemaphore render_finished = g_render_finished[frame->image_index];
+  VkPipelineStageFlags wait_stage =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+  VkSubmitInfo submit_info;
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.pNext = 0;
+  submit_info.waitSemaphoreCount = 1;
+  submit_info.pWaitSemaphores = &slot->image_acquired;
+  submit_info.pWaitDstStageMask = &wait_stage;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &frame->cmd;
+  submit_info.signalSemaphoreCount = 1;
+  submit_info.pSignalSemaphores = &render_finished;
+  if (vkQueueSubmit(gpu_get_gfx_queue(), 1, &submit_info, slot->in_flight) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to submit frame");
+  }
+
+  VkSwapchainKHR swapchain = gpu_get_vk_swapchain();
+  VkPresentInfoKHR present_info;
+  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  present_info.pNext = 0;
+  present_info.waitSemaphoreCount = 1;
+  present_info.pWaitSemaphores = &render_finished;
+  present_info.swapchainCount = 1;
+  present_info.pSwapchains = &swapchain;
+  present_info.pImageIndices = &frame->image_index;
+  present_info.pResults = 0;
+  PROFILE_BEGIN("vkQueuePresentKHR");
+  VkResult res = vkQueuePresentKHR(gpu_get_present_queue(), &present_info);
+  PROFILE_END();
+
+  g_current_slot = (g_current_slot + 1) % g_slot_count;
+  g_frame_number++;
+
+  // Some platforms never report out of date on resize, so the window's own
+  // resize event counts as well.
+  const uint8_t resized = gpu_consume_resize();
+  if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || resized) {
+    _recreate_swapchain();
+  } else if (res != VK_SUCCESS) {
+    ptia_panic("Failed to present frame");
+  }
+  PROFILE_END();
+}
+
+uint32_t frame_in_flight_count() { return g_slot_count; }
+
+arena_t *frame_scratch() { return &g_scratch; }
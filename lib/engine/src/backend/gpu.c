@@ -1,9 +1,15 @@
 #include "engine/backend/gpu.h"
 #include "GLFW/glfw3.h"
+#include "engine/backend/bindless.h"
+#include "engine/backend/gpu_memory.h"
+#include "engine/backend/pipeline.h"
+#include "engine/backend/pipeline_cache.h"
 #include "engine/backend/util.h"
 #include "engine/backend/window.h"
 #include "engine/error.h"
 #include <assert.h>
+#include <core/profiler.h>
+#include <ctype.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,8 +27,20 @@ typedef struct {
 typedef struct {
   uint32_t gfx_family;
   uint32_t present_family;
+  // Falls back to the graphics family when there is no separate one.
+  uint32_t transfer_family;
 } queue_family_indices_t;
 
+// Feature chain of one device. The 1.2 and 1.3 structs are only chained in
+// when the device's API version has them.
+typedef struct {
+  VkPhysicalDeviceFeatures2 features;
+  VkPhysicalDeviceVulkan12Features features_12;
+  VkPhysicalDeviceVulkan13Features features_13;
+  uint8_t has_12;
+  uint8_t has_13;
+} device_features_t;
+
 typedef struct {
   VkSurfaceCapabilitiesKHR capabilities;
   VkSurfaceFormatKHR *formats;
@@ -36,12 +54,24 @@ static VkPhysicalDevice g_vk_physical_device = VK_NULL_HANDLE;
 static VkDevice g_vk_device = VK_NULL_HANDLE;
 static VkQueue g_vk_gfx_queue = VK_NULL_HANDLE;
 static VkQueue g_vk_present_queue = VK_NULL_HANDLE;
+static VkQueue g_vk_transfer_queue = VK_NULL_HANDLE;
 static VkSurfaceKHR g_vk_surface = VK_NULL_HANDLE;
 static VkSwapchainKHR g_vk_swapchain = VK_NULL_HANDLE;
 static VkFramebuffer *g_vk_swapchain_framebuffers = 0;
 static VkRenderPass g_vk_render_pass = VK_NULL_HANDLE;
 
 static GLFWwindow *g_wnd = 0;
+static uint8_t g_framebuffer_resized = 0;
+
+// No window, no surface: the "swapchain" is a set of offscreen images.
+static uint8_t g_headless = 0;
+static gpu_allocation_t *g_offscreen_memory = 0;
+
+static uint32_t g_gfx_family = ~(0u);
+static uint32_t g_present_family = ~(0u);
+static uint32_t g_transfer_family = ~(0u);
+
+static const char *g_pipeline_cache_path = PIPELINE_CACHE_DEFAULT_PATH;
 
 static VkFormat g_vk_swapchain_format;
 static VkExtent2D g_vk_swapchain_extent;
@@ -58,6 +88,27 @@ static uint32_t g_validation_layers_count = 1;
 static char *g_device_extensions[1] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 static uint32_t g_device_extensions_count = 1;
 
+// Enabled when the device has them, the backend checks before relying on them.
+// Calibrated timestamps only serve the GPU profiler, so builds without it
+// leave the extension off.
+#ifdef PTIA_PROFILE
+static char *g_optional_device_extensions[2] = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME};
+static uint32_t g_optional_device_extensions_count = 2;
+#else
+static char *g_optional_device_extensions[1] = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+static uint32_t g_optional_device_extensions_count = 1;
+#endif
+static uint8_t g_has_memory_budget = 0;
+static uint8_t g_has_calibrated_timestamps = 0;
+static uint8_t g_has_dynamic_rendering = 0;
+static uint8_t g_has_synchronization2 = 0;
+
+// Index or name of the device to use, PTIA_DEVICE takes precedence.
+static const char *g_device_override = 0;
+
 static VkDebugUtilsMessengerEXT g_debug_messenger = VK_NULL_HANDLE;
 #ifdef NDEBUG
 const int USE_VALIDATION_LAYERS = 1;
@@ -171,10 +222,12 @@ void _init_vk_instance(const char *app_name, uint32_t app_version) {
   create_info.flags = 0;
 
   uint32_t glfw_extension_count = 0;
-  const char **glfw_extensions;
-  glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+  const char **glfw_extensions = 0;
+  if (!g_headless) {
+    glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+  }
 
-  char **actual_exts = malloc(sizeof(char *) * glfw_extension_count + 1);
+  char **actual_exts = malloc(sizeof(char *) * (glfw_extension_count + 1));
   actual_exts[0] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
 
   for (int i = 0; i < glfw_extension_count; i++) {
@@ -201,6 +254,7 @@ queue_family_indices_t _find_queue_families(VkPhysicalDevice device) {
   queue_family_indices_t indices;
   indices.gfx_family = ~(0u);
   indices.present_family = ~(0u);
+  indices.transfer_family = ~(0u);
 
   uint32_t queue_family_count = 0;
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, 0);
@@ -213,6 +267,9 @@ queue_family_indices_t _find_queue_families(VkPhysicalDevice device) {
     if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
       indices.gfx_family = i;
     }
+    if (g_headless) {
+      continue;
+    }
 
     VkBool32 present_support = VK_FALSE;
     vkGetPhysicalDeviceSurfaceSupportKHR(device, i, g_vk_surface,
@@ -221,16 +278,46 @@ queue_family_indices_t _find_queue_families(VkPhysicalDevice device) {
       indices.present_family = i;
     }
   }
+
+  // A transfer only family is usually a DMA engine that copies alongside
+  // graphics work. Failing that, any non graphics family still runs on its
+  // own queue.
+  uint32_t best_score = 0;
+  for (uint32_t i = 0; i < queue_family_count; i++) {
+    const VkQueueFlags flags = queue_families[i].queueFlags;
+    if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+    const uint32_t score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+    if (score > best_score) {
+      best_score = score;
+      indices.transfer_family = i;
+    }
+  }
+  if (indices.transfer_family == ~(0u)) {
+    indices.transfer_family = indices.gfx_family;
+  }
+  // Nothing is presented, frames stay on the graphics queue.
+  if (g_headless) {
+    indices.present_family = indices.gfx_family;
+  }
+  free(queue_families);
   return indices;
 }
 
+// The swapchain extension is only required with a window to present to.
+uint32_t _required_device_ext_count() {
+  return g_headless ? 0 : g_device_extensions_count;
+}
+
 uint8_t _match_required_device_exts(VkExtensionProperties *available,
                                     uint32_t count) {
-  for (uint32_t av = 0; av < g_device_extensions_count; av++) {
+  for (uint32_t av = 0; av < _required_device_ext_count(); av++) {
     uint8_t found = 0;
     for (uint32_t i = 0; i < count; i++) {
-      if (strcmp(available[i].extensionName, g_device_extensions[av])) {
+      if (strcmp(available[i].extensionName, g_device_extensions[av]) == 0) {
         found = 1;
+        break;
       }
     }
     if (found == 0) {
@@ -262,13 +349,92 @@ char **_get_vk_ext_names(device_extensions_t extensions) {
   return result;
 }
 
+static void _chain_device_features(device_features_t *features) {
+  features->features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features->features_12.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  features->features_13.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  features->features.pNext = 0;
+  features->features_12.pNext = 0;
+  features->features_13.pNext = 0;
+  void **next = &features->features.pNext;
+  if (features->has_12) {
+    *next = &features->features_12;
+    next = &features->features_12.pNext;
+  }
+  if (features->has_13) {
+    *next = &features->features_13;
+  }
+}
+
+static void _query_device_features(VkPhysicalDevice device,
+                                   device_features_t *features) {
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(device, &props);
+  memset(features, 0, sizeof(*features));
+  features->has_12 = props.apiVersion >= VK_API_VERSION_1_2;
+  features->has_13 = props.apiVersion >= VK_API_VERSION_1_3;
+  _chain_device_features(features);
+  vkGetPhysicalDeviceFeatures2(device, &features->features);
+}
+
+// The upload path relies on timeline semaphores and the bindless set on
+// descriptor indexing with update after bind, shaders indexing its arrays
+// dynamically. Pipelines may ask for line and point polygon modes.
+static uint8_t _has_required_features(const device_features_t *features) {
+  const VkPhysicalDeviceFeatures *f_10 = &features->features.features;
+  const VkPhysicalDeviceVulkan12Features *f = &features->features_12;
+  return f_10->fillModeNonSolid &&
+         f_10->shaderSampledImageArrayDynamicIndexing &&
+         f_10->shaderStorageBufferArrayDynamicIndexing && features->has_12 &&
+         f->timelineSemaphore &&
+         f->runtimeDescriptorArray && f->descriptorBindingPartiallyBound &&
+         f->descriptorBindingSampledImageUpdateAfterBind &&
+         f->descriptorBindingStorageBufferUpdateAfterBind &&
+         f->descriptorBindingUpdateUnusedWhilePending;
+}
+
+static uint32_t _optional_feature_count(const device_features_t *features) {
+  return features->features_13.dynamicRendering +
+         features->features_13.synchronization2;
+}
+
+// Only what the backend uses is turned on: every enabled feature is one more
+// thing the driver may have to keep a slower path around for.
+static void _select_device_features(device_features_t *enabled) {
+  memset(enabled, 0, sizeof(*enabled));
+  enabled->features.features.fillModeNonSolid = VK_TRUE;
+  enabled->features.features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+  enabled->features.features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+  enabled->has_12 = 1;
+  enabled->features_12.timelineSemaphore = VK_TRUE;
+  enabled->features_12.runtimeDescriptorArray = VK_TRUE;
+  enabled->features_12.descriptorBindingPartiallyBound = VK_TRUE;
+  enabled->features_12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  enabled->features_12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+  enabled->features_12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  // The optional 1.3 features stay off until something records with them,
+  // gpu_has_* only report whether they could be turned on.
+  _chain_device_features(enabled);
+}
+
 void _init_vk_logical_device() {
   queue_family_indices_t indices = _find_queue_families(g_vk_physical_device);
 
-  uint32_t unique_indices_count = 2;
+  // Most devices present from the graphics family, and a family may only be
+  // listed once.
+  uint32_t unique_indices[3] = {indices.gfx_family};
+  uint32_t unique_indices_count = 1;
+  if (indices.present_family != indices.gfx_family) {
+    unique_indices[unique_indices_count++] = indices.present_family;
+  }
+  if (indices.transfer_family != indices.gfx_family &&
+      indices.transfer_family != indices.present_family) {
+    unique_indices[unique_indices_count++] = indices.transfer_family;
+  }
   VkDeviceQueueCreateInfo *queue_create_infos =
       malloc(sizeof(VkDeviceQueueCreateInfo) * unique_indices_count);
-  uint32_t unique_indices[2] = {indices.gfx_family, indices.present_family};
   float queue_priority = 1.f;
 
   for (uint32_t i = 0; i < unique_indices_count; i++) {
@@ -282,22 +448,50 @@ void _init_vk_logical_device() {
     queue_create_infos[i] = queue_create_info;
   }
 
-  VkPhysicalDeviceFeatures device_features;
-  vkGetPhysicalDeviceFeatures(g_vk_physical_device, &device_features);
+  // The picked device has the required features, see _is_device_suitable.
+  device_features_t available;
+  _query_device_features(g_vk_physical_device, &available);
+  device_features_t enabled;
+  _select_device_features(&enabled);
+  g_has_dynamic_rendering = available.features_13.dynamicRendering;
+  g_has_synchronization2 = available.features_13.synchronization2;
 
   device_extensions_t exts = _get_device_exts(g_vk_physical_device);
-  char **ext_names = _get_vk_ext_names(exts);
+  const char **enabled_exts =
+      malloc(sizeof(char *) *
+             (g_device_extensions_count + g_optional_device_extensions_count));
+  uint32_t enabled_ext_count = 0;
+  for (uint32_t i = 0; i < _required_device_ext_count(); i++) {
+    enabled_exts[enabled_ext_count++] = g_device_extensions[i];
+  }
+  for (uint32_t i = 0; i < g_optional_device_extensions_count; i++) {
+    for (uint32_t j = 0; j < exts.count; j++) {
+      if (strcmp(exts.exts[j].extensionName,
+                 g_optional_device_extensions[i]) == 0) {
+        enabled_exts[enabled_ext_count++] = g_optional_device_extensions[i];
+        break;
+      }
+    }
+  }
+  for (uint32_t i = 0; i < enabled_ext_count; i++) {
+    if (strcmp(enabled_exts[i], VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+      g_has_memory_budget = 1;
+    }
+    if (strcmp(enabled_exts[i], VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) ==
+        0) {
+      g_has_calibrated_timestamps = 1;
+    }
+  }
 
   VkDeviceCreateInfo device_create_info;
   device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   device_create_info.pQueueCreateInfos = queue_create_infos;
   device_create_info.queueCreateInfoCount = unique_indices_count;
-  device_create_info.pEnabledFeatures = &device_features;
-  device_create_info.enabledExtensionCount = g_device_extensions_count;
-  device_create_info.ppEnabledExtensionNames =
-      (const char **)g_device_extensions;
+  device_create_info.pEnabledFeatures = 0;
+  device_create_info.enabledExtensionCount = enabled_ext_count;
+  device_create_info.ppEnabledExtensionNames = enabled_exts;
   device_create_info.flags = 0;
-  device_create_info.pNext = 0;
+  device_create_info.pNext = &enabled.features;
 
   if (USE_VALIDATION_LAYERS) {
     device_create_info.enabledLayerCount = g_validation_layers_count;
@@ -308,17 +502,27 @@ void _init_vk_logical_device() {
 
   VkResult res = vkCreateDevice(g_vk_physical_device, &device_create_info, 0,
                                 &g_vk_device);
+  free(enabled_exts);
+  free(exts.exts);
+  free(queue_create_infos);
   if (res != VK_SUCCESS) {
     ptia_panic("Failed to create logical vk device");
   }
   vkGetDeviceQueue(g_vk_device, indices.gfx_family, 0, &g_vk_gfx_queue);
   vkGetDeviceQueue(g_vk_device, indices.present_family, 0, &g_vk_present_queue);
+  vkGetDeviceQueue(g_vk_device, indices.transfer_family, 0,
+                   &g_vk_transfer_queue);
+  g_gfx_family = indices.gfx_family;
+  g_present_family = indices.present_family;
+  g_transfer_family = indices.transfer_family;
 }
 
 uint8_t _check_device_ext_support(VkPhysicalDevice device) {
   device_extensions_t exts = _get_device_exts(device);
 
-  return _match_required_device_exts(exts.exts, exts.count);
+  const uint8_t result = _match_required_device_exts(exts.exts, exts.count);
+  free(exts.exts);
+  return result;
 }
 
 swap_chain_support_details_t
@@ -389,7 +593,15 @@ VkExtent2D _select_swap_extent(VkSurfaceCapabilitiesKHR caps) {
 }
 
 uint8_t _is_device_suitable(VkPhysicalDevice device) {
+  device_features_t features;
+  _query_device_features(device, &features);
+  if (!_has_required_features(&features)) {
+    return 0;
+  }
   queue_family_indices_t indices = _find_queue_families(device);
+  if (g_headless) {
+    return indices.gfx_family != ~(0u) && _check_device_ext_support(device);
+  }
 
   uint8_t indices_correct =
       indices.gfx_family != ~(0u) && indices.present_family != ~(0u);
@@ -406,6 +618,72 @@ uint8_t _is_device_suitable(VkPhysicalDevice device) {
   return indices_correct && extensions_supported && swap_chain_suitable;
 }
 
+static uint32_t _device_type_rank(VkPhysicalDeviceType type) {
+  switch (type) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    return 4;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    return 3;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    return 2;
+  case VK_PHYSICAL_DEVICE_TYPE_CPU:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static uint64_t _device_local_mib(VkPhysicalDevice device) {
+  VkPhysicalDeviceMemoryProperties props;
+  vkGetPhysicalDeviceMemoryProperties(device, &props);
+  uint64_t size = 0;
+  for (uint32_t i = 0; i < props.memoryHeapCount; i++) {
+    if (props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      size += props.memoryHeaps[i].size;
+    }
+  }
+  return size >> 20;
+}
+
+// Compared type first, so a discrete GPU always wins over the integrated one
+// of a hybrid laptop, whose "device local" heap is system memory anyway. Then
+// the optional features and then VRAM.
+static uint64_t _score_device(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(device, &props);
+  device_features_t features;
+  _query_device_features(device, &features);
+  uint64_t mib = _device_local_mib(device);
+  if (mib > 0xffffffffffffull) {
+    mib = 0xffffffffffffull;
+  }
+  return ((uint64_t)_device_type_rank(props.deviceType) << 56) |
+         ((uint64_t)_optional_feature_count(&features) << 48) | mib;
+}
+
+// An index into the enumeration order, or part of the device name in any
+// case.
+static uint8_t _device_matches(const char *override, uint32_t index,
+                               const char *name) {
+  char *end = 0;
+  const unsigned long requested = strtoul(override, &end, 10);
+  if (end != override && *end == '\0') {
+    return requested == index;
+  }
+  for (const char *start = name; *start; start++) {
+    uint32_t i = 0;
+    while (override[i] && start[i] &&
+           tolower((unsigned char)override[i]) ==
+               tolower((unsigned char)start[i])) {
+      i++;
+    }
+    if (override[i] == '\0') {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 void _init_vk_pick_phy_dev() {
   uint32_t device_count = 0;
   vkEnumeratePhysicalDevices(g_vk_instance, &device_count, 0);
@@ -417,16 +695,54 @@ void _init_vk_pick_phy_dev() {
   VkPhysicalDevice *devices = malloc(sizeof(VkPhysicalDevice) * device_count);
   vkEnumeratePhysicalDevices(g_vk_instance, &device_count, devices);
 
+  const char *override = getenv("PTIA_DEVICE");
+  if (!override || override[0] == '\0') {
+    override = g_device_override;
+  }
+  if (override && override[0] == '\0') {
+    override = 0;
+  }
+  VkPhysicalDevice best = VK_NULL_HANDLE;
+  VkPhysicalDevice requested = VK_NULL_HANDLE;
+  uint64_t best_score = 0;
   for (uint32_t i = 0; i < device_count; i++) {
-    if (_is_device_suitable(devices[i])) {
-      g_vk_physical_device = devices[i];
-      break;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(devices[i], &props);
+    if (!_is_device_suitable(devices[i])) {
+      printf("  [%u] %s: unsuitable\n", i, props.deviceName);
+      continue;
+    }
+    const uint64_t score = _score_device(devices[i]);
+    printf("  [%u] %s: type rank %u, %u optional features, %llu MiB\n", i,
+           props.deviceName, (uint32_t)(score >> 56),
+           (uint32_t)(score >> 48) & 0xff,
+           (unsigned long long)(score & 0xffffffffffffull));
+    if (best == VK_NULL_HANDLE || score > best_score) {
+      best = devices[i];
+      best_score = score;
+    }
+    if (override && requested == VK_NULL_HANDLE &&
+        _device_matches(override, i, props.deviceName)) {
+      requested = devices[i];
     }
   }
+  free(devices);
 
+  if (override && requested == VK_NULL_HANDLE) {
+    printf("device \"%s\" matches no suitable device, picking by score\n",
+           override);
+  }
+  g_vk_physical_device = requested != VK_NULL_HANDLE ? requested : best;
   if (g_vk_physical_device == VK_NULL_HANDLE) {
-    ptia_panic("Physical device not selected or iniitialised");
+    ptia_panic("No suitable physical device");
   }
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(g_vk_physical_device, &props);
+  printf("using %s\n", props.deviceName);
+}
+
+static void _on_framebuffer_resize(GLFWwindow *wnd, int w, int h) {
+  g_framebuffer_resized = 1;
 }
 
 void _init_glfw() {
@@ -437,6 +753,7 @@ void _init_glfw() {
   window_get_resolution(&width, &height);
   char *title = window_get_title();
   g_wnd = glfwCreateWindow(width, height, title, 0, 0);
+  glfwSetFramebufferSizeCallback(g_wnd, _on_framebuffer_resize);
 }
 
 void _preinit_vk_surface() {
@@ -507,6 +824,53 @@ void _create_swapchain() {
   g_vk_swapchain_format = surface_format.format;
 }
 
+// Stands in for the swapchain when headless. The images are rendered to and
+// then copied out, never presented.
+void _create_offscreen_targets() {
+  uint32_t width;
+  uint32_t height;
+  window_get_resolution(&width, &height);
+  if (width == 0 || height == 0) {
+    ptia_panic("Headless rendering needs window_preset_resolution");
+  }
+  g_vk_swapchain_extent.width = width;
+  g_vk_swapchain_extent.height = height;
+  // Same format a window would most likely get, so captures match what is
+  // shown on screen.
+  g_vk_swapchain_format = VK_FORMAT_R8G8B8A8_SRGB;
+  g_vk_swapchain_image_count = GPU_HEADLESS_IMAGE_COUNT;
+  g_vk_swapchain_images = malloc(sizeof(VkImage) * g_vk_swapchain_image_count);
+  g_offscreen_memory =
+      malloc(sizeof(gpu_allocation_t) * g_vk_swapchain_image_count);
+
+  VkImageCreateInfo create_info;
+  create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  create_info.pNext = 0;
+  create_info.flags = 0;
+  create_info.imageType = VK_IMAGE_TYPE_2D;
+  create_info.format = g_vk_swapchain_format;
+  create_info.extent.width = width;
+  create_info.extent.height = height;
+  create_info.extent.depth = 1;
+  create_info.mipLevels = 1;
+  create_info.arrayLayers = 1;
+  create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  create_info.usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  create_info.queueFamilyIndexCount = 0;
+  create_info.pQueueFamilyIndices = 0;
+  create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  for (uint32_t i = 0; i < g_vk_swapchain_image_count; i++) {
+    if (gpu_image_create(&create_info, GPU_MEMORY_DEVICE,
+                         &g_vk_swapchain_images[i],
+                         &g_offscreen_memory[i]) != VK_SUCCESS) {
+      ptia_panic("Failed to create offscreen render target");
+    }
+  }
+}
+
 void _init_vk_image_views() {
   g_vk_image_view_count = g_vk_swapchain_image_count;
   g_vk_image_views = malloc(sizeof(VkImageView) * g_vk_image_view_count);
@@ -548,7 +912,10 @@ void _init_vk_render_passes() {
   color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // Offscreen targets end up ready to be copied out.
+  color_attachment.finalLayout = g_headless
+                                     ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                     : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
   VkAttachmentReference color_attachment_ref;
   color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -574,8 +941,27 @@ void _init_vk_render_passes() {
   create_info.pAttachments = &color_attachment;
   create_info.subpassCount = 1;
   create_info.pSubpasses = &subpass;
-  create_info.dependencyCount= 0;
-  create_info.pDependencies = 0;
+  // The image is only ready once the acquire semaphore has been waited on at
+  // the colour output stage, so the layout transition has to wait there too.
+  VkSubpassDependency dependencies[2];
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dependencyFlags = 0;
+  // Headless frames may be copied out straight after the pass.
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  dependencies[1].dependencyFlags = 0;
+
+  create_info.dependencyCount = g_headless ? 2 : 1;
+  create_info.pDependencies = dependencies;
 
   if (vkCreateRenderPass(g_vk_device, &create_info, 0, &g_vk_render_pass) !=
       VK_SUCCESS) {
@@ -608,24 +994,142 @@ void _init_vk_framebuffers() {
   }
 }
 
+void gpu_preset_pipeline_cache_path(const char *path) {
+  g_pipeline_cache_path = path;
+}
+
+void gpu_preset_headless(uint8_t headless) { g_headless = headless; }
+
+void gpu_preset_device(const char *device) { g_device_override = device; }
+
 void gpu_init_vk(const char *app_name, uint32_t app_version) {
-  _init_glfw();
+  PROFILE_FUNCTION_BEGIN();
+  if (!g_headless) {
+    PROFILE_BEGIN("_init_glfw");
+    _init_glfw();
+    PROFILE_END();
+  }
   printf("init vk instance\n");
+  PROFILE_BEGIN("_init_vk_instance");
   _init_vk_instance(app_name, app_version);
-  printf("pre-init vk surface\n");
-  _preinit_vk_surface();
+  PROFILE_END();
+  if (!g_headless) {
+    printf("pre-init vk surface\n");
+    PROFILE_BEGIN("_preinit_vk_surface");
+    _preinit_vk_surface();
+    PROFILE_END();
+  }
   printf("pick from physical devices\n");
+  PROFILE_BEGIN("_init_vk_pick_phy_dev");
   _init_vk_pick_phy_dev();
+  PROFILE_END();
   printf("init vk logical device \n");
+  PROFILE_BEGIN("_init_vk_logical_device");
   _init_vk_logical_device();
-  printf("create initial swapchain\n");
-  _create_swapchain();
+  PROFILE_END();
+  printf("init gpu memory allocator\n");
+  PROFILE_BEGIN("gpu_memory_init");
+  gpu_memory_init();
+  PROFILE_END();
+  printf("init bindless descriptor set\n");
+  PROFILE_BEGIN("bindless_init");
+  bindless_init();
+  PROFILE_END();
+  printf("load vk pipeline cache\n");
+  PROFILE_BEGIN("pipeline_cache_load");
+  pipeline_cache_load(g_pipeline_cache_path);
+  PROFILE_END();
+  if (g_headless) {
+    printf("create offscreen render targets\n");
+    PROFILE_BEGIN("_create_offscreen_targets");
+    _create_offscreen_targets();
+    PROFILE_END();
+  } else {
+    printf("create initial swapchain\n");
+    PROFILE_BEGIN("_create_swapchain");
+    _create_swapchain();
+    PROFILE_END();
+  }
   printf("init vk image views\n");
+  PROFILE_BEGIN("_init_vk_image_views");
   _init_vk_image_views();
+  PROFILE_END();
   printf("init vk pipeline render pass(es)\n");
+  PROFILE_BEGIN("_init_vk_render_passes");
   _init_vk_render_passes();
+  PROFILE_END();
   printf("init vk framebuffers from render passes\n");
+  PROFILE_BEGIN("_init_vk_framebuffers");
+  _init_vk_framebuffers();
+  PROFILE_END();
+  PROFILE_END();
+}
+
+void _destroy_swapchain() {
+  for (uint32_t i = 0; i < g_vk_swapchain_image_count; i++) {
+    vkDestroyFramebuffer(g_vk_device, g_vk_swapchain_framebuffers[i], 0);
+  }
+  free(g_vk_swapchain_framebuffers);
+  g_vk_swapchain_framebuffers = 0;
+  for (size_t i = 0; i < g_vk_image_view_count; i++) {
+    vkDestroyImageView(g_vk_device, g_vk_image_views[i], 0);
+  }
+  free(g_vk_image_views);
+  g_vk_image_views = 0;
+  g_vk_image_view_count = 0;
+  if (g_headless) {
+    for (uint32_t i = 0; i < g_vk_swapchain_image_count; i++) {
+      gpu_image_destroy(g_vk_swapchain_images[i], g_offscreen_memory[i]);
+    }
+    free(g_offscreen_memory);
+    g_offscreen_memory = 0;
+  }
+  free(g_vk_swapchain_images);
+  g_vk_swapchain_images = 0;
+  g_vk_swapchain_image_count = 0;
+  if (g_vk_swapchain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(g_vk_device, g_vk_swapchain, 0);
+    g_vk_swapchain = VK_NULL_HANDLE;
+  }
+}
+
+uint8_t gpu_recreate_swapchain() {
+  // Offscreen targets never go out of date.
+  if (g_headless) {
+    return 0;
+  }
+  // A minimised window has a zero sized framebuffer and no valid swapchain,
+  // sleep until it comes back or the window is closed.
+  int w = 0, h = 0;
+  glfwGetFramebufferSize(g_wnd, &w, &h);
+  while ((w == 0 || h == 0) && !glfwWindowShouldClose(g_wnd)) {
+    glfwWaitEvents();
+    glfwGetFramebufferSize(g_wnd, &w, &h);
+  }
+  if (w == 0 || h == 0) {
+    return 0;
+  }
+  vkDeviceWaitIdle(g_vk_device);
+  _destroy_swapchain();
+  _create_swapchain();
+  _init_vk_image_views();
   _init_vk_framebuffers();
+  g_framebuffer_resized = 0;
+  return 1;
+}
+
+uint8_t gpu_pump_events() {
+  if (g_headless) {
+    return 1;
+  }
+  glfwPollEvents();
+  return !glfwWindowShouldClose(g_wnd);
+}
+
+uint8_t gpu_consume_resize() {
+  const uint8_t resized = g_framebuffer_resized;
+  g_framebuffer_resized = 0;
+  return resized;
 }
 
 VkInstance gpu_get_vk_instance() { return g_vk_instance; }
@@ -642,19 +1146,50 @@ VkFormat gpu_get_swapchain_format() { return g_vk_swapchain_format; }
 
 VkRenderPass gpu_get_render_pass() { return g_vk_render_pass; }
 
+VkQueue gpu_get_gfx_queue() { return g_vk_gfx_queue; }
+
+VkQueue gpu_get_present_queue() { return g_vk_present_queue; }
+
+uint8_t gpu_has_memory_budget() { return g_has_memory_budget; }
+
+uint8_t gpu_has_calibrated_timestamps() { return g_has_calibrated_timestamps; }
+
+uint8_t gpu_has_dynamic_rendering() { return g_has_dynamic_rendering; }
+
+uint8_t gpu_has_synchronization2() { return g_has_synchronization2; }
+
+uint32_t gpu_get_gfx_queue_family() { return g_gfx_family; }
+
+VkQueue gpu_get_transfer_queue() { return g_vk_transfer_queue; }
+
+uint32_t gpu_get_transfer_queue_family() { return g_transfer_family; }
+
+uint32_t gpu_get_swapchain_image_count() { return g_vk_swapchain_image_count; }
+
+VkImage gpu_get_swapchain_image(uint32_t image_index) {
+  return g_vk_swapchain_images[image_index];
+}
+
+uint8_t gpu_is_headless() { return g_headless; }
+
+VkFramebuffer gpu_get_framebuffer(uint32_t image_index) {
+  return g_vk_swapchain_framebuffers[image_index];
+}
+
 void gpu_destroy_vk() {
   printf("Tearing down vk\n");
-  for (uint32_t i = 0; i < g_vk_swapchain_image_count; i++) {
-    vkDestroyFramebuffer(g_vk_device, g_vk_swapchain_framebuffers[i], 0);
-  }
+  vkDeviceWaitIdle(g_vk_device);
+  _destroy_swapchain();
   vkDestroyRenderPass(g_vk_device, g_vk_render_pass, 0);
-  for (size_t i = 0; i < g_vk_image_view_count; i++) {
-    vkDestroyImageView(g_vk_device, g_vk_image_views[i], 0);
-  }
 
-  vkDestroySwapchainKHR(g_vk_device, g_vk_swapchain, 0);
-  vkDestroySurfaceKHR(g_vk_instance, g_vk_surface, 0);
-  glfwTerminate();
+  if (!g_headless) {
+    vkDestroySurfaceKHR(g_vk_instance, g_vk_surface, 0);
+    glfwTerminate();
+  }
+  destroy_graphics_pipelines();
+  pipeline_cache_destroy();
+  bindless_shutdown();
+  gpu_memory_shutdown();
   vkDestroyDevice(g_vk_device, 0);
   if (USE_VALIDATION_LAYERS) {
     DestroyDebugUtilsMessengerEXT(g_vk_instance, g_debug_messenger, 0);
@@ -0,0 +1,749 @@
+#include "engine/backend/gpu_memory.h"
+#include "engine/backend/gpu.h"
+#include "engine/error.h"
+#include <core/arrays.h>
+#include <core/handle_pool.h>
+#include <core/tlsf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+typedef struct {
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  void *mapped;
+  // Spans the whole block so defragmentation can copy between blocks. Null
+  // for optimal image blocks and types that take no transfer buffers.
+  VkBuffer copy_buffer;
+  uint32_t type;
+  uint8_t linear;
+  tlsf_t tlsf;
+} gpu_block_t;
+
+typedef struct {
+  ARRAY(gpu_block_t *) blocks;
+} gpu_pool_t;
+
+// What an allocation is bound to. Only buffers can be moved by
+// defragmentation: a linear image shares their pools, but copying its bytes
+// elsewhere says nothing about how the driver laid it out, and raw
+// allocations could be bound to anything.
+typedef enum {
+  GPU_RECORD_RAW = 0,
+  GPU_RECORD_BUFFER,
+  GPU_RECORD_IMAGE,
+} gpu_record_kind_t;
+
+typedef struct {
+  // Null for dedicated allocations, which own memory instead.
+  gpu_block_t *block;
+  uint32_t node;
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+  void *mapped;
+  uint32_t type;
+  gpu_record_kind_t kind;
+} gpu_record_t;
+
+// Where a defragmentation pass is moving an allocation to. The old range
+// stays allocated until gpu_memory_defrag_end.
+typedef struct {
+  gpu_allocation_t allocation;
+  gpu_block_t *block;
+  uint32_t node;
+} gpu_move_t;
+
+static VkPhysicalDeviceMemoryProperties g_props;
+static VkDeviceSize g_block_size[VK_MAX_MEMORY_TYPES];
+static VkDeviceSize g_non_coherent_atom = 1;
+static uint32_t g_max_allocations = 0;
+static uint32_t g_device_allocations = 0;
+// This allocator's own usage, the budget fallback without the extension.
+static VkDeviceSize g_heap_usage[VK_MAX_MEMORY_HEAPS];
+
+// Indexed by memory type, then by whether the contents are linear.
+static gpu_pool_t g_pools[VK_MAX_MEMORY_TYPES][2];
+static handle_pool_t g_allocations;
+static ARRAY(gpu_move_t) g_moves = {0};
+// Every entry point takes it, so resources can be created from any thread.
+// Never held across a user callback.
+static mtx_t g_memory_lock;
+
+static uint32_t _bit_count(uint32_t bits) {
+  uint32_t count = 0;
+  for (; bits; bits &= bits - 1) {
+    count++;
+  }
+  return count;
+}
+
+static uint8_t _host_visible(uint32_t type) {
+  return (g_props.memoryTypes[type].propertyFlags &
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+static uint8_t _non_coherent(uint32_t type) {
+  const VkMemoryPropertyFlags flags = g_props.memoryTypes[type].propertyFlags;
+  return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+         !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+// Cheapest memory type in type_bits that has everything usage requires:
+// every missing preferred flag costs two, every avoided flag present one.
+static uint32_t _find_type(uint32_t type_bits, gpu_memory_usage_t usage) {
+  VkMemoryPropertyFlags required = 0;
+  VkMemoryPropertyFlags preferred = 0;
+  VkMemoryPropertyFlags avoided = 0;
+  switch (usage) {
+  case GPU_MEMORY_DEVICE:
+    preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    break;
+  case GPU_MEMORY_UPLOAD:
+    required =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    break;
+  case GPU_MEMORY_READBACK:
+    required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    break;
+  }
+  const VkMemoryPropertyFlags never = VK_MEMORY_PROPERTY_PROTECTED_BIT |
+                                      VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+  uint32_t best = ~0u;
+  uint32_t best_cost = ~0u;
+  for (uint32_t i = 0; i < g_props.memoryTypeCount; i++) {
+    const VkMemoryPropertyFlags flags = g_props.memoryTypes[i].propertyFlags;
+    if (!(type_bits & (1u << i)) || (flags & required) != required ||
+        (flags & never)) {
+      continue;
+    }
+    const uint32_t cost =
+        2 * _bit_count(preferred & ~flags) + _bit_count(flags & avoided);
+    if (cost < best_cost) {
+      best = i;
+      best_cost = cost;
+    }
+  }
+  return best;
+}
+
+static void _heap_budget(VkDeviceSize budget[VK_MAX_MEMORY_HEAPS],
+                         VkDeviceSize usage[VK_MAX_MEMORY_HEAPS]) {
+  if (gpu_has_memory_budget()) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props;
+    memset(&budget_props, 0, sizeof(budget_props));
+    budget_props.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 props;
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    props.pNext = &budget_props;
+    vkGetPhysicalDeviceMemoryProperties2(gpu_get_vk_phy_device(), &props);
+    for (uint32_t i = 0; i < g_props.memoryHeapCount; i++) {
+      budget[i] = budget_props.heapBudget[i];
+      usage[i] = budget_props.heapUsage[i];
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < g_props.memoryHeapCount; i++) {
+    budget[i] = g_props.memoryHeaps[i].size / 10 * 8;
+    usage[i] = g_heap_usage[i];
+  }
+}
+
+static VkResult _allocate_memory(uint32_t type, VkDeviceSize size,
+                                 const void *next, VkDeviceMemory *out) {
+  if (g_device_allocations >= g_max_allocations) {
+    return VK_ERROR_TOO_MANY_OBJECTS;
+  }
+  const uint32_t heap = g_props.memoryTypes[type].heapIndex;
+  VkDeviceSize budget[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize usage[VK_MAX_MEMORY_HEAPS];
+  _heap_budget(budget, usage);
+  if (usage[heap] + size > budget[heap]) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+
+  VkMemoryAllocateInfo alloc_info;
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.pNext = next;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = type;
+  VkResult res = vkAllocateMemory(gpu_get_vk_device(), &alloc_info, 0, out);
+  if (res != VK_SUCCESS) {
+    return res;
+  }
+  g_heap_usage[heap] += size;
+  g_device_allocations++;
+  return VK_SUCCESS;
+}
+
+static void _free_memory(uint32_t type, VkDeviceMemory memory,
+                         VkDeviceSize size) {
+  vkFreeMemory(gpu_get_vk_device(), memory, 0);
+  g_heap_usage[g_props.memoryTypes[type].heapIndex] -= size;
+  g_device_allocations--;
+}
+
+static gpu_block_t *_create_block(uint32_t type, uint8_t linear) {
+  const VkDeviceSize size = g_block_size[type];
+  VkDeviceMemory memory;
+  if (_allocate_memory(type, size, 0, &memory) != VK_SUCCESS) {
+    return 0;
+  }
+  VkDevice device = gpu_get_vk_device();
+  gpu_block_t *block = calloc(1, sizeof(gpu_block_t));
+  block->memory = memory;
+  block->size = size;
+  block->type = type;
+  block->linear = linear;
+  tlsf_init(&block->tlsf, size);
+  if (_host_visible(type) &&
+      vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) !=
+          VK_SUCCESS) {
+    ptia_panic("Failed to map host visible vk Device Memory");
+  }
+
+  if (linear) {
+    VkBufferCreateInfo buffer_info;
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = 0;
+    buffer_info.flags = 0;
+    buffer_info.size = size;
+    buffer_info.usage =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.queueFamilyIndexCount = 0;
+    buffer_info.pQueueFamilyIndices = 0;
+    if (vkCreateBuffer(device, &buffer_info, 0, &block->copy_buffer) ==
+        VK_SUCCESS) {
+      VkMemoryRequirements requirements;
+      vkGetBufferMemoryRequirements(device, block->copy_buffer, &requirements);
+      if (!(requirements.memoryTypeBits & (1u << type)) ||
+          requirements.size > size ||
+          vkBindBufferMemory(device, block->copy_buffer, memory, 0) !=
+              VK_SUCCESS) {
+        vkDestroyBuffer(device, block->copy_buffer, 0);
+        block->copy_buffer = VK_NULL_HANDLE;
+      }
+    } else {
+      block->copy_buffer = VK_NULL_HANDLE;
+    }
+  }
+
+  array_push(&g_pools[type][linear].blocks, block);
+  return block;
+}
+
+static void _destroy_block(gpu_block_t *block) {
+  VkDevice device = gpu_get_vk_device();
+  if (block->copy_buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, block->copy_buffer, 0);
+  }
+  if (block->mapped) {
+    vkUnmapMemory(device, block->memory);
+  }
+  _free_memory(block->type, block->memory, block->size);
+  tlsf_destroy(&block->tlsf);
+  free(block);
+}
+
+// Frees a range and gives the block back to the driver once it is empty,
+// keeping the last block of each pool around so a single resource being
+// created and destroyed does not allocate device memory every time.
+static void _release_range(gpu_block_t *block, uint32_t node) {
+  tlsf_free(&block->tlsf, node);
+  gpu_pool_t *pool = &g_pools[block->type][block->linear];
+  if (!tlsf_is_empty(&block->tlsf) || pool->blocks.count < 2) {
+    return;
+  }
+  for (uint64_t i = 0; i < pool->blocks.count; i++) {
+    if (pool->blocks.data[i] == block) {
+      pool->blocks.data[i] = pool->blocks.data[--pool->blocks.count];
+      break;
+    }
+  }
+  _destroy_block(block);
+}
+
+static void _place(gpu_record_t *record, gpu_block_t *block, uint32_t node) {
+  record->block = block;
+  record->node = node;
+  record->memory = block->memory;
+  record->offset = tlsf_offset(&block->tlsf, node);
+  record->mapped =
+      block->mapped ? (uint8_t *)block->mapped + record->offset : 0;
+}
+
+static uint8_t _alloc_in_type(uint32_t type,
+                              const VkMemoryRequirements *requirements,
+                              uint8_t linear, uint8_t dedicated,
+                              const void *dedicated_next,
+                              gpu_record_t *record) {
+  memset(record, 0, sizeof(gpu_record_t));
+  record->type = type;
+  record->size = requirements->size;
+  record->alignment = requirements->alignment;
+  // Ranges of non coherent memory are flushed in whole atoms, so they must
+  // not share an atom with a neighbour.
+  if (_non_coherent(type) && record->alignment < g_non_coherent_atom) {
+    record->alignment = g_non_coherent_atom;
+  }
+
+  if (!dedicated && requirements->size <= g_block_size[type] / 2) {
+    gpu_pool_t *pool = &g_pools[type][linear];
+    for (uint64_t i = 0; i < pool->blocks.count; i++) {
+      gpu_block_t *block = pool->blocks.data[i];
+      const uint32_t node =
+          tlsf_alloc(&block->tlsf, record->size, record->alignment);
+      if (node != TLSF_NONE) {
+        _place(record, block, node);
+        return 1;
+      }
+    }
+    gpu_block_t *block = _create_block(type, linear);
+    if (block) {
+      _place(record, block,
+             tlsf_alloc(&block->tlsf, record->size, record->alignment));
+      return 1;
+    }
+    // No room for another block, a dedicated allocation of just this size
+    // may still fit.
+  }
+
+  if (_allocate_memory(type, requirements->size, dedicated_next,
+                       &record->memory) != VK_SUCCESS) {
+    return 0;
+  }
+  if (_host_visible(type) &&
+      vkMapMemory(gpu_get_vk_device(), record->memory, 0, VK_WHOLE_SIZE, 0,
+                  &record->mapped) != VK_SUCCESS) {
+    ptia_panic("Failed to map host visible vk Device Memory");
+  }
+  return 1;
+}
+
+// Tries the best memory type first, then falls back to worse ones while
+// any are left.
+static gpu_allocation_t _alloc(const VkMemoryRequirements *requirements,
+                               gpu_memory_usage_t usage, uint8_t linear,
+                               gpu_record_kind_t kind, uint8_t dedicated,
+                               const void *dedicated_next) {
+  uint32_t type_bits = requirements->memoryTypeBits;
+  gpu_allocation_t allocation = HANDLE_INVALID;
+  mtx_lock(&g_memory_lock);
+  for (uint32_t type = _find_type(type_bits, usage); type != ~0u;
+       type = _find_type(type_bits, usage)) {
+    gpu_record_t record;
+    if (_alloc_in_type(type, requirements, linear, dedicated, dedicated_next,
+                       &record)) {
+      record.kind = kind;
+      allocation = handle_pool_insert(&g_allocations, &record);
+      break;
+    }
+    type_bits &= ~(1u << type);
+  }
+  mtx_unlock(&g_memory_lock);
+  return allocation;
+}
+
+void gpu_memory_init() {
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(gpu_get_vk_phy_device(), &props);
+  vkGetPhysicalDeviceMemoryProperties(gpu_get_vk_phy_device(), &g_props);
+  g_non_coherent_atom = props.limits.nonCoherentAtomSize;
+  g_max_allocations = props.limits.maxMemoryAllocationCount;
+  g_device_allocations = 0;
+  memset(g_heap_usage, 0, sizeof(g_heap_usage));
+  memset(g_pools, 0, sizeof(g_pools));
+
+  // Small heaps, like the 256MB host visible window into VRAM, get smaller
+  // blocks so one block does not swallow the whole heap.
+  for (uint32_t i = 0; i < g_props.memoryTypeCount; i++) {
+    const VkDeviceSize heap_size =
+        g_props.memoryHeaps[g_props.memoryTypes[i].heapIndex].size;
+    g_block_size[i] = heap_size / 8 < GPU_MEMORY_BLOCK_SIZE
+                          ? heap_size / 8
+                          : GPU_MEMORY_BLOCK_SIZE;
+  }
+
+  handle_pool_init(&g_allocations, sizeof(gpu_record_t), 256);
+  mtx_init(&g_memory_lock, mtx_plain);
+}
+
+void gpu_memory_shutdown() {
+  const uint32_t leaked = handle_pool_count(&g_allocations);
+  if (leaked > 0) {
+    ptia_warn("gpu memory: %u allocations still alive at shutdown", leaked);
+  }
+  for (uint32_t i = 0; i < leaked; i++) {
+    gpu_record_t *record = handle_pool_at(&g_allocations, i);
+    if (!record->block) {
+      if (record->mapped) {
+        vkUnmapMemory(gpu_get_vk_device(), record->memory);
+      }
+      _free_memory(record->type, record->memory, record->size);
+    }
+  }
+  for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++) {
+    for (uint32_t linear = 0; linear < 2; linear++) {
+      gpu_pool_t *pool = &g_pools[type][linear];
+      for (uint64_t i = 0; i < pool->blocks.count; i++) {
+        _destroy_block(pool->blocks.data[i]);
+      }
+      array_free(&pool->blocks);
+    }
+  }
+  handle_pool_destroy(&g_allocations);
+  array_free(&g_moves);
+  mtx_destroy(&g_memory_lock);
+}
+
+gpu_allocation_t gpu_memory_alloc(const VkMemoryRequirements *requirements,
+                                  gpu_memory_usage_t usage, uint8_t linear) {
+  return _alloc(requirements, usage, linear ? 1 : 0, GPU_RECORD_RAW, 0, 0);
+}
+
+void gpu_memory_free(gpu_allocation_t allocation) {
+  mtx_lock(&g_memory_lock);
+  gpu_record_t record;
+  if (!handle_pool_remove(&g_allocations, allocation, &record)) {
+    mtx_unlock(&g_memory_lock);
+    return;
+  }
+  // Freed while a defragmentation pass was moving it.
+  for (uint64_t i = 0; i < g_moves.count; i++) {
+    if (handle_equal(g_moves.data[i].allocation, allocation)) {
+      const gpu_move_t move = g_moves.data[i];
+      g_moves.data[i] = g_moves.data[--g_moves.count];
+      _release_range(move.block, move.node);
+      break;
+    }
+  }
+  if (record.block) {
+    _release_range(record.block, record.node);
+  } else {
+    if (record.mapped) {
+      vkUnmapMemory(gpu_get_vk_device(), record.memory);
+    }
+    _free_memory(record.type, record.memory, record.size);
+  }
+  mtx_unlock(&g_memory_lock);
+}
+
+uint8_t gpu_memory_info(gpu_allocation_t allocation,
+                        gpu_allocation_info_t *out) {
+  mtx_lock(&g_memory_lock);
+  const gpu_record_t *record = handle_pool_get(&g_allocations, allocation);
+  if (record) {
+    out->memory = record->memory;
+    out->offset = record->offset;
+    out->size = record->size;
+    out->mapped = record->mapped;
+    out->memory_type = record->type;
+    out->dedicated = record->block == 0;
+  }
+  mtx_unlock(&g_memory_lock);
+  return record != 0;
+}
+
+// Called with the lock held. Fills range with the atoms covering the part of
+// the allocation, clamped to the end of its memory. Returns 0 when the
+// memory is coherent and nothing needs doing.
+static uint8_t _mapped_range(const gpu_record_t *record, VkDeviceSize offset,
+                             VkDeviceSize size, VkMappedMemoryRange *range) {
+  if (!_non_coherent(record->type)) {
+    return 0;
+  }
+  const VkDeviceSize limit = record->block ? record->block->size : record->size;
+  const VkDeviceSize atom = g_non_coherent_atom;
+  if (offset > record->size) {
+    offset = record->size;
+  }
+  if (size == VK_WHOLE_SIZE || size > record->size - offset) {
+    size = record->size - offset;
+  }
+  const VkDeviceSize begin = (record->offset + offset) / atom * atom;
+  VkDeviceSize end = (record->offset + offset + size + atom - 1) / atom * atom;
+  if (end > limit) {
+    end = limit;
+  }
+  range->sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range->pNext = 0;
+  range->memory = record->memory;
+  range->offset = begin;
+  range->size = end - begin;
+  return 1;
+}
+
+uint8_t gpu_memory_flush(gpu_allocation_t allocation, VkDeviceSize offset,
+                         VkDeviceSize size) {
+  mtx_lock(&g_memory_lock);
+  const gpu_record_t *record = handle_pool_get(&g_allocations, allocation);
+  VkMappedMemoryRange range;
+  uint8_t ok = record != 0;
+  if (record && _mapped_range(record, offset, size, &range)) {
+    ok = vkFlushMappedMemoryRanges(gpu_get_vk_device(), 1, &range) ==
+         VK_SUCCESS;
+  }
+  mtx_unlock(&g_memory_lock);
+  return ok;
+}
+
+uint8_t gpu_memory_invalidate(gpu_allocation_t allocation, VkDeviceSize offset,
+                              VkDeviceSize size) {
+  mtx_lock(&g_memory_lock);
+  const gpu_record_t *record = handle_pool_get(&g_allocations, allocation);
+  VkMappedMemoryRange range;
+  uint8_t ok = record != 0;
+  if (record && _mapped_range(record, offset, size, &range)) {
+    ok = vkInvalidateMappedMemoryRanges(gpu_get_vk_device(), 1, &range) ==
+         VK_SUCCESS;
+  }
+  mtx_unlock(&g_memory_lock);
+  return ok;
+}
+
+VkResult gpu_buffer_create(const VkBufferCreateInfo *info,
+                           gpu_memory_usage_t usage, VkBuffer *out_buffer,
+                           gpu_allocation_t *out_allocation) {
+  VkDevice device = gpu_get_vk_device();
+  VkResult res = vkCreateBuffer(device, info, 0, out_buffer);
+  if (res != VK_SUCCESS) {
+    return res;
+  }
+
+  VkBufferMemoryRequirementsInfo2 requirements_info;
+  requirements_info.sType =
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+  requirements_info.pNext = 0;
+  requirements_info.buffer = *out_buffer;
+  VkMemoryDedicatedRequirements dedicated;
+  dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+  dedicated.pNext = 0;
+  VkMemoryRequirements2 requirements;
+  requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  requirements.pNext = &dedicated;
+  vkGetBufferMemoryRequirements2(device, &requirements_info, &requirements);
+
+  VkMemoryDedicatedAllocateInfo dedicated_info;
+  dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicated_info.pNext = 0;
+  dedicated_info.image = VK_NULL_HANDLE;
+  dedicated_info.buffer = *out_buffer;
+  *out_allocation = _alloc(&requirements.memoryRequirements, usage, 1,
+                           GPU_RECORD_BUFFER,
+                           dedicated.prefersDedicatedAllocation ||
+                               dedicated.requiresDedicatedAllocation,
+                           &dedicated_info);
+
+  gpu_allocation_info_t placed;
+  if (!gpu_memory_info(*out_allocation, &placed)) {
+    vkDestroyBuffer(device, *out_buffer, 0);
+    *out_buffer = VK_NULL_HANDLE;
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+  res = vkBindBufferMemory(device, *out_buffer, placed.memory, placed.offset);
+  if (res != VK_SUCCESS) {
+    gpu_buffer_destroy(*out_buffer, *out_allocation);
+    *out_buffer = VK_NULL_HANDLE;
+    *out_allocation = HANDLE_INVALID;
+  }
+  return res;
+}
+
+VkResult gpu_image_create(const VkImageCreateInfo *info,
+                          gpu_memory_usage_t usage, VkImage *out_image,
+                          gpu_allocation_t *out_allocation) {
+  VkDevice device = gpu_get_vk_device();
+  VkResult res = vkCreateImage(device, info, 0, out_image);
+  if (res != VK_SUCCESS) {
+    return res;
+  }
+
+  VkImageMemoryRequirementsInfo2 requirements_info;
+  requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+  requirements_info.pNext = 0;
+  requirements_info.image = *out_image;
+  VkMemoryDedicatedRequirements dedicated;
+  dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+  dedicated.pNext = 0;
+  VkMemoryRequirements2 requirements;
+  requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  requirements.pNext = &dedicated;
+  vkGetImageMemoryRequirements2(device, &requirements_info, &requirements);
+
+  VkMemoryDedicatedAllocateInfo dedicated_info;
+  dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicated_info.pNext = 0;
+  dedicated_info.image = *out_image;
+  dedicated_info.buffer = VK_NULL_HANDLE;
+  *out_allocation =
+      _alloc(&requirements.memoryRequirements, usage,
+             info->tiling == VK_IMAGE_TILING_LINEAR, GPU_RECORD_IMAGE,
+             dedicated.prefersDedicatedAllocation ||
+                 dedicated.requiresDedicatedAllocation,
+             &dedicated_info);
+
+  gpu_allocation_info_t placed;
+  if (!gpu_memory_info(*out_allocation, &placed)) {
+    vkDestroyImage(device, *out_image, 0);
+    *out_image = VK_NULL_HANDLE;
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+  res = vkBindImageMemory(device, *out_image, placed.memory, placed.offset);
+  if (res != VK_SUCCESS) {
+    gpu_image_destroy(*out_image, *out_allocation);
+    *out_image = VK_NULL_HANDLE;
+    *out_allocation = HANDLE_INVALID;
+  }
+  return res;
+}
+
+void gpu_buffer_destroy(VkBuffer buffer, gpu_allocation_t allocation) {
+  vkDestroyBuffer(gpu_get_vk_device(), buffer, 0);
+  gpu_memory_free(allocation);
+}
+
+void gpu_image_destroy(VkImage image, gpu_allocation_t allocation) {
+  vkDestroyImage(gpu_get_vk_device(), image, 0);
+  gpu_memory_free(allocation);
+}
+
+uint32_t gpu_memory_defrag_begin(VkCommandBuffer cmd, VkDeviceSize max_bytes) {
+  mtx_lock(&g_memory_lock);
+  // One pass at a time, the previous one has not been ended yet.
+  if (g_moves.count > 0) {
+    mtx_unlock(&g_memory_lock);
+    return 0;
+  }
+
+  VkDeviceSize moved_bytes = 0;
+  const uint32_t live = handle_pool_count(&g_allocations);
+  for (uint32_t type = 0; type < g_props.memoryTypeCount; type++) {
+    gpu_pool_t *pool = &g_pools[type][1];
+    if (pool->blocks.count < 2) {
+      continue;
+    }
+    gpu_block_t *source = 0;
+    for (uint64_t i = 0; i < pool->blocks.count; i++) {
+      gpu_block_t *block = pool->blocks.data[i];
+      if (!source || block->tlsf.used < source->tlsf.used) {
+        source = block;
+      }
+    }
+    if (source->copy_buffer == VK_NULL_HANDLE) {
+      continue;
+    }
+
+    for (uint32_t i = 0; i < live; i++) {
+      const gpu_record_t *record = handle_pool_at(&g_allocations, i);
+      if (record->block != source || record->kind != GPU_RECORD_BUFFER ||
+          moved_bytes + record->size > max_bytes) {
+        continue;
+      }
+      for (uint64_t j = 0; j < pool->blocks.count; j++) {
+        gpu_block_t *target = pool->blocks.data[j];
+        if (target == source || target->copy_buffer == VK_NULL_HANDLE) {
+          continue;
+        }
+        const uint32_t node =
+            tlsf_alloc(&target->tlsf, record->size, record->alignment);
+        if (node != TLSF_NONE) {
+          gpu_move_t move;
+          move.allocation = handle_pool_handle_at(&g_allocations, i);
+          move.block = target;
+          move.node = node;
+          array_push(&g_moves, move);
+          moved_bytes += record->size;
+          break;
+        }
+      }
+    }
+  }
+
+  if (g_moves.count > 0) {
+    VkMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = 0;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, 0,
+                         0, 0);
+    for (uint64_t i = 0; i < g_moves.count; i++) {
+      const gpu_move_t *move = &g_moves.data[i];
+      const gpu_record_t *record =
+          handle_pool_get(&g_allocations, move->allocation);
+      VkBufferCopy region;
+      region.srcOffset = record->offset;
+      region.dstOffset = tlsf_offset(&move->block->tlsf, move->node);
+      region.size = record->size;
+      vkCmdCopyBuffer(cmd, record->block->copy_buffer,
+                      move->block->copy_buffer, 1, &region);
+    }
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                         0, 0, 0);
+  }
+  const uint32_t moves = (uint32_t)g_moves.count;
+  mtx_unlock(&g_memory_lock);
+  return moves;
+}
+
+void gpu_memory_defrag_end(gpu_defrag_moved_fn moved, void *user_data) {
+  mtx_lock(&g_memory_lock);
+  const uint64_t count = g_moves.count;
+  gpu_allocation_t *handles = malloc(sizeof(gpu_allocation_t) * (count + 1));
+  for (uint64_t i = 0; i < count; i++) {
+    const gpu_move_t move = g_moves.data[i];
+    gpu_record_t *record = handle_pool_get(&g_allocations, move.allocation);
+    gpu_block_t *old_block = record->block;
+    const uint32_t old_node = record->node;
+    _place(record, move.block, move.node);
+    _release_range(old_block, old_node);
+    handles[i] = move.allocation;
+  }
+  array_clear(&g_moves);
+  mtx_unlock(&g_memory_lock);
+
+  if (moved) {
+    for (uint64_t i = 0; i < count; i++) {
+      moved(handles[i], user_data);
+    }
+  }
+  free(handles);
+}
+
+void gpu_memory_get_stats(gpu_memory_stats_t *out) {
+  memset(out, 0, sizeof(gpu_memory_stats_t));
+  mtx_lock(&g_memory_lock);
+  for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++) {
+    for (uint32_t linear = 0; linear < 2; linear++) {
+      const gpu_pool_t *pool = &g_pools[type][linear];
+      for (uint64_t i = 0; i < pool->blocks.count; i++) {
+        out->blocks++;
+        out->block_bytes += pool->blocks.data[i]->size;
+      }
+    }
+  }
+  out->allocations = handle_pool_count(&g_allocations);
+  for (uint32_t i = 0; i < out->allocations; i++) {
+    const gpu_record_t *record = handle_pool_at(&g_allocations, i);
+    out->used_bytes += record->size;
+    if (!record->block) {
+      out->dedicated++;
+      out->dedicated_bytes += record->size;
+    }
+  }
+  out->heap_count = g_props.memoryHeapCount;
+  _heap_budget(out->heap_budget, out->heap_usage);
+  mtx_unlock(&g_memory_lock);
+}
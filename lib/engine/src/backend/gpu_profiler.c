@@ -0,0 +1,329 @@
+#include "engine/backend/gpu_profiler.h"
+#include "engine/backend/frame.h"
+#include "engine/backend/gpu.h"
+#include "engine/error.h"
+#include <core/profiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  uint32_t depth;
+  uint8_t closed;
+} gpu_scope_record_t;
+
+// Scope i owns queries 2i and 2i + 1.
+typedef struct {
+  VkQueryPool pool;
+  gpu_scope_record_t scopes[GPU_PROFILER_MAX_SCOPES];
+  uint32_t scope_count;
+} gpu_profiler_slot_t;
+
+static uint8_t g_enabled = 0;
+static gpu_profiler_slot_t g_slots[FRAME_MAX_IN_FLIGHT];
+static uint32_t g_slot_count = 0;
+static uint32_t g_current_slot = 0;
+static uint32_t g_open[GPU_PROFILER_MAX_DEPTH];
+static uint32_t g_open_count = 0;
+static uint32_t g_track = PROFILER_NO_TRACK;
+
+static double g_period_ns = 1.0;
+static uint64_t g_valid_mask = ~0ull;
+
+// A device tick and the profiler_now time it happened at.
+static uint64_t g_calibration_ticks = 0;
+static uint64_t g_calibration_ns = 0;
+static PFN_vkGetCalibratedTimestampsEXT g_get_calibrated_timestamps = 0;
+
+static gpu_profiler_scope_t g_results[GPU_PROFILER_MAX_SCOPES];
+static uint32_t g_result_count = 0;
+
+// CLOCK_MONOTONIC is the clock profiler_now reads on everything but Windows,
+// whose QPC domain is in raw counter ticks.
+static uint8_t _has_monotonic_domain() {
+#ifdef _WIN32
+  return 0;
+#else
+  PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT get_domains =
+      (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(
+          gpu_get_vk_instance(),
+          "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+  if (!get_domains) {
+    return 0;
+  }
+  uint32_t count = 0;
+  get_domains(gpu_get_vk_phy_device(), &count, 0);
+  VkTimeDomainEXT *domains = malloc(sizeof(VkTimeDomainEXT) * count);
+  get_domains(gpu_get_vk_phy_device(), &count, domains);
+  uint8_t device = 0;
+  uint8_t monotonic = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    device |= domains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+    monotonic |= domains[i] == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+  }
+  free(domains);
+  return device && monotonic;
+#endif
+}
+
+static uint8_t _calibrate_with_extension() {
+  VkCalibratedTimestampInfoEXT infos[2];
+  infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[0].pNext = 0;
+  infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+  infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[1].pNext = 0;
+  infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+  uint64_t timestamps[2];
+  uint64_t deviation;
+  if (g_get_calibrated_timestamps(gpu_get_vk_device(), 2, infos, timestamps,
+                                  &deviation) != VK_SUCCESS) {
+    return 0;
+  }
+  g_calibration_ticks = timestamps[0] & g_valid_mask;
+  g_calibration_ns = timestamps[1];
+  return 1;
+}
+
+// Without the extension: write one timestamp and take the middle of the
+// submit round trip as the time it was written. Off by at most half the
+// round trip, which is plenty to line passes up against CPU zones.
+static void _calibrate_with_submit(VkQueryPool pool) {
+  VkDevice device = gpu_get_vk_device();
+  VkCommandPoolCreateInfo pool_info;
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.pNext = 0;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = gpu_get_gfx_queue_family();
+  VkCommandPool cmd_pool;
+  if (vkCreateCommandPool(device, &pool_info, 0, &cmd_pool) != VK_SUCCESS) {
+    ptia_panic("Failed to create vk Command Pool");
+  }
+  VkCommandBufferAllocateInfo alloc_info;
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.pNext = 0;
+  alloc_info.commandPool = cmd_pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandBufferCount = 1;
+  VkCommandBuffer cmd;
+  if (vkAllocateCommandBuffers(device, &alloc_info, &cmd) != VK_SUCCESS) {
+    ptia_panic("Failed to allocate vk Command Buffer");
+  }
+  VkFenceCreateInfo fence_info;
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.pNext = 0;
+  fence_info.flags = 0;
+  VkFence fence;
+  if (vkCreateFence(device, &fence_info, 0, &fence) != VK_SUCCESS) {
+    ptia_panic("Failed to create vk Fence");
+  }
+
+  VkCommandBufferBeginInfo begin_info;
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.pNext = 0;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  begin_info.pInheritanceInfo = 0;
+  vkBeginCommandBuffer(cmd, &begin_info);
+  vkCmdResetQueryPool(cmd, pool, 0, 1);
+  vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, 0);
+  vkEndCommandBuffer(cmd);
+
+  VkSubmitInfo submit_info;
+  memset(&submit_info, 0, sizeof(submit_info));
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmd;
+  const uint64_t before = profiler_now();
+  if (vkQueueSubmit(gpu_get_gfx_queue(), 1, &submit_info, fence) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to submit timestamp calibration");
+  }
+  vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+  const uint64_t after = profiler_now();
+
+  uint64_t ticks = 0;
+  vkGetQueryPoolResults(device, pool, 0, 1, sizeof(ticks), &ticks,
+                        sizeof(ticks), VK_QUERY_RESULT_64_BIT);
+  g_calibration_ticks = ticks & g_valid_mask;
+  g_calibration_ns = before + (after - before) / 2;
+
+  vkDestroyFence(device, fence, 0);
+  vkDestroyCommandPool(device, cmd_pool, 0);
+}
+
+static uint64_t _to_profiler_ns(uint64_t ticks) {
+  const int64_t delta = (int64_t)(ticks - g_calibration_ticks);
+  return g_calibration_ns + (int64_t)((double)delta * g_period_ns);
+}
+
+void gpu_profiler_init(uint32_t frames_in_flight) {
+#ifndef PTIA_PROFILE
+  return;
+#endif
+  VkPhysicalDevice phy = gpu_get_vk_phy_device();
+  uint32_t family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(phy, &family_count, 0);
+  VkQueueFamilyProperties *families =
+      malloc(sizeof(VkQueueFamilyProperties) * family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(phy, &family_count, families);
+  const uint32_t valid_bits =
+      families[gpu_get_gfx_queue_family()].timestampValidBits;
+  free(families);
+  if (valid_bits == 0) {
+    printf("graphics queue has no timestamps, gpu profiling disabled\n");
+    return;
+  }
+  g_valid_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(phy, &props);
+  g_period_ns = props.limits.timestampPeriod;
+
+  g_slot_count = frames_in_flight;
+  VkQueryPoolCreateInfo pool_info;
+  pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  pool_info.pNext = 0;
+  pool_info.flags = 0;
+  pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  pool_info.queryCount = GPU_PROFILER_MAX_SCOPES * 2;
+  pool_info.pipelineStatistics = 0;
+  for (uint32_t i = 0; i < g_slot_count; i++) {
+    if (vkCreateQueryPool(gpu_get_vk_device(), &pool_info, 0,
+                          &g_slots[i].pool) != VK_SUCCESS) {
+      ptia_panic("Failed to create vk Query Pool");
+    }
+    g_slots[i].scope_count = 0;
+  }
+
+  if (gpu_has_calibrated_timestamps() && _has_monotonic_domain()) {
+    g_get_calibrated_timestamps =
+        (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(
+            gpu_get_vk_device(), "vkGetCalibratedTimestampsEXT");
+  }
+  if (!g_get_calibrated_timestamps || !_calibrate_with_extension()) {
+    g_get_calibrated_timestamps = 0;
+    _calibrate_with_submit(g_slots[0].pool);
+  }
+  g_track = profiler_track_create("GPU");
+  g_enabled = 1;
+}
+
+void gpu_profiler_shutdown() {
+  if (!g_enabled) {
+    return;
+  }
+  for (uint32_t i = 0; i < g_slot_count; i++) {
+    vkDestroyQueryPool(gpu_get_vk_device(), g_slots[i].pool, 0);
+  }
+  memset(g_slots, 0, sizeof(g_slots));
+  g_slot_count = 0;
+  g_open_count = 0;
+  g_result_count = 0;
+  g_get_calibrated_timestamps = 0;
+  g_track = PROFILER_NO_TRACK;
+  g_enabled = 0;
+}
+
+static void _resolve(gpu_profiler_slot_t *slot) {
+  if (slot->scope_count == 0) {
+    return;
+  }
+  // Value and availability per query. Scopes left open, or whose commands
+  // were never submitted, come back unavailable and are skipped rather than
+  // waited for.
+  uint64_t data[GPU_PROFILER_MAX_SCOPES * 2][2];
+  const uint32_t query_count = slot->scope_count * 2;
+  const VkResult res = vkGetQueryPoolResults(
+      gpu_get_vk_device(), slot->pool, 0, query_count,
+      sizeof(uint64_t) * 2 * query_count, data, sizeof(uint64_t) * 2,
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (res != VK_SUCCESS && res != VK_NOT_READY) {
+    return;
+  }
+
+  g_result_count = 0;
+  for (uint32_t i = 0; i < slot->scope_count; i++) {
+    const gpu_scope_record_t *scope = &slot->scopes[i];
+    const uint64_t *begin = data[i * 2];
+    const uint64_t *end = data[i * 2 + 1];
+    if (!scope->closed || !begin[1] || !end[1]) {
+      continue;
+    }
+    const uint64_t begin_ticks = begin[0] & g_valid_mask;
+    const uint64_t end_ticks = end[0] & g_valid_mask;
+    const uint64_t ticks = (end_ticks - begin_ticks) & g_valid_mask;
+
+    gpu_profiler_scope_t *result = &g_results[g_result_count++];
+    result->name = scope->name;
+    result->depth = scope->depth;
+    result->ms = (double)ticks * g_period_ns / 1e6;
+
+    const uint64_t start_ns = _to_profiler_ns(begin_ticks);
+    profiler_track_zone(g_track, scope->name, start_ns,
+                        start_ns + (uint64_t)((double)ticks * g_period_ns));
+  }
+}
+
+void gpu_profiler_begin_frame(uint32_t slot_index, VkCommandBuffer cmd) {
+  if (!g_enabled) {
+    return;
+  }
+  gpu_profiler_slot_t *slot = &g_slots[slot_index];
+  _resolve(slot);
+  // Device and CPU clocks drift apart, recalibrating is cheap when the
+  // driver can sample both at once.
+  if (g_get_calibrated_timestamps) {
+    _calibrate_with_extension();
+  }
+  vkCmdResetQueryPool(cmd, slot->pool, 0, GPU_PROFILER_MAX_SCOPES * 2);
+  slot->scope_count = 0;
+  g_current_slot = slot_index;
+  g_open_count = 0;
+}
+
+void gpu_profiler_begin(VkCommandBuffer cmd, const char *name) {
+  if (!g_enabled) {
+    return;
+  }
+  gpu_profiler_slot_t *slot = &g_slots[g_current_slot];
+  // Scopes that don't fit still take a place on the stack so ends pair up.
+  uint32_t index = ~0u;
+  if (slot->scope_count < GPU_PROFILER_MAX_SCOPES &&
+      g_open_count < GPU_PROFILER_MAX_DEPTH) {
+    index = slot->scope_count++;
+    gpu_scope_record_t *scope = &slot->scopes[index];
+    scope->name = name;
+    scope->depth = g_open_count;
+    scope->closed = 0;
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot->pool,
+                        index * 2);
+  }
+  if (g_open_count < GPU_PROFILER_MAX_DEPTH) {
+    g_open[g_open_count] = index;
+  }
+  g_open_count++;
+}
+
+void gpu_profiler_end(VkCommandBuffer cmd) {
+  if (!g_enabled || g_open_count == 0) {
+    return;
+  }
+  g_open_count--;
+  if (g_open_count >= GPU_PROFILER_MAX_DEPTH) {
+    return;
+  }
+  const uint32_t index = g_open[g_open_count];
+  if (index == ~0u) {
+    return;
+  }
+  gpu_profiler_slot_t *slot = &g_slots[g_current_slot];
+  vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot->pool,
+                      index * 2 + 1);
+  slot->scopes[index].closed = 1;
+}
+
+uint32_t gpu_profiler_results(const gpu_profiler_scope_t **out) {
+  *out = g_results;
+  return g_result_count;
+}
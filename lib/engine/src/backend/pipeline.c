@@ -1,10 +1,148 @@
 #include "engine/backend/pipeline.h"
+#include "engine/backend/bindless.h"
 #include "engine/backend/gpu.h"
+#include "engine/backend/pipeline_cache.h"
 #include "engine/backend/util.h"
 #include "engine/error.h"
+#include <core/arrays.h>
+#include <core/file.h>
+#include <core/hash.h>
+#include <core/hash_map.h>
+#include <core/profiler.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
 #include <vulkan/vulkan_core.h>
 
-VkShaderModule _create_shader_module(file_str_t code) {
+#define PIPELINE_HASH_SEED 0x70697065ull
+// Most pipelines a compiler thread hands to the driver in one call.
+#define PIPELINE_COMPILE_BATCH 8
+
+// Canonical, padding free form of a pipeline_desc_t. Unused array entries stay
+// zero so two descriptions that build the same pipeline compare equal byte
+// for byte. Shaders are keyed by a 64 bit hash of their path, not the path
+// itself.
+typedef struct {
+    uint64_t vertex_shader;
+    uint64_t fragment_shader;
+    uint32_t vertex_binding_count;
+    VkVertexInputBindingDescription vertex_bindings[PIPELINE_MAX_VERTEX_BINDINGS];
+    uint32_t vertex_attribute_count;
+    VkVertexInputAttributeDescription vertex_attributes[PIPELINE_MAX_VERTEX_ATTRIBUTES];
+    uint32_t topology;
+    uint32_t polygon_mode;
+    uint32_t cull_mode;
+    uint32_t front_face;
+    uint32_t depth_test;
+    uint32_t depth_write;
+    uint32_t depth_compare;
+    uint32_t color_target_count;
+    uint32_t color_formats[PIPELINE_MAX_COLOR_TARGETS];
+    uint32_t blend[PIPELINE_MAX_COLOR_TARGETS];
+    uint32_t depth_format;
+    uint32_t samples;
+} pipeline_key_t;
+
+// Render pass compatibility only looks at formats and sample counts, so one
+// pass per target layout is enough to build against.
+typedef struct {
+    uint32_t color_target_count;
+    uint32_t color_formats[PIPELINE_MAX_COLOR_TARGETS];
+    uint32_t depth_format;
+    uint32_t samples;
+} render_pass_key_t;
+
+typedef struct {
+    pipeline_key_t key;
+    pipeline_def_t def;
+    pipeline_status_t status;
+} pipeline_entry_t;
+
+// No fragment shader, for depth only pipelines.
+#define PIPELINE_NO_SHADER UINT32_MAX
+
+// A pipeline waiting to be compiled. Layout and render pass are resolved up
+// front; shaders are only interned by path, the compile loads them so file
+// reads and module creation stay off the requesting thread.
+typedef struct {
+    uint32_t index;
+    pipeline_key_t key;
+    uint32_t vert_shader;
+    uint32_t frag_shader;
+    VkPipelineLayout layout;
+    VkRenderPass render_pass;
+    double queued_ms;
+} pipeline_build_t;
+
+// Fixed function state a VkGraphicsPipelineCreateInfo points into.
+typedef struct {
+    VkPipelineShaderStageCreateInfo stages[2];
+    VkDynamicState dyn_states[2];
+    VkPipelineDynamicStateCreateInfo dyn_states_create_info;
+    VkPipelineVertexInputStateCreateInfo vtx_input_create_info;
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info;
+    VkPipelineViewportStateCreateInfo vport_create_info;
+    VkPipelineRasterizationStateCreateInfo rasterizer;
+    VkPipelineMultisampleStateCreateInfo multisample_create_info;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil;
+    VkPipelineColorBlendAttachmentState color_blend_attachments[PIPELINE_MAX_COLOR_TARGETS];
+    VkPipelineColorBlendStateCreateInfo color_blending;
+} pipeline_state_t;
+
+// module stays VK_NULL_HANDLE until a compile first needs it, or after the
+// file failed to load so the next attempt reads it again.
+typedef struct {
+    char *path;
+    VkShaderModule module;
+} shader_entry_t;
+
+typedef struct {
+    render_pass_key_t key;
+    VkRenderPass render_pass;
+} render_pass_entry_t;
+
+static ARRAY(pipeline_entry_t) g_pipelines = {0};
+static ARRAY(shader_entry_t) g_shaders = {0};
+static ARRAY(render_pass_entry_t) g_render_passes = {0};
+static hash_map_t g_pipeline_map = {0};
+static hash_map_t g_shader_map = {0};
+static pipeline_stats_t g_stats = {0};
+static pipeline_def_t g_fallback = {0};
+
+// One lock covers the tables, the queue and the stats. Compiler threads only
+// take it to pop work and to publish results, never across a driver call.
+static once_flag g_lock_once = ONCE_FLAG_INIT;
+static mtx_t g_pipeline_lock;
+static cnd_t g_compiler_wake;
+static cnd_t g_pipeline_done;
+static ARRAY(pipeline_build_t) g_queue = {0};
+static uint64_t g_queue_head = 0;
+static thrd_t *g_compilers = 0;
+static uint32_t g_compiler_count = 0;
+static uint8_t g_running = 0;
+// Shader modules dropped by failed builds. A compile running unlocked may
+// still hold one, so they are only destroyed once no compile is in flight.
+static ARRAY(VkShaderModule) g_retired_shaders = {0};
+static uint32_t g_compiles_in_flight = 0;
+
+static void _init_lock() {
+    mtx_init(&g_pipeline_lock, mtx_plain);
+    cnd_init(&g_compiler_wake);
+    cnd_init(&g_pipeline_done);
+}
+
+static void _lock() {
+    call_once(&g_lock_once, _init_lock);
+    mtx_lock(&g_pipeline_lock);
+}
+
+static double _now_ms() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1000000.0;
+}
+
+static VkShaderModule _create_shader_module(const char *path, file_buffer_t code) {
     VkShaderModuleCreateInfo create_info;
     create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     create_info.codeSize = code.size;
@@ -15,7 +153,8 @@ VkShaderModule _create_shader_module(file_str_t code) {
     VkShaderModule module;
     if (vkCreateShaderModule(gpu_get_vk_device(), &create_info, 0, &module) !=
         VK_SUCCESS) {
-        ptia_panic("Failed to create vk Shader Module");
+        fprintf(stderr, "%s: failed to create vk Shader Module\n", path);
+        return VK_NULL_HANDLE;
     }
     return module;
 }
@@ -34,193 +173,777 @@ _create_shader_stage(VkShaderStageFlagBits stage, VkShaderModule module,
     return create_info;
 }
 
-void _init_vk_graphics_pipeline(pipeline_def_t *def) {
-    file_str_t vert_shader_code = read_file("shaders/vert.spv");
-    file_str_t frag_shader_code = read_file("shaders/frag.spv");
+void pipeline_desc_init(pipeline_desc_t *desc) {
+    memset(desc, 0, sizeof(pipeline_desc_t));
+    desc->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc->polygon_mode = VK_POLYGON_MODE_FILL;
+    desc->cull_mode = VK_CULL_MODE_BACK_BIT;
+    desc->front_face = VK_FRONT_FACE_CLOCKWISE;
+    desc->depth_compare = VK_COMPARE_OP_LESS_OR_EQUAL;
+    desc->color_target_count = 1;
+    desc->color_formats[0] = gpu_get_swapchain_format();
+    desc->blend[0] = PIPELINE_BLEND_ALPHA;
+    desc->depth_format = VK_FORMAT_UNDEFINED;
+    desc->samples = VK_SAMPLE_COUNT_1_BIT;
+}
 
-    VkShaderModule vert_shader = _create_shader_module(vert_shader_code);
-    VkShaderModule frag_shader = _create_shader_module(frag_shader_code);
+static uint64_t _hash_path(const char *path) {
+    return path ? hash_bytes(path, strlen(path), PIPELINE_HASH_SEED) : 0;
+}
 
-    def->shaders = malloc(sizeof(VkShaderModule) * 2);
-    def->shader_count = 2;
-    def->shaders[0] = vert_shader;
-    def->shaders[1] = frag_shader;
+static void _build_key(const pipeline_desc_t *desc, pipeline_key_t *key) {
+    if (!desc->vertex_shader) {
+        ptia_panic("Pipeline description without a vertex shader");
+    }
+    if (desc->vertex_binding_count > PIPELINE_MAX_VERTEX_BINDINGS ||
+        desc->vertex_attribute_count > PIPELINE_MAX_VERTEX_ATTRIBUTES ||
+        desc->color_target_count > PIPELINE_MAX_COLOR_TARGETS) {
+        ptia_panic("Pipeline description exceeds its fixed limits");
+    }
+    // A layout with a larger range would not be compatible with the bindless
+    // one for set 0, which frame_begin and record bind once per command
+    // buffer and never again after a pipeline switch.
+    if (desc->push_constant_size > BINDLESS_PUSH_CONSTANT_SIZE) {
+        ptia_panic("Pipeline push constants exceed BINDLESS_PUSH_CONSTANT_SIZE");
+    }
+    memset(key, 0, sizeof(pipeline_key_t));
+    key->vertex_shader = _hash_path(desc->vertex_shader);
+    key->fragment_shader = _hash_path(desc->fragment_shader);
+    key->vertex_binding_count = desc->vertex_binding_count;
+    memcpy(key->vertex_bindings, desc->vertex_bindings,
+           sizeof(VkVertexInputBindingDescription) * desc->vertex_binding_count);
+    key->vertex_attribute_count = desc->vertex_attribute_count;
+    memcpy(key->vertex_attributes, desc->vertex_attributes,
+           sizeof(VkVertexInputAttributeDescription) * desc->vertex_attribute_count);
+    key->topology = desc->topology;
+    key->polygon_mode = desc->polygon_mode;
+    key->cull_mode = desc->cull_mode;
+    key->front_face = desc->front_face;
+    // Fields that cannot affect the result are left at zero, otherwise
+    // leftovers in an unused compare op would split identical pipelines.
+    key->depth_test = desc->depth_test != 0;
+    key->depth_write = desc->depth_write != 0;
+    key->depth_compare = desc->depth_test ? desc->depth_compare : 0;
+    key->color_target_count = desc->color_target_count;
+    for (uint32_t i = 0; i < desc->color_target_count; i++) {
+        key->color_formats[i] = desc->color_formats[i];
+        key->blend[i] = desc->blend[i];
+    }
+    key->depth_format = desc->depth_format;
+    key->samples = desc->samples;
+}
 
-    VkPipelineShaderStageCreateInfo stages[] = {
-        _create_shader_stage(VK_SHADER_STAGE_VERTEX_BIT, vert_shader,
-                             "main"),
-        _create_shader_stage(VK_SHADER_STAGE_FRAGMENT_BIT, frag_shader,
-                             "main")
-    };
+uint64_t pipeline_desc_hash(const pipeline_desc_t *desc) {
+    pipeline_key_t key;
+    _build_key(desc, &key);
+    return hash_bytes(&key, sizeof(key), PIPELINE_HASH_SEED);
+}
 
-    VkDynamicState dyn_states[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
-    };
+// Called with the lock held. Only records the path, nothing is read yet.
+static uint32_t _intern_shader(const char *path) {
+    uint64_t probe = _hash_path(path);
+    for (;;) {
+        const uint32_t index = hash_map_get(&g_shader_map, probe);
+        if (index == HASH_MAP_EMPTY) {
+            break;
+        }
+        if (strcmp(g_shaders.data[index].path, path) == 0) {
+            return index;
+        }
+        probe = hash_combine(probe, 1);
+    }
 
-    VkPipelineDynamicStateCreateInfo dyn_states_create_info;
-    dyn_states_create_info.sType =
-            VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dyn_states_create_info.dynamicStateCount = 2;
-    dyn_states_create_info.pDynamicStates = dyn_states;
-    dyn_states_create_info.pNext = 0;
-    dyn_states_create_info.flags = 0;
+    shader_entry_t entry;
+    entry.module = VK_NULL_HANDLE;
+    const size_t length = strlen(path) + 1;
+    entry.path = memory_alloc(length, MEMORY_TAG_RENDERER);
+    memcpy(entry.path, path, length);
 
+    const uint32_t index = (uint32_t) g_shaders.count;
+    hash_map_set(&g_shader_map, probe, index);
+    array_push(&g_shaders, entry);
+    return index;
+}
 
-    VkPipelineVertexInputStateCreateInfo vtx_input_create_info;
-    vtx_input_create_info.sType =
+// Called without the lock. Loads the module on first use and again after a
+// failed build dropped it; when two compiles race on the same shader the
+// loser's module is dropped. Returns
+// VK_NULL_HANDLE if the file cannot be read or the driver rejects it.
+static VkShaderModule _shader_module(uint32_t index) {
+    mtx_lock(&g_pipeline_lock);
+    VkShaderModule module = g_shaders.data[index].module;
+    // The path string is never moved or freed before shutdown.
+    const char *path = g_shaders.data[index].path;
+    mtx_unlock(&g_pipeline_lock);
+    if (module != VK_NULL_HANDLE) {
+        return module;
+    }
+
+    PROFILE_BEGIN("load shader module");
+    file_buffer_t code;
+    const file_result_t result = file_read_all(path, &code);
+    if (result != FILE_OK) {
+        fprintf(stderr, "%s: %s\n", path, file_result_str(result));
+        PROFILE_END();
+        return VK_NULL_HANDLE;
+    }
+    module = _create_shader_module(path, code);
+    file_buffer_free(&code);
+    PROFILE_END();
+    if (module == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+
+    mtx_lock(&g_pipeline_lock);
+    shader_entry_t *entry = &g_shaders.data[index];
+    if (entry->module == VK_NULL_HANDLE) {
+        entry->module = module;
+    } else {
+        vkDestroyShaderModule(gpu_get_vk_device(), module, 0);
+        module = entry->module;
+    }
+    mtx_unlock(&g_pipeline_lock);
+    return module;
+}
+
+static VkRenderPass _get_render_pass(const pipeline_key_t *pipeline_key) {
+    render_pass_key_t key;
+    memset(&key, 0, sizeof(key));
+    key.color_target_count = pipeline_key->color_target_count;
+    memcpy(key.color_formats, pipeline_key->color_formats, sizeof(key.color_formats));
+    key.depth_format = pipeline_key->depth_format;
+    key.samples = pipeline_key->samples;
+
+    for (uint64_t i = 0; i < g_render_passes.count; i++) {
+        if (memcmp(&g_render_passes.data[i].key, &key, sizeof(key)) == 0) {
+            return g_render_passes.data[i].render_pass;
+        }
+    }
+
+    VkAttachmentDescription attachments[PIPELINE_MAX_COLOR_TARGETS + 1];
+    VkAttachmentReference color_refs[PIPELINE_MAX_COLOR_TARGETS];
+    VkAttachmentReference depth_ref;
+    uint32_t attachment_count = 0;
+
+    for (uint32_t i = 0; i <= key.color_target_count; i++) {
+        const uint8_t is_depth = i == key.color_target_count;
+        if (is_depth && key.depth_format == VK_FORMAT_UNDEFINED) {
+            break;
+        }
+        const VkImageLayout layout = is_depth
+                                         ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                         : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkAttachmentDescription *attachment = &attachments[attachment_count];
+        attachment->flags = 0;
+        attachment->format = is_depth ? key.depth_format : key.color_formats[i];
+        attachment->samples = key.samples;
+        attachment->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment->storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment->initialLayout = layout;
+        attachment->finalLayout = layout;
+
+        VkAttachmentReference *ref = is_depth ? &depth_ref : &color_refs[i];
+        ref->attachment = attachment_count;
+        ref->layout = layout;
+        attachment_count++;
+    }
+
+    VkSubpassDescription subpass;
+    subpass.flags = 0;
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.inputAttachmentCount = 0;
+    subpass.pInputAttachments = 0;
+    subpass.colorAttachmentCount = key.color_target_count;
+    subpass.pColorAttachments = color_refs;
+    subpass.pResolveAttachments = 0;
+    subpass.pDepthStencilAttachment =
+            key.depth_format != VK_FORMAT_UNDEFINED ? &depth_ref : 0;
+    subpass.preserveAttachmentCount = 0;
+    subpass.pPreserveAttachments = 0;
+
+    VkRenderPassCreateInfo create_info;
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.pNext = 0;
+    create_info.flags = 0;
+    create_info.attachmentCount = attachment_count;
+    create_info.pAttachments = attachments;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+    create_info.dependencyCount = 0;
+    create_info.pDependencies = 0;
+
+    render_pass_entry_t entry;
+    entry.key = key;
+    if (vkCreateRenderPass(gpu_get_vk_device(), &create_info, 0, &entry.render_pass) !=
+        VK_SUCCESS) {
+        ptia_panic("Failed to create compatible Render Pass");
+    }
+    array_push(&g_render_passes, entry);
+    return entry.render_pass;
+}
+
+static VkPipelineColorBlendAttachmentState _blend_attachment(pipeline_blend_t blend) {
+    VkPipelineColorBlendAttachmentState state;
+    state.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    state.blendEnable = blend != PIPELINE_BLEND_NONE;
+    state.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    state.colorBlendOp = VK_BLEND_OP_ADD;
+    state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    state.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    switch (blend) {
+        case PIPELINE_BLEND_NONE:
+            break;
+        case PIPELINE_BLEND_ALPHA:
+            state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+        case PIPELINE_BLEND_ADDITIVE:
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            break;
+        case PIPELINE_BLEND_PREMULTIPLIED:
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+    }
+    return state;
+}
+
+static void _prepare_build(const pipeline_desc_t *desc, const pipeline_key_t *key,
+                           pipeline_build_t *build) {
+    build->key = *key;
+    build->vert_shader = _intern_shader(desc->vertex_shader);
+    build->frag_shader =
+            desc->fragment_shader ? _intern_shader(desc->fragment_shader) : PIPELINE_NO_SHADER;
+    build->layout = bindless_get_pipeline_layout();
+    build->render_pass = _get_render_pass(key);
+    build->queued_ms = _now_ms();
+}
+
+// Fills out everything vkCreateGraphicsPipelines reads. The create info points
+// into both build and state, so neither may move before the call.
+static void _fill_create_info(const pipeline_build_t *build, VkShaderModule vert_shader,
+                              VkShaderModule frag_shader, pipeline_state_t *state,
+                              VkGraphicsPipelineCreateInfo *pipeline_create_info) {
+    const pipeline_key_t *key = &build->key;
+
+    uint32_t stage_count = 0;
+    state->stages[stage_count++] = _create_shader_stage(VK_SHADER_STAGE_VERTEX_BIT,
+                                                        vert_shader, "main");
+    if (frag_shader != VK_NULL_HANDLE) {
+        state->stages[stage_count++] = _create_shader_stage(VK_SHADER_STAGE_FRAGMENT_BIT,
+                                                            frag_shader, "main");
+    }
+
+    state->dyn_states[0] = VK_DYNAMIC_STATE_VIEWPORT;
+    state->dyn_states[1] = VK_DYNAMIC_STATE_SCISSOR;
+
+    VkPipelineDynamicStateCreateInfo *dyn_states_create_info = &state->dyn_states_create_info;
+    dyn_states_create_info->sType =
+            VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyn_states_create_info->dynamicStateCount = 2;
+    dyn_states_create_info->pDynamicStates = state->dyn_states;
+    dyn_states_create_info->pNext = 0;
+    dyn_states_create_info->flags = 0;
+
+    VkPipelineVertexInputStateCreateInfo *vtx_input_create_info = &state->vtx_input_create_info;
+    vtx_input_create_info->sType =
             VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vtx_input_create_info.vertexBindingDescriptionCount = 0;
-    vtx_input_create_info.pVertexBindingDescriptions = 0;
-    vtx_input_create_info.vertexAttributeDescriptionCount = 0;
-    vtx_input_create_info.pVertexAttributeDescriptions = 0;
-    vtx_input_create_info.pNext = 0;
-    vtx_input_create_info.flags = 0;
+    vtx_input_create_info->vertexBindingDescriptionCount = key->vertex_binding_count;
+    vtx_input_create_info->pVertexBindingDescriptions = key->vertex_bindings;
+    vtx_input_create_info->vertexAttributeDescriptionCount = key->vertex_attribute_count;
+    vtx_input_create_info->pVertexAttributeDescriptions = key->vertex_attributes;
+    vtx_input_create_info->pNext = 0;
+    vtx_input_create_info->flags = 0;
 
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info;
-    input_assembly_create_info.sType =
+    VkPipelineInputAssemblyStateCreateInfo *input_assembly_create_info =
+            &state->input_assembly_create_info;
+    input_assembly_create_info->sType =
             VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly_create_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    input_assembly_create_info.primitiveRestartEnable = VK_FALSE;
-    input_assembly_create_info.pNext = 0;
-    input_assembly_create_info.flags = 0;
-
-    VkExtent2D swapchain_extent = gpu_get_swapchain_extent();
-
-    VkViewport viewport;
-    viewport.x = 0.f;
-    viewport.y = 0.f;
-    viewport.width = swapchain_extent.width;
-    viewport.height = swapchain_extent.height;
-    viewport.minDepth = 0.f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor;
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent = swapchain_extent;
+    input_assembly_create_info->topology = key->topology;
+    input_assembly_create_info->primitiveRestartEnable = VK_FALSE;
+    input_assembly_create_info->pNext = 0;
+    input_assembly_create_info->flags = 0;
 
-    VkPipelineViewportStateCreateInfo vport_create_info;
-    vport_create_info.sType =
+    // Viewport and scissor are dynamic, only the counts matter here.
+    VkPipelineViewportStateCreateInfo *vport_create_info = &state->vport_create_info;
+    vport_create_info->sType =
             VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    vport_create_info.viewportCount = 1;
-    vport_create_info.scissorCount = 1;
-    vport_create_info.pScissors = &scissor;
-    vport_create_info.pViewports = &viewport;
-    vport_create_info.pNext = 0;
-    vport_create_info.flags = 0;
+    vport_create_info->viewportCount = 1;
+    vport_create_info->scissorCount = 1;
+    vport_create_info->pScissors = 0;
+    vport_create_info->pViewports = 0;
+    vport_create_info->pNext = 0;
+    vport_create_info->flags = 0;
 
-    VkPipelineRasterizationStateCreateInfo rasterizer;
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    rasterizer.depthBiasConstantFactor = 0.f;
-    rasterizer.depthBiasClamp = 0.f;
-    rasterizer.depthBiasSlopeFactor = 0.f;
-    rasterizer.pNext = 0;
-    rasterizer.flags = 0;
+    VkPipelineRasterizationStateCreateInfo *rasterizer = &state->rasterizer;
+    rasterizer->sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer->depthClampEnable = VK_FALSE;
+    rasterizer->rasterizerDiscardEnable = VK_FALSE;
+    rasterizer->polygonMode = key->polygon_mode;
+    rasterizer->lineWidth = 1.0f;
+    rasterizer->cullMode = key->cull_mode;
+    rasterizer->frontFace = key->front_face;
+    rasterizer->depthBiasEnable = VK_FALSE;
+    rasterizer->depthBiasConstantFactor = 0.f;
+    rasterizer->depthBiasClamp = 0.f;
+    rasterizer->depthBiasSlopeFactor = 0.f;
+    rasterizer->pNext = 0;
+    rasterizer->flags = 0;
 
-    VkPipelineMultisampleStateCreateInfo multisample_create_info;
-    multisample_create_info.sType =
+    VkPipelineMultisampleStateCreateInfo *multisample_create_info =
+            &state->multisample_create_info;
+    multisample_create_info->sType =
             VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisample_create_info.sampleShadingEnable = VK_FALSE;
-    multisample_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisample_create_info.minSampleShading = 1.0f;
-    multisample_create_info.pSampleMask = 0;
-    multisample_create_info.alphaToCoverageEnable = VK_FALSE;
-    multisample_create_info.alphaToOneEnable = VK_FALSE;
-    multisample_create_info.pNext = 0;
-    multisample_create_info.flags = 0;
-
-    VkPipelineColorBlendAttachmentState color_blend_attachment;
-    color_blend_attachment.colorWriteMask =
-            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment.blendEnable = VK_TRUE;
-    color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    color_blend_attachment.dstColorBlendFactor =
-            VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
-    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    multisample_create_info->sampleShadingEnable = VK_FALSE;
+    multisample_create_info->rasterizationSamples = key->samples;
+    multisample_create_info->minSampleShading = 1.0f;
+    multisample_create_info->pSampleMask = 0;
+    multisample_create_info->alphaToCoverageEnable = VK_FALSE;
+    multisample_create_info->alphaToOneEnable = VK_FALSE;
+    multisample_create_info->pNext = 0;
+    multisample_create_info->flags = 0;
 
-    VkPipelineColorBlendStateCreateInfo color_blending;
-    color_blending.sType =
+    VkPipelineDepthStencilStateCreateInfo *depth_stencil = &state->depth_stencil;
+    memset(depth_stencil, 0, sizeof(VkPipelineDepthStencilStateCreateInfo));
+    depth_stencil->sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil->depthTestEnable = key->depth_test;
+    depth_stencil->depthWriteEnable = key->depth_write;
+    depth_stencil->depthCompareOp = key->depth_test ? key->depth_compare : VK_COMPARE_OP_ALWAYS;
+    depth_stencil->depthBoundsTestEnable = VK_FALSE;
+    depth_stencil->stencilTestEnable = VK_FALSE;
+    depth_stencil->minDepthBounds = 0.f;
+    depth_stencil->maxDepthBounds = 1.f;
+
+    for (uint32_t i = 0; i < key->color_target_count; i++) {
+        state->color_blend_attachments[i] = _blend_attachment(key->blend[i]);
+    }
+
+    VkPipelineColorBlendStateCreateInfo *color_blending = &state->color_blending;
+    color_blending->sType =
             VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    color_blending.logicOpEnable = VK_FALSE;
-    color_blending.logicOp = VK_LOGIC_OP_COPY;
-    color_blending.attachmentCount = 1;
-    color_blending.pAttachments = &color_blend_attachment;
-    color_blending.blendConstants[0] = 0.0f;
-    color_blending.blendConstants[1] = 0.0f;
-    color_blending.blendConstants[2] = 0.0f;
-    color_blending.blendConstants[3] = 0.0f;
-    color_blending.flags = 0;
-    color_blending.pNext = 0;
-
-    VkPipelineLayoutCreateInfo pipeline_layout_create_info;
-    pipeline_layout_create_info.sType =
-            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_create_info.setLayoutCount = 0;
-    pipeline_layout_create_info.pSetLayouts = 0;
-    pipeline_layout_create_info.pPushConstantRanges = 0;
-    pipeline_layout_create_info.pushConstantRangeCount = 0;
-    pipeline_layout_create_info.flags = 0;
-    pipeline_layout_create_info.pNext = 0;
-
-    if (vkCreatePipelineLayout(gpu_get_vk_device(), &pipeline_layout_create_info, 0,
-                               &def->layout) != VK_SUCCESS) {
-        ptia_panic("Failed to create vk Pipeline Layout");
-    }
-    VkGraphicsPipelineCreateInfo pipeline_create_info;
-    pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_create_info.pNext = 0;
-    pipeline_create_info.flags = 0;
-    pipeline_create_info.stageCount = 2;
-    pipeline_create_info.pStages = stages;
-    pipeline_create_info.pVertexInputState = &vtx_input_create_info;
-    pipeline_create_info.pInputAssemblyState = &input_assembly_create_info;
-    pipeline_create_info.pViewportState = &vport_create_info;
-    pipeline_create_info.pRasterizationState = &rasterizer;
-    pipeline_create_info.pMultisampleState = &multisample_create_info;
-    pipeline_create_info.pDepthStencilState = 0;
-    pipeline_create_info.pColorBlendState = &color_blending;
-    pipeline_create_info.pDynamicState = &dyn_states_create_info;
-    pipeline_create_info.layout = def->layout;
-    pipeline_create_info.renderPass = gpu_get_render_pass();
-    pipeline_create_info.subpass = 0;
-    pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
-    pipeline_create_info.basePipelineIndex = -1;
-    pipeline_create_info.pTessellationState = 0;
-
-    if (vkCreateGraphicsPipelines(gpu_get_vk_device(), VK_NULL_HANDLE, 1,
-                                  &pipeline_create_info, 0,
-                                  &def->pipeline) != VK_SUCCESS) {
-        ptia_panic("Failed to create graphics pipeline");
+    color_blending->logicOpEnable = VK_FALSE;
+    color_blending->logicOp = VK_LOGIC_OP_COPY;
+    color_blending->attachmentCount = key->color_target_count;
+    color_blending->pAttachments = state->color_blend_attachments;
+    color_blending->blendConstants[0] = 0.0f;
+    color_blending->blendConstants[1] = 0.0f;
+    color_blending->blendConstants[2] = 0.0f;
+    color_blending->blendConstants[3] = 0.0f;
+    color_blending->flags = 0;
+    color_blending->pNext = 0;
+
+    pipeline_create_info->sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_create_info->pNext = 0;
+    pipeline_create_info->flags = 0;
+    pipeline_create_info->stageCount = stage_count;
+    pipeline_create_info->pStages = state->stages;
+    pipeline_create_info->pVertexInputState = vtx_input_create_info;
+    pipeline_create_info->pInputAssemblyState = input_assembly_create_info;
+    pipeline_create_info->pViewportState = vport_create_info;
+    pipeline_create_info->pRasterizationState = rasterizer;
+    pipeline_create_info->pMultisampleState = multisample_create_info;
+    pipeline_create_info->pDepthStencilState =
+            key->depth_format != VK_FORMAT_UNDEFINED ? depth_stencil : 0;
+    pipeline_create_info->pColorBlendState = color_blending;
+    pipeline_create_info->pDynamicState = dyn_states_create_info;
+    pipeline_create_info->layout = build->layout;
+    pipeline_create_info->renderPass = build->render_pass;
+    pipeline_create_info->subpass = 0;
+    pipeline_create_info->basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_create_info->basePipelineIndex = -1;
+    pipeline_create_info->pTessellationState = 0;
+}
+
+// One driver call for the whole batch, all sharing the persistent cache.
+// Called without the lock. Pipelines that failed, including those whose
+// shaders did not load, come back as VK_NULL_HANDLE, the rest are usable.
+static void _compile(const pipeline_build_t *builds, uint32_t count, VkPipeline *out) {
+    pipeline_state_t states[PIPELINE_COMPILE_BATCH];
+    VkGraphicsPipelineCreateInfo create_infos[PIPELINE_COMPILE_BATCH];
+    VkPipeline created[PIPELINE_COMPILE_BATCH];
+    uint32_t targets[PIPELINE_COMPILE_BATCH];
+    uint32_t create_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = VK_NULL_HANDLE;
+        const pipeline_build_t *build = &builds[i];
+        const VkShaderModule vert_shader = _shader_module(build->vert_shader);
+        const VkShaderModule frag_shader = build->frag_shader != PIPELINE_NO_SHADER
+                                                   ? _shader_module(build->frag_shader)
+                                                   : VK_NULL_HANDLE;
+        if (vert_shader == VK_NULL_HANDLE ||
+            (build->frag_shader != PIPELINE_NO_SHADER && frag_shader == VK_NULL_HANDLE)) {
+            continue;
+        }
+        _fill_create_info(build, vert_shader, frag_shader, &states[create_count],
+                          &create_infos[create_count]);
+        created[create_count] = VK_NULL_HANDLE;
+        targets[create_count++] = i;
+    }
+    if (create_count == 0) {
+        return;
+    }
+    PROFILE_BEGIN("vkCreateGraphicsPipelines");
+    vkCreateGraphicsPipelines(gpu_get_vk_device(), pipeline_cache_get(), create_count,
+                              create_infos, 0, created);
+    PROFILE_END();
+    for (uint32_t i = 0; i < create_count; i++) {
+        out[targets[i]] = created[i];
     }
 }
 
-void create_command_pool() {
+// Called with the lock held. Detaches the shader's module so the next use
+// reads the file again.
+static void _retire_shader(uint32_t index) {
+    shader_entry_t *entry = &g_shaders.data[index];
+    if (entry->module != VK_NULL_HANDLE) {
+        array_push(&g_retired_shaders, entry->module);
+        entry->module = VK_NULL_HANDLE;
+    }
 }
 
-pipeline_def_t create_graphics_pipeline() {
-    pipeline_def_t def;
-    _init_vk_graphics_pipeline(&def);
-    return def;
+// Called with the lock held before dropping it for a compile.
+static void _begin_compile() {
+    g_compiles_in_flight++;
 }
 
-void destroy_graphics_pipeline(pipeline_def_t *def) {
+// Called with the lock held after the compile's results are published.
+static void _end_compile() {
+    g_compiles_in_flight--;
+    if (g_compiles_in_flight > 0) {
+        return;
+    }
     VkDevice device = gpu_get_vk_device();
+    for (uint64_t i = 0; i < g_retired_shaders.count; i++) {
+        vkDestroyShaderModule(device, g_retired_shaders.data[i], 0);
+    }
+    array_clear(&g_retired_shaders);
+}
+
+// Called with the lock held once a build has been through the driver.
+static void _complete(const pipeline_build_t *build, VkPipeline pipeline, double start_ms,
+                      double compile_ms) {
+    pipeline_entry_t *entry = &g_pipelines.data[build->index];
+    entry->def.pipeline = pipeline;
+    entry->status = pipeline != VK_NULL_HANDLE ? PIPELINE_STATUS_READY : PIPELINE_STATUS_FAILED;
+    if (pipeline == VK_NULL_HANDLE) {
+        // A retry has to see the shaders as they are on disk by then, not
+        // the modules that just failed.
+        _retire_shader(build->vert_shader);
+        if (build->frag_shader != PIPELINE_NO_SHADER) {
+            _retire_shader(build->frag_shader);
+        }
+    }
+
+    const double queued_ms = start_ms - build->queued_ms;
+    if (pipeline != VK_NULL_HANDLE) {
+        g_stats.compiled++;
+    } else {
+        g_stats.failed++;
+    }
+    g_stats.compile_ms_total += compile_ms;
+    if (compile_ms > g_stats.compile_ms_max) {
+        g_stats.compile_ms_max = compile_ms;
+    }
+    if (queued_ms > g_stats.queued_ms_max) {
+        g_stats.queued_ms_max = queued_ms;
+    }
+}
+
+static int _compiler(void *arg) {
+    pipeline_build_t batch[PIPELINE_COMPILE_BATCH];
+    VkPipeline pipelines[PIPELINE_COMPILE_BATCH];
+
+    mtx_lock(&g_pipeline_lock);
+    for (;;) {
+        while (g_running && g_queue_head == g_queue.count) {
+            cnd_wait(&g_compiler_wake, &g_pipeline_lock);
+        }
+        if (!g_running) {
+            break;
+        }
+        uint32_t count = 0;
+        while (count < PIPELINE_COMPILE_BATCH && g_queue_head < g_queue.count) {
+            batch[count++] = g_queue.data[g_queue_head++];
+        }
+        if (g_queue_head == g_queue.count) {
+            array_clear(&g_queue);
+            g_queue_head = 0;
+        }
+        g_stats.compiling += count;
+        _begin_compile();
+        mtx_unlock(&g_pipeline_lock);
+
+        const double start_ms = _now_ms();
+        _compile(batch, count, pipelines);
+        // The driver does not report per pipeline times for a batch, so the
+        // cost is split evenly.
+        const double compile_ms = (_now_ms() - start_ms) / count;
+
+        mtx_lock(&g_pipeline_lock);
+        for (uint32_t i = 0; i < count; i++) {
+            _complete(&batch[i], pipelines[i], start_ms, compile_ms);
+        }
+        g_stats.compiling -= count;
+        _end_compile();
+        cnd_broadcast(&g_pipeline_done);
+    }
+    mtx_unlock(&g_pipeline_lock);
+    return 0;
+}
+
+void pipeline_compiler_init(uint32_t thread_count) {
+    _lock();
+    if (g_running) {
+        mtx_unlock(&g_pipeline_lock);
+        return;
+    }
+    g_running = 1;
+    g_compiler_count = thread_count ? thread_count : 1;
+    g_compilers = malloc(sizeof(thrd_t) * g_compiler_count);
+    for (uint32_t i = 0; i < g_compiler_count; i++) {
+        if (thrd_create(&g_compilers[i], _compiler, 0) != thrd_success) {
+            ptia_panic("Failed to start pipeline compiler thread");
+        }
+    }
+    mtx_unlock(&g_pipeline_lock);
+}
+
+void pipeline_compiler_shutdown() {
+    _lock();
+    if (!g_running) {
+        mtx_unlock(&g_pipeline_lock);
+        return;
+    }
+    g_running = 0;
+    cnd_broadcast(&g_compiler_wake);
+    mtx_unlock(&g_pipeline_lock);
+
+    for (uint32_t i = 0; i < g_compiler_count; i++) {
+        thrd_join(g_compilers[i], 0);
+    }
+    free(g_compilers);
+    g_compilers = 0;
+    g_compiler_count = 0;
+
+    // Whatever never reached a compiler is failed, so nobody waits on it.
+    mtx_lock(&g_pipeline_lock);
+    for (uint64_t i = g_queue_head; i < g_queue.count; i++) {
+        g_pipelines.data[g_queue.data[i].index].status = PIPELINE_STATUS_FAILED;
+        g_stats.failed++;
+    }
+    array_clear(&g_queue);
+    g_queue_head = 0;
+    cnd_broadcast(&g_pipeline_done);
+    mtx_unlock(&g_pipeline_lock);
+}
+
+static uint32_t _find(const pipeline_key_t *key, uint64_t *probe) {
+    // Keys are compared in full, so a collision of the whole key hash just
+    // moves on to the next probe. Shader paths only take part through their
+    // hashes: two paths colliding there would share a pipeline, which at 64
+    // bits is not guarded against.
+    for (;;) {
+        const uint32_t index = hash_map_get(&g_pipeline_map, *probe);
+        if (index == HASH_MAP_EMPTY ||
+            memcmp(&g_pipelines.data[index].key, key, sizeof(pipeline_key_t)) == 0) {
+            return index;
+        }
+        *probe = hash_combine(*probe, 1);
+    }
+}
+
+// Looks the description up and, on a miss, registers a pending entry and
+// resolves its shared state into build. Called with the lock held.
+static uint32_t _lookup_or_insert(const pipeline_desc_t *desc, pipeline_build_t *build,
+                                  uint8_t *out_inserted) {
+    pipeline_key_t key;
+    _build_key(desc, &key);
+    const uint64_t hash = hash_bytes(&key, sizeof(key), PIPELINE_HASH_SEED);
+    uint64_t probe = hash;
+    const uint32_t index = _find(&key, &probe);
+    if (index != HASH_MAP_EMPTY && g_pipelines.data[index].status != PIPELINE_STATUS_FAILED) {
+        g_stats.hits++;
+        *out_inserted = 0;
+        return index;
+    }
+    g_stats.misses++;
+    *out_inserted = 1;
+
+    if (index != HASH_MAP_EMPTY) {
+        // Failed builds are tried again, a shader may have been fixed on disk
+        // since; the failure dropped its modules so they are read afresh. The
+        // entry keeps its id.
+        _prepare_build(desc, &key, build);
+        build->index = index;
+        g_pipelines.data[index].status = PIPELINE_STATUS_PENDING;
+        return index;
+    }
+
+    _prepare_build(desc, &key, build);
+    build->index = (uint32_t) g_pipelines.count;
+
+    pipeline_entry_t entry;
+    entry.key = key;
+    entry.def.layout = build->layout;
+    entry.def.pipeline = VK_NULL_HANDLE;
+    entry.def.hash = hash;
+    entry.status = PIPELINE_STATUS_PENDING;
+    hash_map_set(&g_pipeline_map, probe, build->index);
+    array_push(&g_pipelines, entry);
+    return build->index;
+}
+
+// Compiles on the calling thread, dropping the lock around the driver call.
+static void _compile_now(const pipeline_build_t *build) {
+    VkPipeline pipeline;
+    _begin_compile();
+    mtx_unlock(&g_pipeline_lock);
+    const double start_ms = _now_ms();
+    _compile(build, 1, &pipeline);
+    const double compile_ms = _now_ms() - start_ms;
+    mtx_lock(&g_pipeline_lock);
+    _complete(build, pipeline, start_ms, compile_ms);
+    _end_compile();
+    cnd_broadcast(&g_pipeline_done);
+}
+
+pipeline_def_t create_graphics_pipeline(const pipeline_desc_t *desc) {
+    PROFILE_FUNCTION_BEGIN();
+    pipeline_build_t build;
+    uint8_t inserted;
 
+    _lock();
+    const uint32_t index = _lookup_or_insert(desc, &build, &inserted);
+    if (inserted) {
+        _compile_now(&build);
+    }
+    while (g_pipelines.data[index].status == PIPELINE_STATUS_PENDING) {
+        cnd_wait(&g_pipeline_done, &g_pipeline_lock);
+    }
+    const pipeline_entry_t entry = g_pipelines.data[index];
+    mtx_unlock(&g_pipeline_lock);
+
+    if (entry.status != PIPELINE_STATUS_READY) {
+        ptia_panic("Failed to create graphics pipeline");
+    }
+    PROFILE_END();
+    return entry.def;
+}
+
+uint32_t request_graphics_pipeline(const pipeline_desc_t *desc) {
+    pipeline_build_t build;
+    uint8_t inserted;
+
+    _lock();
+    const uint32_t index = _lookup_or_insert(desc, &build, &inserted);
+    if (inserted) {
+        if (g_running) {
+            array_push(&g_queue, build);
+            const uint32_t depth = (uint32_t) (g_queue.count - g_queue_head);
+            if (depth > g_stats.queue_depth_peak) {
+                g_stats.queue_depth_peak = depth;
+            }
+            cnd_signal(&g_compiler_wake);
+        } else {
+            _compile_now(&build);
+        }
+    }
+    mtx_unlock(&g_pipeline_lock);
+    return index;
+}
 
-    vkDestroyPipeline(device, def->pipeline, 0);
-    vkDestroyPipelineLayout(device, def->layout, 0);
-    vkDestroyShaderModule(device, def->shaders[1], 0);
-    vkDestroyShaderModule(device, def->shaders[0], 0);
+void pipeline_set_fallback(const pipeline_desc_t *desc) {
+    const pipeline_def_t def = create_graphics_pipeline(desc);
+    _lock();
+    g_fallback = def;
+    mtx_unlock(&g_pipeline_lock);
+}
+
+// Called with the lock held.
+static void _check_id(uint32_t id) {
+    if (id >= g_pipelines.count) {
+        mtx_unlock(&g_pipeline_lock);
+        ptia_panic("Unknown pipeline id");
+    }
+}
+
+pipeline_status_t pipeline_status(uint32_t id) {
+    _lock();
+    _check_id(id);
+    const pipeline_status_t status = g_pipelines.data[id].status;
+    mtx_unlock(&g_pipeline_lock);
+    return status;
+}
+
+pipeline_def_t pipeline_resolve(uint32_t id) {
+    _lock();
+    _check_id(id);
+    if (g_pipelines.data[id].status != PIPELINE_STATUS_READY &&
+        g_fallback.pipeline != VK_NULL_HANDLE) {
+        const pipeline_def_t def = g_fallback;
+        g_stats.fallback_uses++;
+        mtx_unlock(&g_pipeline_lock);
+        return def;
+    }
+    // Nothing to stand in for it, so wait like create_graphics_pipeline.
+    while (g_pipelines.data[id].status == PIPELINE_STATUS_PENDING) {
+        cnd_wait(&g_pipeline_done, &g_pipeline_lock);
+    }
+    const pipeline_entry_t entry = g_pipelines.data[id];
+    mtx_unlock(&g_pipeline_lock);
+    if (entry.status != PIPELINE_STATUS_READY) {
+        ptia_panic("Failed to create graphics pipeline and no fallback is set");
+    }
+    return entry.def;
+}
+
+void pipeline_get_stats(pipeline_stats_t *out) {
+    _lock();
+    *out = g_stats;
+    out->pipelines = (uint32_t) g_pipelines.count;
+    out->shader_modules = (uint32_t) g_shaders.count;
+    out->render_passes = (uint32_t) g_render_passes.count;
+    out->queue_depth = (uint32_t) (g_queue.count - g_queue_head);
+    mtx_unlock(&g_pipeline_lock);
+}
+
+void destroy_graphics_pipelines() {
+    pipeline_compiler_shutdown();
+
+    VkDevice device = gpu_get_vk_device();
+    _lock();
+    for (uint64_t i = 0; i < g_pipelines.count; i++) {
+        if (g_pipelines.data[i].def.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, g_pipelines.data[i].def.pipeline, 0);
+        }
+    }
+    for (uint64_t i = 0; i < g_render_passes.count; i++) {
+        vkDestroyRenderPass(device, g_render_passes.data[i].render_pass, 0);
+    }
+    for (uint64_t i = 0; i < g_shaders.count; i++) {
+        vkDestroyShaderModule(device, g_shaders.data[i].module, 0);
+        memory_free(g_shaders.data[i].path, strlen(g_shaders.data[i].path) + 1,
+                    MEMORY_TAG_RENDERER);
+    }
+    array_free(&g_pipelines);
+    array_free(&g_render_passes);
+    for (uint64_t i = 0; i < g_retired_shaders.count; i++) {
+        vkDestroyShaderModule(device, g_retired_shaders.data[i], 0);
+    }
+    array_free(&g_shaders);
+    array_free(&g_retired_shaders);
+    array_free(&g_queue);
+    hash_map_destroy(&g_pipeline_map);
+    hash_map_destroy(&g_shader_map);
+    memset(&g_stats, 0, sizeof(g_stats));
+    memset(&g_fallback, 0, sizeof(g_fallback));
+    mtx_unlock(&g_pipeline_lock);
 }
@@ -0,0 +1,198 @@
+#include "engine/backend/pipeline_cache.h"
+#include "engine/backend/gpu.h"
+#include "engine/error.h"
+#include <core/file.h>
+#include <core/hash.h>
+#include <core/memory.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PIPELINE_CACHE_MAGIC 0x434c5050u // "PPLC"
+#define PIPELINE_CACHE_VERSION 1u
+#define PIPELINE_CACHE_HASH_SEED 0x9e3779b97f4a7c15ull
+
+// Our own header in front of the driver blob. The driver validates its data as
+// well, but some implementations crash on blobs from other drivers instead of
+// rejecting them, so nothing reaches vkCreatePipelineCache unchecked.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t uuid[VK_UUID_SIZE];
+  uint32_t reserved;
+  uint64_t data_size;
+  uint64_t data_hash;
+} pipeline_cache_header_t;
+
+static VkPipelineCache g_vk_pipeline_cache = VK_NULL_HANDLE;
+static const char *g_pipeline_cache_path = 0;
+static uint64_t g_loaded_hash = 0;
+static uint64_t g_loaded_size = 0;
+
+static uint8_t _matches_device(const pipeline_cache_header_t *header,
+                               const VkPhysicalDeviceProperties *props) {
+  return header->vendor_id == props->vendorID &&
+         header->device_id == props->deviceID &&
+         header->driver_version == props->driverVersion &&
+         memcmp(header->uuid, props->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static uint8_t _validate(const uint8_t *file, uint64_t size,
+                         const VkPhysicalDeviceProperties *props) {
+  pipeline_cache_header_t header;
+  if (size < sizeof(header)) {
+    return 0;
+  }
+  memcpy(&header, file, sizeof(header));
+  if (header.magic != PIPELINE_CACHE_MAGIC ||
+      header.version != PIPELINE_CACHE_VERSION) {
+    return 0;
+  }
+  if (!_matches_device(&header, props)) {
+    return 0;
+  }
+  const uint8_t *data = file + sizeof(header);
+  if (header.data_size != size - sizeof(header) ||
+      hash_bytes(data, header.data_size, PIPELINE_CACHE_HASH_SEED) !=
+          header.data_hash) {
+    return 0;
+  }
+
+  // And the driver's own header, same checks as the spec describes.
+  VkPipelineCacheHeaderVersionOne vk_header;
+  if (header.data_size < sizeof(vk_header)) {
+    return 0;
+  }
+  memcpy(&vk_header, data, sizeof(vk_header));
+  return vk_header.headerSize >= sizeof(vk_header) &&
+         vk_header.headerSize <= header.data_size &&
+         vk_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         vk_header.vendorID == props->vendorID &&
+         vk_header.deviceID == props->deviceID &&
+         memcmp(vk_header.pipelineCacheUUID, props->pipelineCacheUUID,
+                VK_UUID_SIZE) == 0;
+}
+
+static VkResult _create(const void *data, size_t size) {
+  VkPipelineCacheCreateInfo create_info;
+  create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  create_info.pNext = 0;
+  create_info.flags = 0;
+  create_info.initialDataSize = size;
+  create_info.pInitialData = data;
+  return vkCreatePipelineCache(gpu_get_vk_device(), &create_info, 0,
+                               &g_vk_pipeline_cache);
+}
+
+void pipeline_cache_load(const char *path) {
+  g_pipeline_cache_path = path;
+  g_loaded_hash = 0;
+  g_loaded_size = 0;
+
+  file_buffer_t file = {0};
+  if (path) {
+    const file_result_t result = file_read_all(path, &file);
+    if (result != FILE_OK && result != FILE_ERR_NOT_FOUND) {
+      fprintf(stderr, "%s: %s, starting with an empty pipeline cache\n", path,
+              file_result_str(result));
+    }
+  }
+
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(gpu_get_vk_phy_device(), &props);
+
+  if (file.data) {
+    if (_validate(file.data, file.size, &props)) {
+      const uint8_t *data = file.data + sizeof(pipeline_cache_header_t);
+      const uint64_t size = file.size - sizeof(pipeline_cache_header_t);
+      if (_create(data, size) == VK_SUCCESS) {
+        g_loaded_hash = hash_bytes(data, size, PIPELINE_CACHE_HASH_SEED);
+        g_loaded_size = size;
+        printf("loaded pipeline cache %s (%llu bytes)\n", path,
+               (unsigned long long)size);
+      }
+    } else {
+      fprintf(stderr, "%s: stale or corrupt pipeline cache, ignoring\n", path);
+    }
+    file_buffer_free(&file);
+  }
+
+  if (g_vk_pipeline_cache == VK_NULL_HANDLE && _create(0, 0) != VK_SUCCESS) {
+    ptia_panic("Failed to create vk Pipeline Cache");
+  }
+}
+
+VkPipelineCache pipeline_cache_get() { return g_vk_pipeline_cache; }
+
+uint8_t pipeline_cache_save() {
+  if (!g_pipeline_cache_path || g_vk_pipeline_cache == VK_NULL_HANDLE) {
+    return 0;
+  }
+  VkDevice device = gpu_get_vk_device();
+  size_t data_size = 0;
+  if (vkGetPipelineCacheData(device, g_vk_pipeline_cache, &data_size, 0) !=
+          VK_SUCCESS ||
+      data_size == 0) {
+    return 0;
+  }
+
+  const uint64_t file_size = sizeof(pipeline_cache_header_t) + data_size;
+  uint8_t *file = memory_alloc(file_size, MEMORY_TAG_RENDERER);
+  if (!file) {
+    return 0;
+  }
+  uint8_t *data = file + sizeof(pipeline_cache_header_t);
+  // The size can only shrink between the two calls, never grow.
+  if (vkGetPipelineCacheData(device, g_vk_pipeline_cache, &data_size, data) !=
+      VK_SUCCESS) {
+    memory_free(file, file_size, MEMORY_TAG_RENDERER);
+    return 0;
+  }
+
+  pipeline_cache_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.data_size = data_size;
+  header.data_hash = hash_bytes(data, data_size, PIPELINE_CACHE_HASH_SEED);
+
+  // Nothing new was compiled, leave the file alone.
+  if (header.data_size == g_loaded_size && header.data_hash == g_loaded_hash) {
+    memory_free(file, file_size, MEMORY_TAG_RENDERER);
+    return 1;
+  }
+
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(gpu_get_vk_phy_device(), &props);
+  header.magic = PIPELINE_CACHE_MAGIC;
+  header.version = PIPELINE_CACHE_VERSION;
+  header.vendor_id = props.vendorID;
+  header.device_id = props.deviceID;
+  header.driver_version = props.driverVersion;
+  memcpy(header.uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+  memcpy(file, &header, sizeof(header));
+
+  const file_result_t result = file_write_atomic(
+      g_pipeline_cache_path, file,
+      sizeof(pipeline_cache_header_t) + data_size);
+  memory_free(file, file_size, MEMORY_TAG_RENDERER);
+  if (result != FILE_OK) {
+    fprintf(stderr, "%s: %s, pipeline cache not saved\n", g_pipeline_cache_path,
+            file_result_str(result));
+    return 0;
+  }
+  g_loaded_hash = header.data_hash;
+  g_loaded_size = header.data_size;
+  printf("saved pipeline cache %s (%llu bytes)\n", g_pipeline_cache_path,
+         (unsigned long long)data_size);
+  return 1;
+}
+
+void pipeline_cache_destroy() {
+  if (g_vk_pipeline_cache == VK_NULL_HANDLE) {
+    return;
+  }
+  pipeline_cache_save();
+  vkDestroyPipelineCache(gpu_get_vk_device(), g_vk_pipeline_cache, 0);
+  g_vk_pipeline_cache = VK_NULL_HANDLE;
+}
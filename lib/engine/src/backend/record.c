@@ -0,0 +1,194 @@
+#include "engine/backend/record.h"
+#include "engine/backend/bindless.h"
+#include "engine/backend/gpu.h"
+#include "engine/error.h"
+#include <core/arrays.h>
+#include <core/jobs.h>
+#include <core/profiler.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Chunks per thread, a little slack so uneven chunks still balance.
+#define RECORD_CHUNKS_PER_THREAD 4
+
+// A pool is only ever touched by one thread, and only while its frame slot is
+// being recorded, so none of this needs locking.
+typedef struct {
+  VkCommandPool pool;
+  ARRAY(VkCommandBuffer) buffers;
+  uint32_t used;
+  uint64_t frame;
+} record_pool_t;
+
+typedef struct {
+  record_fn_t fn;
+  void *user_data;
+  uint32_t chunk_size;
+  uint32_t slot;
+  uint64_t frame;
+  VkExtent2D extent;
+  VkCommandBufferInheritanceInfo inheritance;
+  VkCommandBuffer *chunks;
+} record_job_t;
+
+static record_pool_t *g_pools = 0;
+static uint32_t g_thread_count = 0;
+static uint32_t g_slot_count = 0;
+// No job system at init: chunks run inline on the calling thread.
+static uint8_t g_inline = 0;
+
+void record_init() {
+  // Pools are sized here, so the job system has to be up already.
+  const uint32_t threads = job_system_thread_count();
+  g_inline = threads == 0;
+  g_thread_count = threads > 0 ? threads : 1;
+  g_slot_count = frame_in_flight_count();
+  g_pools = calloc(g_thread_count * g_slot_count, sizeof(record_pool_t));
+
+  for (uint32_t i = 0; i < g_thread_count * g_slot_count; i++) {
+    VkCommandPoolCreateInfo pool_info;
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.pNext = 0;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = gpu_get_gfx_queue_family();
+    if (vkCreateCommandPool(gpu_get_vk_device(), &pool_info, 0,
+                            &g_pools[i].pool) != VK_SUCCESS) {
+      ptia_panic("Failed to create vk Command Pool");
+    }
+    g_pools[i].frame = ~0ull;
+  }
+}
+
+void record_shutdown() {
+  VkDevice device = gpu_get_vk_device();
+  for (uint32_t i = 0; i < g_thread_count * g_slot_count; i++) {
+    vkDestroyCommandPool(device, g_pools[i].pool, 0);
+    array_free(&g_pools[i].buffers);
+  }
+  free(g_pools);
+  g_pools = 0;
+  g_thread_count = 0;
+  g_slot_count = 0;
+}
+
+static VkCommandBuffer _next_buffer(record_pool_t *pool, uint64_t frame) {
+  VkDevice device = gpu_get_vk_device();
+  // First use in this frame: the slot's fence has been waited on by
+  // frame_begin, so everything recorded from this pool last time is done.
+  if (pool->frame != frame) {
+    vkResetCommandPool(device, pool->pool, 0);
+    pool->used = 0;
+    pool->frame = frame;
+  }
+  if (pool->used == pool->buffers.count) {
+    VkCommandBufferAllocateInfo alloc_info;
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.pNext = 0;
+    alloc_info.commandPool = pool->pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    alloc_info.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    if (vkAllocateCommandBuffers(device, &alloc_info, &cmd) != VK_SUCCESS) {
+      ptia_panic("Failed to allocate secondary vk Command Buffer");
+    }
+    array_push(&pool->buffers, cmd);
+  }
+  return pool->buffers.data[pool->used++];
+}
+
+static void _record_chunk(void *data, uint32_t begin, uint32_t end) {
+  PROFILE_FUNCTION_BEGIN();
+  const record_job_t *job = data;
+  uint32_t thread = job_system_thread_index();
+  if (g_inline && thread == ~0u) {
+    thread = 0;
+  }
+  // Sharing another thread's pool would race, so a thread without its own,
+  // e.g. from a job system started after record_init, is a hard error.
+  if (thread >= g_thread_count) {
+    ptia_panic("Recording on a thread without a command pool, call "
+               "record_init after job_system_init");
+  }
+  record_pool_t *pool = &g_pools[job->slot * g_thread_count + thread];
+  VkCommandBuffer cmd = _next_buffer(pool, job->frame);
+
+  VkCommandBufferBeginInfo begin_info;
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.pNext = 0;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  begin_info.pInheritanceInfo = &job->inheritance;
+  if (vkBeginCommandBuffer(cmd, &begin_info) != VK_SUCCESS) {
+    ptia_panic("Failed to begin secondary vk Command Buffer");
+  }
+
+  // Neither dynamic state nor bound descriptors are inherited from the
+  // primary.
+  VkViewport viewport;
+  viewport.x = 0.f;
+  viewport.y = 0.f;
+  viewport.width = job->extent.width;
+  viewport.height = job->extent.height;
+  viewport.minDepth = 0.f;
+  viewport.maxDepth = 1.f;
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+  VkRect2D scissor;
+  scissor.offset.x = 0;
+  scissor.offset.y = 0;
+  scissor.extent = job->extent;
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+  bindless_bind(cmd);
+
+  job->fn(cmd, job->user_data, begin, end);
+
+  if (vkEndCommandBuffer(cmd) != VK_SUCCESS) {
+    ptia_panic("Failed to record secondary vk Command Buffer");
+  }
+  // Chunks start on multiples of the chunk size, which gives each one a
+  // fixed slot no matter which thread got there first.
+  job->chunks[begin / job->chunk_size] = cmd;
+  PROFILE_END();
+}
+
+void record_parallel(const frame_t *frame, record_fn_t fn, void *user_data,
+                     uint32_t item_count, uint32_t min_chunk) {
+  if (item_count == 0) {
+    return;
+  }
+  PROFILE_FUNCTION_BEGIN();
+  const uint32_t target_chunks = g_thread_count * RECORD_CHUNKS_PER_THREAD;
+  uint32_t chunk_size = (item_count + target_chunks - 1) / target_chunks;
+  if (chunk_size < min_chunk) {
+    chunk_size = min_chunk;
+  }
+  if (chunk_size == 0) {
+    chunk_size = 1;
+  }
+  const uint32_t chunk_count = (item_count + chunk_size - 1) / chunk_size;
+
+  record_job_t job;
+  job.fn = fn;
+  job.user_data = user_data;
+  job.chunk_size = chunk_size;
+  job.slot = frame->slot;
+  job.frame = frame->number;
+  job.extent = frame->extent;
+  job.inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  job.inheritance.pNext = 0;
+  job.inheritance.renderPass = gpu_get_render_pass();
+  job.inheritance.subpass = 0;
+  job.inheritance.framebuffer = frame->framebuffer;
+  job.inheritance.occlusionQueryEnable = VK_FALSE;
+  job.inheritance.queryFlags = 0;
+  job.inheritance.pipelineStatistics = 0;
+  job.chunks =
+      arena_push_array(frame_scratch(), VkCommandBuffer, chunk_count);
+
+  job_counter_t counter = {0};
+  job_parallel_for(_record_chunk, &job, item_count, chunk_size, &counter);
+  job_wait(&counter);
+
+  vkCmdExecuteCommands(frame->cmd, chunk_count, job.chunks);
+  PROFILE_END();
+}
@@ -0,0 +1,541 @@
+#include "engine/backend/upload.h"
+#include "engine/backend/gpu.h"
+#include "engine/error.h"
+#include <core/arena.h>
+#include <core/arrays.h>
+#include <core/hash.h>
+#include <core/hash_map.h>
+#include <core/profiler.h>
+#include <string.h>
+
+// Offsets into the ring are kept aligned for the copy engines.
+#define UPLOAD_ALIGNMENT 16ull
+#define UPLOAD_SCRATCH_BLOCK_SIZE (16u * 1024u)
+
+typedef struct {
+  VkBuffer dst;
+  VkBufferCopy region;
+} upload_copy_t;
+
+typedef struct {
+  VkCommandBuffer cmd;
+  // Graphics side of the ownership transfer, only with separate families.
+  VkCommandBuffer acquire_cmd;
+  ARRAY(upload_copy_t) copies;
+  // Timeline value the batch signals, doubling as the ticket of everything
+  // in it. 0 until the batch is first used.
+  uint64_t value;
+  // Ring position just past the batch's data.
+  uint64_t ring_end;
+  uint8_t recording;
+  uint8_t submitted;
+} upload_batch_t;
+
+static upload_batch_t g_batches[UPLOAD_BATCH_COUNT];
+static uint32_t g_current = 0;
+static uint64_t g_next_value = 1;
+// Every batch up to this value has finished and, with separate families,
+// had its acquire submitted.
+static uint64_t g_retired_value = 0;
+
+static VkBuffer g_ring = VK_NULL_HANDLE;
+static gpu_allocation_t g_ring_memory = {0};
+static uint8_t *g_ring_data = 0;
+static VkDeviceSize g_ring_size = 0;
+// Positions grow forever and wrap by modulo, so head - tail is always the
+// space in use.
+static uint64_t g_ring_head = 0;
+static uint64_t g_ring_tail = 0;
+
+static uint8_t g_transfer_ownership = 0;
+static VkCommandPool g_transfer_pool = VK_NULL_HANDLE;
+static VkCommandPool g_acquire_pool = VK_NULL_HANDLE;
+// Signalled by the transfer queue as batches finish.
+static VkSemaphore g_transfer_timeline = VK_NULL_HANDLE;
+// Signalled by the graphics queue as acquires finish.
+static VkSemaphore g_acquire_timeline = VK_NULL_HANDLE;
+
+// Regions and barriers of the batch being recorded, reset once it is
+// submitted, so uploading allocates nothing once warmed up.
+static arena_t g_scratch;
+
+// Buffers whose uploads have retired and now belong to the graphics queue,
+// keyed by _buffer_key, until upload_release.
+static hash_map_t g_handed_over;
+
+// hash_bytes over exactly 8 bytes is a bijection, so distinct buffers never
+// share a key.
+static uint64_t _buffer_key(VkBuffer buffer) {
+  return hash_bytes(&buffer, sizeof(buffer), 0);
+}
+
+static VkSemaphore _create_timeline() {
+  VkSemaphoreTypeCreateInfo type_info;
+  type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  type_info.pNext = 0;
+  type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  type_info.initialValue = 0;
+
+  VkSemaphoreCreateInfo create_info;
+  create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  create_info.pNext = &type_info;
+  create_info.flags = 0;
+
+  VkSemaphore semaphore;
+  if (vkCreateSemaphore(gpu_get_vk_device(), &create_info, 0, &semaphore) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to create vk timeline Semaphore");
+  }
+  return semaphore;
+}
+
+static void _wait_timeline(VkSemaphore semaphore, uint64_t value) {
+  VkSemaphoreWaitInfo wait_info;
+  wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wait_info.pNext = 0;
+  wait_info.flags = 0;
+  wait_info.semaphoreCount = 1;
+  wait_info.pSemaphores = &semaphore;
+  wait_info.pValues = &value;
+  if (vkWaitSemaphores(gpu_get_vk_device(), &wait_info, UINT64_MAX) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to wait for vk timeline Semaphore");
+  }
+}
+
+static VkCommandPool _create_pool(uint32_t family) {
+  VkCommandPoolCreateInfo pool_info;
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.pNext = 0;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                    VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = family;
+  VkCommandPool pool;
+  if (vkCreateCommandPool(gpu_get_vk_device(), &pool_info, 0, &pool) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to create vk Command Pool");
+  }
+  return pool;
+}
+
+static VkCommandBuffer _allocate_cmd(VkCommandPool pool) {
+  VkCommandBufferAllocateInfo alloc_info;
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.pNext = 0;
+  alloc_info.commandPool = pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandBufferCount = 1;
+  VkCommandBuffer cmd;
+  if (vkAllocateCommandBuffers(gpu_get_vk_device(), &alloc_info, &cmd) !=
+      VK_SUCCESS) {
+    ptia_panic("Failed to allocate vk Command Buffer");
+  }
+  return cmd;
+}
+
+static void _begin_cmd(VkCommandBuffer cmd) {
+  VkCommandBufferBeginInfo begin_info;
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.pNext = 0;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  begin_info.pInheritanceInfo = 0;
+  if (vkBeginCommandBuffer(cmd, &begin_info) != VK_SUCCESS) {
+    ptia_panic("Failed to begin recording vk Command Buffer");
+  }
+}
+
+// One submit with an optional timeline wait and a timeline signal.
+static void _submit(VkQueue queue, VkCommandBuffer cmd, VkSemaphore wait,
+                    uint64_t wait_value, VkSemaphore signal,
+                    uint64_t signal_value) {
+  VkTimelineSemaphoreSubmitInfo timeline_info;
+  timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timeline_info.pNext = 0;
+  timeline_info.waitSemaphoreValueCount = wait != VK_NULL_HANDLE ? 1 : 0;
+  timeline_info.pWaitSemaphoreValues = &wait_value;
+  timeline_info.signalSemaphoreValueCount = 1;
+  timeline_info.pSignalSemaphoreValues = &signal_value;
+
+  VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkSubmitInfo submit_info;
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.pNext = &timeline_info;
+  submit_info.waitSemaphoreCount = wait != VK_NULL_HANDLE ? 1 : 0;
+  submit_info.pWaitSemaphores = &wait;
+  submit_info.pWaitDstStageMask = &wait_stage;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmd;
+  submit_info.signalSemaphoreCount = 1;
+  submit_info.pSignalSemaphores = &signal;
+  if (vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+    ptia_panic("Failed to submit upload vk Command Buffer");
+  }
+}
+
+// Release and acquire barriers of an ownership transfer have to describe the
+// same ranges.
+static VkBufferMemoryBarrier *
+_ownership_barriers(const upload_batch_t *batch, VkAccessFlags src_access,
+                    VkAccessFlags dst_access) {
+  VkBufferMemoryBarrier *barriers = arena_push_array(
+      &g_scratch, VkBufferMemoryBarrier, batch->copies.count);
+  for (uint64_t i = 0; i < batch->copies.count; i++) {
+    const upload_copy_t *copy = &batch->copies.data[i];
+    VkBufferMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = 0;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = gpu_get_transfer_queue_family();
+    barrier.dstQueueFamilyIndex = gpu_get_gfx_queue_family();
+    barrier.buffer = copy->dst;
+    barrier.offset = copy->region.dstOffset;
+    barrier.size = copy->region.size;
+    barriers[i] = barrier;
+  }
+  return barriers;
+}
+
+// The copies are done by the time this runs, so the wait in the submit is
+// already satisfied and the graphics queue does not stall on it.
+static void _acquire(upload_batch_t *batch) {
+  _begin_cmd(batch->acquire_cmd);
+  const arena_marker_t marker = arena_mark(&g_scratch);
+  const VkBufferMemoryBarrier *barriers =
+      _ownership_barriers(batch, 0, VK_ACCESS_MEMORY_READ_BIT);
+  vkCmdPipelineBarrier(batch->acquire_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, 0,
+                       (uint32_t)batch->copies.count, barriers, 0, 0);
+  arena_reset_to(&g_scratch, marker);
+  if (vkEndCommandBuffer(batch->acquire_cmd) != VK_SUCCESS) {
+    ptia_panic("Failed to record acquire vk Command Buffer");
+  }
+  _submit(gpu_get_gfx_queue(), batch->acquire_cmd, g_transfer_timeline,
+          batch->value, g_acquire_timeline, batch->value);
+}
+
+static upload_batch_t *_submitted_batch(uint64_t value) {
+  for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+    if (g_batches[i].value == value && g_batches[i].submitted) {
+      return &g_batches[i];
+    }
+  }
+  return 0;
+}
+
+// Retires finished batches in submission order, waiting on the CPU for
+// those up to wait_value.
+static void _retire(uint64_t wait_value) {
+  uint64_t done = 0;
+  vkGetSemaphoreCounterValue(gpu_get_vk_device(), g_transfer_timeline, &done);
+  for (;;) {
+    upload_batch_t *batch = _submitted_batch(g_retired_value + 1);
+    if (!batch) {
+      return;
+    }
+    if (batch->value > done) {
+      if (batch->value > wait_value) {
+        return;
+      }
+      _wait_timeline(g_transfer_timeline, batch->value);
+    }
+    if (g_transfer_ownership) {
+      _acquire(batch);
+    }
+    for (uint64_t i = 0; i < batch->copies.count; i++) {
+      hash_map_set(&g_handed_over, _buffer_key(batch->copies.data[i].dst), 1);
+    }
+    g_ring_tail = batch->ring_end;
+    g_retired_value = batch->value;
+    batch->submitted = 0;
+  }
+}
+
+static upload_batch_t *_current_batch() {
+  upload_batch_t *batch = &g_batches[g_current];
+  if (batch->recording) {
+    return batch;
+  }
+  // Last used UPLOAD_BATCH_COUNT batches ago, normally long finished.
+  if (batch->value != 0) {
+    _retire(batch->value);
+    if (g_transfer_ownership) {
+      _wait_timeline(g_acquire_timeline, batch->value);
+    }
+  }
+  array_clear(&batch->copies);
+  batch->value = g_next_value++;
+  batch->recording = 1;
+  return batch;
+}
+
+static VkDeviceSize _ring_alloc(VkDeviceSize size) {
+  for (;;) {
+    uint64_t pos = (g_ring_head + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+    // Never straddle the end, skip to the start instead.
+    if (pos % g_ring_size + size > g_ring_size) {
+      pos += g_ring_size - pos % g_ring_size;
+    }
+    if (pos + size - g_ring_tail <= g_ring_size) {
+      g_ring_head = pos + size;
+      return pos % g_ring_size;
+    }
+    // Full. What is queued has to go out before it can retire.
+    upload_flush();
+    if (!_submitted_batch(g_retired_value + 1)) {
+      ptia_panic("Upload ring full with nothing in flight");
+    }
+    _retire(g_retired_value + 1);
+  }
+}
+
+void upload_init(VkDeviceSize ring_size) {
+  if (ring_size == 0) {
+    ring_size = UPLOAD_DEFAULT_RING_SIZE;
+  }
+  VkBufferCreateInfo ring_info;
+  ring_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  ring_info.pNext = 0;
+  ring_info.flags = 0;
+  ring_info.size = ring_size;
+  ring_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  ring_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  ring_info.queueFamilyIndexCount = 0;
+  ring_info.pQueueFamilyIndices = 0;
+  if (gpu_buffer_create(&ring_info, GPU_MEMORY_UPLOAD, &g_ring,
+                        &g_ring_memory) != VK_SUCCESS) {
+    ptia_panic("Failed to create upload ring buffer");
+  }
+  gpu_allocation_info_t ring_memory;
+  gpu_memory_info(g_ring_memory, &ring_memory);
+  g_ring_data = ring_memory.mapped;
+  g_ring_size = ring_size;
+  g_ring_head = 0;
+  g_ring_tail = 0;
+  arena_init(&g_scratch, UPLOAD_SCRATCH_BLOCK_SIZE, MEMORY_TAG_RENDERER);
+  hash_map_init(&g_handed_over, 256);
+
+  g_transfer_ownership =
+      gpu_get_transfer_queue_family() != gpu_get_gfx_queue_family();
+  g_transfer_pool = _create_pool(gpu_get_transfer_queue_family());
+  g_transfer_timeline = _create_timeline();
+  if (g_transfer_ownership) {
+    g_acquire_pool = _create_pool(gpu_get_gfx_queue_family());
+    g_acquire_timeline = _create_timeline();
+  }
+
+  memset(g_batches, 0, sizeof(g_batches));
+  for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+    g_batches[i].cmd = _allocate_cmd(g_transfer_pool);
+    if (g_transfer_ownership) {
+      g_batches[i].acquire_cmd = _allocate_cmd(g_acquire_pool);
+    }
+  }
+  g_current = 0;
+  g_next_value = 1;
+  g_retired_value = 0;
+}
+
+void upload_shutdown() {
+  upload_flush();
+  _retire(g_next_value);
+  if (g_transfer_ownership && g_retired_value > 0) {
+    _wait_timeline(g_acquire_timeline, g_retired_value);
+  }
+
+  VkDevice device = gpu_get_vk_device();
+  for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+    array_free(&g_batches[i].copies);
+  }
+  vkDestroyCommandPool(device, g_transfer_pool, 0);
+  vkDestroySemaphore(device, g_transfer_timeline, 0);
+  if (g_transfer_ownership) {
+    vkDestroyCommandPool(device, g_acquire_pool, 0);
+    vkDestroySemaphore(device, g_acquire_timeline, 0);
+  }
+  g_transfer_pool = VK_NULL_HANDLE;
+  g_acquire_pool = VK_NULL_HANDLE;
+  g_transfer_timeline = VK_NULL_HANDLE;
+  g_acquire_timeline = VK_NULL_HANDLE;
+  gpu_buffer_destroy(g_ring, g_ring_memory);
+  g_ring = VK_NULL_HANDLE;
+  g_ring_data = 0;
+  arena_destroy(&g_scratch);
+  hash_map_destroy(&g_handed_over);
+}
+
+uint64_t upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void *data,
+                       VkDeviceSize size) {
+  if (hash_map_get(&g_handed_over, _buffer_key(dst)) != HASH_MAP_EMPTY) {
+    ptia_panic("Upload into a buffer the graphics queue owns, call "
+               "upload_release once it is no longer in use");
+  }
+  const uint8_t *bytes = data;
+  // Half the ring, so a chunk always fits once everything before retired.
+  const VkDeviceSize max_chunk = g_ring_size / 2;
+  uint64_t ticket = g_retired_value;
+  while (size > 0) {
+    const VkDeviceSize chunk = size < max_chunk ? size : max_chunk;
+    const VkDeviceSize offset = _ring_alloc(chunk);
+    memcpy(g_ring_data + offset, bytes, chunk);
+
+    // After the allocation, which may have flushed the previous batch.
+    upload_batch_t *batch = _current_batch();
+    upload_copy_t copy;
+    copy.dst = dst;
+    copy.region.srcOffset = offset;
+    copy.region.dstOffset = dst_offset;
+    copy.region.size = chunk;
+    array_push(&batch->copies, copy);
+    ticket = batch->value;
+
+    bytes += chunk;
+    dst_offset += chunk;
+    size -= chunk;
+  }
+  return ticket;
+}
+
+void upload_flush() {
+  upload_batch_t *batch = &g_batches[g_current];
+  if (!batch->recording || batch->copies.count == 0) {
+    return;
+  }
+  _begin_cmd(batch->cmd);
+  // Released buffers may be written again. Everything that touched them
+  // before was submitted earlier, on this queue or, for the graphics side of
+  // a released buffer, finished before the release, so one barrier orders
+  // the copies after those reads and writes.
+  VkMemoryBarrier barrier;
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.pNext = 0;
+  barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, 0,
+                       0, 0);
+  const arena_marker_t marker = arena_mark(&g_scratch);
+  VkBufferCopy *regions =
+      arena_push_array(&g_scratch, VkBufferCopy, batch->copies.count);
+  // Runs of copies into the same buffer go out as one command.
+  for (uint64_t i = 0; i < batch->copies.count;) {
+    const VkBuffer dst = batch->copies.data[i].dst;
+    uint32_t region_count = 0;
+    for (; i < batch->copies.count && batch->copies.data[i].dst == dst; i++) {
+      regions[region_count++] = batch->copies.data[i].region;
+    }
+    vkCmdCopyBuffer(batch->cmd, g_ring, dst, region_count, regions);
+  }
+
+  if (g_transfer_ownership) {
+    const VkBufferMemoryBarrier *barriers =
+        _ownership_barriers(batch, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+    vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0,
+                         (uint32_t)batch->copies.count, barriers, 0, 0);
+  } else {
+    // Same queue as graphics: later submissions are ordered behind this.
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                         0, 0, 0);
+  }
+  if (vkEndCommandBuffer(batch->cmd) != VK_SUCCESS) {
+    ptia_panic("Failed to record upload vk Command Buffer");
+  }
+  arena_reset_to(&g_scratch, marker);
+  _submit(gpu_get_transfer_queue(), batch->cmd, VK_NULL_HANDLE, 0,
+          g_transfer_timeline, batch->value);
+
+  batch->ring_end = g_ring_head;
+  batch->recording = 0;
+  batch->submitted = 1;
+  g_current = (g_current + 1) % UPLOAD_BATCH_COUNT;
+}
+
+void upload_update() {
+  PROFILE_FUNCTION_BEGIN();
+  upload_flush();
+  _retire(0);
+  PROFILE_END();
+}
+
+uint8_t upload_is_complete(uint64_t ticket) {
+  if (ticket > g_retired_value) {
+    _retire(0);
+  }
+  return ticket <= g_retired_value;
+}
+
+void upload_wait(uint64_t ticket) {
+  if (ticket <= g_retired_value) {
+    return;
+  }
+  const upload_batch_t *current = &g_batches[g_current];
+  if (current->recording && ticket >= current->value) {
+    upload_flush();
+  }
+  _retire(ticket);
+}
+
+void upload_release(VkBuffer buffer) {
+  hash_map_remove(&g_handed_over, _buffer_key(buffer));
+}
+
+static uint8_t _create_device_buffer(VkDeviceSize size,
+                                     VkBufferUsageFlags usage, VkBuffer *out,
+                                     gpu_allocation_t *out_memory) {
+  VkBufferCreateInfo buffer_info;
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.pNext = 0;
+  buffer_info.flags = 0;
+  buffer_info.size = size;
+  buffer_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buffer_info.queueFamilyIndexCount = 0;
+  buffer_info.pQueueFamilyIndices = 0;
+  return gpu_buffer_create(&buffer_info, GPU_MEMORY_DEVICE, out, out_memory) ==
+         VK_SUCCESS;
+}
+
+uint8_t upload_mesh(const mesh_file_t *file, upload_mesh_t *out) {
+  memset(out, 0, sizeof(upload_mesh_t));
+  mesh_span_t positions;
+  mesh_span_t indices;
+  if (!mesh_file_section(file, MESH_SECTION_POSITIONS, &positions) ||
+      !mesh_file_section(file, MESH_SECTION_INDICES, &indices) ||
+      positions.count == 0 || indices.count == 0) {
+    return 0;
+  }
+  const VkDeviceSize vertex_bytes = positions.count * positions.stride;
+  const VkDeviceSize index_bytes = indices.count * indices.stride;
+  if (!_create_device_buffer(vertex_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                             &out->vertices, &out->vertex_memory)) {
+    return 0;
+  }
+  if (!_create_device_buffer(index_bytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                             &out->indices, &out->index_memory)) {
+    gpu_buffer_destroy(out->vertices, out->vertex_memory);
+    memset(out, 0, sizeof(upload_mesh_t));
+    return 0;
+  }
+  out->vertex_count = positions.count;
+  out->vertex_stride = positions.stride;
+  out->index_count = indices.count;
+  out->index_type = indices.encoding == MESH_ENCODING_U16_INDEX
+                        ? VK_INDEX_TYPE_UINT16
+                        : VK_INDEX_TYPE_UINT32;
+
+  upload_buffer(out->vertices, 0, positions.data, vertex_bytes);
+  out->ticket = upload_buffer(out->indices, 0, indices.data, index_bytes);
+  return 1;
+}
+
+void upload_mesh_destroy(upload_mesh_t *mesh) {
+  upload_release(mesh->vertices);
+  upload_release(mesh->indices);
+  gpu_buffer_destroy(mesh->vertices, mesh->vertex_memory);
+  gpu_buffer_destroy(mesh->indices, mesh->index_memory);
+  memset(mesh, 0, sizeof(upload_mesh_t));
+}
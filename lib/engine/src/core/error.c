@@ -1,6 +1,16 @@
 #include "engine/error.h"
 
+#include <stdarg.h>
+
 void ptia_panic(const char* msg) {
     printf("%s", msg);
     exit(EXIT_FAILURE);
 }
+
+void ptia_warn(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
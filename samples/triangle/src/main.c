@@ -1,13 +1,102 @@
+#include <core/profiler.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "engine/backend/frame.h"
 #include "engine/backend/gpu.h"
 #include "engine/backend/pipeline.h"
 #include "engine/backend/window.h"
 
+// Headless runs render a fixed number of frames and keep the last one.
+#define HEADLESS_FRAME_COUNT 60
+
+static void write_ppm(const char *path, const uint8_t *rgba, uint32_t w,
+                      uint32_t h) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    printf("failed to open %s\n", path);
+    return;
+  }
+  fprintf(file, "P6\n%u %u\n255\n", w, h);
+  for (uint32_t i = 0; i < w * h; i++) {
+    fwrite(rgba + i * 4, 1, 3, file);
+  }
+  fclose(file);
+}
+
 int main(int argc, const char **argv) {
+  // --headless [out.ppm]: no window, the final frame is written out instead.
+  // --trace <out.json>: profiling zones as a Chrome trace, written on exit.
+  // --device <n|name>: GPU to use instead of the best scoring one.
+  uint8_t headless = 0;
+  const char *capture_path = "triangle.ppm";
+  const char *trace_path = 0;
+  const char *device = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      headless = 1;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        capture_path = argv[++i];
+      }
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+      device = argv[++i];
+    }
+  }
+  profiler_init();
+  PROFILE_THREAD_NAME("main");
   window_preset_resolution(1000, 800);
   window_set_title("sosig game");
+  gpu_preset_headless(headless);
+  gpu_preset_device(device);
   gpu_init_vk("game A", VK_MAKE_VERSION(0, 0, 1));
-  pipeline_def_t gfx_pipeline = create_graphics_pipeline();
+  pipeline_compiler_init(1);
+  pipeline_desc_t desc;
+  pipeline_desc_init(&desc);
+  desc.vertex_shader = "shaders/vert.spv";
+  desc.fragment_shader = "shaders/frag.spv";
+  // The unblended variant is built up front and drawn until the blended one
+  // has compiled in the background.
+  pipeline_desc_t fallback_desc = desc;
+  fallback_desc.blend[0] = PIPELINE_BLEND_NONE;
+  pipeline_set_fallback(&fallback_desc);
+  const uint32_t gfx_pipeline = request_graphics_pipeline(&desc);
+
+  frame_init(FRAME_DEFAULT_IN_FLIGHT);
+  const float clear_color[4] = {0.f, 0.f, 0.f, 1.f};
+  uint32_t frames_left = HEADLESS_FRAME_COUNT;
+  while (gpu_pump_events() && (!headless || frames_left > 0)) {
+    PROFILE_BEGIN("frame");
+    frame_t frame;
+    if (!frame_begin(&frame)) {
+      PROFILE_END();
+      continue;
+    }
+    frame_begin_main_pass(&frame, clear_color, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(frame.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipeline_resolve(gfx_pipeline).pipeline);
+    vkCmdDraw(frame.cmd, 3, 1, 0, 0);
+    frame_end_main_pass(&frame);
+    if (headless && frames_left == 1) {
+      frame_capture(&frame);
+    }
+    frame_end(&frame);
+    if (headless && --frames_left == 0) {
+      uint8_t *pixels = malloc(frame.extent.width * frame.extent.height * 4);
+      if (frame_read_capture(&frame, pixels)) {
+        write_ppm(capture_path, pixels, frame.extent.width,
+                  frame.extent.height);
+      }
+      free(pixels);
+    }
+    PROFILE_END();
+  }
+  frame_shutdown();
   gpu_destroy_vk();
-}
\ No newline at end of file
+  if (trace_path && !profiler_export_chrome(trace_path)) {
+    printf("failed to write %s\n", trace_path);
+  }
+  profiler_shutdown();
+}
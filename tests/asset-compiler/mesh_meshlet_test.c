@@ -0,0 +1,170 @@
+#include <assets/mesh_meshlet.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#define GRID 24
+#define GRID_VERTICES ((GRID + 1) * (GRID + 1))
+#define GRID_TRIANGLES (GRID * GRID * 2)
+
+// Flat grid on the XZ plane with +Y facing triangles.
+static void _make_grid(f32 *positions, u32 *indices) {
+    for (u32 z = 0; z <= GRID; z++) {
+        for (u32 x = 0; x <= GRID; x++) {
+            f32 *p = positions + (z * (GRID + 1) + x) * 3;
+            p[0] = (f32)x;
+            p[1] = 0.f;
+            p[2] = (f32)z;
+        }
+    }
+    u32 *out = indices;
+    for (u32 z = 0; z < GRID; z++) {
+        for (u32 x = 0; x < GRID; x++) {
+            const u32 a = z * (GRID + 1) + x;
+            const u32 b = a + 1;
+            const u32 c = a + GRID + 1;
+            const u32 d = c + 1;
+            *out++ = a; *out++ = c; *out++ = b;
+            *out++ = b; *out++ = c; *out++ = d;
+        }
+    }
+}
+
+// Triangles are identified by their sorted corners, so each source triangle
+// maps to one key regardless of the rotation the builder emits it in.
+static u64 _triangle_key(u32 a, u32 b, u32 c) {
+    u32 t;
+    if (a > b) { t = a; a = b; b = t; }
+    if (b > c) { t = b; b = c; c = t; }
+    if (a > b) { t = a; a = b; b = t; }
+    return ((u64)a * GRID_VERTICES + b) * GRID_VERTICES + c;
+}
+
+static int _compare_u64(const void *a, const void *b) {
+    const u64 x = *(const u64 *)a;
+    const u64 y = *(const u64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void limits_are_respected(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_TRIANGLES * 3];
+    _make_grid(positions, indices);
+
+    const u32 max_vertices = 32;
+    const u32 max_triangles = 40;
+    mesh_meshlets_t meshlets;
+    mesh_build_meshlets(indices, GRID_TRIANGLES * 3, positions, GRID_VERTICES, max_vertices, max_triangles, &meshlets);
+    TEST_CHECK(meshlets.meshlet_count >= GRID_TRIANGLES / max_triangles);
+    for (u64 m = 0; m < meshlets.meshlet_count; m++) {
+        const mesh_file_meshlet_t *meshlet = &meshlets.meshlets[m];
+        TEST_CHECK(meshlet->vertex_count > 0 && meshlet->vertex_count <= max_vertices);
+        TEST_CHECK(meshlet->triangle_count > 0 && meshlet->triangle_count <= max_triangles);
+        TEST_CHECK(meshlet->triangle_offset % 4 == 0);
+        TEST_CHECK(meshlet->vertex_offset + meshlet->vertex_count <= meshlets.vertex_count);
+        TEST_CHECK(meshlet->triangle_offset + meshlet->triangle_count * 3 <= meshlets.triangle_bytes);
+        for (u32 i = 0; i < meshlet->triangle_count * 3; i++) {
+            TEST_CHECK(meshlets.triangles[meshlet->triangle_offset + i] < meshlet->vertex_count);
+        }
+    }
+    mesh_meshlets_free(&meshlets);
+}
+
+static void every_triangle_once(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_TRIANGLES * 3];
+    _make_grid(positions, indices);
+
+    mesh_meshlets_t meshlets;
+    mesh_build_meshlets(indices, GRID_TRIANGLES * 3, positions, GRID_VERTICES, MESHLET_DEFAULT_MAX_VERTICES,
+                        MESHLET_DEFAULT_MAX_TRIANGLES, &meshlets);
+
+    static u64 expected[GRID_TRIANGLES];
+    static u64 actual[GRID_TRIANGLES];
+    for (u32 t = 0; t < GRID_TRIANGLES; t++) {
+        expected[t] = _triangle_key(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]);
+    }
+    u64 count = 0;
+    for (u64 m = 0; m < meshlets.meshlet_count; m++) {
+        const mesh_file_meshlet_t *meshlet = &meshlets.meshlets[m];
+        const u32 *vertices = &meshlets.vertices[meshlet->vertex_offset];
+        const u8 *triangles = &meshlets.triangles[meshlet->triangle_offset];
+        for (u32 t = 0; t < meshlet->triangle_count && count < GRID_TRIANGLES; t++) {
+            actual[count++] = _triangle_key(vertices[triangles[t * 3]], vertices[triangles[t * 3 + 1]],
+                                            vertices[triangles[t * 3 + 2]]);
+        }
+    }
+    TEST_CHECK(count == GRID_TRIANGLES);
+    qsort(expected, GRID_TRIANGLES, sizeof(u64), _compare_u64);
+    qsort(actual, count, sizeof(u64), _compare_u64);
+    TEST_CHECK(memcmp(expected, actual, sizeof(expected)) == 0);
+    mesh_meshlets_free(&meshlets);
+}
+
+static void result_is_deterministic(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_TRIANGLES * 3];
+    _make_grid(positions, indices);
+
+    mesh_meshlets_t a, b;
+    mesh_build_meshlets(indices, GRID_TRIANGLES * 3, positions, GRID_VERTICES, MESHLET_DEFAULT_MAX_VERTICES,
+                        MESHLET_DEFAULT_MAX_TRIANGLES, &a);
+    mesh_build_meshlets(indices, GRID_TRIANGLES * 3, positions, GRID_VERTICES, MESHLET_DEFAULT_MAX_VERTICES,
+                        MESHLET_DEFAULT_MAX_TRIANGLES, &b);
+    TEST_CHECK(a.meshlet_count == b.meshlet_count);
+    TEST_CHECK(a.vertex_count == b.vertex_count);
+    TEST_CHECK(a.triangle_bytes == b.triangle_bytes);
+    if (a.meshlet_count == b.meshlet_count && a.vertex_count == b.vertex_count &&
+        a.triangle_bytes == b.triangle_bytes) {
+        TEST_CHECK(memcmp(a.meshlets, b.meshlets, a.meshlet_count * sizeof(mesh_file_meshlet_t)) == 0);
+        TEST_CHECK(memcmp(a.bounds, b.bounds, a.meshlet_count * sizeof(mesh_file_meshlet_bounds_t)) == 0);
+        TEST_CHECK(memcmp(a.vertices, b.vertices, a.vertex_count * sizeof(u32)) == 0);
+        TEST_CHECK(memcmp(a.triangles, b.triangles, a.triangle_bytes) == 0);
+    }
+    mesh_meshlets_free(&a);
+    mesh_meshlets_free(&b);
+}
+
+static void bounds_contain_vertices(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_TRIANGLES * 3];
+    _make_grid(positions, indices);
+
+    mesh_meshlets_t meshlets;
+    mesh_build_meshlets(indices, GRID_TRIANGLES * 3, positions, GRID_VERTICES, MESHLET_DEFAULT_MAX_VERTICES,
+                        MESHLET_DEFAULT_MAX_TRIANGLES, &meshlets);
+    for (u64 m = 0; m < meshlets.meshlet_count; m++) {
+        const mesh_file_meshlet_t *meshlet = &meshlets.meshlets[m];
+        const mesh_file_meshlet_bounds_t *bounds = &meshlets.bounds[m];
+        for (u32 v = 0; v < meshlet->vertex_count; v++) {
+            const f32 *p = &positions[meshlets.vertices[meshlet->vertex_offset + v] * 3];
+            const f32 d[3] = {p[0] - bounds->center[0], p[1] - bounds->center[1], p[2] - bounds->center[2]};
+            TEST_CHECK(sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) <= bounds->radius * 1.0001f);
+        }
+
+        // A flat +Y meshlet faces away from a camera far below it and towards
+        // one far above it.
+        const f32 *axis = bounds->cone_axis;
+        TEST_CHECK(fabsf(axis[1] - 1.f) < 1e-4f);
+        for (i32 side = -1; side <= 1; side += 2) {
+            const f32 camera[3] = {bounds->center[0], 100.f * (f32)side, bounds->center[2]};
+            f32 to_apex[3] = {bounds->cone_apex[0] - camera[0], bounds->cone_apex[1] - camera[1],
+                              bounds->cone_apex[2] - camera[2]};
+            const f32 len = sqrtf(to_apex[0] * to_apex[0] + to_apex[1] * to_apex[1] + to_apex[2] * to_apex[2]);
+            const f32 d = (to_apex[0] * axis[0] + to_apex[1] * axis[1] + to_apex[2] * axis[2]) / len;
+            TEST_CHECK((d >= bounds->cone_cutoff) == (side < 0));
+        }
+    }
+    mesh_meshlets_free(&meshlets);
+}
+
+int main(void) {
+    TEST_RUN(limits_are_respected);
+    TEST_RUN(every_triangle_once);
+    TEST_RUN(result_is_deterministic);
+    TEST_RUN(bounds_contain_vertices);
+    return TEST_RESULT();
+}
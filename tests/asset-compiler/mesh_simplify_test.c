@@ -0,0 +1,149 @@
+#include <assets/mesh_simplify.h>
+#include <core/mesh_format.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#define GRID 16
+#define GRID_VERTICES ((GRID + 1) * (GRID + 1))
+#define GRID_INDICES (GRID * GRID * 6)
+
+// (GRID + 1)^2 vertices on the XZ plane, height from bump (0 for flat).
+static void _make_grid(f32 *positions, u32 *indices, f32 bump) {
+    for (u32 z = 0; z <= GRID; z++) {
+        for (u32 x = 0; x <= GRID; x++) {
+            f32 *p = positions + (z * (GRID + 1) + x) * 3;
+            p[0] = (f32)x;
+            p[1] = ((x * 7 + z * 13) % 5) * bump;
+            p[2] = (f32)z;
+        }
+    }
+    u32 *out = indices;
+    for (u32 z = 0; z < GRID; z++) {
+        for (u32 x = 0; x < GRID; x++) {
+            const u32 a = z * (GRID + 1) + x;
+            const u32 b = a + 1;
+            const u32 c = a + GRID + 1;
+            const u32 d = c + 1;
+            *out++ = a; *out++ = c; *out++ = b;
+            *out++ = b; *out++ = c; *out++ = d;
+        }
+    }
+}
+
+static b8 _is_border(u32 v) {
+    const u32 x = v % (GRID + 1);
+    const u32 z = v / (GRID + 1);
+    return x == 0 || z == 0 || x == GRID || z == GRID;
+}
+
+static void flat_grid_reaches_target(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_INDICES];
+    static u32 dst[GRID_INDICES];
+    _make_grid(positions, indices, 0.f);
+
+    f32 error = -1.f;
+    const u64 count = mesh_simplify(dst, indices, GRID_INDICES, positions, GRID_VERTICES, GRID_INDICES / 4, 0.f, &error);
+    TEST_CHECK(count % 3 == 0);
+    TEST_CHECK(count < GRID_INDICES);
+    TEST_CHECK(error >= 0.f && error < 1e-4f);
+    for (u64 i = 0; i < count; i++) {
+        TEST_CHECK(dst[i] < GRID_VERTICES);
+    }
+    for (u64 t = 0; t < count; t += 3) {
+        TEST_CHECK(dst[t] != dst[t + 1] && dst[t + 1] != dst[t + 2] && dst[t] != dst[t + 2]);
+    }
+}
+
+static void border_vertices_are_kept(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_INDICES];
+    static u32 dst[GRID_INDICES];
+    _make_grid(positions, indices, 0.f);
+
+    f32 error;
+    const u64 count = mesh_simplify(dst, indices, GRID_INDICES, positions, GRID_VERTICES, 0, 0.f, &error);
+    static b8 used[GRID_VERTICES];
+    memset(used, 0, sizeof(used));
+    for (u64 i = 0; i < count; i++) {
+        used[dst[i]] = true;
+    }
+    for (u32 v = 0; v < GRID_VERTICES; v++) {
+        if (_is_border(v)) {
+            TEST_CHECK(used[v]);
+        }
+    }
+}
+
+static void result_is_deterministic(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_INDICES];
+    static u32 first[GRID_INDICES];
+    static u32 second[GRID_INDICES];
+    _make_grid(positions, indices, 0.25f);
+
+    f32 error_a, error_b;
+    const u64 a = mesh_simplify(first, indices, GRID_INDICES, positions, GRID_VERTICES, GRID_INDICES / 2, 0.f, &error_a);
+    const u64 b = mesh_simplify(second, indices, GRID_INDICES, positions, GRID_VERTICES, GRID_INDICES / 2, 0.f, &error_b);
+    TEST_CHECK(a == b);
+    TEST_CHECK(error_a == error_b);
+    TEST_CHECK(memcmp(first, second, a * sizeof(u32)) == 0);
+}
+
+static void max_error_is_respected(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_INDICES];
+    static u32 dst[GRID_INDICES];
+    _make_grid(positions, indices, 0.5f);
+
+    const f32 max_error = 0.05f;
+    f32 error;
+    const u64 bounded = mesh_simplify(dst, indices, GRID_INDICES, positions, GRID_VERTICES, 0, max_error, &error);
+    TEST_CHECK(error <= max_error);
+
+    const u64 unbounded = mesh_simplify(dst, indices, GRID_INDICES, positions, GRID_VERTICES, 0, 0.f, &error);
+    TEST_CHECK(unbounded <= bounded);
+}
+
+static void no_op_at_or_below_target(void) {
+    static f32 positions[GRID_VERTICES * 3];
+    static u32 indices[GRID_INDICES];
+    static u32 dst[GRID_INDICES];
+    _make_grid(positions, indices, 0.f);
+
+    f32 error = -1.f;
+    const u64 count = mesh_simplify(dst, indices, GRID_INDICES, positions, GRID_VERTICES, GRID_INDICES, 0.f, &error);
+    TEST_CHECK(count == GRID_INDICES);
+    TEST_CHECK(error == 0.f);
+    TEST_CHECK(memcmp(dst, indices, sizeof(indices)) == 0);
+}
+
+static void lod_selection(void) {
+    const mesh_file_lod_t lods[] = {
+        {.index_offset = 0, .index_count = 300, .error = 0.f},
+        {.index_offset = 300, .index_count = 120, .error = 0.01f},
+        {.index_offset = 420, .index_count = 30, .error = 0.1f},
+    };
+    // error * scale / distance <= 1 pixel with scale 1000.
+    TEST_CHECK(mesh_format_select_lod(lods, 3, 0.f, 1000.f, 1.f) == 0);
+    TEST_CHECK(mesh_format_select_lod(lods, 3, 5.f, 1000.f, 1.f) == 0);
+    TEST_CHECK(mesh_format_select_lod(lods, 3, 10.f, 1000.f, 1.f) == 1);
+    TEST_CHECK(mesh_format_select_lod(lods, 3, 99.f, 1000.f, 1.f) == 1);
+    TEST_CHECK(mesh_format_select_lod(lods, 3, 100.f, 1000.f, 1.f) == 2);
+    TEST_CHECK(mesh_format_select_lod(lods, 3, 1e6f, 1000.f, 1.f) == 2);
+    TEST_CHECK(mesh_format_select_lod(lods, 1, 1e6f, 1000.f, 1.f) == 0);
+}
+
+int main(void) {
+    TEST_RUN(flat_grid_reaches_target);
+    TEST_RUN(border_vertices_are_kept);
+    TEST_RUN(result_is_deterministic);
+    TEST_RUN(max_error_is_respected);
+    TEST_RUN(no_op_at_or_below_target);
+    TEST_RUN(lod_selection);
+    return TEST_RESULT();
+}
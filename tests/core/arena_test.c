@@ -0,0 +1,121 @@
+#include <core/arena.h>
+#include <core/block_pool.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+
+static u64 _tag_allocations(memory_tag_t tag) {
+    memory_stats_t stats;
+    memory_get_stats(&stats);
+    return stats.allocations[tag];
+}
+
+static void allocations_are_aligned(void) {
+    arena_t arena;
+    arena_init(&arena, 1024, MEMORY_TAG_ARENA);
+    TEST_CHECK(arena_alloc(&arena, 3) != 0);
+    for (u64 alignment = 1; alignment <= 256; alignment <<= 1) {
+        const u8 *p = arena_alloc_aligned(&arena, 5, alignment);
+        TEST_CHECK(p && (uintptr_t) p % alignment == 0);
+    }
+    const u64 *zeroed = arena_alloc_zeroed(&arena, sizeof(u64) * 8);
+    for (u32 i = 0; i < 8; i++) {
+        TEST_CHECK(zeroed[i] == 0);
+    }
+    // Bigger than a block gets a block of its own.
+    u8 *big = arena_alloc(&arena, 4096);
+    TEST_CHECK(big != 0);
+    memset(big, 0xab, 4096);
+    arena_destroy(&arena);
+}
+
+// Resetting to a marker rewinds to the exact same address and usage, and
+// blocks grown past the marker are reused instead of allocated again.
+static void marker_reset_reuses_blocks(void) {
+    arena_t arena;
+    arena_init(&arena, 256, MEMORY_TAG_ARENA);
+    arena_alloc(&arena, 100);
+    const arena_marker_t marker = arena_mark(&arena);
+    const u64 used = arena.used;
+
+    u8 *first = arena_alloc(&arena, 64);
+    for (u32 i = 0; i < 16; i++) {
+        arena_alloc(&arena, 200);
+    }
+    TEST_CHECK(arena.used > used);
+    const u64 warmed = _tag_allocations(MEMORY_TAG_ARENA);
+
+    for (u32 round = 0; round < 4; round++) {
+        arena_reset_to(&arena, marker);
+        TEST_CHECK(arena.used == used);
+        TEST_CHECK(arena_alloc(&arena, 64) == first);
+        for (u32 i = 0; i < 16; i++) {
+            arena_alloc(&arena, 200);
+        }
+    }
+    TEST_CHECK(_tag_allocations(MEMORY_TAG_ARENA) == warmed);
+
+    // Nested markers unwind in order.
+    arena_reset_to(&arena, marker);
+    const arena_marker_t inner = arena_mark(&arena);
+    u8 *a = arena_alloc(&arena, 32);
+    arena_reset_to(&arena, inner);
+    TEST_CHECK(arena_alloc(&arena, 32) == a);
+
+    arena_reset(&arena);
+    TEST_CHECK(arena.used == 0);
+    TEST_CHECK(arena.peak >= used);
+    arena_destroy(&arena);
+}
+
+static void marker_before_first_allocation(void) {
+    arena_t arena;
+    arena_init(&arena, 128, MEMORY_TAG_ARENA);
+    const arena_marker_t empty = arena_mark(&arena);
+    u8 *p = arena_alloc(&arena, 16);
+    arena_alloc(&arena, 500);
+    arena_reset_to(&arena, empty);
+    TEST_CHECK(arena.used == 0);
+    TEST_CHECK(arena_alloc(&arena, 16) == p);
+    arena_destroy(&arena);
+}
+
+// Freed blocks come back last in, first out, and the pool reports empty
+// once every block is taken.
+static void block_pool_reuses_freed_blocks(void) {
+    block_pool_t pool;
+    TEST_CHECK(block_pool_init(&pool, 48, 8, MEMORY_TAG_POOL));
+    void *blocks[8];
+    for (u32 i = 0; i < 8; i++) {
+        blocks[i] = block_pool_alloc(&pool);
+        TEST_CHECK(blocks[i] != 0);
+        TEST_CHECK(block_pool_owns(&pool, blocks[i]));
+        for (u32 j = 0; j < i; j++) {
+            TEST_CHECK(blocks[i] != blocks[j]);
+        }
+    }
+    TEST_CHECK(pool.free_count == 0);
+    TEST_CHECK(block_pool_alloc(&pool) == 0);
+
+    block_pool_free(&pool, blocks[2]);
+    block_pool_free(&pool, blocks[5]);
+    TEST_CHECK(pool.free_count == 2);
+    TEST_CHECK(block_pool_alloc(&pool) == blocks[5]);
+    TEST_CHECK(block_pool_alloc(&pool) == blocks[2]);
+    TEST_CHECK(block_pool_alloc(&pool) == 0);
+
+    TEST_CHECK(!block_pool_owns(&pool, (u8 *) blocks[0] + 1));
+    int outside;
+    TEST_CHECK(!block_pool_owns(&pool, &outside));
+    block_pool_destroy(&pool);
+}
+
+int main(void) {
+    TEST_RUN(allocations_are_aligned);
+    TEST_RUN(marker_reset_reuses_blocks);
+    TEST_RUN(marker_before_first_allocation);
+    TEST_RUN(block_pool_reuses_freed_blocks);
+    return TEST_RESULT();
+}
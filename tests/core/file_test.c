@@ -0,0 +1,130 @@
+#include <core/file.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+// Relative, so it lands in the test's working directory.
+#define TEST_PATH "file_test.tmp"
+#define MISSING_PATH "file_test.missing"
+#define CONTENT_SIZE 10000
+
+static u8 g_content[CONTENT_SIZE];
+
+static void _write_content(void) {
+    for (u32 i = 0; i < CONTENT_SIZE; i++) {
+        g_content[i] = (u8) (i * 31 + i / 256);
+    }
+    TEST_CHECK(file_write_atomic(TEST_PATH, g_content, CONTENT_SIZE) == FILE_OK);
+}
+
+static void read_all_is_zero_terminated(void) {
+    _write_content();
+    u64 size = 0;
+    TEST_CHECK(file_size(TEST_PATH, &size) == FILE_OK);
+    TEST_CHECK(size == CONTENT_SIZE);
+
+    file_buffer_t buffer;
+    TEST_CHECK(file_read_all(TEST_PATH, &buffer) == FILE_OK);
+    TEST_CHECK(buffer.size == CONTENT_SIZE);
+    TEST_CHECK(memcmp(buffer.data, g_content, CONTENT_SIZE) == 0);
+    TEST_CHECK(buffer.data[CONTENT_SIZE] == 0);
+    file_buffer_free(&buffer);
+    TEST_CHECK(!buffer.data && buffer.size == 0);
+
+    // Rewriting replaces the contents as a whole.
+    const char text[] = "short";
+    TEST_CHECK(file_write_atomic(TEST_PATH, text, 5) == FILE_OK);
+    TEST_CHECK(file_read_all(TEST_PATH, &buffer) == FILE_OK);
+    TEST_CHECK(buffer.size == 5 && strcmp((const char *) buffer.data, text) == 0);
+    file_buffer_free(&buffer);
+    remove(TEST_PATH);
+}
+
+static void missing_file_is_reported(void) {
+    remove(MISSING_PATH);
+    u64 size = 123;
+    TEST_CHECK(file_size(MISSING_PATH, &size) == FILE_ERR_NOT_FOUND);
+    file_buffer_t buffer;
+    TEST_CHECK(file_read_all(MISSING_PATH, &buffer) == FILE_ERR_NOT_FOUND);
+    TEST_CHECK(!buffer.data && buffer.size == 0);
+    file_map_t map;
+    TEST_CHECK(file_map(MISSING_PATH, &map) == FILE_ERR_NOT_FOUND);
+    TEST_CHECK(!map.data);
+    u8 scratch[16];
+    file_stream_t stream;
+    TEST_CHECK(file_stream_open(MISSING_PATH, scratch, sizeof(scratch), &stream) == FILE_ERR_NOT_FOUND);
+}
+
+// Odd read sizes through a buffer much smaller than the file, mixing
+// buffered reads, reads bigger than the buffer and zero copy chunks.
+static void stream_reads_in_small_pieces(void) {
+    _write_content();
+    u8 scratch[64];
+    file_stream_t stream;
+    TEST_CHECK(file_stream_open(TEST_PATH, scratch, sizeof(scratch), &stream) == FILE_OK);
+
+    static u8 out[CONTENT_SIZE];
+    u64 total = 0;
+    u32 step = 0;
+    for (;;) {
+        u64 got = 0;
+        if (step % 3 == 2) {
+            const u8 *chunk;
+            TEST_CHECK(file_stream_next(&stream, &chunk, &got) == FILE_OK);
+            TEST_CHECK(got <= sizeof(scratch) && total + got <= CONTENT_SIZE);
+            memcpy(out + total, chunk, got);
+        } else {
+            u64 want = step % 3 ? 200 : 7 + step % 50;
+            want = want < CONTENT_SIZE - total ? want : CONTENT_SIZE - total;
+            TEST_CHECK(file_stream_read(&stream, out + total, want, &got) == FILE_OK);
+        }
+        total += got;
+        TEST_CHECK(stream.offset == total);
+        if (total == CONTENT_SIZE) {
+            break;
+        }
+        if (got == 0 && step % 3 != 2) {
+            TEST_CHECK(!"stream ended early");
+            break;
+        }
+        step++;
+    }
+    TEST_CHECK(memcmp(out, g_content, CONTENT_SIZE) == 0);
+
+    u64 got = 1;
+    TEST_CHECK(file_stream_read(&stream, out, 16, &got) == FILE_OK);
+    TEST_CHECK(got == 0);
+    const u8 *chunk;
+    TEST_CHECK(file_stream_next(&stream, &chunk, &got) == FILE_OK);
+    TEST_CHECK(got == 0);
+    file_stream_close(&stream);
+    remove(TEST_PATH);
+}
+
+static void map_matches_contents(void) {
+    _write_content();
+    file_map_t map;
+    TEST_CHECK(file_map(TEST_PATH, &map) == FILE_OK);
+    TEST_CHECK(map.size == CONTENT_SIZE);
+    file_map_prefetch(&map);
+    TEST_CHECK(map.data && memcmp(map.data, g_content, CONTENT_SIZE) == 0);
+    file_unmap(&map);
+    TEST_CHECK(!map.data);
+
+    // Empty files map to an empty view.
+    TEST_CHECK(file_write_atomic(TEST_PATH, g_content, 0) == FILE_OK);
+    TEST_CHECK(file_map(TEST_PATH, &map) == FILE_OK);
+    TEST_CHECK(!map.data && map.size == 0);
+    file_unmap(&map);
+    remove(TEST_PATH);
+}
+
+int main(void) {
+    TEST_RUN(read_all_is_zero_terminated);
+    TEST_RUN(missing_file_is_reported);
+    TEST_RUN(stream_reads_in_small_pieces);
+    TEST_RUN(map_matches_contents);
+    return TEST_RESULT();
+}
@@ -0,0 +1,94 @@
+#include <core/handle_pool.h>
+
+#include "test.h"
+
+typedef struct {
+    u32 value;
+    u32 pad;
+} item_t;
+
+static item_t _item(u32 value) {
+    item_t item = {value, 0};
+    return item;
+}
+
+static void zeroed_handle_is_invalid(void) {
+    handle_pool_t pool;
+    handle_pool_init(&pool, sizeof(item_t), 0);
+    TEST_CHECK(!handle_is_valid(HANDLE_INVALID));
+    TEST_CHECK(!handle_pool_contains(&pool, HANDLE_INVALID));
+    TEST_CHECK(!handle_pool_get(&pool, HANDLE_INVALID));
+    const item_t first = _item(1);
+    handle_pool_insert(&pool, &first);
+    // Slot 0 exists now, generation 0 still must not reach it.
+    TEST_CHECK(!handle_pool_get(&pool, HANDLE_INVALID));
+    handle_pool_destroy(&pool);
+}
+
+// Removing bumps the slot generation, so the old handle fails every lookup
+// even after the slot has been handed out again.
+static void stale_generation_is_rejected(void) {
+    handle_pool_t pool;
+    handle_pool_init(&pool, sizeof(item_t), 4);
+    const item_t a = _item(10);
+    const handle_t old = handle_pool_insert(&pool, &a);
+    item_t removed;
+    TEST_CHECK(handle_pool_remove(&pool, old, &removed));
+    TEST_CHECK(removed.value == 10);
+    TEST_CHECK(!handle_pool_contains(&pool, old));
+    TEST_CHECK(!handle_pool_remove(&pool, old, 0));
+
+    const item_t b = _item(20);
+    const handle_t reused = handle_pool_insert(&pool, &b);
+    TEST_CHECK(reused.index == old.index);
+    TEST_CHECK(reused.generation != old.generation);
+    TEST_CHECK(!handle_pool_get(&pool, old));
+    TEST_CHECK(!handle_pool_remove(&pool, old, 0));
+    const item_t *live = handle_pool_get(&pool, reused);
+    TEST_CHECK(live && live->value == 20);
+    TEST_CHECK(handle_pool_count(&pool) == 1);
+    handle_pool_destroy(&pool);
+}
+
+// Removal swaps the last item into the hole, handles to the moved item must
+// keep finding it and dense iteration must see every live item once.
+static void handles_follow_swapped_items(void) {
+    handle_pool_t pool;
+    handle_pool_init(&pool, sizeof(item_t), 0);
+    handle_t handles[64];
+    for (u32 i = 0; i < 64; i++) {
+        const item_t item = _item(i);
+        handles[i] = handle_pool_insert(&pool, &item);
+    }
+    for (u32 i = 0; i < 64; i += 3) {
+        TEST_CHECK(handle_pool_remove(&pool, handles[i], 0));
+    }
+
+    u32 seen[64] = {0};
+    for (u32 i = 0; i < handle_pool_count(&pool); i++) {
+        const item_t *item = handle_pool_at(&pool, i);
+        seen[item->value]++;
+        TEST_CHECK(handle_equal(handle_pool_handle_at(&pool, i), handles[item->value]));
+    }
+    for (u32 i = 0; i < 64; i++) {
+        const item_t *item = handle_pool_get(&pool, handles[i]);
+        if (i % 3 == 0) {
+            TEST_CHECK(!item);
+            TEST_CHECK(seen[i] == 0);
+        } else {
+            TEST_CHECK(item && item->value == i);
+            TEST_CHECK(seen[i] == 1);
+        }
+    }
+    handle_pool_clear(&pool);
+    TEST_CHECK(handle_pool_count(&pool) == 0);
+    TEST_CHECK(!handle_pool_get(&pool, handles[1]));
+    handle_pool_destroy(&pool);
+}
+
+int main(void) {
+    TEST_RUN(zeroed_handle_is_invalid);
+    TEST_RUN(stale_generation_is_rejected);
+    TEST_RUN(handles_follow_swapped_items);
+    return TEST_RESULT();
+}
@@ -0,0 +1,130 @@
+#include <core/hash_map.h>
+
+#include "test.h"
+
+#define CHURN_KEYS 40
+
+static u32 g_seed = 777u;
+
+static u32 _random(void) {
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return g_seed >> 8;
+}
+
+static void set_get_overwrite_remove(void) {
+    // A zeroed map is usable, the first set allocates.
+    hash_map_t map = {0};
+    TEST_CHECK(hash_map_get(&map, 5) == HASH_MAP_EMPTY);
+    TEST_CHECK(!hash_map_remove(&map, 5));
+
+    // Enough keys to grow a few times.
+    for (u64 key = 0; key < 1000; key++) {
+        hash_map_set(&map, key * 0x9e3779b97f4a7c15ull, (u32) key);
+    }
+    TEST_CHECK(map.count == 1000);
+    TEST_CHECK(map.count * 4 <= map.capacity * 3);
+    for (u64 key = 0; key < 1000; key++) {
+        TEST_CHECK(hash_map_get(&map, key * 0x9e3779b97f4a7c15ull) == key);
+    }
+
+    hash_map_set(&map, 0, 42);
+    TEST_CHECK(hash_map_get(&map, 0) == 42);
+    TEST_CHECK(map.count == 1000);
+
+    for (u64 key = 0; key < 1000; key += 2) {
+        TEST_CHECK(hash_map_remove(&map, key * 0x9e3779b97f4a7c15ull));
+    }
+    TEST_CHECK(!hash_map_remove(&map, 0));
+    TEST_CHECK(map.count == 500);
+    for (u64 key = 1; key < 1000; key++) {
+        const u32 expected = key % 2 ? (u32) key : HASH_MAP_EMPTY;
+        TEST_CHECK(hash_map_get(&map, key * 0x9e3779b97f4a7c15ull) == expected);
+    }
+
+    hash_map_clear(&map);
+    TEST_CHECK(map.count == 0);
+    TEST_CHECK(hash_map_get(&map, 0x9e3779b97f4a7c15ull) == HASH_MAP_EMPTY);
+    hash_map_destroy(&map);
+}
+
+// Keys are their own hash, so with 16 slots these land as
+//   14:14  15:30  0:46  1:15  2:0  3:17
+// one run that wraps past the end of the table. Removing its head has to
+// shift every later entry back by one, across the wrap.
+static void remove_shifts_wrapped_cluster(void) {
+    hash_map_t map;
+    hash_map_init(&map, 16);
+    TEST_CHECK(map.capacity == 16);
+    const u64 keys[] = {14, 30, 46, 15, 0, 17};
+    for (u32 i = 0; i < 6; i++) {
+        hash_map_set(&map, keys[i], i);
+    }
+    TEST_CHECK(map.keys[0] == 46 && map.keys[3] == 17);
+
+    TEST_CHECK(hash_map_remove(&map, 14));
+    TEST_CHECK(hash_map_get(&map, 14) == HASH_MAP_EMPTY);
+    for (u32 i = 1; i < 6; i++) {
+        TEST_CHECK(hash_map_get(&map, keys[i]) == i);
+    }
+    TEST_CHECK(map.keys[14] == 30 && map.keys[15] == 46);
+    TEST_CHECK(map.keys[0] == 15 && map.keys[1] == 0 && map.keys[2] == 17);
+    TEST_CHECK(map.values[3] == HASH_MAP_EMPTY);
+
+    // 15 and 0 sit one past their homes now, removing 46 at slot 15 puts both
+    // back home and 17 follows into slot 1.
+    TEST_CHECK(hash_map_remove(&map, 46));
+    TEST_CHECK(map.keys[15] == 15 && map.keys[0] == 0 && map.keys[1] == 17);
+    TEST_CHECK(map.values[2] == HASH_MAP_EMPTY);
+    for (u32 i = 1; i < 6; i++) {
+        TEST_CHECK(hash_map_get(&map, keys[i]) == (i == 2 ? HASH_MAP_EMPTY : i));
+    }
+    TEST_CHECK(map.count == 4);
+    hash_map_destroy(&map);
+}
+
+// Few distinct homes and a table that never grows, so runs are long and wrap
+// all the time. Checked against a plain array after every step.
+static void churn_matches_reference(void) {
+    hash_map_t map;
+    hash_map_init(&map, 64);
+    u32 reference[CHURN_KEYS];
+    for (u32 i = 0; i < CHURN_KEYS; i++) {
+        reference[i] = HASH_MAP_EMPTY;
+    }
+    // Homes 60..63 and 0..3, spread over 40 keys.
+    u64 keys[CHURN_KEYS];
+    for (u32 i = 0; i < CHURN_KEYS; i++) {
+        keys[i] = (u64) (60 + i % 8) % 64 + 64 * (i / 8);
+    }
+
+    for (u32 step = 0; step < 20000; step++) {
+        const u32 i = _random() % CHURN_KEYS;
+        if (_random() % 2) {
+            const u32 value = _random() % 1000;
+            hash_map_set(&map, keys[i], value);
+            reference[i] = value;
+        } else {
+            TEST_CHECK(hash_map_remove(&map, keys[i]) == (reference[i] != HASH_MAP_EMPTY));
+            reference[i] = HASH_MAP_EMPTY;
+        }
+        u64 live = 0;
+        for (u32 j = 0; j < CHURN_KEYS; j++) {
+            if (hash_map_get(&map, keys[j]) != reference[j]) {
+                TEST_CHECK(!"hash map diverged from reference");
+                hash_map_destroy(&map);
+                return;
+            }
+            live += reference[j] != HASH_MAP_EMPTY;
+        }
+        TEST_CHECK(map.count == live);
+    }
+    TEST_CHECK(map.capacity == 64);
+    hash_map_destroy(&map);
+}
+
+int main(void) {
+    TEST_RUN(set_get_overwrite_remove);
+    TEST_RUN(remove_shifts_wrapped_cluster);
+    TEST_RUN(churn_matches_reference);
+    return TEST_RESULT();
+}
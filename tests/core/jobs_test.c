@@ -0,0 +1,130 @@
+#include <core/jobs.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+
+#define WORKERS 4
+// More jobs than one thread's ring holds, so the run-inline paths get hit too.
+#define INDEX_COUNT 20000
+#define SLOW_JOBS 64
+#define CHILD_JOBS 16
+
+static _Atomic u32 g_hits[INDEX_COUNT];
+static _Atomic u32 g_out_of_range;
+
+static void _hit(void *data, u32 begin, u32 end) {
+    const u32 count = (u32) (uintptr_t) data;
+    if (begin >= end || end > count) {
+        atomic_fetch_add(&g_out_of_range, 1);
+        return;
+    }
+    for (u32 i = begin; i < end; i++) {
+        atomic_fetch_add_explicit(&g_hits[i], 1, memory_order_relaxed);
+    }
+}
+
+static void _check_parallel_for(u32 count, u32 batch_size) {
+    for (u32 i = 0; i < count; i++) {
+        atomic_store(&g_hits[i], 0);
+    }
+    atomic_store(&g_out_of_range, 0);
+    job_counter_t counter = {0};
+    job_parallel_for(_hit, (void *) (uintptr_t) count, count, batch_size, &counter);
+    job_wait(&counter);
+    TEST_CHECK(atomic_load(&counter.pending) == 0);
+    TEST_CHECK(atomic_load(&g_out_of_range) == 0);
+    u32 wrong = 0;
+    for (u32 i = 0; i < count; i++) {
+        wrong += atomic_load(&g_hits[i]) != 1;
+    }
+    TEST_CHECK(wrong == 0);
+}
+
+// Batch sizes that divide the count, leave a remainder, exceed it, and zero,
+// which is treated as one.
+static void parallel_for_visits_each_index_once(void) {
+    TEST_CHECK(job_system_thread_count() > 1);
+    const u32 batch_sizes[] = {0, 1, 3, 64, 1000, 7777, INDEX_COUNT, INDEX_COUNT + 5};
+    for (u32 i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++) {
+        _check_parallel_for(INDEX_COUNT, batch_sizes[i]);
+        _check_parallel_for(INDEX_COUNT - 1, batch_sizes[i]);
+    }
+    // Nothing to do must not touch the counter.
+    job_counter_t counter = {0};
+    job_parallel_for(_hit, 0, 0, 16, &counter);
+    TEST_CHECK(atomic_load(&counter.pending) == 0);
+}
+
+// Plain, non-atomic results: job_wait has to order every job's writes before
+// it returns, which is also what a thread sanitizer run checks.
+static u64 g_results[SLOW_JOBS];
+static u64 g_child_results[SLOW_JOBS][CHILD_JOBS];
+
+static u64 _spin(u32 seed) {
+    u64 value = seed;
+    for (u32 i = 0; i < 20000; i++) {
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return value | 1;
+}
+
+static void _child(void *data, u32 begin, u32 end) {
+    u64 *results = data;
+    for (u32 i = begin; i < end; i++) {
+        results[i] = _spin(i);
+    }
+}
+
+// Forks children from inside a job and joins them before finishing, so the
+// waiting thread runs other jobs while it waits.
+static void _slow(void *data, u32 begin, u32 end) {
+    (void) data;
+    for (u32 i = begin; i < end; i++) {
+        job_counter_t children = {0};
+        job_parallel_for(_child, g_child_results[i], CHILD_JOBS, 1, &children);
+        job_wait(&children);
+        u64 sum = 0;
+        for (u32 j = 0; j < CHILD_JOBS; j++) {
+            sum += g_child_results[i][j] != 0;
+        }
+        g_results[i] = sum == CHILD_JOBS ? _spin(i) : 0;
+    }
+}
+
+static void wait_returns_after_every_job(void) {
+    TEST_CHECK(job_system_thread_count() > 1);
+    for (u32 round = 0; round < 4; round++) {
+        memset(g_results, 0, sizeof(g_results));
+        memset(g_child_results, 0, sizeof(g_child_results));
+        job_counter_t counter = {0};
+        for (u32 i = 0; i < SLOW_JOBS; i++) {
+            job_desc_t desc = {_slow, 0, i, i + 1};
+            job_run(&desc, 1, &counter);
+        }
+        job_wait(&counter);
+        TEST_CHECK(atomic_load(&counter.pending) == 0);
+        u32 missing = 0;
+        for (u32 i = 0; i < SLOW_JOBS; i++) {
+            missing += g_results[i] != _spin(i);
+        }
+        TEST_CHECK(missing == 0);
+    }
+}
+
+static void waiting_on_nothing_returns(void) {
+    job_counter_t counter = {0};
+    job_wait(&counter);
+    TEST_CHECK(atomic_load(&counter.pending) == 0);
+}
+
+int main(void) {
+    job_system_init(WORKERS);
+    TEST_RUN(parallel_for_visits_each_index_once);
+    TEST_RUN(wait_returns_after_every_job);
+    TEST_RUN(waiting_on_nothing_returns);
+    job_system_shutdown();
+    return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+#include <core/tlsf.h>
+
+#include <stdlib.h>
+
+#include "test.h"
+
+#define RANGE_SIZE (64ull << 20)
+#define SLOTS 512
+
+// Deterministic, so a failure reproduces.
+static u32 g_seed = 12345u;
+
+static u32 _random(void) {
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return g_seed >> 8;
+}
+
+static void fresh_range_is_one_free_block(void) {
+    tlsf_t tlsf;
+    tlsf_init(&tlsf, RANGE_SIZE);
+    TEST_CHECK(tlsf_validate(&tlsf));
+    TEST_CHECK(tlsf_is_empty(&tlsf));
+    TEST_CHECK(tlsf_largest_free(&tlsf) == RANGE_SIZE);
+
+    const u32 all = tlsf_alloc(&tlsf, RANGE_SIZE, 1);
+    TEST_CHECK(all != TLSF_NONE);
+    TEST_CHECK(tlsf_offset(&tlsf, all) == 0);
+    TEST_CHECK(tlsf_alloc(&tlsf, 1, 1) == TLSF_NONE);
+    tlsf_free(&tlsf, all);
+    TEST_CHECK(tlsf_is_empty(&tlsf));
+    TEST_CHECK(tlsf_alloc(&tlsf, RANGE_SIZE + 1, 1) == TLSF_NONE);
+    TEST_CHECK(tlsf_validate(&tlsf));
+    tlsf_destroy(&tlsf);
+}
+
+static void alignment_is_honoured(void) {
+    tlsf_t tlsf;
+    tlsf_init(&tlsf, RANGE_SIZE);
+    // Throw the next offsets off any power of two first.
+    TEST_CHECK(tlsf_alloc(&tlsf, 3, 1) != TLSF_NONE);
+    for (u64 alignment = 1; alignment <= (1ull << 16); alignment <<= 1) {
+        const u32 block = tlsf_alloc(&tlsf, 100, alignment);
+        TEST_CHECK(block != TLSF_NONE);
+        TEST_CHECK(tlsf_offset(&tlsf, block) % alignment == 0);
+        TEST_CHECK(tlsf_size(&tlsf, block) >= 100);
+    }
+    TEST_CHECK(tlsf_validate(&tlsf));
+    tlsf_destroy(&tlsf);
+}
+
+// Random allocs and frees, with the invariants checked after every step and
+// no two live ranges allowed to overlap. Freeing everything must merge back
+// into the one block the range started as.
+static void random_churn_keeps_invariants(void) {
+    tlsf_t tlsf;
+    tlsf_init(&tlsf, RANGE_SIZE);
+    u32 blocks[SLOTS];
+    for (u32 i = 0; i < SLOTS; i++) {
+        blocks[i] = TLSF_NONE;
+    }
+
+    u32 live = 0;
+    for (u32 step = 0; step < 20000; step++) {
+        const u32 slot = _random() % SLOTS;
+        if (blocks[slot] == TLSF_NONE) {
+            const u64 size = 1 + _random() % (256u << 10);
+            const u64 alignment = 1ull << (_random() % 13);
+            blocks[slot] = tlsf_alloc(&tlsf, size, alignment);
+            if (blocks[slot] != TLSF_NONE) {
+                TEST_CHECK(tlsf_offset(&tlsf, blocks[slot]) % alignment == 0);
+                TEST_CHECK(tlsf_size(&tlsf, blocks[slot]) >= size);
+                live++;
+            }
+        } else {
+            tlsf_free(&tlsf, blocks[slot]);
+            blocks[slot] = TLSF_NONE;
+            live--;
+        }
+        TEST_CHECK(tlsf.alloc_count == live);
+        if (step % 64 == 0 && !tlsf_validate(&tlsf)) {
+            TEST_CHECK(!"tlsf invariants broken");
+            break;
+        }
+    }
+
+    for (u32 i = 0; i < SLOTS; i++) {
+        if (blocks[i] == TLSF_NONE) {
+            continue;
+        }
+        const u64 begin = tlsf_offset(&tlsf, blocks[i]);
+        const u64 end = begin + tlsf_size(&tlsf, blocks[i]);
+        TEST_CHECK(end <= RANGE_SIZE);
+        for (u32 j = i + 1; j < SLOTS; j++) {
+            if (blocks[j] == TLSF_NONE) {
+                continue;
+            }
+            const u64 other = tlsf_offset(&tlsf, blocks[j]);
+            TEST_CHECK(other >= end || other + tlsf_size(&tlsf, blocks[j]) <= begin);
+        }
+    }
+
+    for (u32 i = 0; i < SLOTS; i++) {
+        if (blocks[i] != TLSF_NONE) {
+            tlsf_free(&tlsf, blocks[i]);
+        }
+    }
+    TEST_CHECK(tlsf_validate(&tlsf));
+    TEST_CHECK(tlsf_is_empty(&tlsf));
+    TEST_CHECK(tlsf.used == 0);
+    TEST_CHECK(tlsf_largest_free(&tlsf) == RANGE_SIZE);
+    tlsf_destroy(&tlsf);
+}
+
+int main(void) {
+    TEST_RUN(fresh_range_is_one_free_block);
+    TEST_RUN(alignment_is_honoured);
+    TEST_RUN(random_churn_keeps_invariants);
+    return TEST_RESULT();
+}
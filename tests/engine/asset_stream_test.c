@@ -0,0 +1,166 @@
+#include <engine/assets/asset_stream.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include "test.h"
+
+// A single worker blocks opening a FIFO until the test opens the write end,
+// which holds everything queued behind it still while the test sets up.
+#define GATE_PATH "asset_stream_test.fifo"
+#define MISSING_PATH "asset_stream_test.missing"
+#define MAX_CALLS 16
+
+static uintptr_t g_calls[MAX_CALLS];
+static asset_status_t g_call_status[MAX_CALLS];
+static uint32_t g_call_count = 0;
+
+static void _record(asset_load_t *load) {
+    if (g_call_count < MAX_CALLS) {
+        g_call_status[g_call_count] = load->status;
+        g_calls[g_call_count++] = (uintptr_t) load->user_data;
+    }
+}
+
+static void _reset_calls(void) {
+    g_call_count = 0;
+}
+
+static uint8_t _finished(asset_status_t status) {
+    return status != ASSET_STATUS_QUEUED && status != ASSET_STATUS_LOADING;
+}
+
+static void _wait_loading(handle_t request) {
+    while (asset_stream_poll(request, 0) != ASSET_STATUS_LOADING) {
+        thrd_yield();
+    }
+}
+
+static void _wait_finished(handle_t request) {
+    while (!_finished(asset_stream_poll(request, 0))) {
+        thrd_yield();
+    }
+}
+
+static handle_t _open_gate(uintptr_t id) {
+    remove(GATE_PATH);
+    TEST_CHECK(mkfifo(GATE_PATH, 0600) == 0);
+    const handle_t gate = asset_stream_request(GATE_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_HIGH, _record,
+                                               (void *) id);
+    // Loading means the worker is inside open and everything else waits.
+    _wait_loading(gate);
+    return gate;
+}
+
+static void _close_gate(void) {
+    const int fd = open(GATE_PATH, O_WRONLY);
+    TEST_CHECK(fd >= 0);
+    close(fd);
+    remove(GATE_PATH);
+}
+
+static void _drain_all(void) {
+    for (uint32_t spins = 0; asset_stream_pending() > 0; spins++) {
+        if (spins == 1000000) {
+            TEST_CHECK(!"requests never drained");
+            return;
+        }
+        asset_stream_drain(MAX_CALLS);
+        thrd_yield();
+    }
+}
+
+// Higher priorities first, equal priorities in request order.
+static void priorities_decide_order(void) {
+    asset_stream_init(1, 8);
+    _reset_calls();
+    _open_gate(0);
+    asset_stream_request(MISSING_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_LOW, _record, (void *) 1);
+    asset_stream_request(MISSING_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_HIGH, _record, (void *) 2);
+    asset_stream_request(MISSING_PATH, ASSET_REQUEST_MAP, ASSET_PRIORITY_NORMAL, _record, (void *) 3);
+    asset_stream_request(MISSING_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_HIGH, _record, (void *) 4);
+    _close_gate();
+    _drain_all();
+
+    const uintptr_t expected[] = {0, 2, 4, 3, 1};
+    TEST_CHECK(g_call_count == 5);
+    for (uint32_t i = 0; i < 5 && i < g_call_count; i++) {
+        TEST_CHECK(g_calls[i] == expected[i]);
+    }
+    // The gate is not a regular file, the rest do not exist.
+    TEST_CHECK(g_call_status[0] == ASSET_STATUS_FAILED);
+    TEST_CHECK(g_call_status[1] == ASSET_STATUS_FAILED);
+    asset_stream_shutdown();
+}
+
+static void cancel_queued_and_loading(void) {
+    asset_stream_init(1, 8);
+    _reset_calls();
+    const handle_t gate = _open_gate(0);
+    const handle_t queued = asset_stream_request(MISSING_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_NORMAL,
+                                                 _record, (void *) 1);
+    TEST_CHECK(asset_stream_cancel(queued));
+    // Finished right away, a second cancel has nothing left to do.
+    TEST_CHECK(asset_stream_poll(queued, 0) == ASSET_STATUS_CANCELLED);
+    TEST_CHECK(!asset_stream_cancel(queued));
+
+    // The loading one finishes cancelled once the read returns.
+    TEST_CHECK(asset_stream_cancel(gate));
+    _close_gate();
+    _wait_finished(gate);
+    TEST_CHECK(asset_stream_poll(gate, 0) == ASSET_STATUS_CANCELLED);
+
+    _drain_all();
+    TEST_CHECK(g_call_count == 2);
+    TEST_CHECK(g_call_status[0] == ASSET_STATUS_CANCELLED && g_calls[0] == 1);
+    TEST_CHECK(g_call_status[1] == ASSET_STATUS_CANCELLED && g_calls[1] == 0);
+    asset_stream_shutdown();
+}
+
+// Requests released after finishing but before drain reached them must not
+// leave dead entries behind for new requests to pile on top of.
+static void release_before_drain(void) {
+    asset_stream_init(1, 4);
+    _reset_calls();
+    handle_t requests[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        requests[i] = asset_stream_request(MISSING_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_NORMAL, _record,
+                                           (void *) (uintptr_t) i);
+        TEST_CHECK(handle_is_valid(requests[i]));
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        _wait_finished(requests[i]);
+    }
+    for (uint32_t i = 1; i < 4; i++) {
+        asset_stream_release(requests[i]);
+    }
+
+    // Released slots only come back once drain has been through them.
+    TEST_CHECK(!handle_is_valid(asset_stream_request(MISSING_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_NORMAL,
+                                                     _record, (void *) 9)));
+    TEST_CHECK(asset_stream_drain(MAX_CALLS) == 1);
+    TEST_CHECK(g_call_count == 1 && g_calls[0] == 0);
+    TEST_CHECK(asset_stream_pending() == 0);
+
+    for (uint32_t i = 0; i < 4; i++) {
+        requests[i] = asset_stream_request(MISSING_PATH, ASSET_REQUEST_READ, ASSET_PRIORITY_NORMAL, _record,
+                                           (void *) (uintptr_t) (10 + i));
+        TEST_CHECK(handle_is_valid(requests[i]));
+    }
+    _drain_all();
+    TEST_CHECK(g_call_count == 5);
+    for (uint32_t i = 1; i < 5 && i < g_call_count; i++) {
+        TEST_CHECK(g_calls[i] == 9 + i);
+    }
+    asset_stream_shutdown();
+}
+
+int main(void) {
+    TEST_RUN(priorities_decide_order);
+    TEST_RUN(cancel_queued_and_loading);
+    TEST_RUN(release_before_drain);
+    return TEST_RESULT();
+}
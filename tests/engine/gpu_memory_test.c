@@ -0,0 +1,448 @@
+#include <engine/backend/gpu.h>
+#include <engine/backend/gpu_memory.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+// gpu_memory.c only keeps the books, so it runs against a fake device: a
+// device local heap whose one type resources use, and a host heap with a
+// cached, non coherent type that only raw allocations ask for. Handles are
+// counters, every object remembers the size it was created with, and mapped
+// pointers are never dereferenced.
+#define FAKE_HEAP_SIZE (1ull << 30)
+#define FAKE_OBJECTS 4096
+#define FAKE_ATOM 64
+
+static uintptr_t g_next_handle = 1;
+static VkDeviceSize g_object_size[FAKE_OBJECTS];
+static int g_live_memory = 0;
+static int g_copies = 0;
+static int g_invalidates = 0;
+static VkMappedMemoryRange g_last_range;
+
+static uintptr_t _new_object(VkDeviceSize size) {
+    const uintptr_t handle = g_next_handle++;
+    if (handle < FAKE_OBJECTS) {
+        g_object_size[handle] = size;
+    }
+    return handle;
+}
+
+VkDevice gpu_get_vk_device() { return (VkDevice)1; }
+VkPhysicalDevice gpu_get_vk_phy_device() { return (VkPhysicalDevice)1; }
+uint8_t gpu_has_memory_budget() { return 0; }
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice device,
+                                                         VkPhysicalDeviceProperties *props) {
+    (void)device;
+    memset(props, 0, sizeof(*props));
+    props->limits.nonCoherentAtomSize = FAKE_ATOM;
+    props->limits.maxMemoryAllocationCount = 4096;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
+    VkPhysicalDevice device, VkPhysicalDeviceMemoryProperties *props) {
+    (void)device;
+    memset(props, 0, sizeof(*props));
+    props->memoryTypeCount = 2;
+    props->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    props->memoryTypes[0].heapIndex = 0;
+    props->memoryTypes[1].propertyFlags =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    props->memoryTypes[1].heapIndex = 1;
+    props->memoryHeapCount = 2;
+    props->memoryHeaps[0].size = FAKE_HEAP_SIZE;
+    props->memoryHeaps[1].size = FAKE_HEAP_SIZE;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties2(
+    VkPhysicalDevice device, VkPhysicalDeviceMemoryProperties2 *props) {
+    (void)device;
+    (void)props;
+    abort();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *info,
+                                                const VkAllocationCallbacks *allocator,
+                                                VkDeviceMemory *memory) {
+    (void)device;
+    (void)allocator;
+    *memory = (VkDeviceMemory)_new_object(info->allocationSize);
+    g_live_memory++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory,
+                                        const VkAllocationCallbacks *allocator) {
+    (void)device;
+    (void)memory;
+    (void)allocator;
+    g_live_memory--;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device, VkDeviceMemory memory,
+                                           VkDeviceSize offset, VkDeviceSize size,
+                                           VkMemoryMapFlags flags, void **data) {
+    (void)device;
+    (void)memory;
+    (void)offset;
+    (void)size;
+    (void)flags;
+    *data = (void *)(uintptr_t)0x10000;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(VkDevice device, uint32_t count,
+                                                         const VkMappedMemoryRange *ranges) {
+    (void)device;
+    (void)count;
+    (void)ranges;
+    abort();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice device, uint32_t count,
+                                                              const VkMappedMemoryRange *ranges) {
+    (void)device;
+    TEST_CHECK(count == 1);
+    g_last_range = ranges[0];
+    g_invalidates++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice device, VkDeviceMemory memory) {
+    (void)device;
+    (void)memory;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice device, const VkBufferCreateInfo *info,
+                                              const VkAllocationCallbacks *allocator,
+                                              VkBuffer *buffer) {
+    (void)device;
+    (void)allocator;
+    *buffer = (VkBuffer)_new_object(info->size);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice device, VkBuffer buffer,
+                                           const VkAllocationCallbacks *allocator) {
+    (void)device;
+    (void)buffer;
+    (void)allocator;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice device, const VkImageCreateInfo *info,
+                                             const VkAllocationCallbacks *allocator,
+                                             VkImage *image) {
+    (void)device;
+    (void)allocator;
+    *image = (VkImage)_new_object((VkDeviceSize)info->extent.width * info->extent.height * 4);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice device, VkImage image,
+                                          const VkAllocationCallbacks *allocator) {
+    (void)device;
+    (void)image;
+    (void)allocator;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice device, VkBuffer buffer,
+                                                         VkMemoryRequirements *requirements) {
+    (void)device;
+    requirements->size = g_object_size[(uintptr_t)buffer];
+    requirements->alignment = 256;
+    requirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(
+    VkDevice device, const VkBufferMemoryRequirementsInfo2 *info,
+    VkMemoryRequirements2 *requirements) {
+    vkGetBufferMemoryRequirements(device, info->buffer, &requirements->memoryRequirements);
+    VkMemoryDedicatedRequirements *dedicated = requirements->pNext;
+    dedicated->prefersDedicatedAllocation = VK_FALSE;
+    dedicated->requiresDedicatedAllocation = VK_FALSE;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(
+    VkDevice device, const VkImageMemoryRequirementsInfo2 *info,
+    VkMemoryRequirements2 *requirements) {
+    (void)device;
+    requirements->memoryRequirements.size = g_object_size[(uintptr_t)info->image];
+    requirements->memoryRequirements.alignment = 4096;
+    requirements->memoryRequirements.memoryTypeBits = 1;
+    VkMemoryDedicatedRequirements *dedicated = requirements->pNext;
+    dedicated->prefersDedicatedAllocation = VK_FALSE;
+    dedicated->requiresDedicatedAllocation = VK_FALSE;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device, VkBuffer buffer,
+                                                  VkDeviceMemory memory, VkDeviceSize offset) {
+    (void)device;
+    (void)buffer;
+    (void)memory;
+    (void)offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device, VkImage image,
+                                                 VkDeviceMemory memory, VkDeviceSize offset) {
+    (void)device;
+    (void)image;
+    (void)memory;
+    (void)offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(
+    VkCommandBuffer cmd, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages,
+    VkDependencyFlags flags, uint32_t memory_barrier_count, const VkMemoryBarrier *memory_barriers,
+    uint32_t buffer_barrier_count, const VkBufferMemoryBarrier *buffer_barriers,
+    uint32_t image_barrier_count, const VkImageMemoryBarrier *image_barriers) {
+    (void)cmd;
+    (void)src_stages;
+    (void)dst_stages;
+    (void)flags;
+    (void)memory_barrier_count;
+    (void)memory_barriers;
+    (void)buffer_barrier_count;
+    (void)buffer_barriers;
+    (void)image_barrier_count;
+    (void)image_barriers;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer cmd, VkBuffer src, VkBuffer dst,
+                                           uint32_t region_count, const VkBufferCopy *regions) {
+    (void)cmd;
+    (void)src;
+    (void)dst;
+    (void)regions;
+    g_copies += (int)region_count;
+}
+
+static gpu_allocation_t _buffer(VkDeviceSize size, VkBuffer *buffer) {
+    VkBufferCreateInfo info;
+    memset(&info, 0, sizeof(info));
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    gpu_allocation_t allocation;
+    TEST_CHECK(gpu_buffer_create(&info, GPU_MEMORY_DEVICE, buffer, &allocation) == VK_SUCCESS);
+    return allocation;
+}
+
+static gpu_allocation_t _linear_image(uint32_t width, uint32_t height, VkImage *image) {
+    VkImageCreateInfo info;
+    memset(&info, 0, sizeof(info));
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.extent.width = width;
+    info.extent.height = height;
+    info.extent.depth = 1;
+    info.tiling = VK_IMAGE_TILING_LINEAR;
+    gpu_allocation_t allocation;
+    TEST_CHECK(gpu_image_create(&info, GPU_MEMORY_DEVICE, image, &allocation) == VK_SUCCESS);
+    return allocation;
+}
+
+static void small_buffers_share_a_block(void) {
+    gpu_memory_init();
+    VkBuffer buffers[32];
+    gpu_allocation_t allocations[32];
+    for (uint32_t i = 0; i < 32; i++) {
+        allocations[i] = _buffer(1u << 20, &buffers[i]);
+    }
+
+    gpu_memory_stats_t stats;
+    gpu_memory_get_stats(&stats);
+    TEST_CHECK(stats.blocks == 1);
+    TEST_CHECK(stats.allocations == 32);
+    TEST_CHECK(stats.dedicated == 0);
+    TEST_CHECK(stats.used_bytes == 32ull << 20);
+    TEST_CHECK(g_live_memory == 1);
+
+    for (uint32_t i = 0; i < 32; i++) {
+        gpu_allocation_info_t info;
+        TEST_CHECK(gpu_memory_info(allocations[i], &info));
+        TEST_CHECK(info.offset % 256 == 0);
+        TEST_CHECK(info.offset + info.size <= GPU_MEMORY_BLOCK_SIZE);
+        TEST_CHECK(!info.dedicated);
+        TEST_CHECK(!info.mapped);
+    }
+    for (uint32_t i = 0; i < 32; i++) {
+        gpu_buffer_destroy(buffers[i], allocations[i]);
+    }
+    // The last block of a pool is kept around.
+    gpu_memory_get_stats(&stats);
+    TEST_CHECK(stats.allocations == 0);
+    TEST_CHECK(stats.blocks == 1);
+    gpu_memory_shutdown();
+    TEST_CHECK(g_live_memory == 0);
+}
+
+static void large_buffers_are_dedicated(void) {
+    gpu_memory_init();
+    VkBuffer buffer;
+    const gpu_allocation_t allocation = _buffer(GPU_MEMORY_BLOCK_SIZE, &buffer);
+    gpu_allocation_info_t info;
+    TEST_CHECK(gpu_memory_info(allocation, &info));
+    TEST_CHECK(info.dedicated);
+    TEST_CHECK(info.offset == 0);
+
+    gpu_memory_stats_t stats;
+    gpu_memory_get_stats(&stats);
+    TEST_CHECK(stats.blocks == 0);
+    TEST_CHECK(stats.dedicated == 1);
+    TEST_CHECK(stats.dedicated_bytes == GPU_MEMORY_BLOCK_SIZE);
+    gpu_buffer_destroy(buffer, allocation);
+    TEST_CHECK(g_live_memory == 0);
+    gpu_memory_shutdown();
+}
+
+static void stale_handles_are_ignored(void) {
+    gpu_memory_init();
+    VkBuffer buffer;
+    const gpu_allocation_t first = _buffer(4096, &buffer);
+    gpu_buffer_destroy(buffer, first);
+    gpu_allocation_info_t info;
+    TEST_CHECK(!gpu_memory_info(first, &info));
+    // Reuses the slot, the old handle must not reach the new record.
+    const gpu_allocation_t second = _buffer(4096, &buffer);
+    TEST_CHECK(!gpu_memory_info(first, &info));
+    gpu_memory_free(first);
+    TEST_CHECK(gpu_memory_info(second, &info));
+    gpu_buffer_destroy(buffer, second);
+    gpu_memory_shutdown();
+    TEST_CHECK(g_live_memory == 0);
+}
+
+// Ranges of non coherent memory widen to whole atoms and stop at the end of
+// the memory, coherent and device memory is left alone.
+static void invalidate_rounds_to_atoms(void) {
+    gpu_memory_init();
+    VkBuffer buffer;
+    const gpu_allocation_t device = _buffer(4096, &buffer);
+    TEST_CHECK(gpu_memory_invalidate(device, 0, VK_WHOLE_SIZE));
+    TEST_CHECK(g_invalidates == 0);
+
+    VkMemoryRequirements requirements = {1000, 16, 2};
+    const gpu_allocation_t first = gpu_memory_alloc(&requirements, GPU_MEMORY_READBACK, 1);
+    const gpu_allocation_t second = gpu_memory_alloc(&requirements, GPU_MEMORY_READBACK, 1);
+    gpu_allocation_info_t info;
+    TEST_CHECK(gpu_memory_info(second, &info));
+    TEST_CHECK(info.memory_type == 1 && info.mapped && !info.dedicated);
+    TEST_CHECK(info.offset % FAKE_ATOM == 0);
+
+    TEST_CHECK(gpu_memory_invalidate(second, 10, 100));
+    TEST_CHECK(g_invalidates == 1);
+    TEST_CHECK(g_last_range.memory == info.memory);
+    TEST_CHECK(g_last_range.offset == info.offset);
+    TEST_CHECK(g_last_range.size == 2 * FAKE_ATOM);
+
+    TEST_CHECK(gpu_memory_invalidate(second, 100, VK_WHOLE_SIZE));
+    TEST_CHECK(g_last_range.offset == info.offset + FAKE_ATOM);
+    TEST_CHECK(g_last_range.size == 1024 - FAKE_ATOM);
+
+    // Dedicated memory is exactly the requested size, the last partial atom
+    // is clamped to it.
+    VkMemoryRequirements large = {(FAKE_HEAP_SIZE / 8) + 10, 16, 2};
+    const gpu_allocation_t dedicated = gpu_memory_alloc(&large, GPU_MEMORY_READBACK, 1);
+    TEST_CHECK(gpu_memory_info(dedicated, &info) && info.dedicated);
+    TEST_CHECK(gpu_memory_invalidate(dedicated, 0, VK_WHOLE_SIZE));
+    TEST_CHECK(g_last_range.offset == 0 && g_last_range.size == large.size);
+
+    gpu_memory_free(dedicated);
+    TEST_CHECK(!gpu_memory_invalidate(dedicated, 0, VK_WHOLE_SIZE));
+    gpu_memory_free(first);
+    gpu_memory_free(second);
+    gpu_buffer_destroy(buffer, device);
+    gpu_memory_shutdown();
+    TEST_CHECK(g_live_memory == 0);
+}
+
+static uint32_t g_moved = 0;
+
+static void _on_moved(gpu_allocation_t allocation, void *user_data) {
+    (void)allocation;
+    (void)user_data;
+    g_moved++;
+}
+
+// Buffers and linear images share a pool. Only the buffer may leave the
+// emptiest block, the image stays bound where it was.
+static void defrag_moves_only_buffers(void) {
+    gpu_memory_init();
+    const VkDeviceSize eighth = GPU_MEMORY_BLOCK_SIZE / 8;
+    // Fill the first block until an eighth no longer fits, the one that
+    // spilled opened a second block.
+    VkBuffer fill[9];
+    gpu_allocation_t fill_allocations[9];
+    gpu_allocation_info_t first_block;
+    uint32_t fill_count = 0;
+    for (; fill_count < 9; fill_count++) {
+        fill_allocations[fill_count] = _buffer(eighth, &fill[fill_count]);
+        gpu_allocation_info_t info;
+        TEST_CHECK(gpu_memory_info(fill_allocations[fill_count], &info));
+        if (fill_count == 0) {
+            first_block = info;
+        } else if (info.memory != first_block.memory) {
+            break;
+        }
+    }
+    TEST_CHECK(fill_count < 9 && fill_count >= 2);
+    VkImage image;
+    const gpu_allocation_t image_allocation = _linear_image(2048, 1024, &image);
+    VkBuffer buffer;
+    const gpu_allocation_t buffer_allocation = _buffer(eighth, &buffer);
+
+    gpu_memory_stats_t stats;
+    gpu_memory_get_stats(&stats);
+    TEST_CHECK(stats.blocks == 2);
+    // Leaves the image and the buffer alone in the emptier second block, with
+    // room for them in the first.
+    gpu_buffer_destroy(fill[fill_count], fill_allocations[fill_count]);
+    gpu_buffer_destroy(fill[0], fill_allocations[0]);
+    gpu_buffer_destroy(fill[1], fill_allocations[1]);
+
+    gpu_allocation_info_t image_before;
+    gpu_allocation_info_t buffer_before;
+    TEST_CHECK(gpu_memory_info(image_allocation, &image_before));
+    TEST_CHECK(gpu_memory_info(buffer_allocation, &buffer_before));
+    TEST_CHECK(image_before.memory != first_block.memory);
+    TEST_CHECK(buffer_before.memory == image_before.memory);
+
+    g_copies = 0;
+    g_moved = 0;
+    TEST_CHECK(gpu_memory_defrag_begin((VkCommandBuffer)1, ~0ull) == 1);
+    TEST_CHECK(g_copies == 1);
+    gpu_memory_defrag_end(_on_moved, 0);
+    TEST_CHECK(g_moved == 1);
+
+    gpu_allocation_info_t image_after;
+    gpu_allocation_info_t buffer_after;
+    TEST_CHECK(gpu_memory_info(image_allocation, &image_after));
+    TEST_CHECK(gpu_memory_info(buffer_allocation, &buffer_after));
+    TEST_CHECK(image_after.memory == image_before.memory);
+    TEST_CHECK(image_after.offset == image_before.offset);
+    TEST_CHECK(buffer_after.memory == first_block.memory);
+
+    // Nothing else is movable out of the image's block.
+    TEST_CHECK(gpu_memory_defrag_begin((VkCommandBuffer)1, ~0ull) == 0);
+    gpu_memory_defrag_end(0, 0);
+
+    for (uint32_t i = 2; i < fill_count; i++) {
+        gpu_buffer_destroy(fill[i], fill_allocations[i]);
+    }
+    gpu_image_destroy(image, image_allocation);
+    gpu_buffer_destroy(buffer, buffer_allocation);
+    gpu_memory_shutdown();
+    TEST_CHECK(g_live_memory == 0);
+}
+
+int main(void) {
+    TEST_RUN(small_buffers_share_a_block);
+    TEST_RUN(large_buffers_are_dedicated);
+    TEST_RUN(stale_handles_are_ignored);
+    TEST_RUN(invalidate_rounds_to_atoms);
+    TEST_RUN(defrag_moves_only_buffers);
+    return TEST_RESULT();
+}
@@ -0,0 +1,27 @@
+#ifndef POTENTIA_TEST_H
+#define POTENTIA_TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for the CPU-only tests. A failed check reports and carries
+// on so one run shows every failure; main returns TEST_RESULT().
+static int g_test_failures = 0;
+
+#define TEST_CHECK(cond)                                                           \
+    do {                                                                           \
+        if (!(cond)) {                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_test_failures++;                                                     \
+        }                                                                          \
+    } while (0)
+
+#define TEST_RUN(fn)                                                   \
+    do {                                                               \
+        const int failures_before = g_test_failures;                   \
+        fn();                                                          \
+        printf("%s %s\n", g_test_failures == failures_before ? "ok  " : "FAIL", #fn); \
+    } while (0)
+
+#define TEST_RESULT() (g_test_failures == 0 ? 0 : 1)
+
+#endif
@@ -1,11 +1,64 @@
 #ifndef ASSETS_MESH_H
 #define ASSETS_MESH_H
+#include <core/arrays.h>
 #include <core/defines.h>
 #include <core/handle.h>
+#include "assets/mesh_encode.h"
+#include "assets/mesh_optimise.h"
 
-int mesh_load(const char *filename, handle_t* handle);
+#define MESH_IMPORT_OPTIMISE (1u << 0)
 
-void mesh_save(const char *filename, handle_t *handle);
+// Everything that changes the compiled output must live here, the batch
+// cache keys on mesh_import_options_hash.
+typedef struct {
+    u32 post_process;
+    u32 flags;
+    u32 encode_flags;
+    u32 lod_count;
+    f32 lod_ratios[MESH_LOD_MAX];
+    // Zero disables meshlet generation.
+    u32 meshlet_max_vertices;
+    u32 meshlet_max_triangles;
+} mesh_import_options_t;
+
+typedef struct {
+    mesh_cache_stats_t before;
+    mesh_cache_stats_t after;
+    u64 vertices_before;
+    u64 vertices_after;
+} mesh_optimise_stats_t;
+
+typedef struct {
+    mesh_optimise_stats_t optimise;
+    mesh_encoding_report_t encoding;
+    u32 lod_count;
+    mesh_file_lod_t lods[MESH_LOD_MAX];
+    u64 meshlet_count;
+    f32 meshlet_vertices_mean;
+    f32 meshlet_triangles_mean;
+    u32 submesh_count;
+    u32 node_count;
+} mesh_report_t;
+
+// Files an import read besides the input itself, such as .mtl or .bin files,
+// with paths as the importer opened them.
+typedef ARRAY(char *) mesh_dependencies_t;
+
+mesh_import_options_t mesh_import_options_default();
+u64 mesh_import_options_hash(const mesh_import_options_t *options);
+
+int mesh_load(const char *filename, const mesh_import_options_t *options, handle_t* handle);
+// mesh_load that also appends every dependency to dependencies, which may be
+// 0.
+int mesh_load_tracked(const char *filename, const mesh_import_options_t *options, handle_t *handle,
+                      mesh_dependencies_t *dependencies);
+void mesh_dependencies_free(mesh_dependencies_t *dependencies);
+
+int mesh_save(const char *filename, handle_t *handle);
+
+int mesh_get_report(handle_t *handle, mesh_report_t *report);
+
+void mesh_release(handle_t *handle);
 
 void mesh_cleanup();
 
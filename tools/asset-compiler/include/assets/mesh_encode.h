@@ -0,0 +1,69 @@
+#ifndef ASSETS_MESH_ENCODE_H
+#define ASSETS_MESH_ENCODE_H
+
+#include <core/defines.h>
+#include <core/mesh_format.h>
+
+#define MESH_ENCODE_POSITIONS (1u << 0)
+#define MESH_ENCODE_NORMALS (1u << 1)
+#define MESH_ENCODE_TEX_COORDS (1u << 2)
+#define MESH_ENCODE_INDICES (1u << 3)
+#define MESH_ENCODE_ALL (MESH_ENCODE_POSITIONS | MESH_ENCODE_NORMALS | MESH_ENCODE_TEX_COORDS | MESH_ENCODE_INDICES)
+
+// Planar f32 attributes as they come out of import, null when absent.
+typedef struct {
+    const f32 *positions;
+    const f32 *normals;
+    const f32 *tangents;
+    const f32 *tex_coords;
+    const u32 *indices;
+    u64 vertex_count;
+    u64 index_count;
+    // Largest index + 1, smaller than vertex_count when indices are relative
+    // to a per submesh base vertex. Zero means vertex_count.
+    u64 index_range;
+    // Vertex ranges quantised against their own bounds, null for a single
+    // range covering every vertex.
+    const mesh_file_submesh_t *submeshes;
+    u32 submesh_count;
+} mesh_attributes_t;
+
+typedef struct {
+    void *data;
+    u64 count;
+    u32 stride;
+    u16 encoding;
+} mesh_encoded_stream_t;
+
+typedef struct {
+    // One per submesh, or a single entry when the attributes have none.
+    mesh_file_bounds_t *bounds;
+    u32 bounds_count;
+    mesh_encoded_stream_t positions;
+    mesh_encoded_stream_t normals;
+    mesh_encoded_stream_t tangents;
+    mesh_encoded_stream_t tex_coords;
+    mesh_encoded_stream_t indices;
+} mesh_encoded_t;
+
+// Round trip error of the chosen encodings, measured by decoding the
+// encoded streams with the same code the runtime uses. The relative position
+// error is against the diagonal of the vertex's own submesh.
+typedef struct {
+    f32 position_max;
+    f32 position_mean;
+    f32 position_max_relative;
+    f32 normal_max_deg;
+    f32 normal_mean_deg;
+    f32 tangent_max_deg;
+    f32 tex_coord_max;
+    f32 tex_coord_mean;
+} mesh_encoding_report_t;
+
+mesh_file_bounds_t mesh_compute_bounds(const f32 *positions, u64 vertex_count);
+void mesh_encode(const mesh_attributes_t *attributes, u32 flags, mesh_encoded_t *out);
+void mesh_encode_report(const mesh_attributes_t *attributes, const mesh_encoded_t *encoded,
+                        mesh_encoding_report_t *report);
+void mesh_encoded_free(mesh_encoded_t *encoded);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ASSETS_MESH_MESHLET_H
+#define ASSETS_MESH_MESHLET_H
+
+#include <core/defines.h>
+#include <core/mesh_format.h>
+
+#define MESHLET_DEFAULT_MAX_VERTICES 64
+#define MESHLET_DEFAULT_MAX_TRIANGLES 124
+
+typedef struct {
+    mesh_file_meshlet_t *meshlets;
+    mesh_file_meshlet_bounds_t *bounds;
+    u64 meshlet_count;
+    u32 *vertices;
+    u64 vertex_count;
+    u8 *triangles;
+    u64 triangle_bytes;
+} mesh_meshlets_t;
+
+// Greedy clustering that grows each meshlet through triangles sharing its
+// vertices, preferring the one adding the fewest new vertices. The result
+// only depends on the input, so it is stable across runs and machines.
+void mesh_build_meshlets(const u32 *indices, u64 index_count, const f32 *positions, u64 vertex_count,
+                         u32 max_vertices, u32 max_triangles, mesh_meshlets_t *out);
+mesh_file_meshlet_bounds_t mesh_compute_meshlet_bounds(const mesh_file_meshlet_t *meshlet,
+                                                       const u32 *meshlet_vertices, const u8 *meshlet_triangles,
+                                                       const f32 *positions);
+void mesh_meshlets_free(mesh_meshlets_t *meshlets);
+
+#endif
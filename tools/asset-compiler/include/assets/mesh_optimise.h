@@ -0,0 +1,42 @@
+#ifndef ASSETS_MESH_OPTIMISE_H
+#define ASSETS_MESH_OPTIMISE_H
+
+#include <core/defines.h>
+
+#define MESH_OPT_CACHE_SIZE 16
+#define MESH_OPT_OVERDRAW_THRESHOLD 1.05f
+
+// One interleaved or planar vertex stream, used for deduplication and remaps.
+typedef struct {
+    void *data;
+    u64 stride;
+} mesh_opt_stream_t;
+
+typedef struct {
+    f32 acmr;
+    f32 atvr;
+} mesh_cache_stats_t;
+
+mesh_cache_stats_t mesh_opt_analyse_cache(const u32 *indices, u64 index_count, u64 vertex_count,
+                                          u32 cache_size);
+
+// Builds remap[old] = new so that bitwise identical vertices (across every
+// stream) collapse onto one. Returns the unique vertex count.
+u64 mesh_opt_generate_remap(u32 *remap, const u32 *indices, u64 index_count,
+                            const mesh_opt_stream_t *streams, u32 stream_count, u64 vertex_count);
+
+void mesh_opt_remap_indices(u32 *dst, const u32 *indices, u64 index_count, const u32 *remap);
+void mesh_opt_remap_vertices(void *dst, const void *src, u64 vertex_count, u64 stride, const u32 *remap);
+
+// Forsyth style post-transform cache reordering of triangles.
+void mesh_opt_vertex_cache(u32 *dst, const u32 *indices, u64 index_count, u64 vertex_count);
+
+// Tipsify style cluster sort on an already cache optimised list, outward
+// facing clusters first. Threshold bounds the ACMR cost of the extra splits.
+void mesh_opt_overdraw(u32 *dst, const u32 *indices, u64 index_count, const f32 *positions,
+                       u64 vertex_count, u64 position_stride, f32 threshold);
+
+// Builds remap in first-use order and returns the referenced vertex count.
+u64 mesh_opt_vertex_fetch_remap(u32 *remap, const u32 *indices, u64 index_count, u64 vertex_count);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef ASSETS_MESH_SIMPLIFY_H
+#define ASSETS_MESH_SIMPLIFY_H
+
+#include <core/defines.h>
+
+// Quadric error metric edge collapse. Vertices are never moved or created, so
+// every LOD can index the same vertex buffer. Open borders and attribute seams
+// are locked. Stops at target_index_count or once a collapse would exceed
+// max_error (object space distance, 0 for unbounded). Returns the new index
+// count and writes the resulting deviation to out_error.
+u64 mesh_simplify(u32 *dst, const u32 *indices, u64 index_count, const f32 *positions, u64 vertex_count,
+                  u64 target_index_count, f32 max_error, f32 *out_error);
+
+#endif
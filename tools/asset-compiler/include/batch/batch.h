@@ -0,0 +1,62 @@
+#ifndef BATCH_BATCH_H
+#define BATCH_BATCH_H
+
+#include <core/defines.h>
+#include "assets/mesh.h"
+
+typedef enum {
+    BATCH_JOB_PENDING = 0,
+    BATCH_JOB_COMPILED,
+    BATCH_JOB_SKIPPED,
+    BATCH_JOB_FAILED,
+} batch_job_status_t;
+
+typedef struct {
+    char *input;
+    char *relative;
+    char *output;
+    u64 key;
+    mesh_dependencies_t dependencies;
+    batch_job_status_t status;
+    mesh_report_t report;
+} batch_job_t;
+
+typedef struct {
+    batch_job_t *jobs;
+    u64 count;
+    u64 capacity;
+} batch_job_list_t;
+
+// Encoding error gates, a compiled mesh exceeding any of them fails its job.
+// Zero disables a gate. Part of the cache key, so tightening a limit
+// recompiles everything.
+typedef struct {
+    f32 position_relative;
+    // Normals and tangents both.
+    f32 normal_deg;
+    f32 tex_coord;
+} batch_error_limits_t;
+
+typedef struct {
+    const char *output_dir;
+    u32 worker_count;
+    b8 force;
+    mesh_import_options_t options;
+    batch_error_limits_t limits;
+} batch_config_t;
+
+typedef struct {
+    u64 compiled;
+    u64 skipped;
+    u64 failed;
+    f64 seconds;
+} batch_stats_t;
+
+int batch_collect_directory(const char *dir, batch_job_list_t *list);
+int batch_collect_manifest(const char *manifest, batch_job_list_t *list);
+void batch_job_list_free(batch_job_list_t *list);
+
+u32 batch_default_worker_count();
+batch_stats_t batch_run(const batch_config_t *config, batch_job_list_t *list);
+
+#endif
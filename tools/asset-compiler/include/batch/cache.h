@@ -0,0 +1,34 @@
+#ifndef BATCH_CACHE_H
+#define BATCH_CACHE_H
+
+#include <core/defines.h>
+
+// Incremental build cache: relative input path -> key of the last successful
+// compile. The key mixes the content hash of the input and of every file the
+// import read besides it with the import options. Those dependencies are kept
+// so the next run can hash them again before deciding to skip.
+typedef struct {
+    char *path;
+    u64 key;
+    char **dependencies;
+    u32 dependency_count;
+} asset_cache_entry_t;
+
+typedef struct {
+    asset_cache_entry_t *entries;
+    u64 count;
+    u64 capacity;
+} asset_cache_t;
+
+int asset_cache_load(asset_cache_t *cache, const char *filename);
+int asset_cache_save(const asset_cache_t *cache, const char *filename);
+// Null when path has no entry.
+const asset_cache_entry_t *asset_cache_lookup(const asset_cache_t *cache, const char *path);
+// Copies path and dependencies.
+void asset_cache_set(asset_cache_t *cache, const char *path, u64 key, char *const *dependencies,
+                     u32 dependency_count);
+void asset_cache_free(asset_cache_t *cache);
+
+int asset_hash_file(const char *filename, u64 seed, u64 *hash);
+
+#endif
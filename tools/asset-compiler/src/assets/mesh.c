@@ -1,128 +1,872 @@
 #include "assets/mesh.h"
+#include "assets/mesh_meshlet.h"
+#include "assets/mesh_optimise.h"
+#include "assets/mesh_simplify.h"
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <core/arrays.h>
+#include <string.h>
+#include <threads.h>
+#include <core/arena.h>
 #include <core/bitwise.h>
+#include <core/handle_pool.h>
+#include <core/hash.h>
+#include <core/mesh_format.h>
 
+#include <assimp/cfileio.h>
 #include <assimp/cimport.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
-#define ARRAY_START_LEN 8
+#define MESH_SECTION_MAX 16
+#define MESH_ATTRIBUTE_COUNT 4
+#define MESH_SCRATCH_BLOCK_SIZE (4ull << 20)
 
 
 typedef struct {
     b8 indices;
     b8 tex_coords;
+    b8 normals;
+    b8 tangents;
 } mesh_features_t;
 
+// Used both for a single imported submesh while it is processed and for the
+// pooled scene that gets saved. Only the latter fills in the scene tables.
 typedef struct {
-    f32 *vertices;
+    f32 *positions;
+    f32 *normals;
+    f32 *tangents;
+    f32 *tex_coords;
     u32 *indices;
-    u64 vertices_size;
-    u64 indices_size;
-    mesh_features_t *features;
+    u64 vertex_count;
+    u64 index_count;
+    mesh_features_t features;
+    mesh_file_lod_t *lods;
+    u32 lod_count;
+    mesh_meshlets_t meshlets;
+    u32 material_index;
+    mesh_file_submesh_t *submeshes;
+    u32 submesh_count;
+    mesh_file_node_t *nodes;
+    f32 *node_transforms;
+    u32 *node_meshes;
+    u32 node_count;
+    u32 node_mesh_count;
+    mesh_encoded_t encoded;
+    mesh_report_t report;
 } mesh_t;
 
-u32 _make_mesh_features_bitmask(mesh_features_t *features);
+typedef struct {
+    u32 type;
+    u32 encoding;
+    u32 stride;
+    u64 count;
+    const void *data;
+} mesh_section_desc_t;
 
-static u64 meshes_count = 0;
-static u64 meshes_capacity = ARRAY_START_LEN;
-static mesh_t**meshes = malloc(ARRAY_START_LEN * sizeof(mesh_t));
+u32 _make_mesh_features_bitmask(const mesh_features_t *features);
 
-int mesh_load(const char *filename, handle_t *handle) {
-    const struct aiScene *scene = aiImportFile(filename, aiProcess_Triangulate);
-    if (!scene) {
-        aiReleaseImport(scene);
-        return 1;
+// Holds mesh_t pointers so a mesh stays put while the pool reshuffles.
+static handle_pool_t meshes;
+
+// Batch mode imports on several threads, the store itself is shared.
+static mtx_t meshes_lock;
+static once_flag meshes_lock_once = ONCE_FLAG_INIT;
+
+static void _init_meshes_lock() {
+    mtx_init(&meshes_lock, mtx_plain);
+    handle_pool_init(&meshes, sizeof(mesh_t *), 0);
+}
+
+mesh_import_options_t mesh_import_options_default() {
+    mesh_import_options_t options;
+    options.post_process = aiProcess_Triangulate | aiProcess_CalcTangentSpace;
+    options.flags = 0;
+    options.encode_flags = 0;
+    options.lod_count = 0;
+    for (u32 i = 0; i < MESH_LOD_MAX; i++) {
+        options.lod_ratios[i] = 0.f;
     }
+    options.meshlet_max_vertices = 0;
+    options.meshlet_max_triangles = 0;
+    return options;
+}
 
-    struct aiMesh *mesh = *scene->mMeshes;
+u64 mesh_import_options_hash(const mesh_import_options_t *options) {
+    u64 h = MESH_FORMAT_VERSION;
+    h = hash_combine(h, options->post_process);
+    h = hash_combine(h, options->flags);
+    h = hash_combine(h, options->encode_flags);
+    h = hash_combine(h, options->lod_count);
+    h = hash_combine(h, hash_bytes(options->lod_ratios, options->lod_count * sizeof(f32), 0));
+    h = hash_combine(h, options->meshlet_max_vertices);
+    h = hash_combine(h, options->meshlet_max_triangles);
+    return h;
+}
 
-    float *vertices = malloc(3 * mesh[0].mNumVertices * sizeof(float));
-    if (!vertices) {
-        aiReleaseImport(scene);
-        return 1;
+// Planar attribute streams of a mesh, in a fixed order, with their widths.
+static u32 _attribute_streams(mesh_t *mesh, f32 ***slots, u32 *components) {
+    f32 **all[MESH_ATTRIBUTE_COUNT] = {&mesh->positions, &mesh->normals, &mesh->tangents, &mesh->tex_coords};
+    const u32 widths[MESH_ATTRIBUTE_COUNT] = {3, 3, 4, 2};
+    u32 count = 0;
+    for (u32 i = 0; i < MESH_ATTRIBUTE_COUNT; i++) {
+        if (*all[i]) {
+            slots[count] = all[i];
+            components[count] = widths[i];
+            count++;
+        }
     }
+    return count;
+}
 
-    u32 *indices = malloc(3 * mesh[0].mNumFaces * sizeof(u32));
-    if (!indices) {
-        free(vertices);
-        aiReleaseImport(scene);
-        return 1;
+static void _remap_attributes(mesh_t *mesh, const u32 *remap, u64 new_count) {
+    f32 **slots[MESH_ATTRIBUTE_COUNT];
+    u32 components[MESH_ATTRIBUTE_COUNT];
+    const u32 stream_count = _attribute_streams(mesh, slots, components);
+    for (u32 s = 0; s < stream_count; s++) {
+        const u64 stride = components[s] * sizeof(f32);
+        f32 *remapped = malloc(new_count * stride);
+        mesh_opt_remap_vertices(remapped, *slots[s], mesh->vertex_count, stride, remap);
+        free(*slots[s]);
+        *slots[s] = remapped;
+    }
+    mesh_opt_remap_indices(mesh->indices, mesh->indices, mesh->index_count, remap);
+    mesh->vertex_count = new_count;
+}
+
+static void _optimise_mesh(mesh_t *mesh, arena_t *scratch_arena) {
+    const u64 index_count = mesh->index_count;
+    mesh_optimise_stats_t *stats = &mesh->report.optimise;
+    stats->vertices_before = mesh->vertex_count;
+    stats->before = mesh_opt_analyse_cache(mesh->indices, index_count, mesh->vertex_count, MESH_OPT_CACHE_SIZE);
+
+    const arena_marker_t marker = arena_mark(scratch_arena);
+    u32 *remap = arena_push_array(scratch_arena, u32, mesh->vertex_count);
+    u32 *scratch = arena_push_array(scratch_arena, u32, index_count);
+
+    f32 **slots[MESH_ATTRIBUTE_COUNT];
+    u32 components[MESH_ATTRIBUTE_COUNT];
+    mesh_opt_stream_t streams[MESH_ATTRIBUTE_COUNT];
+    const u32 stream_count = _attribute_streams(mesh, slots, components);
+    for (u32 s = 0; s < stream_count; s++) {
+        streams[s].data = *slots[s];
+        streams[s].stride = components[s] * sizeof(f32);
     }
+    const u64 unique_count = mesh_opt_generate_remap(remap, mesh->indices, index_count, streams, stream_count,
+                                                     mesh->vertex_count);
+    _remap_attributes(mesh, remap, unique_count);
+
+    mesh_opt_vertex_cache(scratch, mesh->indices, index_count, mesh->vertex_count);
+    mesh_opt_overdraw(mesh->indices, scratch, index_count, mesh->positions, mesh->vertex_count, 3 * sizeof(f32),
+                      MESH_OPT_OVERDRAW_THRESHOLD);
 
-    u32 vertex_count = 0;
-    for (unsigned int i = 0; i < mesh[0].mNumVertices; i++) {
-        vertices[vertex_count++] = mesh[0].mVertices[i].x;
-        vertices[vertex_count++] = mesh[0].mVertices[i].y;
-        vertices[vertex_count++] = mesh[0].mVertices[i].z;
+    const u64 fetched_count = mesh_opt_vertex_fetch_remap(remap, mesh->indices, index_count, mesh->vertex_count);
+    _remap_attributes(mesh, remap, fetched_count);
+
+    stats->vertices_after = mesh->vertex_count;
+    stats->after = mesh_opt_analyse_cache(mesh->indices, index_count, mesh->vertex_count, MESH_OPT_CACHE_SIZE);
+
+    arena_reset_to(scratch_arena, marker);
+}
+
+// Replaces the index buffer with every LOD's indices back to back, each
+// simplified from the original so errors are measured against the source.
+static void _generate_lods(mesh_t *mesh, const mesh_import_options_t *options, arena_t *scratch_arena) {
+    const u64 source_count = mesh->index_count;
+    u32 *lod_indices = malloc(options->lod_count * source_count * sizeof(u32));
+    const arena_marker_t marker = arena_mark(scratch_arena);
+    u32 *scratch = arena_push_array(scratch_arena, u32, source_count);
+    mesh->lods = calloc(options->lod_count, sizeof(mesh_file_lod_t));
+
+    u64 offset = 0;
+    f32 previous_error = 0.f;
+    for (u32 i = 0; i < options->lod_count; i++) {
+        const u64 target = (u64) ((f64) source_count * options->lod_ratios[i]) / 3 * 3;
+        f32 error;
+        const u64 count = mesh_simplify(scratch, mesh->indices, source_count, mesh->positions, mesh->vertex_count,
+                                        target, 0.f, &error);
+        if (options->flags & MESH_IMPORT_OPTIMISE) {
+            mesh_opt_vertex_cache(&lod_indices[offset], scratch, count, mesh->vertex_count);
+        } else {
+            memcpy(&lod_indices[offset], scratch, count * sizeof(u32));
+        }
+        // Coarser levels never claim to be more accurate than finer ones.
+        previous_error = error > previous_error ? error : previous_error;
+
+        mesh_file_lod_t *lod = &mesh->lods[i];
+        lod->index_offset = (u32) offset;
+        lod->index_count = (u32) count;
+        lod->error = previous_error;
+        lod->pad = 0.f;
+        offset += count;
     }
+    mesh->lod_count = options->lod_count;
+
+    arena_reset_to(scratch_arena, marker);
+    free(mesh->indices);
+    mesh->indices = lod_indices;
+    mesh->index_count = offset;
+}
 
-    u32 index_count = 0;
-    for (int i = 0; i < mesh[0].mNumFaces; i++) {
-        indices[index_count++] = mesh[0].mFaces[i].mIndices[0];
-        indices[index_count++] = mesh[0].mFaces[i].mIndices[1];
-        indices[index_count++] = mesh[0].mFaces[i].mIndices[2];
+static mesh_attributes_t _mesh_attributes(const mesh_t *mesh) {
+    mesh_attributes_t attributes;
+    attributes.positions = mesh->positions;
+    attributes.normals = mesh->normals;
+    attributes.tangents = mesh->tangents;
+    attributes.tex_coords = mesh->tex_coords;
+    attributes.indices = mesh->indices;
+    attributes.vertex_count = mesh->vertex_count;
+    attributes.index_count = mesh->index_count;
+    attributes.index_range = 0;
+    for (u32 i = 0; i < mesh->submesh_count; i++) {
+        const u64 range = mesh->submeshes[i].vertex_count;
+        attributes.index_range = range > attributes.index_range ? range : attributes.index_range;
     }
+    attributes.submeshes = mesh->submeshes;
+    attributes.submesh_count = mesh->submesh_count;
+    return attributes;
+}
+
+// Meshlets cover the most detailed level only.
+static void _build_meshlets(mesh_t *mesh, const mesh_import_options_t *options) {
+    const u64 offset = mesh->lod_count > 0 ? mesh->lods[0].index_offset : 0;
+    const u64 count = mesh->lod_count > 0 ? mesh->lods[0].index_count : mesh->index_count;
+    mesh_build_meshlets(&mesh->indices[offset], count, mesh->positions, mesh->vertex_count,
+                        options->meshlet_max_vertices, options->meshlet_max_triangles, &mesh->meshlets);
 
-    meshes_count++;
-    ensure_capacity_overalloc((void **) &meshes, &meshes_capacity, meshes_count, sizeof(mesh_t));
+}
+
+void _free_mesh(mesh_t *mesh) {
+    free(mesh->positions);
+    free(mesh->normals);
+    free(mesh->tangents);
+    free(mesh->tex_coords);
+    free(mesh->indices);
+    free(mesh->lods);
+    mesh_meshlets_free(&mesh->meshlets);
+    free(mesh->submeshes);
+    free(mesh->nodes);
+    free(mesh->node_transforms);
+    free(mesh->node_meshes);
+    mesh_encoded_free(&mesh->encoded);
+    free(mesh);
+}
+
+static mesh_t *_import_mesh(const struct aiMesh *src) {
+    // Triangulation leaves point and line primitives alone, those are dropped.
+    u64 triangle_count = 0;
+    for (u64 i = 0; i < src->mNumFaces; i++) {
+        triangle_count += src->mFaces[i].mNumIndices == 3;
+    }
+    if (triangle_count == 0) {
+        return 0;
+    }
 
-    mesh_features_t mesh_features = {
-        .indices = true,
-        .tex_coords = false,
+    const u64 vertex_count = src->mNumVertices;
+    mesh_t *mesh = calloc(1, sizeof(mesh_t));
+    mesh->vertex_count = vertex_count;
+    mesh->index_count = 3 * triangle_count;
+    mesh->material_index = src->mMaterialIndex;
+    mesh->positions = malloc(3 * vertex_count * sizeof(f32));
+    mesh->indices = malloc(mesh->index_count * sizeof(u32));
+    if (src->mNormals) {
+        mesh->normals = malloc(3 * vertex_count * sizeof(f32));
+    }
+    if (src->mNormals && src->mTangents && src->mBitangents) {
+        mesh->tangents = malloc(4 * vertex_count * sizeof(f32));
+    }
+    if (src->mTextureCoords[0]) {
+        mesh->tex_coords = malloc(2 * vertex_count * sizeof(f32));
+    }
+    if (!mesh->positions || !mesh->indices) {
+        _free_mesh(mesh);
+        return 0;
+    }
+
+    for (u64 i = 0; i < vertex_count; i++) {
+        mesh->positions[i * 3 + 0] = src->mVertices[i].x;
+        mesh->positions[i * 3 + 1] = src->mVertices[i].y;
+        mesh->positions[i * 3 + 2] = src->mVertices[i].z;
+        if (mesh->normals) {
+            mesh->normals[i * 3 + 0] = src->mNormals[i].x;
+            mesh->normals[i * 3 + 1] = src->mNormals[i].y;
+            mesh->normals[i * 3 + 2] = src->mNormals[i].z;
+        }
+        if (mesh->tangents) {
+            const struct aiVector3D n = src->mNormals[i];
+            const struct aiVector3D t = src->mTangents[i];
+            const struct aiVector3D b = src->mBitangents[i];
+            // Handedness: does cross(n, t) point along the imported bitangent.
+            const f32 cx = n.y * t.z - n.z * t.y;
+            const f32 cy = n.z * t.x - n.x * t.z;
+            const f32 cz = n.x * t.y - n.y * t.x;
+            mesh->tangents[i * 4 + 0] = t.x;
+            mesh->tangents[i * 4 + 1] = t.y;
+            mesh->tangents[i * 4 + 2] = t.z;
+            mesh->tangents[i * 4 + 3] = cx * b.x + cy * b.y + cz * b.z < 0.f ? -1.f : 1.f;
+        }
+        if (mesh->tex_coords) {
+            mesh->tex_coords[i * 2 + 0] = src->mTextureCoords[0][i].x;
+            mesh->tex_coords[i * 2 + 1] = src->mTextureCoords[0][i].y;
+        }
+    }
+
+    u64 index_count = 0;
+    for (u64 i = 0; i < src->mNumFaces; i++) {
+        if (src->mFaces[i].mNumIndices != 3) {
+            continue;
+        }
+        mesh->indices[index_count++] = src->mFaces[i].mIndices[0];
+        mesh->indices[index_count++] = src->mFaces[i].mIndices[1];
+        mesh->indices[index_count++] = src->mFaces[i].mIndices[2];
+    }
+
+    mesh->features.indices = true;
+    mesh->features.normals = mesh->normals != 0;
+    mesh->features.tangents = mesh->tangents != 0;
+    mesh->features.tex_coords = mesh->tex_coords != 0;
+    return mesh;
+}
+
+static void _fill_defaults(f32 *dst, u64 count, const f32 *value, u32 components) {
+    for (u64 v = 0; v < count; v++) {
+        memcpy(&dst[v * components], value, components * sizeof(f32));
+    }
+}
+
+// Concatenates processed submeshes into shared pools. Attributes any submesh
+// has are present for all, missing ones are filled with neutral values.
+static mesh_t *_pool_submeshes(mesh_t **parts, u32 part_count) {
+    mesh_t *scene = calloc(1, sizeof(mesh_t));
+    u64 lod_total = 0;
+    u64 meshlet_total = 0;
+    u64 meshlet_vertex_total = 0;
+    u64 meshlet_triangle_bytes = 0;
+    for (u32 i = 0; i < part_count; i++) {
+        const mesh_t *part = parts[i];
+        scene->vertex_count += part->vertex_count;
+        scene->index_count += part->index_count;
+        scene->features.normals |= part->features.normals;
+        scene->features.tangents |= part->features.tangents;
+        scene->features.tex_coords |= part->features.tex_coords;
+        lod_total += part->lod_count;
+        meshlet_total += part->meshlets.meshlet_count;
+        meshlet_vertex_total += part->meshlets.vertex_count;
+        meshlet_triangle_bytes += part->meshlets.triangle_bytes;
+    }
+    scene->features.indices = true;
+
+    const u64 n = scene->vertex_count;
+    scene->positions = malloc(n * 3 * sizeof(f32));
+    scene->normals = scene->features.normals ? malloc(n * 3 * sizeof(f32)) : 0;
+    scene->tangents = scene->features.tangents ? malloc(n * 4 * sizeof(f32)) : 0;
+    scene->tex_coords = scene->features.tex_coords ? malloc(n * 2 * sizeof(f32)) : 0;
+    scene->indices = malloc(scene->index_count * sizeof(u32));
+    scene->submeshes = calloc(part_count, sizeof(mesh_file_submesh_t));
+    scene->submesh_count = part_count;
+    scene->lods = calloc(lod_total, sizeof(mesh_file_lod_t));
+
+    mesh_meshlets_t *meshlets = &scene->meshlets;
+    if (meshlet_total > 0) {
+        meshlets->meshlets = malloc(meshlet_total * sizeof(mesh_file_meshlet_t));
+        meshlets->bounds = malloc(meshlet_total * sizeof(mesh_file_meshlet_bounds_t));
+        meshlets->vertices = malloc(meshlet_vertex_total * sizeof(u32));
+        meshlets->triangles = malloc(meshlet_triangle_bytes);
+    }
+
+    const f32 default_normal[3] = {0.f, 0.f, 1.f};
+    const f32 default_tangent[4] = {1.f, 0.f, 0.f, 1.f};
+    const f32 default_tex_coord[2] = {0.f, 0.f};
+
+    mesh_report_t *report = &scene->report;
+    f64 acmr_before = 0.0, acmr_after = 0.0, atvr_before = 0.0, atvr_after = 0.0;
+    u64 triangles = 0;
+    u64 meshlet_source_triangles = 0;
+    u64 base = 0;
+    u64 index_base = 0;
+    for (u32 i = 0; i < part_count; i++) {
+        const mesh_t *part = parts[i];
+        mesh_file_submesh_t *sub = &scene->submeshes[i];
+        const u64 pv = part->vertex_count;
+
+        memcpy(&scene->positions[base * 3], part->positions, pv * 3 * sizeof(f32));
+        if (scene->normals) {
+            part->normals ? memcpy(&scene->normals[base * 3], part->normals, pv * 3 * sizeof(f32))
+                          : _fill_defaults(&scene->normals[base * 3], pv, default_normal, 3);
+        }
+        if (scene->tangents) {
+            part->tangents ? memcpy(&scene->tangents[base * 4], part->tangents, pv * 4 * sizeof(f32))
+                           : _fill_defaults(&scene->tangents[base * 4], pv, default_tangent, 4);
+        }
+        if (scene->tex_coords) {
+            part->tex_coords ? memcpy(&scene->tex_coords[base * 2], part->tex_coords, pv * 2 * sizeof(f32))
+                             : _fill_defaults(&scene->tex_coords[base * 2], pv, default_tex_coord, 2);
+        }
+        memcpy(&scene->indices[index_base], part->indices, part->index_count * sizeof(u32));
+
+        const mesh_file_bounds_t bounds = mesh_compute_bounds(part->positions, pv);
+        sub->vertex_offset = (u32) base;
+        sub->vertex_count = (u32) pv;
+        sub->index_offset = (u32) index_base;
+        sub->index_count = (u32) part->index_count;
+        sub->lod_offset = scene->lod_count;
+        sub->lod_count = part->lod_count;
+        sub->meshlet_offset = (u32) meshlets->meshlet_count;
+        sub->meshlet_count = (u32) part->meshlets.meshlet_count;
+        for (u32 k = 0; k < 3; k++) {
+            sub->center[k] = (bounds.min[k] + bounds.max[k]) * 0.5f;
+        }
+        sub->radius = bounds.radius;
+        sub->material_index = part->material_index;
+
+        for (u32 l = 0; l < part->lod_count; l++) {
+            mesh_file_lod_t lod = part->lods[l];
+            lod.index_offset += (u32) index_base;
+            scene->lods[scene->lod_count++] = lod;
+            report->lods[l].index_count += part->lods[l].index_count;
+            report->lods[l].error = lod.error > report->lods[l].error ? lod.error : report->lods[l].error;
+        }
+
+        const mesh_meshlets_t *src = &part->meshlets;
+        for (u64 m = 0; m < src->meshlet_count; m++) {
+            mesh_file_meshlet_t meshlet = src->meshlets[m];
+            meshlet.vertex_offset += (u32) meshlets->vertex_count;
+            meshlet.triangle_offset += (u32) meshlets->triangle_bytes;
+            meshlets->meshlets[meshlets->meshlet_count] = meshlet;
+            meshlets->bounds[meshlets->meshlet_count] = src->bounds[m];
+            meshlets->meshlet_count++;
+        }
+        for (u64 v = 0; v < src->vertex_count; v++) {
+            meshlets->vertices[meshlets->vertex_count++] = src->vertices[v] + (u32) base;
+        }
+        if (src->triangle_bytes > 0) {
+            memcpy(&meshlets->triangles[meshlets->triangle_bytes], src->triangles, src->triangle_bytes);
+            meshlets->triangle_bytes += src->triangle_bytes;
+        }
+        if (src->meshlet_count > 0) {
+            const u64 source = part->lod_count > 0 ? part->lods[0].index_count : part->index_count;
+            meshlet_source_triangles += source / 3;
+        }
+
+        // ACMR is misses per triangle and ATVR misses per vertex, so weighting
+        // by those counts gives the figures for the whole pool.
+        const mesh_optimise_stats_t *stats = &part->report.optimise;
+        const u64 part_triangles = (part->lod_count > 0 ? part->lods[0].index_count : part->index_count) / 3;
+        acmr_before += stats->before.acmr * (f64) part_triangles;
+        acmr_after += stats->after.acmr * (f64) part_triangles;
+        atvr_before += stats->before.atvr * (f64) stats->vertices_before;
+        atvr_after += stats->after.atvr * (f64) stats->vertices_after;
+        report->optimise.vertices_before += stats->vertices_before;
+        report->optimise.vertices_after += stats->vertices_after;
+        triangles += part_triangles;
+        base += pv;
+        index_base += part->index_count;
+    }
+
+    if (triangles > 0) {
+        report->optimise.before.acmr = (f32) (acmr_before / (f64) triangles);
+        report->optimise.after.acmr = (f32) (acmr_after / (f64) triangles);
+    }
+    if (report->optimise.vertices_before > 0) {
+        report->optimise.before.atvr = (f32) (atvr_before / (f64) report->optimise.vertices_before);
+    }
+    if (report->optimise.vertices_after > 0) {
+        report->optimise.after.atvr = (f32) (atvr_after / (f64) report->optimise.vertices_after);
+    }
+    report->lod_count = parts[0]->lod_count;
+    report->meshlet_count = meshlets->meshlet_count;
+    if (meshlets->meshlet_count > 0) {
+        report->meshlet_vertices_mean = (f32) ((f64) meshlets->vertex_count / (f64) meshlets->meshlet_count);
+        report->meshlet_triangles_mean = (f32) ((f64) meshlet_source_triangles / (f64) meshlets->meshlet_count);
+    }
+    report->submesh_count = part_count;
+    return scene;
+}
+
+static u32 _count_nodes(const struct aiNode *node) {
+    u32 count = 1;
+    for (u32 i = 0; i < node->mNumChildren; i++) {
+        count += _count_nodes(node->mChildren[i]);
+    }
+    return count;
+}
+
+static void _flatten_node(mesh_t *scene, const struct aiNode *node, i32 parent, const u32 *submesh_of,
+                          u32 node_capacity) {
+    const u32 index = scene->node_count++;
+    mesh_file_node_t *dst = &scene->nodes[index];
+    dst->parent = parent;
+    dst->mesh_offset = scene->node_mesh_count;
+    dst->mesh_count = 0;
+    dst->pad = 0;
+    for (u32 i = 0; i < node->mNumMeshes; i++) {
+        const u32 submesh = submesh_of[node->mMeshes[i]];
+        if (submesh != ~0u) {
+            scene->node_meshes[scene->node_mesh_count++] = submesh;
+            dst->mesh_count++;
+        }
+    }
+
+    struct aiVector3D scaling, position;
+    struct aiQuaternion rotation;
+    aiDecomposeMatrix(&node->mTransformation, &scaling, &rotation, &position);
+    const f32 values[MESH_NODE_TRANSFORM_PLANES] = {
+        position.x, position.y, position.z, rotation.x, rotation.y, rotation.z, rotation.w,
+        scaling.x, scaling.y, scaling.z,
     };
+    for (u32 p = 0; p < MESH_NODE_TRANSFORM_PLANES; p++) {
+        scene->node_transforms[p * node_capacity + index] = values[p];
+    }
 
-    mesh_t* out_mesh = malloc(sizeof(mesh_t));
-    out_mesh->features = &mesh_features;
-    out_mesh->indices = indices;
-    out_mesh->vertices = vertices;
-    out_mesh->vertices_size = vertex_count;
-    out_mesh->indices_size = index_count;
+    for (u32 i = 0; i < node->mNumChildren; i++) {
+        _flatten_node(scene, node->mChildren[i], (i32) index, submesh_of, node_capacity);
+    }
+}
 
-    meshes[meshes_count] = out_mesh;
+static u64 _count_node_meshes(const struct aiNode *node) {
+    u64 count = node->mNumMeshes;
+    for (u32 i = 0; i < node->mNumChildren; i++) {
+        count += _count_node_meshes(node->mChildren[i]);
+    }
+    return count;
+}
 
-    *handle = handle_create(meshes_count - 1);
+static void _import_nodes(mesh_t *scene, const struct aiScene *src, const u32 *submesh_of) {
+    const u32 count = _count_nodes(src->mRootNode);
+    const u64 references = _count_node_meshes(src->mRootNode);
+    scene->nodes = calloc(count, sizeof(mesh_file_node_t));
+    scene->node_transforms = calloc((u64) count * MESH_NODE_TRANSFORM_PLANES, sizeof(f32));
+    scene->node_meshes = malloc((references > 0 ? references : 1) * sizeof(u32));
+    _flatten_node(scene, src->mRootNode, -1, submesh_of, count);
+    scene->report.node_count = scene->node_count;
+}
+
+typedef struct {
+    const char *input;
+    mesh_dependencies_t *dependencies;
+} mesh_file_tracker_t;
+
+static size_t _file_read(struct aiFile *file, char *buffer, size_t size, size_t count) {
+    return fread(buffer, size, count, (FILE *) file->UserData);
+}
+
+static size_t _file_write(struct aiFile *file, const char *buffer, size_t size, size_t count) {
+    return fwrite(buffer, size, count, (FILE *) file->UserData);
+}
+
+static size_t _file_tell(struct aiFile *file) {
+    return (size_t) ftell((FILE *) file->UserData);
+}
+
+static size_t _file_size(struct aiFile *file) {
+    FILE *f = (FILE *) file->UserData;
+    const long at = ftell(f);
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, at, SEEK_SET);
+    return (size_t) size;
+}
+
+static enum aiReturn _file_seek(struct aiFile *file, size_t offset, enum aiOrigin origin) {
+    const int whence = origin == aiOrigin_SET ? SEEK_SET : origin == aiOrigin_CUR ? SEEK_CUR : SEEK_END;
+    return fseek((FILE *) file->UserData, (long) offset, whence) == 0 ? aiReturn_SUCCESS : aiReturn_FAILURE;
+}
+
+static void _file_flush(struct aiFile *file) {
+    fflush((FILE *) file->UserData);
+}
 
+// Plain stdio, except that every file opened besides the input is recorded.
+static struct aiFile *_file_open(struct aiFileIO *io, const char *path, const char *mode) {
+    FILE *f = fopen(path, mode);
+    if (!f) {
+        return 0;
+    }
+    mesh_file_tracker_t *tracker = (mesh_file_tracker_t *) io->UserData;
+    mesh_dependencies_t *dependencies = tracker->dependencies;
+    b8 known = strcmp(path, tracker->input) == 0;
+    for (u64 i = 0; i < dependencies->count && !known; i++) {
+        known = strcmp(dependencies->data[i], path) == 0;
+    }
+    if (!known) {
+        array_push(dependencies, strdup(path));
+    }
+
+    struct aiFile *file = malloc(sizeof(struct aiFile));
+    file->ReadProc = _file_read;
+    file->WriteProc = _file_write;
+    file->TellProc = _file_tell;
+    file->FileSizeProc = _file_size;
+    file->SeekProc = _file_seek;
+    file->FlushProc = _file_flush;
+    file->UserData = (aiUserData) f;
+    return file;
+}
+
+static void _file_close(struct aiFileIO *io, struct aiFile *file) {
+    (void) io;
+    fclose((FILE *) file->UserData);
+    free(file);
+}
+
+void mesh_dependencies_free(mesh_dependencies_t *dependencies) {
+    for (u64 i = 0; i < dependencies->count; i++) {
+        free(dependencies->data[i]);
+    }
+    array_free(dependencies);
+}
+
+int mesh_load(const char *filename, const mesh_import_options_t *options, handle_t *handle) {
+    return mesh_load_tracked(filename, options, handle, 0);
+}
+
+int mesh_load_tracked(const char *filename, const mesh_import_options_t *options, handle_t *handle,
+                      mesh_dependencies_t *dependencies) {
+    const struct aiScene *scene;
+    if (dependencies) {
+        mesh_file_tracker_t tracker = {filename, dependencies};
+        struct aiFileIO io;
+        io.OpenProc = _file_open;
+        io.CloseProc = _file_close;
+        io.UserData = (aiUserData) &tracker;
+        scene = aiImportFileEx(filename, options->post_process, &io);
+    } else {
+        scene = aiImportFile(filename, options->post_process);
+    }
+    if (!scene || scene->mNumMeshes == 0) {
+        aiReleaseImport(scene);
+        return 1;
+    }
+
+    // Each submesh is optimised, simplified and clustered on its own before
+    // everything is pooled, so results match compiling them separately.
+    arena_t scratch;
+    arena_init(&scratch, MESH_SCRATCH_BLOCK_SIZE, MEMORY_TAG_ARENA);
+    mesh_t **parts = arena_push_array(&scratch, mesh_t *, scene->mNumMeshes);
+    u32 *submesh_of = arena_push_array(&scratch, u32, scene->mNumMeshes);
+    u32 part_count = 0;
+    for (u32 i = 0; i < scene->mNumMeshes; i++) {
+        mesh_t *part = _import_mesh(scene->mMeshes[i]);
+        submesh_of[i] = part ? part_count : ~0u;
+        if (!part) {
+            continue;
+        }
+        if (options->flags & MESH_IMPORT_OPTIMISE) {
+            _optimise_mesh(part, &scratch);
+        }
+        if (options->lod_count > 0) {
+            _generate_lods(part, options, &scratch);
+        }
+        if (options->meshlet_max_vertices > 0 && options->meshlet_max_triangles > 0) {
+            _build_meshlets(part, options);
+        }
+        parts[part_count++] = part;
+    }
+
+    mesh_t *out_mesh = 0;
+    if (part_count > 0) {
+        out_mesh = _pool_submeshes(parts, part_count);
+        _import_nodes(out_mesh, scene, submesh_of);
+    }
+    for (u32 i = 0; i < part_count; i++) {
+        _free_mesh(parts[i]);
+    }
+    arena_destroy(&scratch);
     aiReleaseImport(scene);
+    if (!out_mesh) {
+        return 1;
+    }
+
+    const mesh_attributes_t attributes = _mesh_attributes(out_mesh);
+    mesh_encode(&attributes, options->encode_flags, &out_mesh->encoded);
+    mesh_encode_report(&attributes, &out_mesh->encoded, &out_mesh->report.encoding);
+
+    call_once(&meshes_lock_once, _init_meshes_lock);
+    mtx_lock(&meshes_lock);
+    *handle = handle_pool_insert(&meshes, &out_mesh);
+    mtx_unlock(&meshes_lock);
+
     return 0;
 }
 
-void mesh_save(const char *filename, handle_t *handle) {
-    FILE *f = fopen(filename, "rw");
-    u64 mesh_index = handle->index;
-    const mesh_t* mesh = meshes[mesh_index];
+int _write_mesh_file(const char *filename, u32 features, const mesh_section_desc_t *descs, u32 desc_count) {
+    if (desc_count > MESH_SECTION_MAX) {
+        return 1;
+    }
+    const u64 sections_offset = mesh_format_align(sizeof(mesh_file_header_t));
+    mesh_file_section_t sections[MESH_SECTION_MAX];
 
-    const u32 features_bitmask = _make_mesh_features_bitmask(mesh->features);
-    fwrite(&features_bitmask, sizeof(u32), 1, f);
+    u64 offset = mesh_format_align(sections_offset + desc_count * sizeof(mesh_file_section_t));
+    for (u32 i = 0; i < desc_count; i++) {
+        sections[i].type = (u16) descs[i].type;
+        sections[i].encoding = (u16) descs[i].encoding;
+        sections[i].stride = descs[i].stride;
+        sections[i].count = descs[i].count;
+        sections[i].size = descs[i].count * descs[i].stride;
+        sections[i].offset = offset;
+        offset = mesh_format_align(offset + sections[i].size);
+    }
 
-    fwrite(&mesh->vertices_size, sizeof(u64), 1, f);
-    fwrite(&mesh->indices_size, sizeof(u64), 1, f);
+    // Assemble the whole image in memory so the checksum can go in the header
+    // and the file lands with a single write.
+    const u64 file_size = offset;
+    u8 *image = calloc(1, file_size);
+    if (!image) {
+        return 1;
+    }
+    memcpy(image + sections_offset, sections, desc_count * sizeof(mesh_file_section_t));
+    for (u32 i = 0; i < desc_count; i++) {
+        memcpy(image + sections[i].offset, descs[i].data, sections[i].size);
+    }
 
-    fwrite(mesh->vertices, sizeof(f32), mesh->vertices_size, f);
-    fwrite(mesh->indices, sizeof(f32), mesh->indices_size, f);
+    mesh_file_header_t header = {
+        .magic = MESH_FORMAT_MAGIC,
+        .version = MESH_FORMAT_VERSION,
+        .features = features,
+        .section_count = desc_count,
+        .file_size = file_size,
+        .checksum = 0,
+        .sections_offset = sections_offset,
+        .reserved = 0,
+    };
+    memcpy(image, &header, sizeof(header));
+    header.checksum = mesh_format_checksum(image, file_size);
+    memcpy(image, &header, sizeof(header));
 
-    fflush(f);
+    FILE *f = fopen(filename, "wb");
+    if (!f) {
+        free(image);
+        return 1;
+    }
+    const size_t written = fwrite(image, 1, file_size, f);
     fclose(f);
+    free(image);
+    return written == file_size ? 0 : 1;
+}
+
+static mesh_t *_get_mesh(const handle_t *handle) {
+    call_once(&meshes_lock_once, _init_meshes_lock);
+    mtx_lock(&meshes_lock);
+    mesh_t **slot = handle_pool_get(&meshes, *handle);
+    mesh_t *mesh = slot ? *slot : 0;
+    mtx_unlock(&meshes_lock);
+    return mesh;
+}
+
+int mesh_get_report(handle_t *handle, mesh_report_t *report) {
+    const mesh_t *mesh = _get_mesh(handle);
+    if (!mesh) {
+        return 1;
+    }
+    *report = mesh->report;
+    return 0;
+}
+
+static void _push_stream(mesh_section_desc_t *descs, u32 *count, u32 type, const mesh_encoded_stream_t *stream) {
+    if (!stream->data) {
+        return;
+    }
+    descs[*count].type = type;
+    descs[*count].encoding = stream->encoding;
+    descs[*count].stride = stream->stride;
+    descs[*count].count = stream->count;
+    descs[*count].data = stream->data;
+    (*count)++;
+}
+
+int mesh_save(const char *filename, handle_t *handle) {
+    const mesh_t* mesh = _get_mesh(handle);
+    if (!mesh) {
+        return 1;
+    }
+
+    const mesh_encoded_t *encoded = &mesh->encoded;
+    mesh_section_desc_t descs[MESH_SECTION_MAX];
+    u32 desc_count = 0;
+    descs[desc_count++] = (mesh_section_desc_t) {
+        MESH_SECTION_BOUNDS, MESH_ENCODING_RAW, sizeof(mesh_file_bounds_t), encoded->bounds_count, encoded->bounds,
+    };
+    _push_stream(descs, &desc_count, MESH_SECTION_POSITIONS, &encoded->positions);
+    _push_stream(descs, &desc_count, MESH_SECTION_NORMALS, &encoded->normals);
+    _push_stream(descs, &desc_count, MESH_SECTION_TANGENTS, &encoded->tangents);
+    _push_stream(descs, &desc_count, MESH_SECTION_TEX_COORDS, &encoded->tex_coords);
+    _push_stream(descs, &desc_count, MESH_SECTION_INDICES, &encoded->indices);
+    descs[desc_count++] = (mesh_section_desc_t) {
+        MESH_SECTION_SUBMESHES, MESH_ENCODING_RAW, sizeof(mesh_file_submesh_t), mesh->submesh_count,
+        mesh->submeshes,
+    };
+    if (mesh->lod_count > 0) {
+        descs[desc_count++] = (mesh_section_desc_t) {
+            MESH_SECTION_LODS, MESH_ENCODING_RAW, sizeof(mesh_file_lod_t), mesh->lod_count, mesh->lods,
+        };
+    }
+    const mesh_meshlets_t *meshlets = &mesh->meshlets;
+    if (meshlets->meshlet_count > 0) {
+        descs[desc_count++] = (mesh_section_desc_t) {
+            MESH_SECTION_MESHLETS, MESH_ENCODING_RAW, sizeof(mesh_file_meshlet_t), meshlets->meshlet_count,
+            meshlets->meshlets,
+        };
+        descs[desc_count++] = (mesh_section_desc_t) {
+            MESH_SECTION_MESHLET_VERTICES, MESH_ENCODING_U32_INDEX, sizeof(u32), meshlets->vertex_count,
+            meshlets->vertices,
+        };
+        descs[desc_count++] = (mesh_section_desc_t) {
+            MESH_SECTION_MESHLET_TRIANGLES, MESH_ENCODING_RAW, sizeof(u8), meshlets->triangle_bytes,
+            meshlets->triangles,
+        };
+        descs[desc_count++] = (mesh_section_desc_t) {
+            MESH_SECTION_MESHLET_BOUNDS, MESH_ENCODING_RAW, sizeof(mesh_file_meshlet_bounds_t),
+            meshlets->meshlet_count, meshlets->bounds,
+        };
+    }
+    descs[desc_count++] = (mesh_section_desc_t) {
+        MESH_SECTION_NODES, MESH_ENCODING_RAW, sizeof(mesh_file_node_t), mesh->node_count, mesh->nodes,
+    };
+    if (mesh->node_mesh_count > 0) {
+        descs[desc_count++] = (mesh_section_desc_t) {
+            MESH_SECTION_NODE_MESHES, MESH_ENCODING_RAW, sizeof(u32), mesh->node_mesh_count, mesh->node_meshes,
+        };
+    }
+    descs[desc_count++] = (mesh_section_desc_t) {
+        MESH_SECTION_NODE_TRANSFORMS, MESH_ENCODING_F32, MESH_NODE_TRANSFORM_PLANES * sizeof(f32),
+        mesh->node_count, mesh->node_transforms,
+    };
+    return _write_mesh_file(filename, _make_mesh_features_bitmask(&mesh->features), descs, desc_count);
+}
+
+void mesh_release(handle_t *handle) {
+    call_once(&meshes_lock_once, _init_meshes_lock);
+    mtx_lock(&meshes_lock);
+    mesh_t *mesh = 0;
+    const b8 removed = handle_pool_remove(&meshes, *handle, &mesh);
+    mtx_unlock(&meshes_lock);
+    if (removed) {
+        _free_mesh(mesh);
+    }
+    *handle = HANDLE_INVALID;
 }
 
 void mesh_cleanup() {
-    for (u64 i = 0; i < meshes_count; i++) {
-        free(meshes[i].vertices);
-        free(meshes[i].indices);
+    call_once(&meshes_lock_once, _init_meshes_lock);
+    for (u32 i = 0; i < handle_pool_count(&meshes); i++) {
+        _free_mesh(*(mesh_t **) handle_pool_at(&meshes, i));
     }
-    free(meshes);
+    handle_pool_clear(&meshes);
 }
 
-u32 _make_mesh_features_bitmask(mesh_features_t *features) {
+u32 _make_mesh_features_bitmask(const mesh_features_t *features) {
     u32 bitmask = 0;
     if (features->indices) {
-        bitmask = bitmask_flags_set_on(bitmask, 0);
+        bitmask = bitmask_flags_set_on(bitmask, MESH_FEATURE_BIT_INDICES);
+    }
+    if (features->tex_coords) {
+        bitmask = bitmask_flags_set_on(bitmask, MESH_FEATURE_BIT_TEX_COORDS);
+    }
+    if (features->normals) {
+        bitmask = bitmask_flags_set_on(bitmask, MESH_FEATURE_BIT_NORMALS);
     }
-    else if (features->tex_coords) {
-        bitmask = bitmask_flags_set_on(bitmask, 1);
+    if (features->tangents) {
+        bitmask = bitmask_flags_set_on(bitmask, MESH_FEATURE_BIT_TANGENTS);
     }
     return bitmask;
 }
@@ -0,0 +1,225 @@
+#include "assets/mesh_encode.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <core/quantise.h>
+
+#define RAD_TO_DEG 57.29577951308232f
+
+mesh_file_bounds_t mesh_compute_bounds(const f32 *positions, u64 vertex_count) {
+    mesh_file_bounds_t bounds;
+    memset(&bounds, 0, sizeof(bounds));
+    if (vertex_count == 0) {
+        return bounds;
+    }
+    for (u32 k = 0; k < 3; k++) {
+        bounds.min[k] = FLT_MAX;
+        bounds.max[k] = -FLT_MAX;
+    }
+    for (u64 v = 0; v < vertex_count; v++) {
+        for (u32 k = 0; k < 3; k++) {
+            const f32 p = positions[v * 3 + k];
+            bounds.min[k] = p < bounds.min[k] ? p : bounds.min[k];
+            bounds.max[k] = p > bounds.max[k] ? p : bounds.max[k];
+        }
+    }
+    f32 diagonal = 0.f;
+    for (u32 k = 0; k < 3; k++) {
+        const f32 extent = bounds.max[k] - bounds.min[k];
+        bounds.dequant_scale[k] = extent / 65535.f;
+        diagonal += extent * extent;
+    }
+    bounds.radius = 0.5f * sqrtf(diagonal);
+    return bounds;
+}
+
+static u32 _range_count(const mesh_attributes_t *attributes) {
+    return attributes->submesh_count > 0 ? attributes->submesh_count : 1;
+}
+
+static void _vertex_range(const mesh_attributes_t *attributes, u32 range, u64 *first, u64 *count) {
+    if (attributes->submesh_count == 0) {
+        *first = 0;
+        *count = attributes->vertex_count;
+        return;
+    }
+    *first = attributes->submeshes[range].vertex_offset;
+    *count = attributes->submeshes[range].vertex_count;
+}
+
+static mesh_encoded_stream_t _alloc_stream(u64 count, u16 encoding, u32 components) {
+    mesh_encoded_stream_t stream;
+    stream.count = count;
+    stream.encoding = encoding;
+    stream.stride = mesh_format_encoding_stride(encoding, components);
+    stream.data = malloc(count * stream.stride);
+    return stream;
+}
+
+static mesh_encoded_stream_t _copy_stream(const f32 *src, u64 count, u32 components) {
+    mesh_encoded_stream_t stream = _alloc_stream(count, MESH_ENCODING_F32, components);
+    memcpy(stream.data, src, count * stream.stride);
+    return stream;
+}
+
+void mesh_encode(const mesh_attributes_t *attributes, u32 flags, mesh_encoded_t *out) {
+    memset(out, 0, sizeof(mesh_encoded_t));
+    const u64 n = attributes->vertex_count;
+    // Each submesh gets the full 16 bit range over its own box, so a small
+    // prop keeps its precision next to a large level mesh.
+    out->bounds_count = _range_count(attributes);
+    out->bounds = malloc(out->bounds_count * sizeof(mesh_file_bounds_t));
+    for (u32 r = 0; r < out->bounds_count; r++) {
+        u64 first, count;
+        _vertex_range(attributes, r, &first, &count);
+        out->bounds[r] = mesh_compute_bounds(&attributes->positions[first * 3], count);
+    }
+
+    if (flags & MESH_ENCODE_POSITIONS) {
+        out->positions = _alloc_stream(n, MESH_ENCODING_UNORM16_POSITION, 3);
+        u16 *dst = out->positions.data;
+        for (u32 r = 0; r < out->bounds_count; r++) {
+            u64 first, count;
+            _vertex_range(attributes, r, &first, &count);
+            for (u64 v = first; v < first + count; v++) {
+                mesh_format_encode_position(&attributes->positions[v * 3], &out->bounds[r], &dst[v * 4]);
+            }
+        }
+    } else {
+        out->positions = _copy_stream(attributes->positions, n, 3);
+    }
+
+    if (attributes->normals && (flags & MESH_ENCODE_NORMALS)) {
+        out->normals = _alloc_stream(n, MESH_ENCODING_OCT16_NORMAL, 3);
+        i16 *dst = out->normals.data;
+        for (u64 v = 0; v < n; v++) {
+            mesh_format_encode_normal(&attributes->normals[v * 3], &dst[v * 2]);
+        }
+    } else if (attributes->normals) {
+        out->normals = _copy_stream(attributes->normals, n, 3);
+    }
+
+    if (attributes->tangents && (flags & MESH_ENCODE_NORMALS)) {
+        out->tangents = _alloc_stream(n, MESH_ENCODING_OCT16_TANGENT, 4);
+        i16 *dst = out->tangents.data;
+        for (u64 v = 0; v < n; v++) {
+            mesh_format_encode_tangent(&attributes->tangents[v * 4], &dst[v * 2]);
+        }
+    } else if (attributes->tangents) {
+        out->tangents = _copy_stream(attributes->tangents, n, 4);
+    }
+
+    if (attributes->tex_coords && (flags & MESH_ENCODE_TEX_COORDS)) {
+        out->tex_coords = _alloc_stream(n, MESH_ENCODING_F16_TEX_COORD, 2);
+        u16 *dst = out->tex_coords.data;
+        for (u64 v = 0; v < n * 2; v++) {
+            dst[v] = half_from_f32(attributes->tex_coords[v]);
+        }
+    } else if (attributes->tex_coords) {
+        out->tex_coords = _copy_stream(attributes->tex_coords, n, 2);
+    }
+
+    const u64 index_count = attributes->index_count;
+    const u64 index_range = attributes->index_range ? attributes->index_range : n;
+    if ((flags & MESH_ENCODE_INDICES) && index_range <= 65536) {
+        out->indices = _alloc_stream(index_count, MESH_ENCODING_U16_INDEX, 1);
+        u16 *dst = out->indices.data;
+        for (u64 i = 0; i < index_count; i++) {
+            dst[i] = (u16) attributes->indices[i];
+        }
+    } else {
+        out->indices = _alloc_stream(index_count, MESH_ENCODING_U32_INDEX, 1);
+        memcpy(out->indices.data, attributes->indices, index_count * sizeof(u32));
+    }
+}
+
+static f32 _angle_deg(const f32 *a, const f32 *b) {
+    const f32 dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    const f32 la = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    const f32 lb = sqrtf(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+    if (la == 0.f || lb == 0.f) {
+        return 0.f;
+    }
+    const f32 c = dot / (la * lb);
+    return acosf(c > 1.f ? 1.f : (c < -1.f ? -1.f : c)) * RAD_TO_DEG;
+}
+
+static const void *_element(const mesh_encoded_stream_t *stream, u64 i) {
+    return (const u8 *) stream->data + i * stream->stride;
+}
+
+void mesh_encode_report(const mesh_attributes_t *attributes, const mesh_encoded_t *encoded,
+                        mesh_encoding_report_t *report) {
+    memset(report, 0, sizeof(mesh_encoding_report_t));
+    const u64 n = attributes->vertex_count;
+    if (n == 0) {
+        return;
+    }
+    f64 position_sum = 0.0;
+    f64 normal_sum = 0.0;
+    f64 tex_coord_sum = 0.0;
+
+    for (u32 r = 0; r < encoded->bounds_count; r++) {
+        const mesh_file_bounds_t *bounds = &encoded->bounds[r];
+        const f32 diagonal = 2.f * bounds->radius;
+        u64 first, count;
+        _vertex_range(attributes, r, &first, &count);
+        for (u64 v = first; v < first + count; v++) {
+            f32 p[3];
+            mesh_format_decode_position(_element(&encoded->positions, v), encoded->positions.encoding, bounds, p);
+            const f32 *src = &attributes->positions[v * 3];
+            const f32 d[3] = {p[0] - src[0], p[1] - src[1], p[2] - src[2]};
+            const f32 err = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            const f32 relative = diagonal > 0.f ? err / diagonal : 0.f;
+            report->position_max = err > report->position_max ? err : report->position_max;
+            report->position_max_relative =
+                relative > report->position_max_relative ? relative : report->position_max_relative;
+            position_sum += err;
+        }
+    }
+
+    for (u64 v = 0; v < n; v++) {
+        if (attributes->normals) {
+            f32 normal[3];
+            mesh_format_decode_normal(_element(&encoded->normals, v), encoded->normals.encoding, normal);
+            const f32 angle = _angle_deg(normal, &attributes->normals[v * 3]);
+            report->normal_max_deg = angle > report->normal_max_deg ? angle : report->normal_max_deg;
+            normal_sum += angle;
+        }
+        if (attributes->tangents) {
+            f32 tangent[4];
+            mesh_format_decode_tangent(_element(&encoded->tangents, v), encoded->tangents.encoding, tangent);
+            const f32 *src_t = &attributes->tangents[v * 4];
+            f32 angle = _angle_deg(tangent, src_t);
+            if ((tangent[3] < 0.f) != (src_t[3] < 0.f)) {
+                angle = 180.f;
+            }
+            report->tangent_max_deg = angle > report->tangent_max_deg ? angle : report->tangent_max_deg;
+        }
+        if (attributes->tex_coords) {
+            f32 uv[2];
+            mesh_format_decode_tex_coord(_element(&encoded->tex_coords, v), encoded->tex_coords.encoding, uv);
+            const f32 *src_uv = &attributes->tex_coords[v * 2];
+            const f32 du = fabsf(uv[0] - src_uv[0]);
+            const f32 dv = fabsf(uv[1] - src_uv[1]);
+            const f32 uv_err = du > dv ? du : dv;
+            report->tex_coord_max = uv_err > report->tex_coord_max ? uv_err : report->tex_coord_max;
+            tex_coord_sum += uv_err;
+        }
+    }
+    report->position_mean = (f32) (position_sum / (f64) n);
+    report->normal_mean_deg = (f32) (normal_sum / (f64) n);
+    report->tex_coord_mean = (f32) (tex_coord_sum / (f64) n);
+}
+
+void mesh_encoded_free(mesh_encoded_t *encoded) {
+    free(encoded->bounds);
+    free(encoded->positions.data);
+    free(encoded->normals.data);
+    free(encoded->tangents.data);
+    free(encoded->tex_coords.data);
+    free(encoded->indices.data);
+    memset(encoded, 0, sizeof(mesh_encoded_t));
+}
@@ -0,0 +1,281 @@
+#include "assets/mesh_meshlet.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOT_IN_MESHLET 0xffu
+#define CONE_MIN_SPREAD 0.1f
+
+typedef struct {
+    u32 vertices[MESH_MESHLET_MAX_VERTICES];
+    u8 *triangles;
+    u32 vertex_count;
+    u32 triangle_count;
+} meshlet_builder_t;
+
+static u32 _new_vertices(const u8 *local, const u32 *tri) {
+    // Degenerate triangles can reference the same new vertex more than once.
+    u32 count = local[tri[0]] == NOT_IN_MESHLET;
+    count += local[tri[1]] == NOT_IN_MESHLET && tri[1] != tri[0];
+    count += local[tri[2]] == NOT_IN_MESHLET && tri[2] != tri[0] && tri[2] != tri[1];
+    return count;
+}
+
+static void _add_triangle(meshlet_builder_t *builder, u8 *local, const u32 *tri) {
+    for (u32 k = 0; k < 3; k++) {
+        if (local[tri[k]] == NOT_IN_MESHLET) {
+            local[tri[k]] = (u8) builder->vertex_count;
+            builder->vertices[builder->vertex_count++] = tri[k];
+        }
+        builder->triangles[builder->triangle_count * 3 + k] = local[tri[k]];
+    }
+    builder->triangle_count++;
+}
+
+static void _flush(mesh_meshlets_t *out, meshlet_builder_t *builder, u8 *local) {
+    mesh_file_meshlet_t *meshlet = &out->meshlets[out->meshlet_count++];
+    meshlet->vertex_offset = (u32) out->vertex_count;
+    meshlet->triangle_offset = (u32) out->triangle_bytes;
+    meshlet->vertex_count = builder->vertex_count;
+    meshlet->triangle_count = builder->triangle_count;
+
+    memcpy(&out->vertices[out->vertex_count], builder->vertices, builder->vertex_count * sizeof(u32));
+    out->vertex_count += builder->vertex_count;
+    const u64 bytes = builder->triangle_count * 3;
+    memcpy(&out->triangles[out->triangle_bytes], builder->triangles, bytes);
+    memset(&out->triangles[out->triangle_bytes + bytes], 0, ((bytes + 3) & ~3ull) - bytes);
+    out->triangle_bytes += (bytes + 3) & ~3ull;
+
+    for (u32 i = 0; i < builder->vertex_count; i++) {
+        local[builder->vertices[i]] = NOT_IN_MESHLET;
+    }
+    builder->vertex_count = 0;
+    builder->triangle_count = 0;
+}
+
+void mesh_build_meshlets(const u32 *indices, u64 index_count, const f32 *positions, u64 vertex_count,
+                         u32 max_vertices, u32 max_triangles, mesh_meshlets_t *out) {
+    memset(out, 0, sizeof(mesh_meshlets_t));
+    const u64 tri_count = index_count / 3;
+    if (tri_count == 0) {
+        return;
+    }
+    max_vertices = max_vertices < 3 ? 3 : (max_vertices > MESH_MESHLET_MAX_VERTICES ? MESH_MESHLET_MAX_VERTICES
+                                                                                    : max_vertices);
+    max_triangles = max_triangles < 1 ? 1 : max_triangles;
+
+    // Worst case is one meshlet per triangle.
+    out->meshlets = malloc(tri_count * sizeof(mesh_file_meshlet_t));
+    out->vertices = malloc(index_count * sizeof(u32));
+    out->triangles = malloc(tri_count * 4);
+
+    u32 *adj_offsets = calloc(vertex_count + 1, sizeof(u32));
+    u32 *adjacency = malloc(index_count * sizeof(u32));
+    for (u64 i = 0; i < index_count; i++) {
+        adj_offsets[indices[i] + 1]++;
+    }
+    for (u64 v = 0; v < vertex_count; v++) {
+        adj_offsets[v + 1] += adj_offsets[v];
+    }
+    u32 *fill = calloc(vertex_count, sizeof(u32));
+    for (u64 i = 0; i < index_count; i++) {
+        adjacency[adj_offsets[indices[i]] + fill[indices[i]]++] = (u32) (i / 3);
+    }
+    free(fill);
+
+    u8 *used = calloc(tri_count, 1);
+    u8 *local = malloc(vertex_count);
+    memset(local, NOT_IN_MESHLET, vertex_count);
+
+    meshlet_builder_t builder;
+    builder.vertex_count = 0;
+    builder.triangle_count = 0;
+    builder.triangles = malloc(max_triangles * 3);
+
+    u64 cursor = 0;
+    for (;;) {
+        while (cursor < tri_count && used[cursor]) {
+            cursor++;
+        }
+        if (cursor == tri_count) {
+            break;
+        }
+        used[cursor] = 1;
+        _add_triangle(&builder, local, &indices[cursor * 3]);
+
+        while (builder.triangle_count < max_triangles) {
+            u64 best = ~0ull;
+            u32 best_new = 4;
+            for (u32 i = 0; i < builder.vertex_count; i++) {
+                const u32 v = builder.vertices[i];
+                for (u32 a = adj_offsets[v]; a < adj_offsets[v + 1]; a++) {
+                    const u32 t = adjacency[a];
+                    if (used[t]) {
+                        continue;
+                    }
+                    const u32 added = _new_vertices(local, &indices[t * 3]);
+                    if (builder.vertex_count + added > max_vertices) {
+                        continue;
+                    }
+                    if (added < best_new || (added == best_new && t < best)) {
+                        best = t;
+                        best_new = added;
+                    }
+                }
+            }
+            if (best == ~0ull) {
+                break;
+            }
+            used[best] = 1;
+            _add_triangle(&builder, local, &indices[best * 3]);
+        }
+        _flush(out, &builder, local);
+    }
+
+    out->bounds = malloc(out->meshlet_count * sizeof(mesh_file_meshlet_bounds_t));
+    for (u64 m = 0; m < out->meshlet_count; m++) {
+        out->bounds[m] = mesh_compute_meshlet_bounds(&out->meshlets[m], out->vertices, out->triangles, positions);
+    }
+
+    free(builder.triangles);
+    free(local);
+    free(used);
+    free(adjacency);
+    free(adj_offsets);
+}
+
+static f32 _dist2(const f32 *a, const f32 *b) {
+    const f32 d[3] = {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+    return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+}
+
+// Ritter's bounding sphere: seed with the widest axis-extreme pair, then grow.
+static void _bounding_sphere(const f32 *positions, const u32 *vertices, u32 count, f32 center[3], f32 *radius) {
+    u32 min_v[3] = {vertices[0], vertices[0], vertices[0]};
+    u32 max_v[3] = {vertices[0], vertices[0], vertices[0]};
+    for (u32 i = 0; i < count; i++) {
+        const f32 *p = &positions[vertices[i] * 3];
+        for (u32 k = 0; k < 3; k++) {
+            min_v[k] = p[k] < positions[min_v[k] * 3 + k] ? vertices[i] : min_v[k];
+            max_v[k] = p[k] > positions[max_v[k] * 3 + k] ? vertices[i] : max_v[k];
+        }
+    }
+    u32 axis = 0;
+    f32 widest = -1.f;
+    for (u32 k = 0; k < 3; k++) {
+        const f32 d = _dist2(&positions[min_v[k] * 3], &positions[max_v[k] * 3]);
+        if (d > widest) {
+            widest = d;
+            axis = k;
+        }
+    }
+    const f32 *a = &positions[min_v[axis] * 3];
+    const f32 *b = &positions[max_v[axis] * 3];
+    for (u32 k = 0; k < 3; k++) {
+        center[k] = (a[k] + b[k]) * 0.5f;
+    }
+    f32 r = sqrtf(widest) * 0.5f;
+
+    for (u32 i = 0; i < count; i++) {
+        const f32 *p = &positions[vertices[i] * 3];
+        const f32 d2 = _dist2(p, center);
+        if (d2 > r * r) {
+            const f32 d = sqrtf(d2);
+            const f32 grown = (r + d) * 0.5f;
+            const f32 shift = (grown - r) / d;
+            for (u32 k = 0; k < 3; k++) {
+                center[k] += (p[k] - center[k]) * shift;
+            }
+            r = grown;
+        }
+    }
+    *radius = r;
+}
+
+mesh_file_meshlet_bounds_t mesh_compute_meshlet_bounds(const mesh_file_meshlet_t *meshlet,
+                                                       const u32 *meshlet_vertices, const u8 *meshlet_triangles,
+                                                       const f32 *positions) {
+    mesh_file_meshlet_bounds_t bounds;
+    memset(&bounds, 0, sizeof(bounds));
+    const u32 *vertices = &meshlet_vertices[meshlet->vertex_offset];
+    const u8 *triangles = &meshlet_triangles[meshlet->triangle_offset];
+    _bounding_sphere(positions, vertices, meshlet->vertex_count, bounds.center, &bounds.radius);
+
+    // Normal cone from the unit normals of non-degenerate triangles.
+    f32 *normals = calloc(meshlet->triangle_count * 3, sizeof(f32));
+    f32 axis[3] = {0.f, 0.f, 0.f};
+    for (u32 t = 0; t < meshlet->triangle_count; t++) {
+        const f32 *a = &positions[vertices[triangles[t * 3 + 0]] * 3];
+        const f32 *b = &positions[vertices[triangles[t * 3 + 1]] * 3];
+        const f32 *c = &positions[vertices[triangles[t * 3 + 2]] * 3];
+        const f32 e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const f32 e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        f32 *n = &normals[t * 3];
+        n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+        n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+        n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+        const f32 len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len == 0.f) {
+            continue;
+        }
+        for (u32 k = 0; k < 3; k++) {
+            n[k] /= len;
+            axis[k] += n[k];
+        }
+    }
+    const f32 axis_len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+    f32 min_dot = 1.f;
+    if (axis_len > 0.f) {
+        for (u32 k = 0; k < 3; k++) {
+            axis[k] /= axis_len;
+        }
+        for (u32 t = 0; t < meshlet->triangle_count; t++) {
+            const f32 *n = &normals[t * 3];
+            if (n[0] == 0.f && n[1] == 0.f && n[2] == 0.f) {
+                continue;
+            }
+            const f32 d = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+            min_dot = d < min_dot ? d : min_dot;
+        }
+    }
+
+    memcpy(bounds.cone_axis, axis, sizeof(axis));
+    memcpy(bounds.cone_apex, bounds.center, sizeof(bounds.center));
+    if (axis_len == 0.f || min_dot <= CONE_MIN_SPREAD) {
+        // Normals too spread out for the cone to ever reject anything.
+        bounds.cone_cutoff = 1.f;
+        free(normals);
+        return bounds;
+    }
+
+    // Pull the apex back along the axis until it lies behind every triangle plane.
+    f32 max_t = 0.f;
+    for (u32 t = 0; t < meshlet->triangle_count; t++) {
+        const f32 *n = &normals[t * 3];
+        if (n[0] == 0.f && n[1] == 0.f && n[2] == 0.f) {
+            continue;
+        }
+        const f32 *p = &positions[vertices[triangles[t * 3]] * 3];
+        const f32 to_center[3] = {bounds.center[0] - p[0], bounds.center[1] - p[1], bounds.center[2] - p[2]};
+        const f32 dc = to_center[0] * n[0] + to_center[1] * n[1] + to_center[2] * n[2];
+        const f32 dn = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+        const f32 t_plane = dc / dn;
+        max_t = t_plane > max_t ? t_plane : max_t;
+    }
+    for (u32 k = 0; k < 3; k++) {
+        bounds.cone_apex[k] = bounds.center[k] - axis[k] * max_t;
+    }
+    bounds.cone_cutoff = sqrtf(1.f - min_dot * min_dot);
+    free(normals);
+    return bounds;
+}
+
+void mesh_meshlets_free(mesh_meshlets_t *meshlets) {
+    free(meshlets->meshlets);
+    free(meshlets->bounds);
+    free(meshlets->vertices);
+    free(meshlets->triangles);
+    memset(meshlets, 0, sizeof(mesh_meshlets_t));
+}
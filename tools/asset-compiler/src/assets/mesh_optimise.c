@@ -0,0 +1,432 @@
+#include "assets/mesh_optimise.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <core/hash.h>
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_VALENCE_TABLE 32
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_CACHE_DECAY 1.5f
+#define FORSYTH_VALENCE_SCALE 2.0f
+#define FORSYTH_VALENCE_POWER 0.5f
+
+#define INVALID_INDEX (~0u)
+
+typedef struct {
+    const u32 *indices;
+    u32 *cache_time;
+    u32 time;
+    u32 cache_size;
+} cache_sim_t;
+
+static void _cache_sim_init(cache_sim_t *sim, const u32 *indices, u64 vertex_count, u32 cache_size) {
+    sim->indices = indices;
+    sim->cache_time = calloc(vertex_count, sizeof(u32));
+    sim->cache_size = cache_size;
+    sim->time = cache_size + 1;
+}
+
+static void _cache_sim_flush(cache_sim_t *sim) {
+    sim->time += sim->cache_size + 1;
+}
+
+// Returns the number of FIFO misses caused by triangle tri.
+static u32 _cache_sim_triangle(cache_sim_t *sim, u64 tri) {
+    u32 misses = 0;
+    for (u32 k = 0; k < 3; k++) {
+        const u32 v = sim->indices[tri * 3 + k];
+        if (sim->time - sim->cache_time[v] > sim->cache_size) {
+            sim->cache_time[v] = sim->time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+mesh_cache_stats_t mesh_opt_analyse_cache(const u32 *indices, u64 index_count, u64 vertex_count,
+                                          u32 cache_size) {
+    mesh_cache_stats_t stats = {0};
+    if (index_count < 3) {
+        return stats;
+    }
+    cache_sim_t sim;
+    _cache_sim_init(&sim, indices, vertex_count, cache_size);
+
+    u8 *referenced = calloc(vertex_count, 1);
+    u64 unique = 0;
+    u64 misses = 0;
+    const u64 tri_count = index_count / 3;
+    for (u64 t = 0; t < tri_count; t++) {
+        misses += _cache_sim_triangle(&sim, t);
+    }
+    for (u64 i = 0; i < index_count; i++) {
+        unique += referenced[indices[i]] == 0;
+        referenced[indices[i]] = 1;
+    }
+    stats.acmr = (f32) misses / (f32) tri_count;
+    stats.atvr = (f32) misses / (f32) unique;
+
+    free(referenced);
+    free(sim.cache_time);
+    return stats;
+}
+
+static u64 _vertex_hash(const mesh_opt_stream_t *streams, u32 stream_count, u32 v) {
+    u64 h = 0;
+    for (u32 s = 0; s < stream_count; s++) {
+        const u8 *data = (const u8 *) streams[s].data + v * streams[s].stride;
+        h = hash_combine(h, hash_bytes(data, streams[s].stride, s));
+    }
+    return h;
+}
+
+static b8 _vertex_equal(const mesh_opt_stream_t *streams, u32 stream_count, u32 a, u32 b) {
+    for (u32 s = 0; s < stream_count; s++) {
+        const u8 *data = streams[s].data;
+        const u64 stride = streams[s].stride;
+        if (memcmp(data + a * stride, data + b * stride, stride) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+u64 mesh_opt_generate_remap(u32 *remap, const u32 *indices, u64 index_count,
+                            const mesh_opt_stream_t *streams, u32 stream_count, u64 vertex_count) {
+    u64 table_size = 1;
+    while (table_size < vertex_count * 2) {
+        table_size *= 2;
+    }
+    u32 *table = malloc(table_size * sizeof(u32));
+    memset(table, 0xff, table_size * sizeof(u32));
+    memset(remap, 0xff, vertex_count * sizeof(u32));
+
+    u32 next = 0;
+    for (u64 i = 0; i < index_count; i++) {
+        const u32 v = indices[i];
+        if (remap[v] != INVALID_INDEX) {
+            continue;
+        }
+        u64 slot = _vertex_hash(streams, stream_count, v) & (table_size - 1);
+        while (table[slot] != INVALID_INDEX && !_vertex_equal(streams, stream_count, table[slot], v)) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] == INVALID_INDEX) {
+            table[slot] = v;
+            remap[v] = next++;
+        } else {
+            remap[v] = remap[table[slot]];
+        }
+    }
+    free(table);
+    return next;
+}
+
+void mesh_opt_remap_indices(u32 *dst, const u32 *indices, u64 index_count, const u32 *remap) {
+    for (u64 i = 0; i < index_count; i++) {
+        dst[i] = remap[indices[i]];
+    }
+}
+
+void mesh_opt_remap_vertices(void *dst, const void *src, u64 vertex_count, u64 stride, const u32 *remap) {
+    for (u64 i = 0; i < vertex_count; i++) {
+        if (remap[i] != INVALID_INDEX) {
+            memcpy((u8 *) dst + remap[i] * stride, (const u8 *) src + i * stride, stride);
+        }
+    }
+}
+
+static f32 g_forsyth_cache_scores[FORSYTH_CACHE_SIZE];
+static f32 g_forsyth_valence_scores[FORSYTH_VALENCE_TABLE];
+static once_flag g_forsyth_tables_once = ONCE_FLAG_INIT;
+
+static void _init_forsyth_tables() {
+    for (u32 i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+        if (i < 3) {
+            g_forsyth_cache_scores[i] = FORSYTH_LAST_TRI_SCORE;
+        } else {
+            const f32 s = 1.f - (f32) (i - 3) / (f32) (FORSYTH_CACHE_SIZE - 3);
+            g_forsyth_cache_scores[i] = powf(s, FORSYTH_CACHE_DECAY);
+        }
+    }
+    for (u32 i = 0; i < FORSYTH_VALENCE_TABLE; i++) {
+        g_forsyth_valence_scores[i] = i ? FORSYTH_VALENCE_SCALE * powf((f32) i, -FORSYTH_VALENCE_POWER) : 0.f;
+    }
+}
+
+static f32 _forsyth_vertex_score(i32 cache_pos, u32 remaining) {
+    if (remaining == 0) {
+        return -1.f;
+    }
+    f32 score = cache_pos >= 0 ? g_forsyth_cache_scores[cache_pos] : 0.f;
+    score += remaining < FORSYTH_VALENCE_TABLE
+                 ? g_forsyth_valence_scores[remaining]
+                 : FORSYTH_VALENCE_SCALE * powf((f32) remaining, -FORSYTH_VALENCE_POWER);
+    return score;
+}
+
+void mesh_opt_vertex_cache(u32 *dst, const u32 *indices, u64 index_count, u64 vertex_count) {
+    const u64 tri_count = index_count / 3;
+    if (tri_count == 0) {
+        return;
+    }
+    call_once(&g_forsyth_tables_once, _init_forsyth_tables);
+
+    // Vertex -> live triangle adjacency, triangles are swap-removed once emitted.
+    u32 *live = calloc(vertex_count, sizeof(u32));
+    u32 *offsets = malloc(vertex_count * sizeof(u32));
+    u32 *adjacency = malloc(index_count * sizeof(u32));
+    for (u64 i = 0; i < index_count; i++) {
+        live[indices[i]]++;
+    }
+    u32 offset = 0;
+    for (u64 v = 0; v < vertex_count; v++) {
+        offsets[v] = offset;
+        offset += live[v];
+        live[v] = 0;
+    }
+    for (u64 t = 0; t < tri_count; t++) {
+        for (u32 k = 0; k < 3; k++) {
+            const u32 v = indices[t * 3 + k];
+            adjacency[offsets[v] + live[v]++] = (u32) t;
+        }
+    }
+
+    i32 *cache_pos = malloc(vertex_count * sizeof(i32));
+    f32 *vertex_score = malloc(vertex_count * sizeof(f32));
+    for (u64 v = 0; v < vertex_count; v++) {
+        cache_pos[v] = -1;
+        vertex_score[v] = _forsyth_vertex_score(-1, live[v]);
+    }
+
+    f32 *tri_score = malloc(tri_count * sizeof(f32));
+    u8 *emitted = calloc(tri_count, 1);
+    u64 best = 0;
+    for (u64 t = 0; t < tri_count; t++) {
+        const u32 *tri = &indices[t * 3];
+        tri_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+        if (tri_score[t] > tri_score[best]) {
+            best = t;
+        }
+    }
+
+    u32 cache[FORSYTH_CACHE_SIZE + 3];
+    u32 cache_new[FORSYTH_CACHE_SIZE + 3];
+    u32 cache_count = 0;
+    u64 scan_cursor = 0;
+
+    for (u64 out = 0; out < tri_count; out++) {
+        const u32 *tri = &indices[best * 3];
+        dst[out * 3 + 0] = tri[0];
+        dst[out * 3 + 1] = tri[1];
+        dst[out * 3 + 2] = tri[2];
+        emitted[best] = 1;
+
+        for (u32 k = 0; k < 3; k++) {
+            const u32 v = tri[k];
+            u32 *list = &adjacency[offsets[v]];
+            for (u32 j = 0; j < live[v]; j++) {
+                if (list[j] == best) {
+                    list[j] = list[--live[v]];
+                    break;
+                }
+            }
+        }
+
+        // New cache: the emitted triangle first, then the previous contents.
+        u32 new_count = 0;
+        cache_new[new_count++] = tri[0];
+        cache_new[new_count++] = tri[1];
+        cache_new[new_count++] = tri[2];
+        for (u32 j = 0; j < cache_count; j++) {
+            const u32 v = cache[j];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                cache_new[new_count++] = v;
+            }
+        }
+
+        f32 best_score = -1.f;
+        u64 next_best = INVALID_INDEX;
+        for (u32 j = 0; j < new_count; j++) {
+            const u32 v = cache_new[j];
+            cache_pos[v] = j < FORSYTH_CACHE_SIZE ? (i32) j : -1;
+            vertex_score[v] = _forsyth_vertex_score(cache_pos[v], live[v]);
+        }
+        for (u32 j = 0; j < new_count; j++) {
+            const u32 v = cache_new[j];
+            for (u32 a = 0; a < live[v]; a++) {
+                const u32 t = adjacency[offsets[v] + a];
+                const u32 *other = &indices[t * 3];
+                tri_score[t] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+                if (tri_score[t] > best_score) {
+                    best_score = tri_score[t];
+                    next_best = t;
+                }
+            }
+        }
+
+        cache_count = new_count < FORSYTH_CACHE_SIZE ? new_count : FORSYTH_CACHE_SIZE;
+        memcpy(cache, cache_new, cache_count * sizeof(u32));
+
+        if (next_best == INVALID_INDEX) {
+            // Nothing adjacent to the cache: restart at the next live triangle.
+            while (scan_cursor < tri_count && emitted[scan_cursor]) {
+                scan_cursor++;
+            }
+            next_best = scan_cursor;
+        }
+        best = next_best;
+    }
+
+    free(emitted);
+    free(tri_score);
+    free(vertex_score);
+    free(cache_pos);
+    free(adjacency);
+    free(offsets);
+    free(live);
+}
+
+typedef struct {
+    f32 key;
+    u32 cluster;
+} cluster_sort_t;
+
+static int _compare_clusters(const void *pa, const void *pb) {
+    const cluster_sort_t *a = pa;
+    const cluster_sort_t *b = pb;
+    if (a->key != b->key) {
+        return a->key > b->key ? -1 : 1;
+    }
+    return a->cluster < b->cluster ? -1 : 1;
+}
+
+static const f32 *_position(const f32 *positions, u64 stride, u32 v) {
+    return (const f32 *) ((const u8 *) positions + v * stride);
+}
+
+void mesh_opt_overdraw(u32 *dst, const u32 *indices, u64 index_count, const f32 *positions,
+                       u64 vertex_count, u64 position_stride, f32 threshold) {
+    const u64 tri_count = index_count / 3;
+    if (tri_count == 0) {
+        return;
+    }
+    cache_sim_t sim;
+    _cache_sim_init(&sim, indices, vertex_count, MESH_OPT_CACHE_SIZE);
+
+    // Hard boundaries: triangles where the cache was effectively flushed.
+    u32 *hard = malloc((tri_count + 1) * sizeof(u32));
+    u64 hard_count = 0;
+    for (u64 t = 0; t < tri_count; t++) {
+        if (_cache_sim_triangle(&sim, t) == 3 || t == 0) {
+            hard[hard_count++] = (u32) t;
+        }
+    }
+    hard[hard_count] = (u32) tri_count;
+
+    // Soft boundaries: split further wherever the running ACMR is already
+    // within threshold of the whole cluster's.
+    u32 *clusters = malloc((tri_count + 1) * sizeof(u32));
+    u64 cluster_count = 0;
+    for (u64 c = 0; c < hard_count; c++) {
+        const u32 start = hard[c];
+        const u32 end = hard[c + 1];
+
+        _cache_sim_flush(&sim);
+        u32 cluster_misses = 0;
+        for (u32 t = start; t < end; t++) {
+            cluster_misses += _cache_sim_triangle(&sim, t);
+        }
+        const f32 cluster_threshold = threshold * (f32) cluster_misses / (f32) (end - start);
+
+        clusters[cluster_count++] = start;
+        _cache_sim_flush(&sim);
+        u32 running_misses = 0;
+        u32 running_tris = 0;
+        for (u32 t = start; t < end; t++) {
+            running_misses += _cache_sim_triangle(&sim, t);
+            running_tris++;
+            if ((f32) running_misses / (f32) running_tris <= cluster_threshold && t + 1 < end) {
+                clusters[cluster_count++] = t + 1;
+                _cache_sim_flush(&sim);
+                running_misses = 0;
+                running_tris = 0;
+            }
+        }
+    }
+    clusters[cluster_count] = (u32) tri_count;
+
+    f32 mesh_centroid[3] = {0.f, 0.f, 0.f};
+    for (u64 v = 0; v < vertex_count; v++) {
+        const f32 *p = _position(positions, position_stride, (u32) v);
+        mesh_centroid[0] += p[0];
+        mesh_centroid[1] += p[1];
+        mesh_centroid[2] += p[2];
+    }
+    for (u32 k = 0; k < 3; k++) {
+        mesh_centroid[k] /= (f32) vertex_count;
+    }
+
+    cluster_sort_t *order = malloc(cluster_count * sizeof(cluster_sort_t));
+    for (u64 c = 0; c < cluster_count; c++) {
+        f32 centroid[3] = {0.f, 0.f, 0.f};
+        f32 normal[3] = {0.f, 0.f, 0.f};
+        f32 area_sum = 0.f;
+        for (u32 t = clusters[c]; t < clusters[c + 1]; t++) {
+            const f32 *a = _position(positions, position_stride, indices[t * 3 + 0]);
+            const f32 *b = _position(positions, position_stride, indices[t * 3 + 1]);
+            const f32 *d = _position(positions, position_stride, indices[t * 3 + 2]);
+            const f32 e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            const f32 e1[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+            const f32 n[3] = {
+                e0[1] * e1[2] - e0[2] * e1[1],
+                e0[2] * e1[0] - e0[0] * e1[2],
+                e0[0] * e1[1] - e0[1] * e1[0],
+            };
+            const f32 area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (u32 k = 0; k < 3; k++) {
+                centroid[k] += area * (a[k] + b[k] + d[k]) / 3.f;
+                normal[k] += n[k];
+            }
+            area_sum += area;
+        }
+        const f32 inv_area = area_sum > 0.f ? 1.f / area_sum : 0.f;
+        const f32 normal_len = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const f32 inv_normal = normal_len > 0.f ? 1.f / normal_len : 0.f;
+
+        f32 key = 0.f;
+        for (u32 k = 0; k < 3; k++) {
+            key += (centroid[k] * inv_area - mesh_centroid[k]) * normal[k] * inv_normal;
+        }
+        order[c].key = key;
+        order[c].cluster = (u32) c;
+    }
+    qsort(order, cluster_count, sizeof(cluster_sort_t), _compare_clusters);
+
+    u64 out = 0;
+    for (u64 c = 0; c < cluster_count; c++) {
+        const u32 cluster = order[c].cluster;
+        const u64 count = (clusters[cluster + 1] - clusters[cluster]) * 3;
+        memcpy(&dst[out], &indices[clusters[cluster] * 3], count * sizeof(u32));
+        out += count;
+    }
+
+    free(order);
+    free(clusters);
+    free(hard);
+    free(sim.cache_time);
+}
+
+u64 mesh_opt_vertex_fetch_remap(u32 *remap, const u32 *indices, u64 index_count, u64 vertex_count) {
+    memset(remap, 0xff, vertex_count * sizeof(u32));
+    u32 next = 0;
+    for (u64 i = 0; i < index_count; i++) {
+        if (remap[indices[i]] == INVALID_INDEX) {
+            remap[indices[i]] = next++;
+        }
+    }
+    return next;
+}
@@ -0,0 +1,319 @@
+#include "assets/mesh_simplify.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <core/hash.h>
+
+#define INVALID_INDEX (~0u)
+#define SIMPLIFY_MAX_PASSES 64
+#define SIMPLIFY_FLIP_THRESHOLD 1e-2
+
+typedef struct {
+    f64 a2, b2, c2, d2;
+    f64 ab, ac, ad;
+    f64 bc, bd, cd;
+    f64 w;
+} quadric_t;
+
+typedef struct {
+    u32 from;
+    u32 to;
+    f64 cost;
+} collapse_t;
+
+static void _quadric_add_plane(quadric_t *q, f64 a, f64 b, f64 c, f64 d, f64 w) {
+    q->a2 += w * a * a;
+    q->b2 += w * b * b;
+    q->c2 += w * c * c;
+    q->d2 += w * d * d;
+    q->ab += w * a * b;
+    q->ac += w * a * c;
+    q->ad += w * a * d;
+    q->bc += w * b * c;
+    q->bd += w * b * d;
+    q->cd += w * c * d;
+    q->w += w;
+}
+
+static void _quadric_sum(quadric_t *out, const quadric_t *a, const quadric_t *b) {
+    out->a2 = a->a2 + b->a2;
+    out->b2 = a->b2 + b->b2;
+    out->c2 = a->c2 + b->c2;
+    out->d2 = a->d2 + b->d2;
+    out->ab = a->ab + b->ab;
+    out->ac = a->ac + b->ac;
+    out->ad = a->ad + b->ad;
+    out->bc = a->bc + b->bc;
+    out->bd = a->bd + b->bd;
+    out->cd = a->cd + b->cd;
+    out->w = a->w + b->w;
+}
+
+// Weighted mean squared distance of p to the quadric's planes.
+static f64 _quadric_error(const quadric_t *q, const f32 *p) {
+    const f64 x = p[0], y = p[1], z = p[2];
+    const f64 e = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z + q->d2 +
+                  2.0 * (q->ab * x * y + q->ac * x * z + q->ad * x + q->bc * y * z + q->bd * y + q->cd * z);
+    return q->w > 0.0 ? fabs(e) / q->w : 0.0;
+}
+
+static const f32 *_pos(const f32 *positions, u32 v) {
+    return &positions[v * 3];
+}
+
+static void _triangle_normal(const f32 *a, const f32 *b, const f32 *c, f64 n[3]) {
+    const f64 e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const f64 e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+// Collapses vertices sharing a position onto one representative, so seams
+// are seen as one surface.
+static void _build_position_remap(u32 *rep, const f32 *positions, u64 vertex_count) {
+    u64 table_size = 1;
+    while (table_size < vertex_count * 2) {
+        table_size *= 2;
+    }
+    u32 *table = malloc(table_size * sizeof(u32));
+    memset(table, 0xff, table_size * sizeof(u32));
+    for (u64 v = 0; v < vertex_count; v++) {
+        const f32 *p = _pos(positions, (u32) v);
+        u64 slot = hash_bytes(p, 3 * sizeof(f32), 0) & (table_size - 1);
+        while (table[slot] != INVALID_INDEX && memcmp(_pos(positions, table[slot]), p, 3 * sizeof(f32)) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] == INVALID_INDEX) {
+            table[slot] = (u32) v;
+        }
+        rep[v] = table[slot];
+    }
+    free(table);
+}
+
+// Marks representatives that must not move: attribute seams and vertices on
+// an open border (an edge used by exactly one triangle).
+static void _classify_locked(u8 *locked, const u32 *indices, u64 index_count, const u32 *rep, u64 vertex_count) {
+    memset(locked, 0, vertex_count);
+    for (u64 v = 0; v < vertex_count; v++) {
+        if (rep[v] != v) {
+            locked[rep[v]] = 1;
+        }
+    }
+
+    u64 table_size = 1;
+    while (table_size < index_count * 2) {
+        table_size *= 2;
+    }
+    u64 *edges = malloc(table_size * sizeof(u64));
+    u32 *uses = calloc(table_size, sizeof(u32));
+    memset(edges, 0xff, table_size * sizeof(u64));
+    for (u64 i = 0; i < index_count; i++) {
+        const u32 a = rep[indices[i]];
+        const u32 b = rep[indices[i - i % 3 + (i + 1) % 3]];
+        const u64 key = a < b ? ((u64) a << 32) | b : ((u64) b << 32) | a;
+        u64 slot = hash_bytes(&key, sizeof(key), 0) & (table_size - 1);
+        while (edges[slot] != ~0ull && edges[slot] != key) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        edges[slot] = key;
+        uses[slot]++;
+    }
+    for (u64 s = 0; s < table_size; s++) {
+        if (edges[s] != ~0ull && uses[s] == 1) {
+            locked[edges[s] >> 32] = 1;
+            locked[edges[s] & 0xffffffffu] = 1;
+        }
+    }
+    free(uses);
+    free(edges);
+}
+
+static int _compare_collapses(const void *pa, const void *pb) {
+    const collapse_t *a = pa;
+    const collapse_t *b = pb;
+    if (a->cost != b->cost) {
+        return a->cost < b->cost ? -1 : 1;
+    }
+    return a->from < b->from ? -1 : (a->from > b->from ? 1 : 0);
+}
+
+// Would moving every corner at from onto to flip any remaining triangle.
+static b8 _collapse_flips(const u32 *indices, const u32 *rep, const f32 *positions, const u32 *adj_offsets,
+                          const u32 *adjacency, u32 from, u32 to) {
+    for (u32 a = adj_offsets[from]; a < adj_offsets[from + 1]; a++) {
+        const u32 *tri = &indices[adjacency[a] * 3];
+        const u32 r[3] = {rep[tri[0]], rep[tri[1]], rep[tri[2]]};
+        if (r[0] == to || r[1] == to || r[2] == to) {
+            continue;
+        }
+        const f32 *p[3] = {_pos(positions, r[0]), _pos(positions, r[1]), _pos(positions, r[2])};
+        f64 before[3];
+        _triangle_normal(p[0], p[1], p[2], before);
+        for (u32 k = 0; k < 3; k++) {
+            if (r[k] == from) {
+                p[k] = _pos(positions, to);
+            }
+        }
+        f64 after[3];
+        _triangle_normal(p[0], p[1], p[2], after);
+        const f64 dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        const f64 lb = sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+        const f64 la = sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+        if (dot < SIMPLIFY_FLIP_THRESHOLD * lb * la) {
+            return true;
+        }
+    }
+    return false;
+}
+
+u64 mesh_simplify(u32 *dst, const u32 *indices, u64 index_count, const f32 *positions, u64 vertex_count,
+                  u64 target_index_count, f32 max_error, f32 *out_error) {
+    memcpy(dst, indices, index_count * sizeof(u32));
+    *out_error = 0.f;
+    if (index_count <= target_index_count || vertex_count == 0) {
+        return index_count;
+    }
+
+    u32 *rep = malloc(vertex_count * sizeof(u32));
+    u8 *locked = malloc(vertex_count);
+    _build_position_remap(rep, positions, vertex_count);
+    _classify_locked(locked, indices, index_count, rep, vertex_count);
+
+    quadric_t *quadrics = calloc(vertex_count, sizeof(quadric_t));
+    for (u64 t = 0; t < index_count / 3; t++) {
+        const u32 r[3] = {rep[indices[t * 3]], rep[indices[t * 3 + 1]], rep[indices[t * 3 + 2]]};
+        f64 n[3];
+        _triangle_normal(_pos(positions, r[0]), _pos(positions, r[1]), _pos(positions, r[2]), n);
+        const f64 len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len == 0.0) {
+            continue;
+        }
+        n[0] /= len;
+        n[1] /= len;
+        n[2] /= len;
+        const f32 *p = _pos(positions, r[0]);
+        const f64 d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+        for (u32 k = 0; k < 3; k++) {
+            _quadric_add_plane(&quadrics[r[k]], n[0], n[1], n[2], d, 0.5 * len);
+        }
+    }
+
+    u32 *collapse_to = malloc(vertex_count * sizeof(u32));
+    u8 *touched = malloc(vertex_count);
+    u32 *adj_offsets = malloc((vertex_count + 1) * sizeof(u32));
+    u32 *adjacency = malloc(index_count * sizeof(u32));
+    collapse_t *collapses = malloc(index_count * sizeof(collapse_t));
+    const f64 max_cost = max_error > 0.f ? (f64) max_error * max_error : INFINITY;
+    f64 result_cost = 0.0;
+
+    for (u32 pass = 0; pass < SIMPLIFY_MAX_PASSES && index_count > target_index_count; pass++) {
+        const u64 tri_count = index_count / 3;
+
+        memset(adj_offsets, 0, (vertex_count + 1) * sizeof(u32));
+        for (u64 i = 0; i < index_count; i++) {
+            adj_offsets[rep[dst[i]] + 1]++;
+        }
+        for (u64 v = 0; v < vertex_count; v++) {
+            adj_offsets[v + 1] += adj_offsets[v];
+        }
+        memset(collapse_to, 0, vertex_count * sizeof(u32));
+        for (u64 i = 0; i < index_count; i++) {
+            const u32 r = rep[dst[i]];
+            adjacency[adj_offsets[r] + collapse_to[r]++] = (u32) (i / 3);
+        }
+
+        // Candidate collapses along every triangle edge, cheapest direction.
+        u64 collapse_count = 0;
+        for (u64 i = 0; i < index_count; i++) {
+            const u32 a = dst[i];
+            const u32 b = dst[i - i % 3 + (i + 1) % 3];
+            const u32 ra = rep[a];
+            const u32 rb = rep[b];
+            if (ra == rb || (locked[ra] && locked[rb])) {
+                continue;
+            }
+            quadric_t q;
+            _quadric_sum(&q, &quadrics[ra], &quadrics[rb]);
+            const f64 cost_ab = locked[ra] ? INFINITY : _quadric_error(&q, _pos(positions, rb));
+            const f64 cost_ba = locked[rb] ? INFINITY : _quadric_error(&q, _pos(positions, ra));
+            collapse_t c;
+            if (cost_ab <= cost_ba) {
+                c.from = a;
+                c.to = b;
+                c.cost = cost_ab;
+            } else {
+                c.from = b;
+                c.to = a;
+                c.cost = cost_ba;
+            }
+            if (c.cost <= max_cost) {
+                collapses[collapse_count++] = c;
+            }
+        }
+        if (collapse_count == 0) {
+            break;
+        }
+        qsort(collapses, collapse_count, sizeof(collapse_t), _compare_collapses);
+
+        // Each interior collapse removes roughly two triangles.
+        const u64 goal = (index_count - target_index_count) / 6 + 1;
+        memset(touched, 0, vertex_count);
+        for (u64 v = 0; v < vertex_count; v++) {
+            collapse_to[v] = (u32) v;
+        }
+        u64 collapsed = 0;
+        for (u64 c = 0; c < collapse_count && collapsed < goal; c++) {
+            const u32 from = collapses[c].from;
+            const u32 to = collapses[c].to;
+            const u32 rf = rep[from];
+            const u32 rt = rep[to];
+            if (touched[rf] || touched[rt]) {
+                continue;
+            }
+            if (_collapse_flips(dst, rep, positions, adj_offsets, adjacency, rf, rt)) {
+                continue;
+            }
+            collapse_to[from] = to;
+            _quadric_sum(&quadrics[rt], &quadrics[rt], &quadrics[rf]);
+            // Keep the freshly merged neighbourhood stable for the rest of the pass.
+            for (u32 a = adj_offsets[rf]; a < adj_offsets[rf + 1]; a++) {
+                const u32 *tri = &dst[adjacency[a] * 3];
+                touched[rep[tri[0]]] = touched[rep[tri[1]]] = touched[rep[tri[2]]] = 1;
+            }
+            result_cost = collapses[c].cost > result_cost ? collapses[c].cost : result_cost;
+            collapsed++;
+        }
+        if (collapsed == 0) {
+            break;
+        }
+
+        u64 write = 0;
+        for (u64 t = 0; t < tri_count; t++) {
+            const u32 a = collapse_to[dst[t * 3 + 0]];
+            const u32 b = collapse_to[dst[t * 3 + 1]];
+            const u32 c = collapse_to[dst[t * 3 + 2]];
+            if (rep[a] == rep[b] || rep[b] == rep[c] || rep[a] == rep[c]) {
+                continue;
+            }
+            dst[write++] = a;
+            dst[write++] = b;
+            dst[write++] = c;
+        }
+        index_count = write;
+    }
+
+    *out_error = (f32) sqrt(result_cost);
+
+    free(collapses);
+    free(adjacency);
+    free(adj_offsets);
+    free(touched);
+    free(collapse_to);
+    free(quadrics);
+    free(locked);
+    free(rep);
+    return index_count;
+}
@@ -0,0 +1,350 @@
+#include "batch/batch.h"
+#include "batch/cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <core/arrays.h>
+#include <core/hash.h>
+#include <core/jobs.h>
+
+#include <assimp/cimport.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define BATCH_PATH_MAX 4096
+#define BATCH_CACHE_FILE ".potentia-cache"
+#define BATCH_OUTPUT_EXT ".pmsh"
+
+typedef struct {
+    const batch_config_t *config;
+    const asset_cache_t *cache;
+    batch_job_list_t *list;
+} batch_shared_t;
+
+static char *_join_path(const char *a, const char *b) {
+    const size_t len = strlen(a) + strlen(b) + 2;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%s", a, b);
+    return path;
+}
+
+static b8 _is_importable(const char *path) {
+    const char *ext = strrchr(path, '.');
+    return ext && aiIsExtensionSupported(ext);
+}
+
+static void _push_job(batch_job_list_t *list, const char *root, const char *relative) {
+    list->count++;
+    array_grow((void **) &list->jobs, &list->capacity, list->count, sizeof(batch_job_t));
+    batch_job_t *job = &list->jobs[list->count - 1];
+    job->input = _join_path(root, relative);
+    job->relative = strdup(relative);
+    job->output = 0;
+    job->key = 0;
+    memset(&job->dependencies, 0, sizeof(job->dependencies));
+    job->status = BATCH_JOB_PENDING;
+    memset(&job->report, 0, sizeof(mesh_report_t));
+}
+
+static int _walk_directory(const char *root, const char *relative, batch_job_list_t *list) {
+    char *dir = relative[0] ? _join_path(root, relative) : strdup(root);
+#ifdef _WIN32
+    char pattern[BATCH_PATH_MAX];
+    snprintf(pattern, sizeof(pattern), "%s/*", dir);
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    free(dir);
+    if (find == INVALID_HANDLE_VALUE) {
+        return 1;
+    }
+    do {
+        const char *name = entry.cFileName;
+        const b8 is_dir = (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    DIR *d = opendir(dir);
+    if (!d) {
+        free(dir);
+        return 1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        const char *name = entry->d_name;
+        char full[BATCH_PATH_MAX];
+        snprintf(full, sizeof(full), "%s/%s", dir, name);
+        struct stat st;
+        if (stat(full, &st) != 0) {
+            continue;
+        }
+        const b8 is_dir = S_ISDIR(st.st_mode);
+#endif
+        if (name[0] == '.') {
+            continue;
+        }
+        char child[BATCH_PATH_MAX];
+        if (relative[0]) {
+            snprintf(child, sizeof(child), "%s/%s", relative, name);
+        } else {
+            snprintf(child, sizeof(child), "%s", name);
+        }
+        if (is_dir) {
+            _walk_directory(root, child, list);
+        } else if (_is_importable(name)) {
+            _push_job(list, root, child);
+        }
+#ifdef _WIN32
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    }
+    closedir(d);
+    free(dir);
+#endif
+    return 0;
+}
+
+int batch_collect_directory(const char *dir, batch_job_list_t *list) {
+    return _walk_directory(dir, "", list);
+}
+
+int batch_collect_manifest(const char *manifest, batch_job_list_t *list) {
+    FILE *f = fopen(manifest, "r");
+    if (!f) {
+        return 1;
+    }
+
+    // Manifest entries are relative to the manifest's own directory.
+    char root[BATCH_PATH_MAX];
+    snprintf(root, sizeof(root), "%s", manifest);
+    char *sep = strrchr(root, '/');
+    if (sep) {
+        *sep = 0;
+    } else {
+        snprintf(root, sizeof(root), ".");
+    }
+
+    char line[BATCH_PATH_MAX];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == 0 || line[0] == '#') {
+            continue;
+        }
+        _push_job(list, root, line);
+    }
+    fclose(f);
+    return 0;
+}
+
+void batch_job_list_free(batch_job_list_t *list) {
+    for (u64 i = 0; i < list->count; i++) {
+        free(list->jobs[i].input);
+        free(list->jobs[i].relative);
+        free(list->jobs[i].output);
+        mesh_dependencies_free(&list->jobs[i].dependencies);
+    }
+    memory_free(list->jobs, list->capacity * sizeof(batch_job_t), MEMORY_TAG_ARRAY);
+    memset(list, 0, sizeof(batch_job_list_t));
+}
+
+u32 batch_default_worker_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const long count = info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? (u32) count : 1;
+}
+
+static b8 _file_exists(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+static void _make_parent_dirs(const char *path) {
+    char buf[BATCH_PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') {
+            continue;
+        }
+        *p = 0;
+#ifdef _WIN32
+        _mkdir(buf);
+#else
+        mkdir(buf, 0755);
+#endif
+        *p = '/';
+    }
+}
+
+static char *_output_path(const char *output_dir, const char *relative) {
+    char buf[BATCH_PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s/%s", output_dir, relative);
+    char *ext = strrchr(buf, '.');
+    char *sep = strrchr(buf, '/');
+    if (ext && ext > sep) {
+        *ext = 0;
+    }
+    const size_t len = strlen(buf) + strlen(BATCH_OUTPUT_EXT) + 1;
+    char *path = malloc(len);
+    snprintf(path, len, "%s%s", buf, BATCH_OUTPUT_EXT);
+    return path;
+}
+
+static b8 _exceeds_limits(const batch_error_limits_t *limits, const mesh_encoding_report_t *report) {
+    return (limits->position_relative > 0.f && report->position_max_relative > limits->position_relative) ||
+           (limits->normal_deg > 0.f && report->normal_max_deg > limits->normal_deg) ||
+           (limits->normal_deg > 0.f && report->tangent_max_deg > limits->normal_deg) ||
+           (limits->tex_coord > 0.f && report->tex_coord_max > limits->tex_coord);
+}
+
+// Mixes the path and contents of every dependency into key. Fails when one of
+// them can't be read any more, which forces a rebuild.
+static int _hash_dependencies(u64 key, char *const *paths, u64 count, u64 *out) {
+    for (u64 i = 0; i < count; i++) {
+        u64 content_hash;
+        if (asset_hash_file(paths[i], 0, &content_hash) != 0) {
+            return 1;
+        }
+        key = hash_combine(key, hash_combine(hash_bytes(paths[i], strlen(paths[i]), 0), content_hash));
+    }
+    *out = key;
+    return 0;
+}
+
+static void _run_job(const batch_shared_t *shared, batch_job_t *job) {
+    const batch_config_t *config = shared->config;
+    job->output = _output_path(config->output_dir, job->relative);
+
+    u64 content_hash;
+    if (asset_hash_file(job->input, 0, &content_hash) != 0) {
+        job->status = BATCH_JOB_FAILED;
+        return;
+    }
+    // The limits are part of the key: a mesh compiled under looser limits
+    // has to go through the gates again, not be skipped.
+    const u64 input_key =
+        hash_combine(hash_combine(content_hash, mesh_import_options_hash(&config->options)),
+                     hash_bytes(&config->limits, sizeof(config->limits), 0));
+
+    // The dependencies are only known from the last import. If the input
+    // now refers to different files, its own hash has changed anyway.
+    const asset_cache_entry_t *cached = config->force ? 0 : asset_cache_lookup(shared->cache, job->relative);
+    u64 cached_key;
+    if (cached && _file_exists(job->output) &&
+        _hash_dependencies(input_key, cached->dependencies, cached->dependency_count, &cached_key) == 0 &&
+        cached_key == cached->key) {
+        for (u32 i = 0; i < cached->dependency_count; i++) {
+            array_push(&job->dependencies, strdup(cached->dependencies[i]));
+        }
+        job->key = cached_key;
+        job->status = BATCH_JOB_SKIPPED;
+        return;
+    }
+
+    handle_t handle;
+    if (mesh_load_tracked(job->input, &config->options, &handle, &job->dependencies) != 0) {
+        job->status = BATCH_JOB_FAILED;
+        return;
+    }
+    if (_hash_dependencies(input_key, job->dependencies.data, job->dependencies.count, &job->key) != 0) {
+        job->status = BATCH_JOB_FAILED;
+        mesh_release(&handle);
+        return;
+    }
+    mesh_get_report(&handle, &job->report);
+    if (_exceeds_limits(&config->limits, &job->report.encoding)) {
+        job->status = BATCH_JOB_FAILED;
+        mesh_release(&handle);
+        return;
+    }
+    _make_parent_dirs(job->output);
+    job->status = mesh_save(job->output, &handle) == 0 ? BATCH_JOB_COMPILED : BATCH_JOB_FAILED;
+    mesh_release(&handle);
+}
+
+static void _run_jobs(void *data, u32 begin, u32 end) {
+    const batch_shared_t *shared = data;
+    for (u32 i = begin; i < end; i++) {
+        _run_job(shared, &shared->list->jobs[i]);
+    }
+}
+
+static f64 _now_seconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (f64) ts.tv_sec + (f64) ts.tv_nsec * 1e-9;
+}
+
+batch_stats_t batch_run(const batch_config_t *config, batch_job_list_t *list) {
+    const f64 start = _now_seconds();
+
+    char *cache_path = _join_path(config->output_dir, BATCH_CACHE_FILE);
+    asset_cache_t cache;
+    asset_cache_load(&cache, cache_path);
+
+    batch_shared_t shared;
+    shared.config = config;
+    shared.cache = &cache;
+    shared.list = list;
+
+    u32 worker_count = config->worker_count ? config->worker_count : batch_default_worker_count();
+    if (worker_count > list->count) {
+        worker_count = list->count > 0 ? (u32) list->count : 1;
+    }
+    // One asset per job, imports vary too much in cost for bigger batches.
+    // The calling thread takes part while it waits.
+    if (job_system_init(worker_count - 1) < worker_count - 1) {
+        fprintf(stderr, "could not start %u workers, compiling on fewer threads\n", worker_count - 1);
+    }
+    job_counter_t counter = {0};
+    job_parallel_for(_run_jobs, &shared, (u32) list->count, 1, &counter);
+    job_wait(&counter);
+    job_system_shutdown();
+
+    // Only inputs seen in this run survive into the new cache, failures are
+    // dropped so they get retried next time.
+    asset_cache_t next_cache;
+    memset(&next_cache, 0, sizeof(next_cache));
+    batch_stats_t stats = {0};
+    for (u64 i = 0; i < list->count; i++) {
+        const batch_job_t *job = &list->jobs[i];
+        switch (job->status) {
+            case BATCH_JOB_COMPILED:
+                stats.compiled++;
+                asset_cache_set(&next_cache, job->relative, job->key, job->dependencies.data,
+                                (u32) job->dependencies.count);
+                break;
+            case BATCH_JOB_SKIPPED:
+                stats.skipped++;
+                asset_cache_set(&next_cache, job->relative, job->key, job->dependencies.data,
+                                (u32) job->dependencies.count);
+                break;
+            default:
+                stats.failed++;
+                break;
+        }
+    }
+    _make_parent_dirs(cache_path);
+    asset_cache_save(&next_cache, cache_path);
+    asset_cache_free(&next_cache);
+    asset_cache_free(&cache);
+    free(cache_path);
+
+    stats.seconds = _now_seconds() - start;
+    return stats;
+}
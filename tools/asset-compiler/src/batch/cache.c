@@ -0,0 +1,163 @@
+#include "batch/cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <core/file.h>
+#include <core/hash.h>
+
+#define CACHE_START_CAPACITY 64
+#define CACHE_HEADER "potentia-asset-cache 2"
+#define HASH_CHUNK_SIZE (1 << 20)
+#define HASH_STREAM_BUFFER_SIZE 4096
+
+static u64 _path_hash(const char *path) {
+    return hash_bytes(path, strlen(path), 0);
+}
+
+static asset_cache_entry_t *_find_slot(const asset_cache_t *cache, const char *path) {
+    const u64 mask = cache->capacity - 1;
+    u64 slot = _path_hash(path) & mask;
+    while (cache->entries[slot].path && strcmp(cache->entries[slot].path, path) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return &cache->entries[slot];
+}
+
+static void _grow(asset_cache_t *cache) {
+    asset_cache_t grown;
+    grown.count = 0;
+    grown.capacity = cache->capacity ? cache->capacity * 2 : CACHE_START_CAPACITY;
+    grown.entries = calloc(grown.capacity, sizeof(asset_cache_entry_t));
+
+    for (u64 i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].path) {
+            *_find_slot(&grown, cache->entries[i].path) = cache->entries[i];
+            grown.count++;
+        }
+    }
+    free(cache->entries);
+    *cache = grown;
+}
+
+static void _free_dependencies(asset_cache_entry_t *entry) {
+    for (u32 i = 0; i < entry->dependency_count; i++) {
+        free(entry->dependencies[i]);
+    }
+    free(entry->dependencies);
+    entry->dependencies = 0;
+    entry->dependency_count = 0;
+}
+
+static void _add_dependency(asset_cache_entry_t *entry, const char *path) {
+    entry->dependencies = realloc(entry->dependencies, sizeof(char *) * (entry->dependency_count + 1));
+    entry->dependencies[entry->dependency_count++] = strdup(path);
+}
+
+int asset_cache_load(asset_cache_t *cache, const char *filename) {
+    memset(cache, 0, sizeof(asset_cache_t));
+    _grow(cache);
+
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        return 1;
+    }
+    char line[4096];
+    if (!fgets(line, sizeof(line), f) || strncmp(line, CACHE_HEADER, strlen(CACHE_HEADER)) != 0) {
+        fclose(f);
+        return 1;
+    }
+    // "<key> <path>", followed by a "+ <path>" line per dependency.
+    asset_cache_entry_t *entry = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '+' && line[1] == ' ') {
+            if (entry) {
+                _add_dependency(entry, line + 2);
+            }
+            continue;
+        }
+        char *path = 0;
+        const u64 key = strtoull(line, &path, 16);
+        if (!path || *path != ' ') {
+            entry = 0;
+            continue;
+        }
+        path++;
+        asset_cache_set(cache, path, key, 0, 0);
+        entry = _find_slot(cache, path);
+    }
+    fclose(f);
+    return 0;
+}
+
+int asset_cache_save(const asset_cache_t *cache, const char *filename) {
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        return 1;
+    }
+    fprintf(f, "%s\n", CACHE_HEADER);
+    for (u64 i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].path) {
+            const asset_cache_entry_t *entry = &cache->entries[i];
+            fprintf(f, "%016llx %s\n", entry->key, entry->path);
+            for (u32 d = 0; d < entry->dependency_count; d++) {
+                fprintf(f, "+ %s\n", entry->dependencies[d]);
+            }
+        }
+    }
+    return fclose(f) == 0 ? 0 : 1;
+}
+
+const asset_cache_entry_t *asset_cache_lookup(const asset_cache_t *cache, const char *path) {
+    const asset_cache_entry_t *entry = _find_slot(cache, path);
+    return entry->path ? entry : 0;
+}
+
+void asset_cache_set(asset_cache_t *cache, const char *path, u64 key, char *const *dependencies,
+                     u32 dependency_count) {
+    // Keep the load factor under 1/2 so probes stay short.
+    if ((cache->count + 1) * 2 > cache->capacity) {
+        _grow(cache);
+    }
+    asset_cache_entry_t *entry = _find_slot(cache, path);
+    if (!entry->path) {
+        entry->path = strdup(path);
+        cache->count++;
+    }
+    entry->key = key;
+    _free_dependencies(entry);
+    for (u32 i = 0; i < dependency_count; i++) {
+        _add_dependency(entry, dependencies[i]);
+    }
+}
+
+void asset_cache_free(asset_cache_t *cache) {
+    for (u64 i = 0; i < cache->capacity; i++) {
+        free(cache->entries[i].path);
+        _free_dependencies(&cache->entries[i]);
+    }
+    free(cache->entries);
+    memset(cache, 0, sizeof(asset_cache_t));
+}
+
+int asset_hash_file(const char *filename, u64 seed, u64 *hash) {
+    u8 buffer[HASH_STREAM_BUFFER_SIZE];
+    file_stream_t stream;
+    if (file_stream_open(filename, buffer, sizeof(buffer), &stream) != FILE_OK) {
+        return 1;
+    }
+    // Whole chunks are requested every time, so the hash never depends on
+    // how the OS happened to split the reads. They bypass the stream buffer.
+    u8 *chunk = malloc(HASH_CHUNK_SIZE);
+    u64 h = seed;
+    u64 read = 0;
+    file_result_t result;
+    while ((result = file_stream_read(&stream, chunk, HASH_CHUNK_SIZE, &read)) == FILE_OK && read > 0) {
+        h = hash_combine(h, hash_bytes(chunk, read, 0));
+    }
+    file_stream_close(&stream);
+    free(chunk);
+    *hash = h;
+    return result == FILE_OK ? 0 : 1;
+}
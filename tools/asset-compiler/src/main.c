@@ -1,6 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#define DV_FILENAME "model.fbx"
+#include "assets/mesh.h"
+#include "assets/mesh_meshlet.h"
+#include "batch/batch.h"
 
-int main() {
+static void _print_optimise_report(const batch_job_list_t *list) {
+    for (u64 i = 0; i < list->count; i++) {
+        const batch_job_t *job = &list->jobs[i];
+        if (job->status != BATCH_JOB_COMPILED) {
+            continue;
+        }
+        const mesh_optimise_stats_t *s = &job->report.optimise;
+        printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, vertices %llu -> %llu\n", job->relative,
+               s->before.acmr, s->after.acmr, s->before.atvr, s->after.atvr, s->vertices_before,
+               s->vertices_after);
+    }
+}
 
-}
\ No newline at end of file
+static void _print_encoding_report(const batch_job_list_t *list) {
+    for (u64 i = 0; i < list->count; i++) {
+        const batch_job_t *job = &list->jobs[i];
+        if (job->status == BATCH_JOB_SKIPPED || job->status == BATCH_JOB_PENDING) {
+            continue;
+        }
+        const mesh_encoding_report_t *r = &job->report.encoding;
+        printf("%s: position max %g (%.2e of extent) mean %g, normal max %.3fdeg mean %.3fdeg, "
+               "tangent max %.3fdeg, uv max %g mean %g\n",
+               job->relative, r->position_max, r->position_max_relative, r->position_mean, r->normal_max_deg,
+               r->normal_mean_deg, r->tangent_max_deg, r->tex_coord_max, r->tex_coord_mean);
+    }
+}
+
+static void _print_lod_report(const batch_job_list_t *list) {
+    for (u64 i = 0; i < list->count; i++) {
+        const batch_job_t *job = &list->jobs[i];
+        if (job->status != BATCH_JOB_COMPILED) {
+            continue;
+        }
+        for (u32 l = 0; l < job->report.lod_count; l++) {
+            const mesh_file_lod_t *lod = &job->report.lods[l];
+            printf("%s: LOD%u %u triangles, error %g\n", job->relative, l, lod->index_count / 3, lod->error);
+        }
+    }
+}
+
+static void _print_scene_report(const batch_job_list_t *list) {
+    for (u64 i = 0; i < list->count; i++) {
+        const batch_job_t *job = &list->jobs[i];
+        if (job->status != BATCH_JOB_COMPILED || job->report.submesh_count < 2) {
+            continue;
+        }
+        printf("%s: %u submeshes, %u nodes\n", job->relative, job->report.submesh_count, job->report.node_count);
+    }
+}
+
+static void _print_meshlet_report(const batch_job_list_t *list) {
+    for (u64 i = 0; i < list->count; i++) {
+        const batch_job_t *job = &list->jobs[i];
+        if (job->status != BATCH_JOB_COMPILED) {
+            continue;
+        }
+        printf("%s: %llu meshlets, %.1f vertices %.1f triangles on average\n", job->relative,
+               job->report.meshlet_count, job->report.meshlet_vertices_mean, job->report.meshlet_triangles_mean);
+    }
+}
+
+static int _parse_meshlet_limits(const char *list, mesh_import_options_t *options) {
+    char *end = 0;
+    const unsigned long vertices = strtoul(list, &end, 10);
+    if (*end != ',') {
+        return 1;
+    }
+    const unsigned long triangles = strtoul(end + 1, &end, 10);
+    if (*end != '\0' || vertices < 3 || vertices > MESH_MESHLET_MAX_VERTICES || triangles < 1) {
+        return 1;
+    }
+    options->meshlet_max_vertices = (u32) vertices;
+    options->meshlet_max_triangles = (u32) triangles;
+    return 0;
+}
+
+static int _parse_lods(const char *list, mesh_import_options_t *options) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    options->lod_count = 0;
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(0, ",")) {
+        const f32 percent = strtof(tok, 0);
+        if (options->lod_count == MESH_LOD_MAX || percent <= 0.f || percent > 100.f) {
+            return 1;
+        }
+        options->lod_ratios[options->lod_count++] = percent / 100.f;
+    }
+    return options->lod_count == 0;
+}
+
+static int _parse_encodings(const char *list, u32 *flags) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(0, ",")) {
+        if (strcmp(tok, "pos16") == 0) {
+            *flags |= MESH_ENCODE_POSITIONS;
+        } else if (strcmp(tok, "oct16") == 0) {
+            *flags |= MESH_ENCODE_NORMALS;
+        } else if (strcmp(tok, "uv16") == 0) {
+            *flags |= MESH_ENCODE_TEX_COORDS;
+        } else if (strcmp(tok, "idx16") == 0) {
+            *flags |= MESH_ENCODE_INDICES;
+        } else if (strcmp(tok, "all") == 0) {
+            *flags |= MESH_ENCODE_ALL;
+        } else {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void _print_usage(const char *exe) {
+    printf("usage: %s [options] <input-dir | @manifest>\n"
+           "  -o <dir>    output directory (default: compiled)\n"
+           "  -j <n>      worker threads (default: all cores)\n"
+           "  --force     ignore the incremental cache\n"
+           "  --optimise  dedup and reorder for vertex cache, overdraw and fetch\n"
+           "  --encode <pos16,oct16,uv16,idx16|all>\n"
+           "              quantised attribute encodings, prints round trip error\n"
+           "  --max-position-error <f>  fail if error exceeds f of the mesh extent\n"
+           "  --max-normal-error <deg>  fail if normal/tangent error exceeds deg\n"
+           "  --max-uv-error <f>        fail if uv error exceeds f\n"
+           "  --lods <p0,p1,...>        LOD chain as triangle percentages, e.g. 100,50,25,12\n"
+           "  --meshlets                split LOD0 into meshlets of up to 64 vertices, 124 triangles\n"
+           "  --meshlet-limits <v,t>    meshlet vertex and triangle limits\n",
+           exe);
+}
+
+int main(int argc, const char **argv) {
+    batch_config_t config;
+    config.output_dir = "compiled";
+    config.worker_count = 0;
+    config.force = false;
+    config.options = mesh_import_options_default();
+    memset(&config.limits, 0, sizeof(config.limits));
+
+    const char *input = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            config.output_dir = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            config.worker_count = (u32) strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--force") == 0) {
+            config.force = true;
+        } else if (strcmp(argv[i], "--optimise") == 0) {
+            config.options.flags |= MESH_IMPORT_OPTIMISE;
+        } else if (strcmp(argv[i], "--encode") == 0 && i + 1 < argc) {
+            if (_parse_encodings(argv[++i], &config.options.encode_flags) != 0) {
+                _print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc) {
+            if (_parse_lods(argv[++i], &config.options) != 0) {
+                _print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--meshlets") == 0) {
+            config.options.meshlet_max_vertices = MESHLET_DEFAULT_MAX_VERTICES;
+            config.options.meshlet_max_triangles = MESHLET_DEFAULT_MAX_TRIANGLES;
+        } else if (strcmp(argv[i], "--meshlet-limits") == 0 && i + 1 < argc) {
+            if (_parse_meshlet_limits(argv[++i], &config.options) != 0) {
+                _print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--max-position-error") == 0 && i + 1 < argc) {
+            config.limits.position_relative = strtof(argv[++i], 0);
+        } else if (strcmp(argv[i], "--max-normal-error") == 0 && i + 1 < argc) {
+            config.limits.normal_deg = strtof(argv[++i], 0);
+        } else if (strcmp(argv[i], "--max-uv-error") == 0 && i + 1 < argc) {
+            config.limits.tex_coord = strtof(argv[++i], 0);
+        } else if (argv[i][0] != '-' && !input) {
+            input = argv[i];
+        } else {
+            _print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!input) {
+        _print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    batch_job_list_t list = {0};
+    const int collect_failed = input[0] == '@'
+                                   ? batch_collect_manifest(input + 1, &list)
+                                   : batch_collect_directory(input, &list);
+    if (collect_failed) {
+        fprintf(stderr, "failed to read inputs from %s\n", input);
+        return EXIT_FAILURE;
+    }
+
+    const batch_stats_t stats = batch_run(&config, &list);
+    _print_scene_report(&list);
+    if (config.options.flags & MESH_IMPORT_OPTIMISE) {
+        _print_optimise_report(&list);
+    }
+    if (config.options.encode_flags) {
+        _print_encoding_report(&list);
+    }
+    if (config.options.lod_count) {
+        _print_lod_report(&list);
+    }
+    if (config.options.meshlet_max_vertices) {
+        _print_meshlet_report(&list);
+    }
+    for (u64 i = 0; i < list.count; i++) {
+        if (list.jobs[i].status == BATCH_JOB_FAILED) {
+            fprintf(stderr, "failed: %s\n", list.jobs[i].input);
+        }
+    }
+    printf("%llu compiled, %llu up to date, %llu failed in %.2fs\n", stats.compiled, stats.skipped,
+           stats.failed, stats.seconds);
+
+    batch_job_list_free(&list);
+    mesh_cleanup();
+    return stats.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
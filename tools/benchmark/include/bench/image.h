@@ -0,0 +1,20 @@
+#ifndef BENCH_IMAGE_H
+#define BENCH_IMAGE_H
+
+#include <core/defines.h>
+
+// Captured frames are stored as binary PPM, alpha dropped.
+b8 bench_image_write_ppm(const char *path, const u8 *rgba, u32 width, u32 height);
+
+typedef struct {
+    // Pixels with any channel off by more than the tolerance.
+    u64 differing;
+    u32 max_difference;
+} bench_image_diff_t;
+
+// Compares rgba against a reference PPM. Returns 0 if the reference is
+// missing, unreadable or of another size.
+b8 bench_image_compare_ppm(const char *path, const u8 *rgba, u32 width, u32 height, u32 tolerance,
+                           bench_image_diff_t *out);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <core/defines.h>
+
+typedef enum {
+    // Whole loop iteration, from frame_begin to the return of frame_end.
+    BENCH_METRIC_FRAME = 0,
+    // frame_begin: the fence wait and, with a window, acquiring the image.
+    BENCH_METRIC_WAIT,
+    BENCH_METRIC_RECORD,
+    // frame_end: queue submit and, with a window, present.
+    BENCH_METRIC_SUBMIT,
+    BENCH_METRIC_COUNT,
+} bench_metric_t;
+
+typedef struct {
+    f64 mean;
+    f64 min;
+    f64 p50;
+    f64 p90;
+    f64 p95;
+    f64 p99;
+    f64 max;
+} bench_summary_t;
+
+typedef struct {
+    const char *name;
+    u32 frame_count;
+    u32 sample_capacity;
+    // Milliseconds, one per measured frame.
+    f64 *samples[BENCH_METRIC_COUNT];
+    bench_summary_t summary[BENCH_METRIC_COUNT];
+    // Tagged core allocations made per measured frame, on average.
+    f64 cpu_allocations_per_frame;
+    // Live GPU allocations once the scene is set up.
+    u32 gpu_allocations;
+} bench_result_t;
+
+typedef struct {
+    const char *device;
+    u32 width;
+    u32 height;
+    u32 warmup;
+    u32 frames;
+} bench_run_info_t;
+
+const char *bench_metric_name(bench_metric_t metric);
+
+// Room for frame_count samples. A run cut short lowers frame_count.
+void bench_result_init(bench_result_t *result, const char *name, u32 frame_count);
+void bench_result_free(bench_result_t *result);
+// Fills summary from samples, nearest rank percentiles.
+void bench_summarise(bench_result_t *result);
+
+void bench_print(const bench_result_t *results, u32 count);
+b8 bench_write_json(const char *path, const bench_run_info_t *info, const bench_result_t *results, u32 count);
+
+// Compares against a report written by bench_write_json. A timing regresses
+// when its p50 or p95 grows by more than threshold_percent and by at least
+// BENCH_MIN_REGRESSION_MS; allocation counts regress on any growth. Scenes
+// missing from the baseline are skipped. Returns the number of regressions,
+// or -1 if the baseline could not be read.
+#define BENCH_MIN_REGRESSION_MS 0.05
+i32 bench_compare_baseline(const char *path, const bench_result_t *results, u32 count, f64 threshold_percent);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef BENCH_SCENE_H
+#define BENCH_SCENE_H
+
+#include <core/defines.h>
+#include "engine/backend/frame.h"
+#include "engine/backend/gpu_memory.h"
+#include "engine/backend/pipeline.h"
+
+#define BENCH_DEFAULT_DRAW_COUNT 4096
+// Bytes the upload scene streams to the GPU every frame.
+#define BENCH_UPLOAD_BYTES (4ull << 20)
+
+typedef struct {
+    pipeline_def_t pipeline;
+    u32 draw_count;
+    // One target per frame slot, the upload of a frame never writes into a
+    // buffer a frame still in flight was given.
+    VkBuffer upload_targets[FRAME_MAX_IN_FLIGHT];
+    gpu_allocation_t upload_memory[FRAME_MAX_IN_FLIGHT];
+    u64 upload_tickets[FRAME_MAX_IN_FLIGHT];
+    u32 upload_target_count;
+    u8 *upload_data;
+} bench_context_t;
+
+// A scripted scene renders the same thing every frame, so timings from one
+// run can be compared with the next. record is called between beginning and
+// ending the main pass, which begins with the scene's contents.
+typedef struct {
+    const char *name;
+    const char *description;
+    VkSubpassContents contents;
+    b8 (*setup)(bench_context_t *ctx);
+    void (*record)(bench_context_t *ctx, const frame_t *frame);
+    void (*teardown)(bench_context_t *ctx);
+} bench_scene_t;
+
+const bench_scene_t *bench_scenes(u32 *out_count);
+// Null if there is no scene by that name.
+const bench_scene_t *bench_find_scene(const char *name);
+
+#endif
@@ -0,0 +1,100 @@
+#include "bench/image.h"
+
+#include <core/file.h>
+#include <core/memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+b8 bench_image_write_ppm(const char *path, const u8 *rgba, u32 width, u32 height) {
+    char header[64];
+    const int header_size = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+    const u64 pixel_bytes = (u64) width * height * 3;
+    const u64 size = (u64) header_size + pixel_bytes;
+    u8 *data = memory_alloc(size, MEMORY_TAG_FILE);
+    if (!data) {
+        return false;
+    }
+    memcpy(data, header, header_size);
+    u8 *dst = data + header_size;
+    for (u64 i = 0; i < (u64) width * height; i++) {
+        dst[i * 3 + 0] = rgba[i * 4 + 0];
+        dst[i * 3 + 1] = rgba[i * 4 + 1];
+        dst[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+    const file_result_t result = file_write_atomic(path, data, size);
+    memory_free(data, size, MEMORY_TAG_FILE);
+    return result == FILE_OK;
+}
+
+// Header tokens are separated by whitespace, comments run to the end of the
+// line.
+static const char *_skip_space(const char *p, const char *end) {
+    while (p < end) {
+        if (*p == '#') {
+            while (p < end && *p != '\n') {
+                p++;
+            }
+        } else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+b8 bench_image_compare_ppm(const char *path, const u8 *rgba, u32 width, u32 height, u32 tolerance,
+                           bench_image_diff_t *out) {
+    file_buffer_t file;
+    if (file_read_all(path, &file) != FILE_OK) {
+        return false;
+    }
+    const char *p = (const char *) file.data;
+    const char *end = p + file.size;
+    if (file.size < 2 || p[0] != 'P' || p[1] != '6') {
+        file_buffer_free(&file);
+        return false;
+    }
+    p += 2;
+    u64 header[3];
+    for (u32 i = 0; i < 3; i++) {
+        p = _skip_space(p, end);
+        char *next = 0;
+        header[i] = strtoull(p, &next, 10);
+        if (next == p) {
+            file_buffer_free(&file);
+            return false;
+        }
+        p = next;
+    }
+    // Exactly one whitespace byte separates the header from the pixels.
+    p++;
+    const u64 pixel_count = (u64) width * height;
+    if (header[0] != width || header[1] != height || header[2] != 255 || p + pixel_count * 3 > end) {
+        file_buffer_free(&file);
+        return false;
+    }
+
+    const u8 *reference = (const u8 *) p;
+    out->differing = 0;
+    out->max_difference = 0;
+    for (u64 i = 0; i < pixel_count; i++) {
+        u32 pixel_difference = 0;
+        for (u32 c = 0; c < 3; c++) {
+            const i32 d = (i32) rgba[i * 4 + c] - (i32) reference[i * 3 + c];
+            const u32 difference = (u32) (d < 0 ? -d : d);
+            if (difference > pixel_difference) {
+                pixel_difference = difference;
+            }
+        }
+        if (pixel_difference > tolerance) {
+            out->differing++;
+        }
+        if (pixel_difference > out->max_difference) {
+            out->max_difference = pixel_difference;
+        }
+    }
+    file_buffer_free(&file);
+    return true;
+}
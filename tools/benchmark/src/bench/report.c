@@ -0,0 +1,231 @@
+#include "bench/report.h"
+
+#include <core/file.h>
+#include <core/memory.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *metric_names[BENCH_METRIC_COUNT] = {"frame_ms", "wait_ms", "record_ms", "submit_ms"};
+
+const char *bench_metric_name(bench_metric_t metric) { return metric_names[metric]; }
+
+void bench_result_init(bench_result_t *result, const char *name, u32 frame_count) {
+    memset(result, 0, sizeof(*result));
+    result->name = name;
+    result->frame_count = frame_count;
+    result->sample_capacity = frame_count;
+    for (u32 m = 0; m < BENCH_METRIC_COUNT; m++) {
+        result->samples[m] = memory_alloc_zeroed(sizeof(f64) * frame_count, MEMORY_TAG_ARRAY);
+    }
+}
+
+void bench_result_free(bench_result_t *result) {
+    for (u32 m = 0; m < BENCH_METRIC_COUNT; m++) {
+        memory_free(result->samples[m], sizeof(f64) * result->sample_capacity, MEMORY_TAG_ARRAY);
+        result->samples[m] = 0;
+    }
+}
+
+static int _compare_f64(const void *a, const void *b) {
+    const f64 x = *(const f64 *) a;
+    const f64 y = *(const f64 *) b;
+    return (x > y) - (x < y);
+}
+
+static f64 _percentile(const f64 *sorted, u32 count, f64 percent) {
+    u32 rank = (u32) (percent / 100.0 * count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > count) {
+        rank = count;
+    }
+    return sorted[rank - 1];
+}
+
+void bench_summarise(bench_result_t *result) {
+    const u32 count = result->frame_count;
+    if (count == 0) {
+        return;
+    }
+    f64 *sorted = memory_alloc(sizeof(f64) * count, MEMORY_TAG_ARRAY);
+    for (u32 m = 0; m < BENCH_METRIC_COUNT; m++) {
+        memcpy(sorted, result->samples[m], sizeof(f64) * count);
+        qsort(sorted, count, sizeof(f64), _compare_f64);
+        f64 sum = 0.0;
+        for (u32 i = 0; i < count; i++) {
+            sum += sorted[i];
+        }
+        bench_summary_t *s = &result->summary[m];
+        s->mean = sum / count;
+        s->min = sorted[0];
+        s->p50 = _percentile(sorted, count, 50.0);
+        s->p90 = _percentile(sorted, count, 90.0);
+        s->p95 = _percentile(sorted, count, 95.0);
+        s->p99 = _percentile(sorted, count, 99.0);
+        s->max = sorted[count - 1];
+    }
+    memory_free(sorted, sizeof(f64) * count, MEMORY_TAG_ARRAY);
+}
+
+void bench_print(const bench_result_t *results, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        printf("%s: %u frames, %.2f allocations/frame, %u gpu allocations\n", r->name, r->frame_count,
+               r->cpu_allocations_per_frame, r->gpu_allocations);
+        for (u32 m = 0; m < BENCH_METRIC_COUNT; m++) {
+            const bench_summary_t *s = &r->summary[m];
+            printf("  %-10s mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n", metric_names[m], s->mean, s->p50,
+                   s->p95, s->p99, s->max);
+        }
+    }
+}
+
+typedef struct {
+    char *data;
+    u64 size;
+    u64 capacity;
+} json_writer_t;
+
+static void _appendf(json_writer_t *w, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int needed = vsnprintf(0, 0, fmt, args);
+    va_end(args);
+    if (w->size + needed + 1 > w->capacity) {
+        u64 capacity = w->capacity ? w->capacity * 2 : 4096;
+        while (capacity < w->size + needed + 1) {
+            capacity *= 2;
+        }
+        w->data = memory_realloc(w->data, w->capacity, capacity, MEMORY_TAG_ARRAY);
+        w->capacity = capacity;
+    }
+    va_start(args, fmt);
+    vsnprintf(w->data + w->size, needed + 1, fmt, args);
+    va_end(args);
+    w->size += needed;
+}
+
+// Device names come from the driver, keep them printable and quote free.
+static void _append_string(json_writer_t *w, const char *s) {
+    _appendf(w, "\"");
+    for (; *s; s++) {
+        _appendf(w, "%c", (*s == '"' || *s == '\\' || *s < ' ') ? '_' : *s);
+    }
+    _appendf(w, "\"");
+}
+
+b8 bench_write_json(const char *path, const bench_run_info_t *info, const bench_result_t *results, u32 count) {
+    json_writer_t w = {0};
+    _appendf(&w, "{\n  \"device\": ");
+    _append_string(&w, info->device);
+    _appendf(&w, ",\n  \"width\": %u,\n  \"height\": %u,\n  \"warmup\": %u,\n  \"frames\": %u,\n  \"scenes\": [",
+             info->width, info->height, info->warmup, info->frames);
+    for (u32 i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        _appendf(&w, "%s\n    {\n      \"name\": ", i ? "," : "");
+        _append_string(&w, r->name);
+        _appendf(&w, ",\n");
+        for (u32 m = 0; m < BENCH_METRIC_COUNT; m++) {
+            const bench_summary_t *s = &r->summary[m];
+            _appendf(&w,
+                     "      \"%s\": {\"mean\": %.6f, \"min\": %.6f, \"p50\": %.6f, \"p90\": %.6f, \"p95\": %.6f, "
+                     "\"p99\": %.6f, \"max\": %.6f},\n",
+                     metric_names[m], s->mean, s->min, s->p50, s->p90, s->p95, s->p99, s->max);
+        }
+        _appendf(&w, "      \"cpu_allocations_per_frame\": %.6f,\n      \"gpu_allocations\": %u\n    }",
+                 r->cpu_allocations_per_frame, r->gpu_allocations);
+    }
+    _appendf(&w, "\n  ]\n}\n");
+    const file_result_t result = file_write_atomic(path, w.data, w.size);
+    memory_free(w.data, w.capacity, MEMORY_TAG_ARRAY);
+    return result == FILE_OK;
+}
+
+// Not a general JSON reader: it relies on the layout bench_write_json
+// produces, one object per scene with its name first.
+static const char *_find_scene(const char *text, const char *name, const char **out_end) {
+    char key[256];
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    const char *scene = strstr(text, key);
+    if (!scene) {
+        return 0;
+    }
+    const char *next = strstr(scene + 1, "\"name\": ");
+    *out_end = next ? next : scene + strlen(scene);
+    return scene;
+}
+
+static b8 _find_number(const char *begin, const char *end, const char *object, const char *field, f64 *out) {
+    char key[64];
+    const char *p = begin;
+    if (object) {
+        snprintf(key, sizeof(key), "\"%s\": {", object);
+        p = strstr(p, key);
+        if (!p || p >= end) {
+            return false;
+        }
+    }
+    snprintf(key, sizeof(key), "\"%s\": ", field);
+    p = strstr(p, key);
+    if (!p || p >= end) {
+        return false;
+    }
+    char *number_end = 0;
+    *out = strtod(p + strlen(key), &number_end);
+    return number_end != p + strlen(key);
+}
+
+static b8 _regressed(const char *scene, const char *what, f64 baseline, f64 current, f64 threshold_percent) {
+    const f64 change = baseline > 0.0 ? (current - baseline) / baseline * 100.0 : 0.0;
+    const b8 regressed = change > threshold_percent && current - baseline >= BENCH_MIN_REGRESSION_MS;
+    printf("%s %s: %.3f -> %.3f (%+.1f%%)%s\n", scene, what, baseline, current, change,
+           regressed ? " REGRESSION" : "");
+    return regressed;
+}
+
+i32 bench_compare_baseline(const char *path, const bench_result_t *results, u32 count, f64 threshold_percent) {
+    file_buffer_t file;
+    if (file_read_all(path, &file) != FILE_OK) {
+        return -1;
+    }
+    const char *text = (const char *) file.data;
+    i32 regressions = 0;
+    for (u32 i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        const char *end = 0;
+        const char *scene = _find_scene(text, r->name, &end);
+        if (!scene) {
+            printf("%s: not in baseline\n", r->name);
+            continue;
+        }
+        for (u32 m = 0; m < BENCH_METRIC_COUNT; m++) {
+            char what[64];
+            f64 baseline;
+            if (_find_number(scene, end, metric_names[m], "p50", &baseline)) {
+                snprintf(what, sizeof(what), "%s p50", metric_names[m]);
+                regressions += _regressed(r->name, what, baseline, r->summary[m].p50, threshold_percent);
+            }
+            if (_find_number(scene, end, metric_names[m], "p95", &baseline)) {
+                snprintf(what, sizeof(what), "%s p95", metric_names[m]);
+                regressions += _regressed(r->name, what, baseline, r->summary[m].p95, threshold_percent);
+            }
+        }
+        // Allocation counts are deterministic, any growth is a regression.
+        f64 baseline;
+        if (_find_number(scene, end, 0, "cpu_allocations_per_frame", &baseline) &&
+            r->cpu_allocations_per_frame > baseline + 0.5) {
+            printf("%s allocations/frame: %.2f -> %.2f REGRESSION\n", r->name, baseline,
+                   r->cpu_allocations_per_frame);
+            regressions++;
+        }
+        if (_find_number(scene, end, 0, "gpu_allocations", &baseline) && r->gpu_allocations > baseline) {
+            printf("%s gpu allocations: %.0f -> %u REGRESSION\n", r->name, baseline, r->gpu_allocations);
+            regressions++;
+        }
+    }
+    file_buffer_free(&file);
+    return regressions;
+}
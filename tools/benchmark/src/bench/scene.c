@@ -0,0 +1,106 @@
+#include "bench/scene.h"
+
+#include <core/memory.h>
+#include <string.h>
+
+#include "engine/backend/gpu.h"
+#include "engine/backend/record.h"
+#include "engine/backend/upload.h"
+
+static void _record_clear(bench_context_t *ctx, const frame_t *frame) {}
+
+// One draw call per triangle measures per draw CPU cost, not the GPU.
+static void _record_draws_range(VkCommandBuffer cmd, void *user_data, u32 begin, u32 end) {
+    bench_context_t *ctx = user_data;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->pipeline.pipeline);
+    for (u32 i = begin; i < end; i++) {
+        vkCmdDraw(cmd, 3, 1, 0, i);
+    }
+}
+
+static void _record_draws(bench_context_t *ctx, const frame_t *frame) {
+    _record_draws_range(frame->cmd, ctx, 0, ctx->draw_count);
+}
+
+static void _record_draws_parallel(bench_context_t *ctx, const frame_t *frame) {
+    record_parallel(frame, _record_draws_range, ctx, ctx->draw_count, 64);
+}
+
+static void _teardown_upload(bench_context_t *ctx);
+
+static b8 _setup_upload(bench_context_t *ctx) {
+    VkBufferCreateInfo info;
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.pNext = 0;
+    info.flags = 0;
+    info.size = BENCH_UPLOAD_BYTES;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = 0;
+    info.pQueueFamilyIndices = 0;
+    ctx->upload_data = memory_alloc(BENCH_UPLOAD_BYTES, MEMORY_TAG_RENDERER);
+    ctx->upload_target_count = 0;
+    for (u32 i = 0; i < frame_in_flight_count(); i++) {
+        if (gpu_buffer_create(&info, GPU_MEMORY_DEVICE, &ctx->upload_targets[i], &ctx->upload_memory[i]) !=
+            VK_SUCCESS) {
+            _teardown_upload(ctx);
+            return false;
+        }
+        ctx->upload_tickets[i] = 0;
+        ctx->upload_target_count++;
+    }
+    for (u64 i = 0; i < BENCH_UPLOAD_BYTES; i++) {
+        ctx->upload_data[i] = (u8) (i * 31);
+    }
+    return true;
+}
+
+// Nothing reads the targets, but a real renderer would have read this slot's
+// target in the frame that last used the slot, which frame_begin waited for.
+// Its upload went out that many frames ago and is retired by now, so the
+// wait only stalls when the transfer queue falls behind.
+static void _record_upload(bench_context_t *ctx, const frame_t *frame) {
+    upload_wait(ctx->upload_tickets[frame->slot]);
+    upload_release(ctx->upload_targets[frame->slot]);
+    ctx->upload_tickets[frame->slot] =
+        upload_buffer(ctx->upload_targets[frame->slot], 0, ctx->upload_data, BENCH_UPLOAD_BYTES);
+    upload_update();
+}
+
+static void _teardown_upload(bench_context_t *ctx) {
+    // The buffers may still be the target of a copy or an ownership transfer.
+    for (u32 i = 0; i < ctx->upload_target_count; i++) {
+        upload_wait(ctx->upload_tickets[i]);
+    }
+    vkDeviceWaitIdle(gpu_get_vk_device());
+    for (u32 i = 0; i < ctx->upload_target_count; i++) {
+        upload_release(ctx->upload_targets[i]);
+        gpu_buffer_destroy(ctx->upload_targets[i], ctx->upload_memory[i]);
+    }
+    ctx->upload_target_count = 0;
+    memory_free(ctx->upload_data, BENCH_UPLOAD_BYTES, MEMORY_TAG_RENDERER);
+    ctx->upload_data = 0;
+}
+
+static const bench_scene_t scenes[] = {
+    {"clear", "main pass clear only", VK_SUBPASS_CONTENTS_INLINE, 0, _record_clear, 0},
+    {"draws", "one draw call per triangle, recorded inline", VK_SUBPASS_CONTENTS_INLINE, 0, _record_draws, 0},
+    {"draws_parallel", "the draws scene recorded on the job system into secondary buffers",
+     VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, 0, _record_draws_parallel, 0},
+    {"upload", "4MB streamed through the staging ring every frame", VK_SUBPASS_CONTENTS_INLINE, _setup_upload,
+     _record_upload, _teardown_upload},
+};
+
+const bench_scene_t *bench_scenes(u32 *out_count) {
+    *out_count = sizeof(scenes) / sizeof(scenes[0]);
+    return scenes;
+}
+
+const bench_scene_t *bench_find_scene(const char *name) {
+    for (u32 i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+        if (strcmp(scenes[i].name, name) == 0) {
+            return &scenes[i];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <core/jobs.h>
+#include <core/memory.h>
+#include <core/profiler.h>
+
+#include "bench/image.h"
+#include "bench/report.h"
+#include "bench/scene.h"
+#include "engine/backend/gpu.h"
+#include "engine/backend/record.h"
+#include "engine/backend/upload.h"
+#include "engine/backend/window.h"
+
+typedef struct {
+    const char *scenes;
+    u32 frames;
+    u32 warmup;
+    u32 draws;
+    u32 width;
+    u32 height;
+    u32 threads;
+    b8 windowed;
+    const char *device;
+    const char *shader_dir;
+    const char *json_path;
+    const char *baseline_path;
+    f64 threshold;
+    const char *capture_dir;
+    const char *reference_dir;
+    u32 tolerance;
+    const char *trace_path;
+} bench_config_t;
+
+static f64 _now_ms() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (f64) ts.tv_sec * 1e3 + (f64) ts.tv_nsec * 1e-6;
+}
+
+static u64 _cpu_allocation_count() {
+    memory_stats_t stats;
+    memory_get_stats(&stats);
+    u64 count = 0;
+    for (u32 i = 0; i < MEMORY_TAG_COUNT; i++) {
+        count += stats.allocations[i];
+    }
+    return count;
+}
+
+static void _render_frame(const bench_scene_t *scene, bench_context_t *ctx, b8 capture, frame_t *out_frame,
+                          f64 out_ms[BENCH_METRIC_COUNT]) {
+    static const float clear_color[4] = {0.1f, 0.1f, 0.1f, 1.f};
+    PROFILE_BEGIN(scene->name);
+    frame_t frame;
+    f64 start;
+    do {
+        start = _now_ms();
+    } while (!frame_begin(&frame));
+    const f64 begun = _now_ms();
+    frame_begin_main_pass(&frame, clear_color, scene->contents);
+    scene->record(ctx, &frame);
+    frame_end_main_pass(&frame);
+    if (capture) {
+        frame_capture(&frame);
+    }
+    const f64 recorded = _now_ms();
+    frame_end(&frame);
+    const f64 end = _now_ms();
+
+    out_ms[BENCH_METRIC_FRAME] = end - start;
+    out_ms[BENCH_METRIC_WAIT] = begun - start;
+    out_ms[BENCH_METRIC_RECORD] = recorded - begun;
+    out_ms[BENCH_METRIC_SUBMIT] = end - recorded;
+    *out_frame = frame;
+    PROFILE_END();
+}
+
+// Renders one more, unmeasured frame and keeps it. Returns false on a render
+// regression.
+static b8 _check_image(const bench_config_t *config, const bench_scene_t *scene, bench_context_t *ctx) {
+    frame_t frame;
+    f64 ms[BENCH_METRIC_COUNT];
+    _render_frame(scene, ctx, true, &frame, ms);
+    const u64 size = (u64) frame.extent.width * frame.extent.height * 4;
+    u8 *pixels = memory_alloc(size, MEMORY_TAG_RENDERER);
+    b8 ok = frame_read_capture(&frame, pixels);
+    if (!ok) {
+        fprintf(stderr, "%s: failed to read back the frame\n", scene->name);
+    }
+
+    char path[1024];
+    if (ok && config->capture_dir) {
+        snprintf(path, sizeof(path), "%s/%s.ppm", config->capture_dir, scene->name);
+        if (!bench_image_write_ppm(path, pixels, frame.extent.width, frame.extent.height)) {
+            fprintf(stderr, "failed to write %s\n", path);
+        }
+    }
+    if (ok && config->reference_dir) {
+        snprintf(path, sizeof(path), "%s/%s.ppm", config->reference_dir, scene->name);
+        bench_image_diff_t diff;
+        if (!bench_image_compare_ppm(path, pixels, frame.extent.width, frame.extent.height, config->tolerance,
+                                     &diff)) {
+            fprintf(stderr, "%s: no usable reference image at %s\n", scene->name, path);
+            ok = false;
+        } else if (diff.differing > 0) {
+            printf("%s: %llu pixels differ, by up to %u RENDER REGRESSION\n", scene->name, diff.differing,
+                   diff.max_difference);
+            ok = false;
+        } else {
+            printf("%s: matches reference, max difference %u\n", scene->name, diff.max_difference);
+        }
+    }
+    memory_free(pixels, size, MEMORY_TAG_RENDERER);
+    return ok;
+}
+
+static b8 _run_scene(const bench_config_t *config, const bench_scene_t *scene, bench_context_t *ctx,
+                     bench_result_t *result, b8 *out_image_ok) {
+    if (scene->setup && !scene->setup(ctx)) {
+        fprintf(stderr, "%s: setup failed\n", scene->name);
+        return false;
+    }
+
+    frame_t frame;
+    f64 ms[BENCH_METRIC_COUNT];
+    for (u32 i = 0; i < config->warmup && gpu_pump_events(); i++) {
+        _render_frame(scene, ctx, false, &frame, ms);
+    }
+
+    bench_result_init(result, scene->name, config->frames);
+    const u64 allocations_before = _cpu_allocation_count();
+    u32 measured = 0;
+    for (; measured < config->frames && gpu_pump_events(); measured++) {
+        _render_frame(scene, ctx, false, &frame, ms);
+        for (u32 m = 0; m < BENCH_METRIC_COUNT; m++) {
+            result->samples[m][measured] = ms[m];
+        }
+    }
+    if (measured > 0) {
+        result->cpu_allocations_per_frame = (f64) (_cpu_allocation_count() - allocations_before) / measured;
+    }
+    // A closed window cuts the run short, only what was measured counts.
+    result->frame_count = measured;
+    gpu_memory_stats_t gpu_stats;
+    gpu_memory_get_stats(&gpu_stats);
+    result->gpu_allocations = gpu_stats.allocations;
+    bench_summarise(result);
+
+    *out_image_ok = true;
+    if (gpu_is_headless() && (config->capture_dir || config->reference_dir)) {
+        *out_image_ok = _check_image(config, scene, ctx);
+    }
+    vkDeviceWaitIdle(gpu_get_vk_device());
+    if (scene->teardown) {
+        scene->teardown(ctx);
+    }
+    return true;
+}
+
+static void _print_usage(const char *exe) {
+    u32 scene_count;
+    const bench_scene_t *scenes = bench_scenes(&scene_count);
+    printf("usage: %s [options]\n"
+           "  --scenes <a,b,...>     scenes to run (default: all)\n"
+           "  --frames <n>           measured frames per scene (default: 300)\n"
+           "  --warmup <n>           unmeasured frames before each scene (default: 30)\n"
+           "  --draws <n>            draw calls in the draw scenes (default: %u)\n"
+           "  --resolution <wxh>     render target size (default: 1280x720)\n"
+           "  -j <n>                 job system threads (default: 4)\n"
+           "  --shaders <dir>        directory with vert.spv and frag.spv (default: shaders)\n"
+           "  --window               present to a window instead of rendering headless\n"
+           "  --device <n|name>      GPU by index or part of its name (default: best scoring)\n"
+           "  --json <path>          write the report as JSON\n"
+           "  --baseline <path>      compare against an earlier JSON report\n"
+           "  --threshold <percent>  allowed slowdown before a timing regresses (default: 5)\n"
+           "  --capture <dir>        write each scene's final frame as <scene>.ppm\n"
+           "  --reference <dir>      compare each scene's final frame with <dir>/<scene>.ppm\n"
+           "  --tolerance <n>        allowed per channel difference (default: 2)\n"
+           "  --trace <path>         write profiling zones as a Chrome trace (needs POTENTIA_PROFILE)\n"
+           "scenes:\n",
+           exe, BENCH_DEFAULT_DRAW_COUNT);
+    for (u32 i = 0; i < scene_count; i++) {
+        printf("  %-16s %s\n", scenes[i].name, scenes[i].description);
+    }
+}
+
+static b8 _parse_resolution(const char *s, bench_config_t *config) {
+    char *end = 0;
+    const unsigned long w = strtoul(s, &end, 10);
+    if (*end != 'x') {
+        return false;
+    }
+    const unsigned long h = strtoul(end + 1, &end, 10);
+    if (*end != '\0' || w == 0 || h == 0) {
+        return false;
+    }
+    config->width = (u32) w;
+    config->height = (u32) h;
+    return true;
+}
+
+int main(int argc, const char **argv) {
+    bench_config_t config;
+    config.scenes = 0;
+    config.frames = 300;
+    config.warmup = 30;
+    config.draws = BENCH_DEFAULT_DRAW_COUNT;
+    config.width = 1280;
+    config.height = 720;
+    config.threads = 4;
+    config.windowed = false;
+    config.device = 0;
+    config.shader_dir = "shaders";
+    config.json_path = 0;
+    config.baseline_path = 0;
+    config.threshold = 5.0;
+    config.capture_dir = 0;
+    config.reference_dir = 0;
+    config.tolerance = 2;
+    config.trace_path = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scenes") == 0 && i + 1 < argc) {
+            config.scenes = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            config.frames = (u32) strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            config.warmup = (u32) strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+            config.draws = (u32) strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            if (!_parse_resolution(argv[++i], &config)) {
+                _print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            config.threads = (u32) strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc) {
+            config.shader_dir = argv[++i];
+        } else if (strcmp(argv[i], "--window") == 0) {
+            config.windowed = true;
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            config.device = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            config.json_path = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            config.baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            config.threshold = strtod(argv[++i], 0);
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            config.capture_dir = argv[++i];
+        } else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc) {
+            config.reference_dir = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            config.tolerance = (u32) strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            config.trace_path = argv[++i];
+        } else {
+            _print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (config.frames == 0) {
+        _print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    u32 scene_count;
+    const bench_scene_t *all_scenes = bench_scenes(&scene_count);
+    const bench_scene_t *selected[32];
+    u32 selected_count = 0;
+    if (config.scenes) {
+        char buf[512];
+        snprintf(buf, sizeof(buf), "%s", config.scenes);
+        for (char *tok = strtok(buf, ","); tok; tok = strtok(0, ",")) {
+            const bench_scene_t *scene = bench_find_scene(tok);
+            if (!scene || selected_count == sizeof(selected) / sizeof(selected[0])) {
+                fprintf(stderr, "unknown scene %s\n", tok);
+                return EXIT_FAILURE;
+            }
+            selected[selected_count++] = scene;
+        }
+    } else {
+        for (u32 i = 0; i < scene_count; i++) {
+            selected[selected_count++] = &all_scenes[i];
+        }
+    }
+
+    profiler_init();
+    PROFILE_THREAD_NAME("main");
+    window_preset_resolution(config.width, config.height);
+    window_set_title("potentia benchmark");
+    gpu_preset_headless(!config.windowed);
+    gpu_preset_device(config.device);
+    gpu_init_vk("benchmark", VK_MAKE_VERSION(0, 0, 1));
+    const u32 workers = config.threads > 0 ? config.threads - 1 : 0;
+    if (job_system_init(workers) < workers) {
+        fprintf(stderr, "started fewer than %u job workers, parallel scenes are not comparable\n", workers);
+    }
+    frame_init(FRAME_DEFAULT_IN_FLIGHT);
+    record_init();
+    upload_init(UPLOAD_DEFAULT_RING_SIZE);
+
+    char vertex_shader[1024];
+    char fragment_shader[1024];
+    snprintf(vertex_shader, sizeof(vertex_shader), "%s/vert.spv", config.shader_dir);
+    snprintf(fragment_shader, sizeof(fragment_shader), "%s/frag.spv", config.shader_dir);
+    pipeline_desc_t desc;
+    pipeline_desc_init(&desc);
+    desc.vertex_shader = vertex_shader;
+    desc.fragment_shader = fragment_shader;
+
+    bench_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.pipeline = create_graphics_pipeline(&desc);
+    ctx.draw_count = config.draws;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(gpu_get_vk_phy_device(), &props);
+    printf("%s, %ux%u, %u warmup + %u measured frames per scene\n", props.deviceName, config.width, config.height,
+           config.warmup, config.frames);
+
+    bench_result_t results[32];
+    u32 result_count = 0;
+    b8 failed = false;
+    for (u32 i = 0; i < selected_count; i++) {
+        b8 image_ok;
+        if (!_run_scene(&config, selected[i], &ctx, &results[result_count], &image_ok)) {
+            failed = true;
+            continue;
+        }
+        failed |= !image_ok;
+        result_count++;
+    }
+    bench_print(results, result_count);
+
+    if (config.json_path) {
+        bench_run_info_t info;
+        info.device = props.deviceName;
+        info.width = config.width;
+        info.height = config.height;
+        info.warmup = config.warmup;
+        info.frames = config.frames;
+        if (!bench_write_json(config.json_path, &info, results, result_count)) {
+            fprintf(stderr, "failed to write %s\n", config.json_path);
+            failed = true;
+        }
+    }
+    if (config.baseline_path) {
+        const i32 regressions = bench_compare_baseline(config.baseline_path, results, result_count, config.threshold);
+        if (regressions < 0) {
+            fprintf(stderr, "failed to read baseline %s\n", config.baseline_path);
+            failed = true;
+        } else if (regressions > 0) {
+            printf("%d regressions against %s\n", regressions, config.baseline_path);
+            failed = true;
+        }
+    }
+
+    for (u32 i = 0; i < result_count; i++) {
+        bench_result_free(&results[i]);
+    }
+    upload_shutdown();
+    record_shutdown();
+    frame_shutdown();
+    job_system_shutdown();
+    gpu_destroy_vk();
+    if (config.trace_path && !profiler_export_chrome(config.trace_path)) {
+        fprintf(stderr, "failed to write %s\n", config.trace_path);
+        failed = true;
+    }
+    profiler_shutdown();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}